@@ -110,6 +110,7 @@ void easm_del_expr(struct easm_expr *expr) {
 	easm_del_expr(expr->e2);
 	free(expr->astr.str);
 	free(expr->str);
+	free(expr->alabel);
 	easm_del_sinsn(expr->sinsn);
 	easm_del_mods(expr->mods);
 	free(expr);
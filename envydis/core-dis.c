@@ -370,32 +370,6 @@ void atombf_d DPROTO {
 	ADDARRAY(ctx->atoms, makeli(expr));
 }
 
-struct dis_op_chunk {
-	int len;
-	int isbe;
-};
-
-struct dis_res {
-	enum dis_status {
-		DIS_STATUS_OK = 0,
-		DIS_STATUS_EOF = 0x1,		/* EOF in the middle of an opcode */
-		DIS_STATUS_UNK_FORM = 0x2,	/* failed to determine instruction format - opcode length uncertain */
-		DIS_STATUS_UNK_INSN = 0x4,	/* failed to determine instruction name - unknown opcode or due to one of the above errors */
-		DIS_STATUS_UNK_OPERAND = 0x8,	/* failed to determine instruction operands */
-		DIS_STATUS_UNUSED_BITS = 0x10,	/* instruction decoded, but unused bitfields have non-default values */
-	} status;
-	uint32_t oplen;
-	struct dis_op_chunk *chunks;
-	int chunksnum;
-	int chunksmax;
-//	uint32_t align;
-//	uint32_t askip;
-	ull a[MAXOPLEN], m[MAXOPLEN];
-	struct easm_insn *insn;
-	int endmark;
-//	uint32_t *umask;
-};
-
 static struct easm_sinsn *dis_parse_sinsn(struct disctx *ctx, enum dis_status *status, int *spos);
 
 static struct easm_expr *dis_parse_expr(struct disctx *ctx, enum dis_status *status, int *spos) {
@@ -461,28 +435,33 @@ static struct easm_insn *dis_parse_insn(struct disctx *ctx, enum dis_status *sta
 struct decoctx {
 	const struct disisa *isa;
 	struct varinfo *varinfo;
-	uint8_t *code;
+	const uint8_t *code;
 	int *marks;
 	const char **names;
 	uint32_t codebase;
 	uint32_t codesz;
+	int stride;
 	struct label *labels;
 	int labelsnum;
 	int labelsmax;
 };
 
-struct dis_res *do_dis(struct decoctx *deco, uint32_t cur) {
-	struct disctx c = { 0 };
-	struct disctx *ctx = &c;
-	struct dis_res *res = calloc(sizeof *res, 1);
+static void do_dis(struct decoctx *deco, struct disctx *ctx, uint32_t cur, struct ed_insn *res) {
+	ull a[MAXOPLEN] = { 0 }, m[MAXOPLEN] = { 0 };
 	int i;
-	int stride = ed_getcstride(deco->isa, deco->varinfo);
+	int stride = deco->stride;
+	memset(res, 0, sizeof *res);
 	for (i = 0; i < MAXOPLEN*8 && cur + i/stride < deco->codesz; i++) {
-		res->a[i/8] |= (ull)deco->code[cur*stride + i] << (i&7)*8;
+		a[i/8] |= (ull)deco->code[cur*stride + i] << (i&7)*8;
 	}
+	memcpy(res->raw, a, sizeof a);
+	res->avail = deco->codesz - cur;
 	ctx->isa = deco->isa;
 	ctx->varinfo = deco->varinfo;
-	atomtab_d (ctx, res->a, res->m, deco->isa->troot);
+	ctx->oplen = 0;
+	ctx->endmark = 0;
+	ctx->atomsnum = 0;
+	atomtab_d (ctx, a, m, deco->isa->troot);
 	res->oplen = ctx->oplen;
 	if (res->oplen + cur > deco->codesz)
 		res->status |= DIS_STATUS_EOF;
@@ -493,22 +472,30 @@ struct dis_res *do_dis(struct decoctx *deco, uint32_t cur) {
 	res->endmark = ctx->endmark;
 	/* XXX unused status */
 	res->insn = dis_parse_insn(ctx, &res->status);
-	return res;
+	res->name = res->insn->subinsns[0]->sinsn->str;
+	/* the parser took over the strings and expressions, only the list items are left */
+	for (i = 0; i < ctx->atomsnum; i++)
+		free(ctx->atoms[i]);
+	ctx->atomsnum = 0;
+	for (i = res->oplen; i < MAXOPLEN * 8; i++)
+		a[i/8] &= ~(0xffull << (i & 7) * 8);
+	for (i = 0; i < MAXOPLEN; i++)
+		res->unk[i] = a[i] & ~m[i];
 }
 
 static void mark(struct decoctx *ctx, uint32_t ptr, int m) {
-	if (ptr < ctx->codebase || ptr >= ctx->codebase + ctx->codesz)
+	if (!ctx->marks || ptr < ctx->codebase || ptr >= ctx->codebase + ctx->codesz)
 		return;
 	ctx->marks[ptr - ctx->codebase] |= m;
 }
 
 static int is_nr_mark(struct decoctx *ctx, uint32_t ptr) {
-	if (ptr < ctx->codebase || ptr >= ctx->codebase + ctx->codesz)
+	if (!ctx->marks || ptr < ctx->codebase || ptr >= ctx->codebase + ctx->codesz)
 		return 0;
 	return ctx->marks[ptr - ctx->codebase] & 0x40;
 }
 
-char *deco_label(struct decoctx *ctx, uint64_t val) {
+static char *deco_label(struct decoctx *ctx, uint64_t val) {
 	int i;
 	for (i = 0; i < ctx->labelsnum; i++)
 		if (ctx->labels[i].val == val && ctx->labels[i].name)
@@ -516,9 +503,9 @@ char *deco_label(struct decoctx *ctx, uint64_t val) {
 	return 0;
 }
 
-static void dis_pp_sinsn(struct decoctx *deco, struct dis_res *dres, struct easm_sinsn *sinsn, uint64_t pos);
+static void dis_pp_sinsn(struct decoctx *deco, struct ed_insn *dres, struct easm_sinsn *sinsn, uint64_t pos);
 
-static void dis_pp_expr(struct decoctx *deco, struct dis_res *dres, struct easm_expr *expr, uint64_t pos) {
+static void dis_pp_expr(struct decoctx *deco, struct ed_insn *dres, struct easm_expr *expr, uint64_t pos) {
 	if (expr->e1)
 		dis_pp_expr(deco, dres, expr->e1, pos);
 	if (expr->e2)
@@ -579,30 +566,158 @@ static void dis_pp_expr(struct decoctx *deco, struct dis_res *dres, struct easm_
 	}
 }
 
-static void dis_pp_sinsn(struct decoctx *deco, struct dis_res *dres, struct easm_sinsn *sinsn, uint64_t pos) {
+static void dis_pp_sinsn(struct decoctx *deco, struct ed_insn *dres, struct easm_sinsn *sinsn, uint64_t pos) {
 	int i, j;
 	for (i = 0; i < sinsn->operandsnum; i++)
 		for (j = 0; j < sinsn->operands[i]->exprsnum; j++)
 			dis_pp_expr(deco, dres, sinsn->operands[i]->exprs[j], pos);
 }
 
-static void dis_pp_subinsn(struct decoctx *deco, struct dis_res *dres, struct easm_subinsn *subinsn, uint64_t pos) {
+static void dis_pp_subinsn(struct decoctx *deco, struct ed_insn *dres, struct easm_subinsn *subinsn, uint64_t pos) {
 	int i;
 	for (i = 0; i < subinsn->prefsnum; i++)
 		dis_pp_expr(deco, dres, subinsn->prefs[i], pos);
 	dis_pp_sinsn(deco, dres, subinsn->sinsn, pos);
 }
 
-static void dis_pp_insn(struct decoctx *deco, struct dis_res *dres, struct easm_insn *insn, uint64_t pos) {
+static void dis_pp_insn(struct decoctx *deco, struct ed_insn *dres, struct easm_insn *insn, uint64_t pos) {
 	int i;
 	for (i = 0; i < insn->subinsnsnum; i++)
 		dis_pp_subinsn(deco, dres, insn->subinsns[i], pos);
 }
 
-void dis_dopp(struct decoctx *deco, struct dis_res *dres, uint64_t pos) {
+static void dis_dopp(struct decoctx *deco, struct ed_insn *dres, uint64_t pos) {
+	dres->pos = pos;
 	dis_pp_insn(deco, dres, dres->insn, pos);
 }
 
+static void dis_print_insn(FILE *out, const struct envy_colors *cols, const struct disisa *isa, int stride, const struct ed_insn *dres, int mark, int quiet) {
+	int i, j;
+	switch (mark & 3) {
+		case 0:
+			if (!quiet)
+				fprintf (out, "%s%08x:%s", cols->reset, dres->pos, cols->reset);
+			break;
+		case 1:
+			fprintf (out, "%s%08x:%s", cols->btarg, dres->pos, cols->reset);
+			break;
+		case 2:
+			fprintf (out, "%s%08x:%s", cols->ctarg, dres->pos, cols->reset);
+			break;
+		case 3:
+			fprintf (out, "%s%08x:%s", cols->bctarg, dres->pos, cols->reset);
+			break;
+	}
+
+	if (!quiet) {
+		for (i = 0; i < isa->maxoplen; i += isa->opunit) {
+			fprintf (out, " ");
+			for (j = isa->opunit*stride - 1; j >= 0; j--)
+				if (i+j/stride && i+j/stride >= dres->oplen) {
+					fprintf (out, "  ");
+				} else if (i+j/stride >= dres->avail) {
+					fprintf (out, "%s??", cols->err);
+				} else {
+					fprintf (out, "%s%02llx", cols->reset, (dres->raw[(i*stride+j)/8] >> ((i*stride+j)&7) * 8) & 0xff);
+				}
+		}
+		fprintf (out, "  ");
+
+		if (mark & 2)
+			fprintf (out, "%sC", cols->ctarg);
+		else
+			fprintf (out, " ");
+		if (mark & 1)
+			fprintf (out, "%sB", cols->btarg);
+		else
+			fprintf (out, " ");
+		fprintf(out, " ");
+	} else if (quiet == 1) {
+		if (mark)
+			fprintf (out, "\n");
+	}
+
+	easm_print_insn(out, cols, dres->insn);
+
+	if (dres->status & DIS_STATUS_UNK_FORM) {
+		fprintf (out, " %s[unknown op length]%s", cols->err, cols->reset);
+	} else {
+		int fl = 0;
+		for (i = 0; i < MAXOPLEN; i++)
+			if (dres->unk[i])
+				fl = 1;
+		if (fl) {
+			fprintf (out, " %s[unknown:", cols->err);
+			/* bytes are counted in code positions, like in the opcode dump above */
+			for (i = 0; i < dres->oplen || i == 0; i += isa->opunit) {
+				fprintf (out, " ");
+				for (j = isa->opunit*stride - 1; j >= 0; j--)
+					if (i+j/stride >= dres->avail)
+						fprintf (out, "??");
+					else
+						fprintf (out, "%02llx", (dres->unk[(i+j)/8] >> ((i + j)&7) * 8) & 0xff);
+			}
+			fprintf (out, "]");
+		}
+	}
+	if (dres->status & DIS_STATUS_EOF) {
+		fprintf (out, " %s[incomplete]%s", cols->err, cols->reset);
+	}
+	if (dres->status & DIS_STATUS_UNK_INSN) {
+		fprintf (out, " %s[unknown instruction]%s", cols->err, cols->reset);
+	}
+	if (dres->status & DIS_STATUS_UNK_OPERAND) {
+		fprintf (out, " %s[unknown operand]%s", cols->err, cols->reset);
+	}
+	fprintf (out, "%s\n", cols->reset);
+}
+
+/*
+ * Single instruction decoder
+ *
+ * Keeps the per-ISA setup and the decoding scratch space around, so that
+ * tools decoding a word at a time don't pay for a full envydis run.
+ */
+
+struct ed_decoder {
+	struct decoctx deco;
+	struct disctx ctx;
+};
+
+struct ed_decoder *ed_decoder_new(const struct disisa *isa, struct varinfo *varinfo) {
+	struct ed_decoder *dec = calloc(sizeof *dec, 1);
+	dec->deco.isa = isa;
+	dec->deco.varinfo = varinfo;
+	dec->deco.stride = ed_getcstride(isa, varinfo);
+	return dec;
+}
+
+void ed_decoder_del(struct ed_decoder *dec) {
+	if (!dec)
+		return;
+	free(dec->ctx.atoms);
+	free(dec);
+}
+
+int ed_decode(struct ed_decoder *dec, const uint8_t *code, uint32_t num, uint32_t pos, struct ed_insn *res) {
+	dec->deco.code = code;
+	dec->deco.codesz = num;
+	dec->deco.codebase = pos;
+	do_dis(&dec->deco, &dec->ctx, 0, res);
+	dis_dopp(&dec->deco, res, pos);
+	return res->oplen;
+}
+
+void ed_insn_fini(struct ed_insn *insn) {
+	easm_del_insn(insn->insn);
+	insn->insn = 0;
+	insn->name = 0;
+}
+
+void ed_print_insn(const struct ed_decoder *dec, FILE *out, const struct envy_colors *cols, const struct ed_insn *insn, int quiet) {
+	dis_print_insn(out, cols, dec->deco.isa, dec->deco.stride, insn, 0, quiet);
+}
+
 /*
  * Disassembler driver
  *
@@ -614,6 +729,8 @@ void envydis (const struct disisa *isa, FILE *out, uint8_t *code, uint32_t start
 {
 	struct decoctx c = { 0 };
 	struct decoctx *ctx = &c;
+	struct disctx dc = { 0 };
+	struct ed_insn dres;
 	int cur = 0, i, j;
 	ctx->code = code;
 	ctx->codesz = num;
@@ -624,7 +741,8 @@ void envydis (const struct disisa *isa, FILE *out, uint8_t *code, uint32_t start
 	ctx->isa = isa;
 	ctx->labels = labels;
 	ctx->labelsnum = labelsnum;
-	int stride = ed_getcstride(ctx->isa, ctx->varinfo);
+	ctx->stride = ed_getcstride(ctx->isa, ctx->varinfo);
+	int stride = ctx->stride;
 	int cbsz = ed_getcbsz(ctx->isa, ctx->varinfo);
 	if (labels) {
 		for (i = 0; i < labelsnum; i++) {
@@ -650,12 +768,13 @@ void envydis (const struct disisa *isa, FILE *out, uint8_t *code, uint32_t start
 					ctx->marks[cur] |= 8;
 				}
 				if (active) {
-					struct dis_res *dres = do_dis(ctx, cur);
-					dis_dopp(ctx, dres, cur + start);
-					if (dres->oplen && !dres->endmark && !(ctx->marks[cur] & 4))
-						cur += dres->oplen;
+					do_dis(ctx, &dc, cur, &dres);
+					dis_dopp(ctx, &dres, cur + start);
+					if (dres.oplen && !dres.endmark && !(ctx->marks[cur] & 4))
+						cur += dres.oplen;
 					else
 						active = 0;
+					ed_insn_fini(&dres);
 				} else {
 					cur++;
 				}
@@ -663,12 +782,13 @@ void envydis (const struct disisa *isa, FILE *out, uint8_t *code, uint32_t start
 		} while (!done);
 	} else {
 		while (cur < num) {
-			struct dis_res *dres = do_dis(ctx, cur);
-			dis_dopp(ctx, dres, cur + start);
-			if (dres->oplen)
-				cur += dres->oplen;
+			do_dis(ctx, &dc, cur, &dres);
+			dis_dopp(ctx, &dres, cur + start);
+			if (dres.oplen)
+				cur += dres.oplen;
 			else
 				cur++;
+			ed_insn_fini(&dres);
 		}
 	}
 	cur = 0;
@@ -755,95 +875,21 @@ void envydis (const struct disisa *isa, FILE *out, uint8_t *code, uint32_t start
 			skip = 0;
 			nonzero = 0;
 		}
-		struct dis_res *dres = do_dis(ctx, cur);
-		dis_dopp(ctx, dres, cur + start);
+		do_dis(ctx, &dc, cur, &dres);
+		dis_dopp(ctx, &dres, cur + start);
 
-		if (dres->endmark || mark & 4)
+		if (dres.endmark || mark & 4)
 			active = 0;
 
 		if (mark & 2 && !ctx->names[cur])
 			fprintf (out, "\n");
-		switch (mark & 3) {
-			case 0:
-				if (!quiet)
-					fprintf (out, "%s%08x:%s", cols->reset, cur + start, cols->reset);
-				break;
-			case 1:
-				fprintf (out, "%s%08x:%s", cols->btarg, cur + start, cols->reset);
-				break;
-			case 2:
-				fprintf (out, "%s%08x:%s", cols->ctarg, cur + start, cols->reset);
-				break;
-			case 3:
-				fprintf (out, "%s%08x:%s", cols->bctarg, cur + start, cols->reset);
-				break;
-		}
-
-		if (!quiet) {
-			for (i = 0; i < isa->maxoplen; i += isa->opunit) {
-				fprintf (out, " ");
-				for (j = isa->opunit*stride - 1; j >= 0; j--)
-					if (i+j/stride && i+j/stride >= dres->oplen) {
-						fprintf (out, "  ");
-					} else if (cur+i+j/stride >= num) {
-						fprintf (out, "%s??", cols->err);
-					} else {
-						fprintf (out, "%s%02x", cols->reset, code[(cur + i)*stride + j]);
-					}
-			}
-			fprintf (out, "  ");
-
-			if (mark & 2)
-				fprintf (out, "%sC", cols->ctarg);
-			else
-				fprintf (out, " ");
-			if (mark & 1)
-				fprintf (out, "%sB", cols->btarg);
-			else
-				fprintf (out, " ");
-			fprintf(out, " ");
-		} else if (quiet == 1) {
-			if (mark)
-				fprintf (out, "\n");
-		}
 
-		easm_print_insn(out, cols, dres->insn);
+		dis_print_insn(out, cols, isa, stride, &dres, mark, quiet);
 
-		if (dres->status & DIS_STATUS_UNK_FORM) {
-			fprintf (out, " %s[unknown op length]%s", cols->err, cols->reset);
-		} else {
-			int fl = 0;
-			for (i = dres->oplen; i < MAXOPLEN * 8; i++)
-				dres->a[i/8] &= ~(0xffull << (i & 7) * 8);
-			for (i = 0; i < MAXOPLEN; i++) {
-				dres->a[i] &= ~dres->m[i];
-				if (dres->a[i])
-					fl = 1;
-			}
-			if (fl) {
-				fprintf (out, " %s[unknown:", cols->err);
-				for (i = 0; i < dres->oplen || i == 0; i += isa->opunit) {
-					fprintf (out, " ");
-					for (j = isa->opunit*stride - 1; j >= 0; j--)
-						if (cur+i+j >= num)
-							fprintf (out, "??");
-						else
-							fprintf (out, "%02llx", (dres->a[(i+j)/8] >> ((i + j)&7) * 8) & 0xff);
-				}
-				fprintf (out, "]");
-			}
-		}
-		if (dres->status & DIS_STATUS_EOF) {
-			fprintf (out, " %s[incomplete]%s", cols->err, cols->reset);
-		}
-		if (dres->status & DIS_STATUS_UNK_INSN) {
-			fprintf (out, " %s[unknown instruction]%s", cols->err, cols->reset);
-		}
-		if (dres->status & DIS_STATUS_UNK_OPERAND) {
-			fprintf (out, " %s[unknown operand]%s", cols->err, cols->reset);
-		}
-		fprintf (out, "%s\n", cols->reset);
-		cur += dres->oplen;
+		cur += dres.oplen;
+		ed_insn_fini(&dres);
 	}
 	free(ctx->marks);
+	free(ctx->names);
+	free(dc.atoms);
 }
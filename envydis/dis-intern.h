@@ -80,7 +80,7 @@
 
 typedef unsigned long long ull;
 
-#define MAXOPLEN (128/64)
+#define MAXOPLEN ED_MAXOPLEN
 
 struct iasctx;
 struct disctx;
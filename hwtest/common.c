@@ -23,9 +23,95 @@
  */
 
 #include "hwtest.h"
+#include "nva.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+int hwtest_iter(struct hwtest_ctx *ctx, int i) {
+	if (i < ctx->iter_min || i > ctx->iter_max)
+		return 0;
+	if (i % ctx->shards != ctx->shard)
+		return 0;
+	/* splitmix64 of the test seed and the iteration number */
+	uint64_t h = (uint64_t)ctx->seed48[0] | (uint64_t)ctx->seed48[1] << 16 | (uint64_t)ctx->seed48[2] << 32;
+	h += (uint64_t)(i + 1) * 0x9e3779b97f4a7c15ull;
+	h = (h ^ h >> 30) * 0xbf58476d1ce4e5b9ull;
+	h = (h ^ h >> 27) * 0x94d049bb133111ebull;
+	h ^= h >> 31;
+	ctx->rand48[0] = h;
+	ctx->rand48[1] = h >> 16;
+	ctx->rand48[2] = h >> 32;
+	ctx->iter = i;
+	return 1;
+}
+
+struct hwtest_shard_res {
+	int res;
+	int iter;
+};
+
+/*
+ * Runs a test on ctx->jobs forked workers, each running every ctx->jobs-th
+ * iteration on its own copy of the simulated card.  Worker output is thrown
+ * away - if anything failed, the first failing iteration is rerun here, so
+ * what gets printed doesn't depend on the scheduling.  The test stays failed
+ * even if the rerun passes, but the log says so.
+ */
+static int hwtest_run_sharded(struct hwtest_ctx *ctx, const struct hwtest_test *test) {
+	struct hwtest_shard_res *sres = mmap(0, ctx->jobs * sizeof *sres, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	int i, worst = 0, iter = -1;
+	if (sres == MAP_FAILED)
+		return test->fun(ctx);
+	fflush(stdout);
+	fflush(stderr);
+	for (i = 0; i < ctx->jobs; i++) {
+		struct hwtest_ctx wctx = *ctx;
+		wctx.shard = i;
+		wctx.shards = ctx->jobs;
+		sres[i].res = HWTEST_RES_FAIL;
+		sres[i].iter = -1;
+		pid_t pid = fork();
+		if (pid == -1) {
+			/*
+			 * A shard run here would change the card state that
+			 * the remaining shards get forked from - give up on
+			 * sharding and run the whole test serially instead.
+			 */
+			while (wait(0) > 0);
+			munmap(sres, ctx->jobs * sizeof *sres);
+			return test->fun(ctx);
+		} else if (!pid) {
+			if (!freopen("/dev/null", "w", stdout) || !freopen("/dev/null", "w", stderr))
+				_exit(1);
+			sres[i].res = test->fun(&wctx);
+			sres[i].iter = wctx.iter;
+			_exit(0);
+		}
+	}
+	while (wait(0) > 0);
+	for (i = 0; i < ctx->jobs; i++) {
+		if (worst < sres[i].res)
+			worst = sres[i].res;
+		if (sres[i].res == HWTEST_RES_FAIL && sres[i].iter != -1 && (iter == -1 || sres[i].iter < iter))
+			iter = sres[i].iter;
+	}
+	munmap(sres, ctx->jobs * sizeof *sres);
+	if (worst == HWTEST_RES_FAIL) {
+		if (iter != -1)
+			ctx->iter_min = ctx->iter_max = iter;
+		if (test->fun(ctx) != HWTEST_RES_FAIL) {
+			for (i = 0; i < ctx->indent; i++)
+				printf("  ");
+			printf("%s: failure in a worker didn't reproduce when rerun\n", test->name);
+		}
+		ctx->iter = iter;
+	}
+	return worst;
+}
 
 int hwtest_run_group(struct hwtest_ctx *ctx, const struct hwtest_group *group, const char *filter) {
 	int i, j;
@@ -53,6 +139,8 @@ int hwtest_run_group(struct hwtest_ctx *ctx, const struct hwtest_group *group, c
 		nctx.rand48[0] = jrand48(ctx->rand48);
 		nctx.rand48[1] = jrand48(ctx->rand48);
 		nctx.rand48[2] = jrand48(ctx->rand48);
+		memcpy(nctx.seed48, nctx.rand48, sizeof nctx.seed48);
+		nctx.iter = -1;
 		if (filter && (strlen(group->tests[i].name) != flen || strncmp(group->tests[i].name, filter, flen)))
 			continue;
 		found = 1;
@@ -63,7 +151,10 @@ int hwtest_run_group(struct hwtest_ctx *ctx, const struct hwtest_group *group, c
 		} else {
 			int res;
 			if (group->tests[i].fun) {
-				res = group->tests[i].fun(&nctx);
+				if (ctx->jobs > 1 && nva_cards[ctx->cnum].backend)
+					res = hwtest_run_sharded(&nctx, &group->tests[i]);
+				else
+					res = group->tests[i].fun(&nctx);
 			} else {
 				if (!fnext) {
 					for (j = 0; j < ctx->indent; j++)
@@ -90,7 +181,10 @@ int hwtest_run_group(struct hwtest_ctx *ctx, const struct hwtest_group *group, c
 			};
 			for (j = 0; j < ctx->indent; j++)
 				printf("  ");
-			printf("%s: %s\n", group->tests[i].name, res[ctx->colors?tabc:tab]);
+			if (res == HWTEST_RES_FAIL && nctx.iter != -1)
+				printf("%s: %s at iteration %d\n", group->tests[i].name, res[ctx->colors?tabc:tab], nctx.iter);
+			else
+				printf("%s: %s\n", group->tests[i].name, res[ctx->colors?tabc:tab]);
 		}
 	}
 	if (!filter)
@@ -26,6 +26,8 @@
 #include "nva.h"
 #include <unistd.h>
 #include <stdio.h>
+#include <limits.h>
+#include <getopt.h>
 #include <pciaccess.h>
 
 int hwtest_root_prep(struct hwtest_ctx *ctx) {
@@ -43,19 +45,24 @@ HWTEST_DEF_GROUP(hwtest_root,
 int main(int argc, char **argv) {
 	struct hwtest_ctx sctx;
 	struct hwtest_ctx *ctx = &sctx;
-	if (nva_init()) {
-		fprintf (stderr, "PCI init failure!\n");
-		return 1;
-	}
-	int c, force = 0;
+	int c, force = 0, sim_chipset = -1;
+	uint64_t seed = 0xcafebeefdeadull;
+	static const struct option options[] = {
+		{ "seed", required_argument, 0, 'S' },
+		{ "iterations", required_argument, 0, 'I' },
+		{ 0 },
+	};
 	ctx->cnum = 0;
 	ctx->colors = 1;
 	ctx->noslow = 0;
 	ctx->indent = 0;
-	ctx->rand48[0] = 0xdead;
-	ctx->rand48[1] = 0xbeef;
-	ctx->rand48[2] = 0xcafe;
-	while ((c = getopt (argc, argv, "c:nsf")) != -1)
+	ctx->jobs = 1;
+	ctx->shard = 0;
+	ctx->shards = 1;
+	ctx->iter_min = 0;
+	ctx->iter_max = INT_MAX;
+	ctx->iter = -1;
+	while ((c = getopt_long (argc, argv, "c:nsfm:j:", options, 0)) != -1)
 		switch (c) {
 			case 'c':
 				sscanf(optarg, "%d", &ctx->cnum);
@@ -69,7 +76,46 @@ int main(int argc, char **argv) {
 			case 'f':
 				force = 1;
 				break;
+			case 'm':
+				sscanf(optarg, "%x", &sim_chipset);
+				break;
+			case 'j':
+				sscanf(optarg, "%d", &ctx->jobs);
+				if (ctx->jobs < 1)
+					ctx->jobs = 1;
+				break;
+			case 'S':
+				seed = strtoull(optarg, 0, 0);
+				break;
+			case 'I':
+				switch (sscanf(optarg, "%d-%d", &ctx->iter_min, &ctx->iter_max)) {
+					case 1:
+						ctx->iter_max = ctx->iter_min;
+						break;
+					case 2:
+						break;
+					default:
+						fprintf (stderr, "Bad iteration range %s\n", optarg);
+						return 1;
+				}
+				break;
+			default:
+				fprintf (stderr, "Usage: %s [-c card | -m chipset] [-nsf] [-j jobs] [--seed seed] [--iterations first[-last]] [test...]\n", argv[0]);
+				return 1;
+		}
+	ctx->rand48[0] = seed;
+	ctx->rand48[1] = seed >> 16;
+	ctx->rand48[2] = seed >> 32;
+	if (sim_chipset != -1) {
+		ctx->cnum = hwtest_sim_card(sim_chipset);
+		if (ctx->cnum == -1) {
+			fprintf (stderr, "No simulated card for chipset %02x.\n", sim_chipset);
+			return 1;
 		}
+	} else if (nva_init()) {
+		fprintf (stderr, "PCI init failure!\n");
+		return 1;
+	}
 	if (ctx->cnum >= nva_cardsnum) {
 		if (nva_cardsnum)
 			fprintf (stderr, "No such card.\n");
@@ -79,7 +125,7 @@ int main(int argc, char **argv) {
 	}
 	ctx->chipset = nva_cards[ctx->cnum].chipset;
 	ctx->card_type = nva_cards[ctx->cnum].card_type;
-	if (pci_device_has_kernel_driver(nva_cards[ctx->cnum].pci)) {
+	if (nva_cards[ctx->cnum].pci && pci_device_has_kernel_driver(nva_cards[ctx->cnum].pci)) {
 		if (force) {
 			fprintf(stderr, "WARNING: Kernel driver in use.\n");
 		} else {
@@ -36,6 +36,14 @@ struct hwtest_ctx {
 	int colors;
 	int indent;
 	unsigned short rand48[3];
+	/* seed of the current test, its iterations derive their own seeds from it */
+	unsigned short seed48[3];
+	/* worker processes for sharding iterations over, only used on simulated cards */
+	int jobs;
+	int shard, shards;
+	/* range of iterations to run, and the one currently running (or -1) */
+	int iter_min, iter_max;
+	int iter;
 };
 
 struct hwtest_test {
@@ -78,6 +86,14 @@ enum hwtest_res {
 	} \
 } while (0)
 
+/*
+ * Loops over the iterations of a seed-driven test.  Every iteration gets a seed
+ * derived from the test seed and its index, so iterations can be sharded and
+ * any one of them can be rerun alone with --iterations.  Iterations must not
+ * depend on state left over from previous ones.
+ */
+#define HWTEST_ITER(ctx, i, n) for ((i) = 0; (i) < (n); (i)++) if (hwtest_iter((ctx), (i)))
+
 #define TEST_READ(reg, exp, msg, ...) do { \
 	uint32_t _reg = reg; \
 	uint32_t _exp = exp; \
@@ -102,6 +118,8 @@ enum hwtest_res {
 uint32_t vram_rd32(int card, uint64_t addr);
 void vram_wr32(int card, uint64_t addr, uint32_t val);
 int hwtest_run_group(struct hwtest_ctx *ctx, const struct hwtest_group *group, const char *filter);
+int hwtest_iter(struct hwtest_ctx *ctx, int i);
+int hwtest_sim_card(int chipset);
 
 extern const struct hwtest_group nv10_tile_group;
 extern const struct hwtest_group nv01_pgraph_group;
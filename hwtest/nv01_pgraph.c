@@ -410,7 +410,7 @@ static int test_scan_vstate(struct hwtest_ctx *ctx) {
 
 static int test_state(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 1000; i++) {
+	HWTEST_ITER(ctx, i, 1000) {
 		struct nv01_pgraph_state exp, real;
 		nv01_pgraph_gen_state(ctx, &exp);
 		nv01_pgraph_load_state(ctx, &exp);
@@ -423,7 +423,7 @@ static int test_state(struct hwtest_ctx *ctx) {
 
 static int test_soft_reset(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		struct nv01_pgraph_state exp, real;
 		nv01_pgraph_gen_state(ctx, &exp);
 		nv01_pgraph_load_state(ctx, &exp);
@@ -447,7 +447,7 @@ static int test_soft_reset(struct hwtest_ctx *ctx) {
 
 static int test_mmio_read(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		struct nv01_pgraph_state exp, real;
 		nv01_pgraph_gen_state(ctx, &exp);
 		int idx = nrand48(ctx->rand48) % ARRAY_SIZE(nv01_pgraph_state_regs);
@@ -468,7 +468,7 @@ static int test_mmio_read(struct hwtest_ctx *ctx) {
 
 static int test_mmio_write(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		struct nv01_pgraph_state exp, real;
 		nv01_pgraph_gen_state(ctx, &exp);
 		int idx = nrand48(ctx->rand48) % ARRAY_SIZE(nv01_pgraph_state_regs);
@@ -507,7 +507,7 @@ static int test_mmio_write(struct hwtest_ctx *ctx) {
 
 static int test_mmio_clip_status(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		int xy = jrand48(ctx->rand48) & 1;
 		struct nv01_pgraph_state exp;
 		nv01_pgraph_gen_state(ctx, &exp);
@@ -567,7 +567,7 @@ static int test_mmio_clip_status(struct hwtest_ctx *ctx) {
 
 static int test_mmio_vtx_write(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		int idx = nrand48(ctx->rand48) % 18;
 		int xy = jrand48(ctx->rand48) & 1;
 		int rel = jrand48(ctx->rand48) & 1;
@@ -600,7 +600,7 @@ static int test_mmio_vtx_write(struct hwtest_ctx *ctx) {
 
 static int test_mmio_iclip_write(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		int xy = jrand48(ctx->rand48) & 1;
 		int rel = jrand48(ctx->rand48) & 1;
 		struct nv01_pgraph_state exp, real;
@@ -623,7 +623,7 @@ static int test_mmio_iclip_write(struct hwtest_ctx *ctx) {
 
 static int test_mmio_uclip_write(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		int xy = jrand48(ctx->rand48) & 1;
 		int idx = jrand48(ctx->rand48) & 1;
 		int rel = jrand48(ctx->rand48) & 1;
@@ -647,7 +647,7 @@ static int test_mmio_uclip_write(struct hwtest_ctx *ctx) {
 
 static int test_mthd_ctx_switch(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		uint32_t val = jrand48(ctx->rand48);
 		int classes[20] = {
 			0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
@@ -704,7 +704,7 @@ static int test_mthd_ctx_switch(struct hwtest_ctx *ctx) {
 
 static int test_mthd_beta(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		uint32_t val = jrand48(ctx->rand48);
 		struct nv01_pgraph_state exp, real;
 		nv01_pgraph_gen_state(ctx, &exp);
@@ -746,78 +746,77 @@ static int check_mthd_invalid(struct hwtest_ctx *ctx, int class, int mthd) {
 
 static int test_mthd_invalid(struct hwtest_ctx *ctx) {
 	int i;
-	int res = 0;
 	int classes[20] = {
 		0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
 		0x08, 0x09, 0x0a, 0x0b, 0x0c,
 		0x0d, 0x0e, 0x1d, 0x1e,
 		0x10, 0x11, 0x12, 0x13, 0x14,
 	};
-	for (i = 0; i < 20; i++) {
-		int class = classes[i];
-		int mthd;
-		for (mthd = 0; mthd < 0x2000; mthd += 4) {
-			if (mthd == 0 || mthd == 0x104) /* CTX_SWITCH, NOTIFY */
-				continue;
-			if ((class == 1 || class == 2) && mthd == 0x300) /* ROP, BETA */
-				continue;
-			if ((class == 3 || class == 4) && mthd == 0x304) /* CHROMA, PLANE */
-				continue;
-			if (class == 5 && (mthd == 0x300 || mthd == 0x304)) /* CLIP */
-				continue;
-			if (class == 6 && (mthd == 0x308 || (mthd >= 0x310 && mthd <= 0x31c))) /* PATTERN */
-				continue;
-			if (class >= 8 && class <= 0xc && mthd == 0x304) /* COLOR */
-				continue;
-			if (class == 8 && mthd >= 0x400 && mthd < 0x580) /* POINT */
-				continue;
-			if (class >= 9 && class <= 0xa && mthd >= 0x400 && mthd < 0x680) /* LINE/LIN */
+	/* one iteration per class and method */
+	HWTEST_ITER(ctx, i, 20 * 0x800) {
+		int class = classes[i >> 11];
+		int mthd = (i & 0x7ff) << 2;
+		if (mthd == 0 || mthd == 0x104) /* CTX_SWITCH, NOTIFY */
+			continue;
+		if ((class == 1 || class == 2) && mthd == 0x300) /* ROP, BETA */
+			continue;
+		if ((class == 3 || class == 4) && mthd == 0x304) /* CHROMA, PLANE */
+			continue;
+		if (class == 5 && (mthd == 0x300 || mthd == 0x304)) /* CLIP */
+			continue;
+		if (class == 6 && (mthd == 0x308 || (mthd >= 0x310 && mthd <= 0x31c))) /* PATTERN */
+			continue;
+		if (class >= 8 && class <= 0xc && mthd == 0x304) /* COLOR */
+			continue;
+		if (class == 8 && mthd >= 0x400 && mthd < 0x580) /* POINT */
+			continue;
+		if (class >= 9 && class <= 0xa && mthd >= 0x400 && mthd < 0x680) /* LINE/LIN */
+			continue;
+		if (class == 0xb && mthd >= 0x310 && mthd < 0x31c) /* TRI.TRIANGLE */
+			continue;
+		if (class == 0xb && mthd >= 0x320 && mthd < 0x338) /* TRI.TRIANGLE32 */
+			continue;
+		if (class == 0xb && mthd >= 0x400 && mthd < 0x600) /* TRI.TRIMESH, TRI.TRIMESH32, TRI.CTRIANGLE, TRI.CTRIMESH */
+			continue;
+		if (class == 0xc && mthd >= 0x400 && mthd < 0x480) /* RECT */
+			continue;
+		if (class == 0xd || class == 0xe || class == 0x1d || class == 0x1e) { /* TEX* */
+			if (mthd == 0x304) /* SUBDIVIDE */
 				continue;
-			if (class == 0xb && mthd >= 0x310 && mthd < 0x31c) /* TRI.TRIANGLE */
+			int vcnt = 4;
+			if ((class & 0xf) == 0xe)
+				vcnt = 9;
+			int vcntd2 = (vcnt+1)/2;
+			if (mthd >= 0x310 && mthd < 0x310+vcnt*4) /* VTX_POS_INT */
 				continue;
-			if (class == 0xb && mthd >= 0x320 && mthd < 0x338) /* TRI.TRIANGLE32 */
+			if (mthd >= 0x350 && mthd < 0x350+vcnt*4) /* VTX_POS_FRACT */
 				continue;
-			if (class == 0xb && mthd >= 0x400 && mthd < 0x600) /* TRI.TRIMESH, TRI.TRIMESH32, TRI.CTRIANGLE, TRI.CTRIMESH */
+			if (class & 0x10 && mthd >= 0x380 && mthd < 0x380+vcntd2*4) /* VTX_BETA */
 				continue;
-			if (class == 0xc && mthd >= 0x400 && mthd < 0x480) /* RECT */
+			if (mthd >= 0x400 && mthd < 0x480) /* COLOR */
 				continue;
-			if (class == 0xd || class == 0xe || class == 0x1d || class == 0x1e) { /* TEX* */
-				if (mthd == 0x304) /* SUBDIVIDE */
-					continue;
-				int vcnt = 4;
-				if ((class & 0xf) == 0xe)
-					vcnt = 9;
-				int vcntd2 = (vcnt+1)/2;
-				if (mthd >= 0x310 && mthd < 0x310+vcnt*4) /* VTX_POS_INT */
-					continue;
-				if (mthd >= 0x350 && mthd < 0x350+vcnt*4) /* VTX_POS_FRACT */
-					continue;
-				if (class & 0x10 && mthd >= 0x380 && mthd < 0x380+vcntd2*4) /* VTX_BETA */
-					continue;
-				if (mthd >= 0x400 && mthd < 0x480) /* COLOR */
-					continue;
-			}
-			if (class == 0x10 && mthd >= 0x300 && mthd < 0x30c) /* BLIT */
-				continue;
-			if (class == 0x11 && mthd >= 0x304 && mthd < 0x310) /* IFC setup */
-				continue;
-			if (class == 0x12 && mthd >= 0x308 && mthd < 0x31c) /* BITMAP setup */
-				continue;
-			if (class >= 0x11 && class <= 0x12 && mthd >= 0x400 && mthd < 0x480) /* IFC/BITMAP data */
-				continue;
-			if (class >= 0x13 && class <= 0x14 && mthd >= 0x308 && mthd < 0x318) /* IFM/ITM */
-				continue;
-			if (class == 0x13 && mthd >= 0x40 && mthd < 0x80) /* IFM data */
-				continue;
-			res |= check_mthd_invalid(ctx, class, mthd);
 		}
+		if (class == 0x10 && mthd >= 0x300 && mthd < 0x30c) /* BLIT */
+			continue;
+		if (class == 0x11 && mthd >= 0x304 && mthd < 0x310) /* IFC setup */
+			continue;
+		if (class == 0x12 && mthd >= 0x308 && mthd < 0x31c) /* BITMAP setup */
+			continue;
+		if (class >= 0x11 && class <= 0x12 && mthd >= 0x400 && mthd < 0x480) /* IFC/BITMAP data */
+			continue;
+		if (class >= 0x13 && class <= 0x14 && mthd >= 0x308 && mthd < 0x318) /* IFM/ITM */
+			continue;
+		if (class == 0x13 && mthd >= 0x40 && mthd < 0x80) /* IFM data */
+			continue;
+		if (check_mthd_invalid(ctx, class, mthd))
+			return HWTEST_RES_FAIL;
 	}
-	return res ? HWTEST_RES_FAIL : HWTEST_RES_PASS;
+	return HWTEST_RES_PASS;
 }
 
 static int test_mthd_rop(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		uint32_t val = jrand48(ctx->rand48);
 		if (jrand48(ctx->rand48) & 1)
 			val &= 0xff;
@@ -843,7 +842,7 @@ static int test_mthd_rop(struct hwtest_ctx *ctx) {
 
 static int test_mthd_chroma_plane(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		int is_plane = jrand48(ctx->rand48) & 1;
 		uint32_t val = jrand48(ctx->rand48);
 		struct nv01_pgraph_state exp, real;
@@ -867,7 +866,7 @@ static int test_mthd_chroma_plane(struct hwtest_ctx *ctx) {
 
 static int test_mthd_clip(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		int is_size = jrand48(ctx->rand48) & 1;
 		uint32_t val = jrand48(ctx->rand48);
 		struct nv01_pgraph_state exp, real;
@@ -892,7 +891,7 @@ static int test_mthd_clip(struct hwtest_ctx *ctx) {
 
 static int test_mthd_pattern_shape(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		uint32_t val = jrand48(ctx->rand48);
 		if (jrand48(ctx->rand48) & 1)
 			val &= 0xf;
@@ -918,7 +917,7 @@ static int test_mthd_pattern_shape(struct hwtest_ctx *ctx) {
 
 static int test_mthd_pattern_mono_bitmap(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		int idx = jrand48(ctx->rand48) & 1;
 		uint32_t val = jrand48(ctx->rand48);
 		struct nv01_pgraph_state exp, real;
@@ -938,7 +937,7 @@ static int test_mthd_pattern_mono_bitmap(struct hwtest_ctx *ctx) {
 
 static int test_mthd_pattern_mono_color(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		int idx = jrand48(ctx->rand48) & 1;
 		uint32_t val = jrand48(ctx->rand48);
 		struct nv01_pgraph_state exp, real;
@@ -958,7 +957,7 @@ static int test_mthd_pattern_mono_color(struct hwtest_ctx *ctx) {
 
 static int test_mthd_subdivide(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		int beta = jrand48(ctx->rand48) & 1;
 		int quad = jrand48(ctx->rand48) & 1;
 		int class = 0xd + beta * 0x10 + quad;
@@ -996,7 +995,7 @@ static int test_mthd_subdivide(struct hwtest_ctx *ctx) {
 
 static int test_mthd_tex_vtx_xy(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		int beta = jrand48(ctx->rand48) & 1;
 		int quad = jrand48(ctx->rand48) & 1;
 		int fract = jrand48(ctx->rand48) & 1;
@@ -1040,7 +1039,7 @@ static int test_mthd_tex_vtx_xy(struct hwtest_ctx *ctx) {
 
 static int test_mthd_tex_vtx_beta(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		int quad = jrand48(ctx->rand48) & 1;
 		int idx = nrand48(ctx->rand48) % (quad?5:2);
 		int mclass = 0x1d + quad;
@@ -1078,7 +1077,7 @@ static int test_mthd_tex_vtx_beta(struct hwtest_ctx *ctx) {
 
 static int test_mthd_solid_color(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		int class;
 		uint32_t mthd;
 		switch (nrand48(ctx->rand48)%5) {
@@ -1124,7 +1123,7 @@ static int test_mthd_solid_color(struct hwtest_ctx *ctx) {
 
 static int test_mthd_bitmap_color(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 10000; i++) {
+	HWTEST_ITER(ctx, i, 10000) {
 		int idx = jrand48(ctx->rand48)&1;
 		uint32_t val = jrand48(ctx->rand48);
 		struct nv01_pgraph_state exp, real;
@@ -1145,7 +1144,7 @@ static int test_mthd_bitmap_color(struct hwtest_ctx *ctx) {
 
 static int test_rop_simple(struct hwtest_ctx *ctx) {
 	int i;
-	for (i = 0; i < 100000; i++) {
+	HWTEST_ITER(ctx, i, 100000) {
 		struct nv01_pgraph_state exp, real;
 		nv01_pgraph_gen_state(ctx, &exp);
 		exp.notify &= ~0x110000;
@@ -0,0 +1,536 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Simulated cards for running tests without the hardware.  Register state
+ * lives in the same structs the nvhw models work on, and everything the
+ * card does in response to MMIO is computed by those models - so running
+ * a test group here checks the test and the model against each other, not
+ * against the hardware.
+ *
+ * Only NV01 PGRAPH is there for now.  Methods that the models don't cover
+ * yet (lines, triangles, rects, blits, IFC/IFM/ITM data, tex colors,
+ * notify) are accepted and ignored.
+ */
+
+#include "hwtest.h"
+#include "nva.h"
+#include "pgraph.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+struct nv01_sim {
+	uint32_t pmc_enable;
+	struct nv01_pgraph_state pgraph;
+	uint8_t *vram;
+	uint32_t vram_mask;
+};
+
+#define NV01_SIM_VRAM_SIZE (8 << 20)
+
+/* plain PGRAPH registers: address, state field, writable bits */
+static const struct {
+	uint32_t addr;
+	size_t offset;
+	uint32_t mask;
+} nv01_sim_regs[] = {
+#define REG(addr, field, mask) { addr, offsetof(struct nv01_pgraph_state, field), mask }
+	REG(0x400080, debug[0], 0x11111110),
+	REG(0x400084, debug[1], 0x31111101),
+	REG(0x400088, debug[2], 0x11111111),
+	REG(0x400140, intr_en, 0x11111111),
+	REG(0x400144, invalid_en, 0x00011111),
+	REG(0x400180, ctx_switch, 0x807fffff),
+	REG(0x400190, ctx_control, 0x11010103),
+	REG(0x400600, pattern_rgb[0], 0x3fffffff),
+	REG(0x400604, pattern_a[0], 0xff),
+	REG(0x400608, pattern_rgb[1], 0x3fffffff),
+	REG(0x40060c, pattern_a[1], 0xff),
+	REG(0x400610, pattern_bitmap[0], 0xffffffff),
+	REG(0x400614, pattern_bitmap[1], 0xffffffff),
+	REG(0x400618, pattern_shape, 3),
+	REG(0x40061c, bitmap_color[0], 0x7fffffff),
+	REG(0x400620, bitmap_color[1], 0x7fffffff),
+	REG(0x400624, rop, 0xff),
+	REG(0x400628, plane, 0x7fffffff),
+	REG(0x40062c, chroma, 0x7fffffff),
+	REG(0x400634, canvas_config, 0x01111011),
+	REG(0x400640, xy_misc_0, 0xf1ff11ff),
+	REG(0x400644, xy_misc_1, 0x03177331),
+	REG(0x400648, xy_misc_2[0], 0x30ffffff),
+	REG(0x40064c, xy_misc_2[1], 0x30ffffff),
+	REG(0x400650, valid, 0x111ff1ff),
+	REG(0x400654, source_color, 0xffffffff),
+	REG(0x400658, subdivide, 0xffff00ff),
+	REG(0x40065c, edgefill, 0xffff0113),
+	REG(0x400680, dma, 0x0000ffff),
+	REG(0x400684, notify, 0x0011ffff),
+	REG(0x400688, canvas_min, 0xffffffff),
+	REG(0x40068c, canvas_max, 0x0fff0fff),
+	REG(0x400690, cliprect_min[0], 0x0fff0fff),
+	REG(0x400694, cliprect_max[0], 0x0fff0fff),
+	REG(0x400698, cliprect_min[1], 0x0fff0fff),
+	REG(0x40069c, cliprect_max[1], 0x0fff0fff),
+	REG(0x4006a0, cliprect_ctrl, 0x113),
+	REG(0x600000, pfb_boot, 0xffffffff),
+	REG(0x600200, pfb_config, 0xffffffff),
+#undef REG
+};
+
+static uint32_t *nv01_sim_reg(struct nv01_sim *sim, uint32_t addr, uint32_t *mask) {
+	static int8_t idx[0x800];
+	static int idx_done;
+	if (!idx_done) {
+		int i;
+		memset(idx, -1, sizeof idx);
+		for (i = 0; i < ARRAY_SIZE(nv01_sim_regs); i++)
+			if (nv01_sim_regs[i].addr < 0x400800)
+				idx[(nv01_sim_regs[i].addr - 0x400000) >> 2] = i;
+		idx_done = 1;
+	}
+	int i = -1;
+	if (addr >= 0x400000 && addr < 0x400800) {
+		i = idx[(addr - 0x400000) >> 2];
+	} else {
+		for (i = 0; i < ARRAY_SIZE(nv01_sim_regs); i++)
+			if (nv01_sim_regs[i].addr == addr)
+				break;
+		if (i == ARRAY_SIZE(nv01_sim_regs))
+			i = -1;
+	}
+	if (i < 0)
+		return 0;
+	*mask = nv01_sim_regs[i].mask;
+	return (uint32_t *)((uint8_t *)&sim->pgraph + nv01_sim_regs[i].offset);
+}
+
+static void nv01_sim_invalid(struct nv01_pgraph_state *pg, uint32_t bits) {
+	pg->intr |= 1;
+	pg->invalid |= bits;
+	pg->access &= ~0x101;
+}
+
+static void nv01_sim_ctx_switch(struct nv01_pgraph_state *pg, int class, uint32_t val) {
+	int chsw = 0;
+	int och = extr(pg->ctx_switch, 16, 7);
+	int nch = extr(val, 16, 7);
+	if ((val & 0x007f8000) != (pg->ctx_switch & 0x007f8000))
+		chsw = 1;
+	if (!extr(pg->ctx_control, 16, 1))
+		chsw = 1;
+	int volatile_reset = val >> 31 && extr(pg->debug[2], 28, 1) && (!extr(pg->ctx_control, 16, 1) || och == nch);
+	if (chsw) {
+		pg->ctx_control |= 0x01010000;
+		pg->intr |= 0x10;
+		pg->access &= ~0x101;
+	} else {
+		pg->ctx_control &= ~0x01000000;
+	}
+	insrt(pg->access, 12, 5, class);
+	insrt(pg->debug[1], 0, 1, volatile_reset);
+	if (volatile_reset) {
+		pg->bitmap_color[0] &= 0x3fffffff;
+		pg->bitmap_color[1] &= 0x3fffffff;
+		pg->valid &= 0x11000000;
+		pg->xy_misc_0 = 0;
+		pg->xy_misc_1 &= 0x33300;
+		pg->xy_misc_2[0] = 0x555500;
+		pg->xy_misc_2[1] = 0x555500;
+		pg->source_color &= 0x00ff00ff;
+		pg->subdivide &= 0xffff0000;
+	}
+	pg->ctx_switch = val & 0x807fffff;
+}
+
+static void nv01_sim_point(struct nv01_sim *sim, uint32_t val) {
+	struct nv01_pgraph_state *pg = &sim->pgraph;
+	int x = extrs(val, 0, 16), y = extrs(val, 16, 16);
+	nv01_pgraph_set_vtx(pg, 0, 0, x);
+	nv01_pgraph_set_vtx(pg, 1, 0, y);
+	pg->xy_misc_0 |= 0x10000000;
+	pg->xy_misc_1 |= 0x01000000;
+	if (extr(pg->canvas_config, 24, 1)) {
+		pg->intr |= 1 << 20;
+		pg->access &= ~0x101;
+	}
+	int32_t min[2], max[2];
+	nv01_pgraph_clip_bounds(pg, min, max);
+	x = pg->vtx_x[0];
+	y = pg->vtx_y[0];
+	if (x < min[0] || x > max[0] || y < min[1] || y > max[1])
+		return;
+	int bfmt = extr(pg->ctx_switch, 9, 4);
+	int bufmask = (bfmt / 5 + 1) & 3;
+	if (!extr(pg->pfb_config, 12, 1))
+		bufmask = 1;
+	int cpp = nv01_pgraph_cpp(pg->pfb_config);
+	int buf, i;
+	for (buf = 0; buf < 2; buf++) {
+		if (!(bufmask & 1 << buf))
+			continue;
+		uint32_t addr = nv01_pgraph_pixel_addr(pg, x, y, buf);
+		uint32_t pixel = 0;
+		for (i = 0; i < cpp; i++)
+			pixel |= sim->vram[(addr + i) & sim->vram_mask] << i * 8;
+		pixel = nv01_pgraph_rop(pg, x, y, pixel);
+		for (i = 0; i < cpp; i++)
+			sim->vram[(addr + i) & sim->vram_mask] = pixel >> i * 8;
+	}
+}
+
+static void nv01_sim_subdivide(struct nv01_pgraph_state *pg, uint32_t val) {
+	int err = 0, j;
+	pg->subdivide = val & 0xffff00ff;
+	if (val & 0xff00)
+		err = 1;
+	for (j = 0; j < 8; j++) {
+		if (extr(val, 4*j, 4) > 8)
+			err = 1;
+		if (j < 2 && extr(val, 4*j, 4) < 2)
+			err = 1;
+	}
+	if (err)
+		nv01_sim_invalid(pg, 0x10);
+}
+
+static void nv01_sim_tex_vtx(struct nv01_pgraph_state *pg, int idx, int fract, uint32_t val) {
+	if (extr(pg->xy_misc_1, 24, 1) && extr(pg->xy_misc_1, 25, 1) != fract)
+		pg->valid &= ~0xffffff;
+	insrt(pg->xy_misc_1, 24, 1, 1);
+	insrt(pg->xy_misc_1, 25, 1, fract);
+	insrt(pg->xy_misc_1, 0, 1, 0);
+	nv01_pgraph_set_vtx(pg, 0, idx, extrs(val, 0, 16));
+	nv01_pgraph_set_vtx(pg, 1, idx, extrs(val, 16, 16));
+	int vidx = extr(pg->xy_misc_0, 28, 4);
+	if (idx == 0)
+		vidx = 0;
+	if (vidx == 2 + nv01_pgraph_use_v16(pg))
+		vidx = 0;
+	else
+		vidx++;
+	insrt(pg->xy_misc_0, 28, 4, vidx);
+	pg->valid |= 0x1001 << idx;
+}
+
+static void nv01_sim_tex_beta(struct nv01_pgraph_state *pg, int idx, uint32_t val) {
+	uint32_t rclass = extr(pg->access, 12, 5);
+	int j;
+	for (j = 0; j < 2; j++) {
+		int vid = idx * 2 + j;
+		if (vid == 9 && (rclass & 0xf) == 0xe)
+			break;
+		uint32_t beta = extr(val, j*16, 16);
+		beta &= 0xff80;
+		beta <<= 8;
+		beta |= 0x4000;
+		if (beta & 1 << 23)
+			beta |= 1 << 24;
+		pg->vtx_beta[vid] = beta;
+	}
+	if (rclass == 0x1d || rclass == 0x1e)
+		pg->valid |= 1 << (12 + idx);
+}
+
+/* returns 0 if the method doesn't exist */
+static int nv01_sim_mthd(struct nv01_sim *sim, int class, uint32_t mthd, uint32_t val) {
+	struct nv01_pgraph_state *pg = &sim->pgraph;
+	if (mthd == 0) {
+		nv01_sim_ctx_switch(pg, class, val);
+		return 1;
+	}
+	if (mthd == 0x104)
+		return 1;
+	switch (class) {
+		case 0x01:
+			if (mthd != 0x300)
+				return 0;
+			pg->beta = val & 0x80000000 ? 0 : val & 0x7f800000;
+			return 1;
+		case 0x02:
+			if (mthd != 0x300)
+				return 0;
+			pg->rop = val & 0xff;
+			if (val & ~0xff)
+				nv01_sim_invalid(pg, 0x10);
+			return 1;
+		case 0x03:
+		case 0x04:
+			if (mthd != 0x304)
+				return 0;
+			*(class == 3 ? &pg->chroma : &pg->plane) = nv01_pgraph_expand_a1r10g10b10(pg->ctx_switch, pg->canvas_config, val);
+			return 1;
+		case 0x05:
+			if (mthd != 0x300 && mthd != 0x304)
+				return 0;
+			nv01_pgraph_set_clip(pg, mthd == 0x304, val);
+			return 1;
+		case 0x06:
+			if (mthd == 0x308) {
+				pg->pattern_shape = val & 3;
+				if (val > 2)
+					nv01_sim_invalid(pg, 0x10);
+				return 1;
+			}
+			if (mthd == 0x310 || mthd == 0x314) {
+				int idx = mthd >> 2 & 1;
+				nv01_pgraph_expand_color(pg->ctx_switch, pg->canvas_config, val, &pg->pattern_rgb[idx], &pg->pattern_a[idx]);
+				return 1;
+			}
+			if (mthd == 0x318 || mthd == 0x31c) {
+				pg->pattern_bitmap[mthd >> 2 & 1] = nv01_pgraph_expand_mono(pg->ctx_switch, val);
+				return 1;
+			}
+			return 0;
+		case 0x08:
+			if (mthd == 0x304 || (mthd >= 0x500 && mthd < 0x580 && !(mthd & 4))) {
+				pg->source_color = val;
+				return 1;
+			}
+			if ((mthd >= 0x400 && mthd < 0x500) || (mthd >= 0x500 && mthd < 0x580)) {
+				nv01_sim_point(sim, val);
+				return 1;
+			}
+			return 0;
+		case 0x09:
+		case 0x0a:
+			if (mthd == 0x304 || (mthd >= 0x600 && mthd < 0x680 && !(mthd & 4))) {
+				pg->source_color = val;
+				return 1;
+			}
+			return mthd >= 0x400 && mthd < 0x680;
+		case 0x0b:
+			if (mthd == 0x304 || mthd == 0x500 || (mthd >= 0x580 && mthd < 0x600 && !(mthd & 4))) {
+				pg->source_color = val;
+				return 1;
+			}
+			return (mthd >= 0x310 && mthd < 0x31c) || (mthd >= 0x320 && mthd < 0x338) || (mthd >= 0x400 && mthd < 0x600);
+		case 0x0c:
+			if (mthd == 0x304) {
+				pg->source_color = val;
+				return 1;
+			}
+			return mthd >= 0x400 && mthd < 0x480;
+		case 0x0d:
+		case 0x0e:
+		case 0x1d:
+		case 0x1e: {
+			int vcnt = (class & 0xf) == 0xe ? 9 : 4;
+			if (mthd == 0x304) {
+				nv01_sim_subdivide(pg, val);
+				return 1;
+			}
+			if (mthd >= 0x310 && mthd < 0x310 + vcnt * 4) {
+				nv01_sim_tex_vtx(pg, (mthd - 0x310) >> 2, 0, val);
+				return 1;
+			}
+			if (mthd >= 0x350 && mthd < 0x350 + vcnt * 4) {
+				nv01_sim_tex_vtx(pg, (mthd - 0x350) >> 2, 1, val);
+				return 1;
+			}
+			if (class & 0x10 && mthd >= 0x380 && mthd < 0x380 + (vcnt + 1) / 2 * 4) {
+				nv01_sim_tex_beta(pg, (mthd - 0x380) >> 2, val);
+				return 1;
+			}
+			return mthd >= 0x400 && mthd < 0x480;
+		}
+		case 0x10:
+			return mthd >= 0x300 && mthd < 0x30c;
+		case 0x11:
+			return (mthd >= 0x304 && mthd < 0x310) || (mthd >= 0x400 && mthd < 0x480);
+		case 0x12:
+			if (mthd == 0x308 || mthd == 0x30c) {
+				pg->bitmap_color[mthd >> 2 & 1] = nv01_pgraph_expand_a1r10g10b10(pg->ctx_switch, pg->canvas_config, val);
+				return 1;
+			}
+			return (mthd >= 0x308 && mthd < 0x31c) || (mthd >= 0x400 && mthd < 0x480);
+		case 0x13:
+			return (mthd >= 0x308 && mthd < 0x318) || (mthd >= 0x40 && mthd < 0x80);
+		case 0x14:
+			return mthd >= 0x308 && mthd < 0x318;
+		default:
+			return 0;
+	}
+}
+
+static void nv01_sim_soft_reset(struct nv01_pgraph_state *pg) {
+	pg->valid = 0;
+	pg->edgefill &= 0xffff0000;
+	pg->xy_misc_0 &= 0x1000;
+	pg->xy_misc_1 &= 0x03000000;
+	pg->xy_misc_2[0] = (pg->xy_misc_2[0] & 0xff000000) | 0x00555500;
+	pg->xy_misc_2[1] = (pg->xy_misc_2[1] & 0xff000000) | 0x00555500;
+}
+
+static uint32_t nv01_sim_rd32(struct nva_card *card, uint32_t addr) {
+	struct nv01_sim *sim = card->priv;
+	struct nv01_pgraph_state *pg = &sim->pgraph;
+	uint32_t *reg, mask;
+	if (addr >= 0x1000000) {
+		uint32_t a = addr & sim->vram_mask & ~3;
+		return sim->vram[a] | sim->vram[a+1] << 8 | sim->vram[a+2] << 16 | (uint32_t)sim->vram[a+3] << 24;
+	}
+	switch (addr) {
+		case 0x000000:
+			return 0x00010100;
+		case 0x000200:
+			return sim->pmc_enable;
+		case 0x400100:
+			return pg->intr;
+		case 0x400104:
+			return pg->invalid;
+		case 0x4006a4:
+			return pg->access;
+		case 0x4006b0:
+			return 0;
+	}
+	if ((addr & ~0x1ff) == 0x400400) {
+		int idx = addr >> 2 & 0x1f;
+		if ((addr & 0x7f) < 0x48)
+			return (addr & 0x80 ? pg->vtx_y : pg->vtx_x)[idx];
+		if ((addr & ~7) == 0x400450)
+			return pg->iclip[addr >> 2 & 1];
+		if ((addr & ~0xf) == 0x400460) {
+			/* reading the user clip disturbs the clip status */
+			pg->xy_misc_1 &= ~0xfff000;
+			return (addr & 4 ? pg->uclip_max : pg->uclip_min)[addr >> 3 & 1];
+		}
+		return 0;
+	}
+	if (addr >= 0x400700 && addr < 0x400738)
+		return pg->vtx_beta[(addr - 0x400700) >> 2];
+	if (addr == 0x400630)
+		return pg->beta;
+	if ((reg = nv01_sim_reg(sim, addr, &mask)))
+		return *reg;
+	return 0;
+}
+
+static void nv01_sim_wr32(struct nva_card *card, uint32_t addr, uint32_t val) {
+	struct nv01_sim *sim = card->priv;
+	struct nv01_pgraph_state *pg = &sim->pgraph;
+	uint32_t *reg, mask;
+	if (addr >= 0x1000000) {
+		uint32_t a = addr & sim->vram_mask & ~3;
+		sim->vram[a] = val;
+		sim->vram[a+1] = val >> 8;
+		sim->vram[a+2] = val >> 16;
+		sim->vram[a+3] = val >> 24;
+		return;
+	}
+	if (addr >= 0x410000 && addr < 0x600000) {
+		int class = addr >> 16 & 0x1f;
+		if (!nv01_sim_mthd(sim, class, addr & 0x1fff, val))
+			nv01_sim_invalid(pg, 1);
+		return;
+	}
+	switch (addr) {
+		case 0x000200:
+			/* PGRAPH reset */
+			if (!(val & 0x1000)) {
+				uint32_t pfb_config = pg->pfb_config, pfb_boot = pg->pfb_boot;
+				memset(pg, 0, sizeof *pg);
+				pg->pfb_config = pfb_config;
+				pg->pfb_boot = pfb_boot;
+				pg->access = 0x0f000000;
+			}
+			sim->pmc_enable = val;
+			return;
+		case 0x400080:
+			if (val & 1)
+				nv01_sim_soft_reset(pg);
+			break;
+		case 0x400100:
+			pg->intr &= ~val;
+			return;
+		case 0x400104:
+			pg->invalid &= ~val;
+			return;
+		case 0x400180:
+			pg->debug[1] &= ~1;
+			pg->ctx_control &= ~0x01000000;
+			break;
+		case 0x400630:
+			pg->beta = val & 0x80000000 ? 0 : val & 0x7f800000;
+			return;
+		case 0x4006a4:
+			if (val & 1 << 24)
+				insrt(pg->access, 0, 1, extr(val, 0, 1));
+			if (val & 1 << 25)
+				insrt(pg->access, 4, 1, extr(val, 4, 1));
+			if (val & 1 << 26)
+				insrt(pg->access, 8, 1, extr(val, 8, 1));
+			if (val & 1 << 27)
+				insrt(pg->access, 12, 5, extr(val, 12, 5));
+			return;
+		case 0x4006b0:
+			return;
+	}
+	if ((addr & ~0x1ff) == 0x400400) {
+		int rel = addr >> 8 & 1;
+		uint32_t a = addr & ~0x100;
+		if ((a & 0x7f) < 0x48)
+			nv01_pgraph_vtx_fixup(pg, a >> 7 & 1, a >> 2 & 0x1f, val, rel);
+		else if ((a & ~7) == 0x400450)
+			nv01_pgraph_iclip_fixup(pg, a >> 2 & 1, val, rel);
+		else if ((a & ~0xf) == 0x400460)
+			nv01_pgraph_uclip_fixup(pg, a >> 3 & 1, a >> 2 & 1, val, rel);
+		return;
+	}
+	if (addr >= 0x400700 && addr < 0x400738) {
+		pg->vtx_beta[(addr - 0x400700) >> 2] = val & 0x01ffffff;
+		return;
+	}
+	if ((reg = nv01_sim_reg(sim, addr, &mask)))
+		*reg = val & mask;
+}
+
+static uint32_t nv01_sim_rd8(struct nva_card *card, uint32_t addr) {
+	return nv01_sim_rd32(card, addr & ~3) >> (addr & 3) * 8 & 0xff;
+}
+
+static void nv01_sim_wr8(struct nva_card *card, uint32_t addr, uint32_t val) {
+	struct nv01_sim *sim = card->priv;
+	if (addr >= 0x1000000)
+		sim->vram[addr & sim->vram_mask] = val;
+}
+
+static const struct nva_backend nv01_sim_backend = {
+	nv01_sim_rd32, nv01_sim_wr32, nv01_sim_rd8, nv01_sim_wr8,
+};
+
+/* creates a simulated card, returns its card index or -1 if there's no model */
+int hwtest_sim_card(int chipset) {
+	if (chipset == 0x01) {
+		struct nv01_sim *sim = calloc(sizeof *sim, 1);
+		sim->vram = calloc(NV01_SIM_VRAM_SIZE, 1);
+		sim->vram_mask = NV01_SIM_VRAM_SIZE - 1;
+		sim->pmc_enable = 0x01111111;
+		sim->pgraph.pfb_boot = 2;	/* 4MB */
+		sim->pgraph.access = 0x0f000000;	/* write enables always read as 1 */
+		return nva_add_card(chipset, &nv01_sim_backend, sim);
+	}
+	return -1;
+}
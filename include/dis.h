@@ -50,6 +50,34 @@ struct label {
 	unsigned size;
 };
 
+struct easm_insn;
+
+#define ED_MAXOPLEN (128/64)
+
+enum dis_status {
+	DIS_STATUS_OK = 0,
+	DIS_STATUS_EOF = 0x1,		/* EOF in the middle of an opcode */
+	DIS_STATUS_UNK_FORM = 0x2,	/* failed to determine instruction format - opcode length uncertain */
+	DIS_STATUS_UNK_INSN = 0x4,	/* failed to determine instruction name - unknown opcode or due to one of the above errors */
+	DIS_STATUS_UNK_OPERAND = 0x8,	/* failed to determine instruction operands */
+	DIS_STATUS_UNUSED_BITS = 0x10,	/* instruction decoded, but unused bitfields have non-default values */
+};
+
+/* a single decoded instruction, as returned by ed_decode */
+struct ed_insn {
+	struct easm_insn *insn;		/* operand tree, owned by this struct */
+	const char *name;		/* mnemonic of the first sub-instruction, points into insn */
+	uint32_t pos;
+	uint32_t oplen;			/* in code positions */
+	uint32_t avail;			/* code positions that were available to the decoder */
+	enum dis_status status;
+	int endmark;
+	unsigned long long raw[ED_MAXOPLEN];	/* opcode as read from the code */
+	unsigned long long unk[ED_MAXOPLEN];	/* opcode bits not claimed by any decoded field */
+};
+
+struct ed_decoder;
+
 const struct disisa *ed_getisa(const char *name);
 
 uint32_t ed_getcbsz(const struct disisa *isa, struct varinfo *varinfo);
@@ -58,6 +86,16 @@ static inline int ed_getcstride(const struct disisa *isa, struct varinfo *varinf
 	return CEILDIV(ed_getcbsz(isa, varinfo), 8);
 }
 
+struct ed_decoder *ed_decoder_new(const struct disisa *isa, struct varinfo *varinfo);
+void ed_decoder_del(struct ed_decoder *dec);
+
+/* decodes one instruction at code[0], num is the code size available, pos its address. returns insn->oplen. */
+int ed_decode(struct ed_decoder *dec, const uint8_t *code, uint32_t num, uint32_t pos, struct ed_insn *insn);
+void ed_insn_fini(struct ed_insn *insn);
+
+/* prints a decoded instruction the same way envydis would */
+void ed_print_insn(const struct ed_decoder *dec, FILE *out, const struct envy_colors *cols, const struct ed_insn *insn, int quiet);
+
 void envydis (const struct disisa *isa, FILE *out, uint8_t *code, uint32_t start, int num, struct varinfo *varinfo, int quiet, struct label *labels, int labelsnum, const struct envy_colors *cols);
 
 #endif
@@ -27,6 +27,16 @@
 #include <stdint.h>
 #include <stddef.h>
 
+struct nva_card;
+
+/* register access for cards that aren't mapped PCI devices, eg. simulated ones */
+struct nva_backend {
+	uint32_t (*rd32) (struct nva_card *card, uint32_t addr);
+	void (*wr32) (struct nva_card *card, uint32_t addr, uint32_t val);
+	uint32_t (*rd8) (struct nva_card *card, uint32_t addr);
+	void (*wr8) (struct nva_card *card, uint32_t addr, uint32_t val);
+};
+
 struct nva_card {
 	struct pci_device *pci;
 	uint32_t boot0;
@@ -41,9 +51,12 @@ struct nva_card {
 	int hasbar2;
 	void *bar2;
 	size_t bar2len;
+	const struct nva_backend *backend;	/* NULL for BAR0 mapped cards */
+	void *priv;
 };
 
 int nva_init();
+int nva_add_card(int chipset, const struct nva_backend *backend, void *priv);
 extern struct nva_card *nva_cards;
 extern int nva_cardsnum;
 
@@ -64,19 +77,29 @@ static inline void nva_gwr8(void *base, uint32_t addr, uint32_t val) {
 }
 
 static inline uint32_t nva_rd32(int card, uint32_t addr) {
+	if (nva_cards[card].backend)
+		return nva_cards[card].backend->rd32(&nva_cards[card], addr);
 	return nva_grd32(nva_cards[card].bar0, addr);
 }
 
 static inline void nva_wr32(int card, uint32_t addr, uint32_t val) {
-	nva_gwr32(nva_cards[card].bar0, addr, val);
+	if (nva_cards[card].backend)
+		nva_cards[card].backend->wr32(&nva_cards[card], addr, val);
+	else
+		nva_gwr32(nva_cards[card].bar0, addr, val);
 }
 
 static inline uint32_t nva_rd8(int card, uint32_t addr) {
+	if (nva_cards[card].backend)
+		return nva_cards[card].backend->rd8(&nva_cards[card], addr);
 	return nva_grd8(nva_cards[card].bar0, addr);
 }
 
 static inline void nva_wr8(int card, uint32_t addr, uint32_t val) {
-	nva_gwr8(nva_cards[card].bar0, addr, val);
+	if (nva_cards[card].backend)
+		nva_cards[card].backend->wr8(&nva_cards[card], addr, val);
+	else
+		nva_gwr8(nva_cards[card].bar0, addr, val);
 }
 
 static inline uint32_t nva_mask(int cnum, uint32_t reg, uint32_t mask, uint32_t val)
@@ -112,6 +135,77 @@ struct nva_regspace {
 int nva_wr(struct nva_regspace *regspace, uint32_t addr, uint64_t val);
 int nva_rd(struct nva_regspace *regspace, uint32_t addr, uint64_t *val);
 
+/*
+ * Bulk accesses: index and window setup is done once for the whole batch.
+ * errs (may be NULL) gets the error for every access, the return value is the
+ * first error hit or 0.  The range variants access num consecutive registers
+ * starting at addr.
+ */
+int nva_rdv(struct nva_regspace *regspace, const uint32_t *addrs, int num, uint64_t *vals, int *errs);
+int nva_wrv(struct nva_regspace *regspace, const uint32_t *addrs, int num, const uint64_t *vals, int *errs);
+int nva_rdrange(struct nva_regspace *regspace, uint32_t addr, int num, uint64_t *vals, int *errs);
+int nva_wrrange(struct nva_regspace *regspace, uint32_t addr, int num, const uint64_t *vals, int *errs);
+
+/* result of writing all 1s and all 0s to a register, then restoring it */
+struct nva_rsscan {
+	uint64_t orig;
+	uint64_t ones;
+	uint64_t zeros;
+	int err;	/* error reading orig - nothing else is done then */
+	int oneserr;
+	int zeroserr;
+	int werr;	/* any of the writes failed */
+};
+
+int nva_scanrange(struct nva_regspace *regspace, uint32_t addr, int num, struct nva_rsscan *res);
+
+/*
+ * Register sampler, see watch.c.  Each record is nva_watch_stride() words:
+ * PTIMER low, PTIMER high (0 without NVA_WATCH_TIME), the number of samples
+ * dropped right before this one because the ring was full, then the register
+ * values in the order given.  peek hands out the records that are ready, in
+ * one contiguous run, without blocking; wait sleeps until there are some and
+ * returns 0 only once the poller is done and everything has been consumed.
+ */
+#define NVA_WATCH_TIME	1	/* read PTIMER with every sample */
+#define NVA_WATCH_ALL	2	/* keep every sample, not only changes */
+#define NVA_WATCH_HDR	3
+
+struct nva_watch;
+
+struct nva_watch *nva_watch_new(int cnum, const uint32_t *regs, int regsnum, int flags, int ringlog2);
+int nva_watch_start(struct nva_watch *w, int cpu, uint64_t duration_ns);
+int nva_watch_peek(struct nva_watch *w, const uint32_t **recs);
+int nva_watch_wait(struct nva_watch *w, const uint32_t **recs);
+void nva_watch_consume(struct nva_watch *w, int num);
+void nva_watch_interrupt(struct nva_watch *w);
+void nva_watch_stop(struct nva_watch *w);
+int nva_watch_stride(struct nva_watch *w);
+void nva_watch_stats(struct nva_watch *w, uint64_t *samples, uint64_t *lost);
+void nva_watch_free(struct nva_watch *w);
+
+/* value histogram in bounded memory, see hist.c */
+struct nva_hist_ent {
+	uint32_t val;
+	uint64_t cnt;
+};
+
+struct nva_hist {
+	struct nva_hist_ent *ents;
+	struct nva_hist_ent *spare;
+	uint32_t size;
+	int shift;
+	uint32_t max;	/* distinct values kept */
+	uint32_t used;
+	uint64_t total;	/* values added */
+	uint64_t err;	/* max undercount of any value, 0 while counts are exact */
+};
+
+void nva_hist_init(struct nva_hist *h, int maxlog2);
+void nva_hist_add(struct nva_hist *h, uint32_t val);
+int nva_hist_sorted(struct nva_hist *h, struct nva_hist_ent **res);
+void nva_hist_fini(struct nva_hist *h);
+
 enum nva_err {
 	NVA_ERR_SUCCESS,
 	NVA_ERR_RANGE,
@@ -62,6 +62,26 @@ int has_large_tile(int chipset);
 int tile_bankoff_bits(int chipset);
 uint32_t tile_translate_addr(int chipset, uint32_t pitch, uint32_t address, int mode, int bankoff, const struct mc_config *mcc, int *ppart, int *ptag);
 
+/* tile_translate_addr precomputed for one surface, see tile_plan_new */
+struct tile_plan {
+	uint32_t pitch;
+	uint32_t units;		/* 16-byte units per line */
+	uint32_t rows;		/* lines per period */
+	uint32_t period;	/* bytes per period */
+	uint32_t period_addr;	/* translated address step per period */
+	int period_tag;
+	int has_tag;		/* part and tag are only known for NV20 and NV40 style tiling */
+	uint32_t *addr;
+	uint8_t *part;
+	int *tag;
+};
+
+struct tile_plan *tile_plan_new(int chipset, uint32_t pitch, int mode, int bankoff, const struct mc_config *mcc);
+void tile_plan_free(struct tile_plan *plan);
+uint32_t tile_plan_translate(const struct tile_plan *plan, uint32_t address, int *ppart, int *ptag);
+void tile_detile(const struct tile_plan *plan, uint8_t *linear, const uint8_t *tiled, uint32_t size, int jobs);
+void tile_retile(const struct tile_plan *plan, uint8_t *tiled, const uint8_t *linear, uint32_t size, int jobs);
+
 int is_igp(int chipset);
 int is_g7x(int chipset);
 int get_maxparts(int chipset);
@@ -96,5 +116,9 @@ int comp_format_ms(int chipset, int format);
 int comp_format_bpp(int chipset, int format);
 
 void comp_decompress(int chipset, int format, uint8_t *data, int tag);
+int comp_tile_size(int chipset);
+void comp_decompress_tiles(int chipset, int format, uint8_t *data, const int *tags, int num, int jobs);
+
+void nvhw_run_chunks(int num, int chunk, int jobs, void (*fn) (void *arg, int start, int end), void *arg);
 
 #endif
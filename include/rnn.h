@@ -68,6 +68,25 @@ struct rnndb {
 	int filesnum;
 	int filesmax;
 	int estatus;
+	int jobs;	/* threads parsing imported files, 0 means one per CPU, 1 none */
+	struct rnnprefetch *prefetch;
+	struct rnncache *cache;
+};
+
+/*
+ * Parsed documents kept across loads of the same database, for tools that
+ * reload it after every edit: see rnn_reloaddb.
+ */
+struct rnncache {
+	struct rnnpfile *files;
+	int filesnum;
+	int filesmax;
+	void **failed;		/* entities whose preparation reported errors */
+	int failednum;
+	int failedmax;
+	int parsed;		/* files parsed by the last load, the rest were cached */
+	int prepared;		/* top-level entities prepared by the last load */
+	int reused;		/* ... and taken over from the previous database */
 };
 
 struct rnnvarset {
@@ -98,6 +117,22 @@ struct rnnenum {
 	char *fullname;
 	int prepared;
 	char *file;
+	struct rnnvalindex *vindex;
+};
+
+/*
+ * value -> vals[] index lookup, built by rnn_prepdb: a dense table when the
+ * values are compact enough, a sorted array otherwise.  Entries sharing a
+ * value (usually for different variants) are chained in database order.
+ */
+struct rnnvalindex {
+	uint64_t base;
+	int *dense;		/* first index for each value in [base, base + densenum), or -1 */
+	int densenum;
+	int *sorted;		/* otherwise first index for each distinct value, by value */
+	int sortednum;
+	struct rnnvalue **vals;
+	int *next;		/* next index with the same value, or -1 */
 };
 
 struct rnnvalue {
@@ -139,6 +174,8 @@ struct rnntypeinfo {
 	int shr;
 	uint64_t min, max, align, radix;
 	int minvalid, maxvalid, alignvalid, radixvalid;
+	struct rnnvalindex *vindex;	/* inline enums only, built by rnn_prepdb */
+	struct rnnbitplan *plan;	/* inline bitsets only, built by rnn_prepdb */
 };
 
 struct rnnbitset {
@@ -150,7 +187,37 @@ struct rnnbitset {
 	int bitfieldsnum;
 	int bitfieldsmax;
 	char *fullname;
+	int prepared;
 	char *file;
+	struct rnnbitplan *plan;
+};
+
+/*
+ * Flattened form of a bitset for decoding: field extraction parameters and
+ * the bitfield type resolved through spectypes.
+ */
+struct rnnbitplanfield {
+	struct rnnbitfield *bf;
+	uint64_t mask;
+	int low;
+	int width;
+	enum rnnplankind {
+		RNN_PLAN_GENERIC,	/* decode through bf->typeinfo */
+		RNN_PLAN_BOOLEAN,
+		RNN_PLAN_HEX,
+		RNN_PLAN_UINT,
+		RNN_PLAN_ENUM,
+	} kind;
+	int always;		/* has no variant restrictions */
+	struct rnnvalindex *vindex;	/* RNN_PLAN_ENUM */
+};
+
+struct rnnbitplan {
+	struct rnnbitplanfield *fields;
+	int fieldsnum;
+	int fieldsmax;
+	uint64_t mask;		/* all field bits */
+	int always;		/* no field has variant restrictions */
 };
 
 struct rnnbitfield {
@@ -174,6 +241,7 @@ struct rnndomain {
 	int subelemsnum;
 	int subelemsmax;
 	char *fullname;
+	int prepared;
 	char *file;
 };
 
@@ -221,6 +289,7 @@ struct rnndelem {
 struct rnnspectype {
 	char *name;
 	struct rnntypeinfo typeinfo;
+	int prepared;
 	char *file;
 };
 
@@ -228,9 +297,18 @@ void rnn_init();
 struct rnndb *rnn_newdb();
 void rnn_parsefile (struct rnndb *db, char *file);
 void rnn_prepdb (struct rnndb *db);
+struct rnncache *rnn_newcache();
+int rnn_pollcache (struct rnncache *cache);
+struct rnndb *rnn_reloaddb (struct rnncache *cache, struct rnndb *old, char *file);
 struct rnnenum *rnn_findenum (struct rnndb *db, const char *name);
 struct rnnbitset *rnn_findbitset (struct rnndb *db, const char *name);
 struct rnndomain *rnn_finddomain (struct rnndb *db, const char *name);
 struct rnnspectype *rnn_findspectype (struct rnndb *db, const char *name);
+struct rnnvalue *rnn_findvalue (struct rnnenum *en, uint64_t value);
+struct rnnvalindex *rnn_valindex (struct rnnvalue **vals, int valsnum);
+int rnn_valindex_first (struct rnnvalindex *vindex, uint64_t value);
+void rnn_freevalindex (struct rnnvalindex *vindex);
+struct rnnbitplan *rnn_bitplan (struct rnnbitfield **bitfields, int bitfieldsnum);
+void rnn_freebitplan (struct rnnbitplan *plan);
 
 #endif
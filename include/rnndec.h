@@ -33,12 +33,34 @@ struct rnndecvariant {
 	int variant;
 };
 
+struct rnndecspec {
+	const void *orig;
+	void *copy;
+};
+
 struct rnndeccontext {
 	struct rnndb *db;
 	struct rnndecvariant **vars;
 	int varsnum;
 	int varsmax;
 	const struct envy_colors *colors;
+	/* set by rnndec_specialize: decode through pruned copies only */
+	int specialized;
+	struct rnndecspec *specdoms;
+	int specdomsnum;
+	int specdomsmax;
+	struct rnndecspec *specs;
+	int specsnum;
+	int specsmax;
+	void **specmem;
+	int specmemnum;
+	int specmemmax;
+	struct rnnbitplan **specplans;
+	int specplansnum;
+	int specplansmax;
+	struct rnnvalindex **specindices;
+	int specindicesnum;
+	int specindicesmax;
 };
 
 struct rnndecaddrinfo {
@@ -47,13 +69,76 @@ struct rnndecaddrinfo {
 	char *name;
 };
 
+/*
+ * Batched address decoding: rnndec_decodebatch resolves each distinct
+ * (addr, write) pair of a trace once and records the path to it as a list
+ * of steps; names are only built by rnndec_appendmatch, if at all.
+ */
+
+/* one register access, match is filled in by rnndec_decodebatch */
+struct rnndecaccess {
+	uint64_t addr;
+	uint64_t value;
+	int write;
+	int match;
+};
+
+/* one element on the path to a register, with its own index */
+struct rnndecstep {
+	struct rnndelem *elem;
+	uint64_t idx;
+};
+
+struct rnndecmatch {
+	uint64_t addr;
+	int write;
+	int found;			/* what rnndec_appendaddr would return */
+	struct rnntypeinfo *typeinfo;	/* 0 unless a register matched */
+	int width;
+	uint64_t offset;		/* into the last step's element */
+	int steps;			/* first step in batch->steps */
+	int stepsnum;
+};
+
+struct rnndecbatch {
+	struct rnndeccontext *ctx;
+	struct rnndomain *domain;
+	struct rnndecmatch *matches;
+	int matchesnum;
+	int matchesmax;
+	struct rnndecstep *steps;
+	int stepsnum;
+	int stepsmax;
+	int *hash;
+	int hashsize;
+};
+
+/* growable output buffer for the append variants below */
+struct rnndecbuf {
+	char *str;
+	size_t len;
+	size_t max;
+};
+
 struct rnndeccontext *rnndec_newcontext(struct rnndb *db);
+struct rnndeccontext *rnndec_specialize(struct rnndeccontext *ctx);
+void rnndec_freecontext(struct rnndeccontext *ctx);
 int rnndec_varadd(struct rnndeccontext *ctx, char *varset, char *variant);
 int rnndec_varmatch(struct rnndeccontext *ctx, struct rnnvarinfo *vi);
 char *rnndec_decode_enum(struct rnndeccontext *ctx, const char *enumname, uint64_t enumval);
 char *rnndec_decodeval(struct rnndeccontext *ctx, struct rnntypeinfo *ti, uint64_t value, int width);
+void rnndec_appendval(struct rnndeccontext *ctx, struct rnndecbuf *buf, struct rnntypeinfo *ti, uint64_t value, int width);
 int rnndec_checkaddr(struct rnndeccontext *ctx, struct rnndomain *domain, uint64_t addr, int write);
 struct rnndecaddrinfo *rnndec_decodeaddr(struct rnndeccontext *ctx, struct rnndomain *domain, uint64_t addr, int write);
+int rnndec_appendaddr(struct rnndeccontext *ctx, struct rnndecbuf *buf, struct rnndomain *domain, uint64_t addr, int write, struct rnndecaddrinfo *info);
+void rnndec_decodebatch(struct rnndeccontext *ctx, struct rnndecbatch *batch, struct rnndomain *domain, struct rnndecaccess *accs, int accsnum);
+int rnndec_appendmatch(struct rnndeccontext *ctx, struct rnndecbuf *buf, struct rnndecbatch *batch, int match);
+void rnndec_batchclear(struct rnndecbatch *batch);
+void rnndec_batchfree(struct rnndecbatch *batch);
 uint64_t rnndec_decodereg(struct rnndeccontext *ctx, struct rnndomain *domain, const char *name);
 
+void rnndec_bufprintf(struct rnndecbuf *buf, const char *format, ...) __attribute__((format(printf, 2, 3)));
+void rnndec_bufclear(struct rnndecbuf *buf);
+void rnndec_buffree(struct rnndecbuf *buf);
+
 #endif
@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Streaming value histogram in bounded memory.  Counts are kept in an open
+ * addressing hash table and are exact as long as the number of distinct values
+ * fits.  When a new value doesn't, every count is decreased by one and the
+ * values that drop to 0 are evicted (Misra-Gries) - from then on counts are
+ * lower bounds, off by at most err <= total / (max + 1), and any value seen
+ * more than err times is guaranteed to still be in the table.
+ */
+
+#include "nva.h"
+#include <stdlib.h>
+#include <string.h>
+
+static uint32_t nva_hist_hash(uint32_t val) {
+	return val * 0x9e3779b1u;
+}
+
+static void nva_hist_put(struct nva_hist *h, uint32_t val, uint64_t cnt) {
+	uint32_t i = nva_hist_hash(val) >> h->shift;
+	while (h->ents[i].cnt)
+		i = (i + 1) & (h->size - 1);
+	h->ents[i].val = val;
+	h->ents[i].cnt = cnt;
+}
+
+void nva_hist_init(struct nva_hist *h, int maxlog2) {
+	/* keep the table at most half full */
+	h->size = 2u << maxlog2;
+	h->shift = 31 - maxlog2;
+	h->max = 1u << maxlog2;
+	h->used = 0;
+	h->total = 0;
+	h->err = 0;
+	h->ents = calloc(h->size, sizeof *h->ents);
+	h->spare = calloc(h->size, sizeof *h->spare);
+}
+
+void nva_hist_fini(struct nva_hist *h) {
+	free(h->ents);
+	free(h->spare);
+	h->ents = 0;
+	h->spare = 0;
+}
+
+/* drops every count by one, the new value included - so it never gets in */
+static void nva_hist_shrink(struct nva_hist *h) {
+	struct nva_hist_ent *old = h->ents;
+	uint32_t i;
+	h->ents = h->spare;
+	h->spare = old;
+	h->used = 0;
+	for (i = 0; i < h->size; i++) {
+		if (old[i].cnt > 1) {
+			nva_hist_put(h, old[i].val, old[i].cnt - 1);
+			h->used++;
+		}
+		old[i].cnt = 0;
+	}
+	h->err++;
+}
+
+void nva_hist_add(struct nva_hist *h, uint32_t val) {
+	uint32_t i = nva_hist_hash(val) >> h->shift;
+	h->total++;
+	while (h->ents[i].cnt) {
+		if (h->ents[i].val == val) {
+			h->ents[i].cnt++;
+			return;
+		}
+		i = (i + 1) & (h->size - 1);
+	}
+	if (h->used == h->max) {
+		nva_hist_shrink(h);
+		return;
+	}
+	nva_hist_put(h, val, 1);
+	h->used++;
+}
+
+static int nva_hist_cmp(const void *pa, const void *pb) {
+	const struct nva_hist_ent *a = pa;
+	const struct nva_hist_ent *b = pb;
+	return (a->val > b->val) - (a->val < b->val);
+}
+
+int nva_hist_sorted(struct nva_hist *h, struct nva_hist_ent **res) {
+	struct nva_hist_ent *ents = malloc((h->used ? h->used : 1) * sizeof *ents);
+	uint32_t i;
+	int n = 0;
+	for (i = 0; i < h->size; i++)
+		if (h->ents[i].cnt)
+			ents[n++] = h->ents[i];
+	qsort(ents, n, sizeof *ents, nva_hist_cmp);
+	*res = ents;
+	return n;
+}
@@ -33,6 +33,26 @@ struct nva_card *nva_cards = 0;
 int nva_cardsnum = 0;
 int nva_cardsmax = 0;
 
+static int nva_card_type(int chipset) {
+	if (chipset < 0x04)
+		return chipset;
+	else if (chipset < 0x10)
+		return 0x04;
+	else if (chipset < 0x20)
+		return 0x10;
+	else if (chipset < 0x30)
+		return 0x20;
+	else if (chipset < 0x40)
+		return 0x30;
+	else if (chipset < 0x50 ||
+		(chipset & 0xf0) == 0x60)
+		return 0x40;
+	else if (chipset < 0xc0)
+		return 0x50;
+	else
+		return 0xc0;
+}
+
 int nva_init() {
 	int ret;
 	ret = pci_system_init();
@@ -151,23 +171,18 @@ int nva_init() {
 		if (dev->vendor_id == 0x104a && dev->device_id == 0x0009)
 			nva_cards[i].chipset = 0x01;
 
-		if (nva_cards[i].chipset < 0x04)
-			nva_cards[i].card_type = nva_cards[i].chipset;
-		else if (nva_cards[i].chipset < 0x10)
-			nva_cards[i].card_type = 0x04;
-		else if (nva_cards[i].chipset < 0x20)
-			nva_cards[i].card_type = 0x10;
-		else if (nva_cards[i].chipset < 0x30)
-			nva_cards[i].card_type = 0x20;
-		else if (nva_cards[i].chipset < 0x40)
-			nva_cards[i].card_type = 0x30;
-		else if (nva_cards[i].chipset < 0x50 ||
-			(nva_cards[i].chipset & 0xf0) == 0x60)
-			nva_cards[i].card_type = 0x40;
-		else if (nva_cards[i].chipset < 0xc0)
-			nva_cards[i].card_type = 0x50;
-		else
-			nva_cards[i].card_type = 0xc0;
+		nva_cards[i].card_type = nva_card_type(nva_cards[i].chipset);
 	}
 	return (nva_cardsnum == 0);
 }
+
+/* adds a card without a PCI device behind it, returns its index */
+int nva_add_card(int chipset, const struct nva_backend *backend, void *priv) {
+	struct nva_card c = { 0 };
+	c.chipset = chipset;
+	c.card_type = nva_card_type(chipset);
+	c.backend = backend;
+	c.priv = priv;
+	ADDARRAY(nva_cards, c);
+	return nva_cardsnum - 1;
+}
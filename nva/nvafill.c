@@ -56,8 +56,25 @@ int main(int argc, char **argv) {
 		sscanf (argv[optind + 1], "%x", &b);
 	if (optind + 2 < argc)
 		sscanf (argv[optind + 2], "%x", &v);
-	for (i = 0; i < b; i += 4) {
-		nva_wr32(cnum, a+i, v+i);
+	struct nva_regspace rs = { 0 };
+	rs.cnum = cnum;
+	rs.card = &nva_cards[cnum];
+	rs.type = NVA_REGSPACE_BAR0;
+	rs.regsz = 4;
+	while (b > 0) {
+		static uint64_t vals[0x1000];
+		int n = (b + 3) / 4;
+		if (n > 0x1000)
+			n = 0x1000;
+		for (i = 0; i < n; i++)
+			vals[i] = (uint32_t)(v + i * 4);
+		if (nva_wrrange(&rs, a, n, vals, 0)) {
+			fprintf (stderr, "Write to %08x failed.\n", a);
+			return 1;
+		}
+		a += n * 4;
+		v += n * 4;
+		b -= n * 4;
 	}
 	return 0;
 }
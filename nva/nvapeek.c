@@ -76,26 +76,30 @@ int main(int argc, char **argv) {
 		sscanf (argv[optind + 1], "%x", &b);
 	int ls = 1;
 	while (b > 0) {
-		uint64_t z[16];
-		int e[16];
-		int s = 0;
-		for (i = j = 0; i < 16 && i < b; i+=rs.regsz, j++) {
-			e[j] = nva_rd(&rs, a+i, &z[j]);
-			if (e[j] || z[j])
-				s = 1;
-		}
-		if (s) {
-			ls = 1;
-			printf ("%08x:", a);
-			for (i = j = 0; i < 16 && i < b; i+=rs.regsz, j++) {
-				nva_rsprint(&rs, e[j], z[j]);
+		/* fetch up to 0x100 lines in one go */
+		static uint64_t z[0x1000];
+		static int e[0x1000];
+		int32_t cb = b < 0x1000 ? b : 0x1000, l;
+		nva_rdrange(&rs, a, (cb + rs.regsz - 1) / rs.regsz, z, e);
+		for (l = 0; l < cb; l += 16) {
+			int s = 0;
+			for (i = l, j = l / rs.regsz; i < l + 16 && i < cb; i+=rs.regsz, j++) {
+				if (e[j] || z[j])
+					s = 1;
+			}
+			if (s) {
+				ls = 1;
+				printf ("%08x:", a + l);
+				for (i = l, j = l / rs.regsz; i < l + 16 && i < cb; i+=rs.regsz, j++) {
+					nva_rsprint(&rs, e[j], z[j]);
+				}
+				printf ("\n");
+			} else  {
+				if (ls) printf ("...\n"), ls = 0;
 			}
-			printf ("\n");
-		} else  {
-			if (ls) printf ("...\n"), ls = 0;
 		}
-		a+=16;
-		b-=16;
+		a+=cb;
+		b-=cb;
 	}
 	return 0;
 }
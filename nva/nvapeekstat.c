@@ -25,12 +25,34 @@
 #include "nva.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <time.h>
+#include "util.h"
 
-int cmp(const void *pa, const void *pb) {
-	const uint32_t *a = pa;
-	const uint32_t *b = pb;
-	return (*a > *b) - (*a < *b);
+static volatile sig_atomic_t interrupted;
+
+static void sigint(int sig) {
+	interrupted = 1;
+}
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void print_hist(struct nva_hist *h, const char *indent) {
+	struct nva_hist_ent *ents;
+	int n = nva_hist_sorted(h, &ents);
+	int i;
+	if (h->err)
+		printf("%s(%"PRIu64" samples, too many distinct values - counts may be up to %"PRIu64" low, rarer values not shown)\n", indent, h->total, h->err);
+	for (i = 0; i < n; i++)
+		printf("%s%08x: %"PRIu64"\n", indent, ents[i].val, ents[i].cnt);
+	free(ents);
 }
 
 int main(int argc, char **argv) {
@@ -40,11 +62,15 @@ int main(int argc, char **argv) {
 	}
 	int c;
 	int cnum =0;
-	while ((c = getopt (argc, argv, "c:")) != -1)
+	int maxlog2 = 16;
+	while ((c = getopt (argc, argv, "c:m:")) != -1)
 		switch (c) {
 			case 'c':
 				sscanf(optarg, "%d", &cnum);
 				break;
+			case 'm':
+				sscanf(optarg, "%d", &maxlog2);
+				break;
 		}
 	if (cnum >= nva_cardsnum) {
 		if (nva_cardsnum)
@@ -53,28 +79,44 @@ int main(int argc, char **argv) {
 			fprintf (stderr, "No cards found.\n");
 		return 1;
 	}
-	int32_t a, b = 10000, i;
+	if (maxlog2 < 1 || maxlog2 > 30) {
+		fprintf (stderr, "Table size out of range.\n");
+		return 1;
+	}
+	uint32_t *regs = 0;
+	int regsnum = 0, regsmax = 0;
+	uint64_t b = 10000, i;
+	int j;
 	if (optind >= argc) {
 		fprintf (stderr, "No address specified.\n");
 		return 1;
 	}
-	sscanf (argv[optind], "%x", &a);
+	/* several registers are given as a comma separated list and read in turn */
+	char *s = argv[optind];
+	do {
+		uint32_t a = strtoul(s, &s, 16);
+		ADDARRAY(regs, a);
+	} while (*s++ == ',');
 	if (optind + 1 < argc)
-		sscanf (argv[optind + 1], "%d", &b);
-	uint32_t tab[b];
-	for (i = 0; i < b; i++)
-		tab[i] = nva_rd32(cnum, a);
-	qsort(tab, b, sizeof *tab, cmp);
-	uint32_t prev = tab[0];
-	int cnt = 0;
-	for (i = 0; i < b; i++) {
-		if (tab[i] != prev) {
-			printf("%08x: %d\n", prev, cnt);
-			cnt = 0;
-			prev = tab[i];
-		}
-		cnt++;
+		sscanf (argv[optind + 1], "%"SCNu64, &b);
+	struct nva_hist *hists = calloc(regsnum, sizeof *hists);
+	for (j = 0; j < regsnum; j++)
+		nva_hist_init(&hists[j], maxlog2);
+	/* 0 samples means until interrupted */
+	signal(SIGINT, sigint);
+	double start = now();
+	for (i = 0; (!b || i < b) && !interrupted; i++)
+		for (j = 0; j < regsnum; j++)
+			nva_hist_add(&hists[j], nva_rd32(cnum, regs[j]));
+	double elapsed = now() - start;
+	for (j = 0; j < regsnum; j++) {
+		if (regsnum > 1)
+			printf("%08x:\n", regs[j]);
+		print_hist(&hists[j], regsnum > 1 ? "\t" : "");
+		nva_hist_fini(&hists[j]);
 	}
-	printf("%08x: %d\n", prev, cnt);
+	fprintf (stderr, "%"PRIu64" samples in %.3fs, %.0f samples/s\n", i, elapsed, elapsed > 0 ? i / elapsed : 0);
+	free(hists);
+	free(regs);
 	return 0;
 }
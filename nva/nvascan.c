@@ -24,6 +24,7 @@
  */
 
 #include "nva.h"
+#include "util.h"
 #include <stdio.h>
 #include <assert.h>
 #include <unistd.h>
@@ -85,70 +86,92 @@ int main(int argc, char **argv) {
 	if (optind + 1 < argc)
 		sscanf (argv[optind + 1], "%x", &b);
 	int ls = 1;
-	for (i = 0; i < b; i+=rs.regsz) {
-		uint64_t x, y, z;
-		int ex = nva_rd(&rs, a+i, &x);
-		int ew = 0, ey = 0, ev = 0, ez = 0, eb = 0;
-		if (!ex) {
-			ew = nva_wr(&rs, a+i, -1ll);
-			ey = nva_rd(&rs, a+i, &y);
-			ev = nva_wr(&rs, a+i, 0);
-			ez = nva_rd(&rs, a+i, &z);
-			eb = nva_wr(&rs, a+i, x);
-		}
-		if (ex || ey || ez || ey || ev || eb || x || y || z) {
-			if (ex) {
-				printf ("%06x: %c\n", a+i, nva_rserrc(ex));
-			} else {
-				int cool = (x != y) || (y != z);
-				int isalias = 0, areg;
-				if (cool && alias) {
-					int j;
-					nva_wr(&rs, a+i, -1ll);
-					for (j = 0; j < i; j+=4) {
-						uint64_t sv;
-						uint64_t ch;
-						int es = nva_rd(&rs, a+j, &sv);
-						if (!es) {
-							es |= nva_wr(&rs, a+j, 0);
-							es |= nva_rd(&rs, a+i, &ch);
-							es |= nva_wr(&rs, a+j, sv);
-							if (ch == z && !es) {
-								areg = a + j;
-								isalias = 1;
-								break;
+	/*
+	 * readable registers seen so far, for -a.  An alias of a register that
+	 * reacts to writes reads back the same, so only those with the same
+	 * masks are tried; ones that don't react (write-only registers read
+	 * back as 0, for one) could still be aliases and are always tried.
+	 */
+	struct scan_cand {
+		uint32_t addr;
+		uint64_t ones;
+		uint64_t zeros;
+		int cool;
+	} *cands = 0;
+	int candsnum = 0, candsmax = 0;
+	static struct nva_rsscan res[0x100];
+	i = 0;
+	while (i < b) {
+		int n = (b - i + rs.regsz - 1) / rs.regsz, k;
+		if (n > 0x100)
+			n = 0x100;
+		if (slow)
+			n = 1;
+		nva_scanrange(&rs, a+i, n, res);
+		for (k = 0; k < n; k++, i+=rs.regsz) {
+			struct nva_rsscan *r = &res[k];
+			uint64_t x = r->orig, y = r->ones, z = r->zeros;
+			int cool = (x != y) || (y != z);
+			if (r->err || r->oneserr || r->zeroserr || r->werr || x || y || z) {
+				if (r->err) {
+					printf ("%06x: %c\n", a+i, nva_rserrc(r->err));
+				} else {
+					int isalias = 0, areg;
+					if (cool && alias) {
+						int j;
+						nva_wr(&rs, a+i, -1ll);
+						for (j = 0; j < candsnum; j++) {
+							uint64_t sv;
+							uint64_t ch;
+							if (cands[j].cool && (cands[j].ones != y || cands[j].zeros != z))
+								continue;
+							int es = nva_rd(&rs, cands[j].addr, &sv);
+							if (!es) {
+								es |= nva_wr(&rs, cands[j].addr, 0);
+								es |= nva_rd(&rs, a+i, &ch);
+								es |= nva_wr(&rs, cands[j].addr, sv);
+								if (ch == z && !es) {
+									areg = cands[j].addr;
+									isalias = 1;
+									break;
+								}
 							}
 						}
+						nva_wr(&rs, a+i, x);
 					}
-					nva_wr(&rs, a+i, x);
-				}
-				printf ("%06x:", a+i);
-				nva_rsprint(&rs, ex, x);
-				nva_rsprint(&rs, ey, y);
-				nva_rsprint(&rs, ez, z);
-				if (ew || ev || eb)
-					printf(" WERR");
-				if (cool)
-					printf(" *");
-				if (isalias) {
-					printf(" ALIASES %06x", areg);
+					printf ("%06x:", a+i);
+					nva_rsprint(&rs, 0, x);
+					nva_rsprint(&rs, r->oneserr, y);
+					nva_rsprint(&rs, r->zeroserr, z);
+					if (r->werr)
+						printf(" WERR");
+					if (cool)
+						printf(" *");
+					if (isalias) {
+						printf(" ALIASES %06x", areg);
+					}
+					printf("\n");
 				}
-				printf("\n");
+				ls = 1;
+			} else {
+				if (ls)
+					printf("...\n");
+				ls = 0;
+			}
+			if (alias && !r->err) {
+				struct scan_cand cand = { a+i, y, z, cool };
+				ADDARRAY(cands, cand);
+			}
+			if (slow) {
+				int j;
+				for (j = 0; j < 100; j++)
+					nva_rd32(rs.cnum, 0);
+				usleep(10000);
+				for (j = 0; j < 100; j++)
+					nva_rd32(rs.cnum, 0);
 			}
-			ls = 1;
-		} else {
-			if (ls)
-				printf("...\n");
-			ls = 0;
-		}
-		if (slow) {
-			int j;
-			for (j = 0; j < 100; j++)
-				nva_rd32(rs.cnum, 0);
-			usleep(10000);
-			for (j = 0; j < 100; j++)
-				nva_rd32(rs.cnum, 0);
 		}
 	}
+	free(cands);
 	return 0;
 }
@@ -24,46 +24,37 @@
 
 #include "nva.h"
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
-#include <pthread.h>
-#include <sched.h>
+#include <inttypes.h>
+#include <signal.h>
 
-int cnum = 0;
-int32_t a;
-
-static const int SZ = 1024 * 1024;
+/*
+ * binary output: magic, number of registers, flags, the register addresses,
+ * then the records exactly as they are in the ring
+ */
+#define NVAWATCH_MAGIC 0x5741564e	/* "NVAW" */
 
-uint32_t queue[1024 * 1024];
-uint32_t tqueue[1024 * 1024];
-volatile int get = 0, put = 0;
+static struct nva_watch *w;
 
-void *watchfun(void *x) {
-	uint32_t val = nva_rd32(cnum, a);
-	queue[put] = val;
-	put = (put + 1) % SZ;
-	while (1) {
-		uint32_t nval = nva_rd32(cnum, a);
-		if (nval != val) {
-			queue[put] = nval;
-			put = (put + 1) % SZ;
-		}
-		val = nval;
-	}
+static void sigint(int sig) {
+	nva_watch_interrupt(w);
 }
 
-void *twatchfun(void *x) {
-	uint32_t val = nva_rd32(cnum, a);
-	queue[put] = val;
-	tqueue[put] = nva_rd32(cnum, 0x9400);
-	put = (put + 1) % SZ;
-	while (1) {
-		uint32_t nval = nva_rd32(cnum, a);
-		if (nval != val) {
-			queue[put] = nval;
-			tqueue[put] = nva_rd32(cnum, 0x9400);
-			put = (put + 1) % SZ;
-		}
-		val = nval;
+static void print_text(const uint32_t *recs, int num, int stride, int regsnum, int wanttime, uint64_t *ptime) {
+	int i, j;
+	for (i = 0; i < num; i++) {
+		const uint32_t *rec = recs + i * stride;
+		uint64_t time = (uint64_t)rec[1] << 32 | rec[0];
+		if (rec[2])
+			printf("(%u samples lost)\n", rec[2]);
+		if (wanttime)
+			printf("%016"PRIx64"[+%"PRIu64"]:", time, time - *ptime);
+		*ptime = time;
+		for (j = 0; j < regsnum; j++)
+			printf(j || wanttime ? " %08x" : "%08x", rec[NVA_WATCH_HDR + j]);
+		printf("\n");
 	}
 }
 
@@ -73,15 +64,35 @@ int main(int argc, char **argv) {
 		return 1;
 	}
 	int c;
-	int wanttime = 0;
-	while ((c = getopt (argc, argv, "tc:")) != -1)
+	int cnum = 0;
+	int flags = 0;
+	int binary = 0;
+	int cpu = -1;
+	int ringlog2 = 20;
+	uint64_t duration = 0;
+	while ((c = getopt (argc, argv, "tabc:C:d:s:")) != -1)
 		switch (c) {
 			case 't':
-				wanttime = 1;
+				flags |= NVA_WATCH_TIME;
+				break;
+			case 'a':
+				flags |= NVA_WATCH_ALL;
+				break;
+			case 'b':
+				binary = 1;
 				break;
 			case 'c':
 				sscanf(optarg, "%d", &cnum);
 				break;
+			case 'C':
+				sscanf(optarg, "%d", &cpu);
+				break;
+			case 'd':
+				sscanf(optarg, "%"SCNu64, &duration);
+				break;
+			case 's':
+				sscanf(optarg, "%d", &ringlog2);
+				break;
 		}
 	if (cnum >= nva_cardsnum) {
 		if (nva_cardsnum)
@@ -94,18 +105,43 @@ int main(int argc, char **argv) {
 		fprintf (stderr, "No address specified.\n");
 		return 1;
 	}
-	sscanf (argv[optind], "%x", &a);
-	pthread_t thr;
-	pthread_create(&thr, 0, wanttime ? twatchfun : watchfun, 0);
-	uint32_t ptime = 0;
-	while (1) {
-		while (get == put)
-			sched_yield();
-		if (wanttime)
-			printf("%08x[+%d]: %08x\n", tqueue[get], tqueue[get]-ptime, queue[get]);
+	int regsnum = argc - optind;
+	uint32_t *regs = calloc(regsnum, sizeof *regs);
+	int i;
+	for (i = 0; i < regsnum; i++)
+		sscanf (argv[optind + i], "%x", &regs[i]);
+	w = nva_watch_new(cnum, regs, regsnum, flags, ringlog2);
+	if (!w) {
+		fprintf (stderr, "Couldn't allocate a ring of 2^%d samples.\n", ringlog2);
+		return 1;
+	}
+	int stride = nva_watch_stride(w);
+	if (binary) {
+		uint32_t hdr[3] = { NVAWATCH_MAGIC, regsnum, flags };
+		fwrite(hdr, sizeof hdr, 1, stdout);
+		fwrite(regs, sizeof *regs, regsnum, stdout);
+	}
+	signal(SIGINT, sigint);
+	int res = nva_watch_start(w, cpu, duration * 1000000);
+	if (res) {
+		fprintf (stderr, "Couldn't start the poller: %s\n", strerror(-res));
+		return 1;
+	}
+	const uint32_t *recs;
+	uint64_t ptime = 0;
+	int num;
+	while ((num = nva_watch_wait(w, &recs))) {
+		if (binary)
+			fwrite(recs, sizeof *recs * stride, num, stdout);
 		else
-			printf("%08x\n", queue[get]);
-		ptime = tqueue[get];
-		get = (get + 1) % SZ;
+			print_text(recs, num, stride, regsnum, flags & NVA_WATCH_TIME, &ptime);
+		nva_watch_consume(w, num);
+		fflush(stdout);
 	}
+	uint64_t samples, lost;
+	nva_watch_stats(w, &samples, &lost);
+	fprintf (stderr, "%"PRIu64" samples, %"PRIu64" lost.\n", samples, lost);
+	nva_watch_free(w);
+	free(regs);
+	return 0;
 }
@@ -29,176 +29,311 @@
 #include <string.h>
 #include <inttypes.h>
 
-int nva_wr(struct nva_regspace *regspace, uint32_t addr, uint64_t val) {
-	void *rawbase = 0;
+/*
+ * State of a run of accesses to one register space.  Everything that doesn't
+ * depend on the address - checking the space exists, finding the window, saving
+ * and restoring index registers - is done once per run, and index registers that
+ * autoincrement are only rewritten when the next address isn't the one they
+ * already point at.
+ */
+struct nva_rsctx {
+	struct nva_regspace *rs;
+	int err;
+	void *rawbase;
 	size_t rawlen;
-	void *raw;
-	int i;
 	uint32_t vgaio;
 	uint32_t vgabase;
+	uint8_t vgaidx;
+	uint32_t vstbase;
+	uint32_t vstpos;
+	uint32_t vstcfg;
+	int vstcfgset;
+	int nextvalid;
+	uint32_t next;
+};
+
+static inline int nva_rs_rawwr(void *raw, int regsz, uint64_t val) {
+	switch (regsz) {
+		case 1:
+			*(volatile uint8_t *)raw = val;
+			return 0;
+		case 2:
+			*(volatile uint16_t *)raw = val;
+			return 0;
+		case 4:
+			*(volatile uint32_t *)raw = val;
+			return 0;
+		case 8:
+			*(volatile uint64_t *)raw = val;
+			return 0;
+		default:
+			return NVA_ERR_REGSZ;
+	}
+}
+
+static inline int nva_rs_rawrd(void *raw, int regsz, uint64_t *val) {
+	switch (regsz) {
+		case 1:
+			*val = *(volatile uint8_t *)raw;
+			return 0;
+		case 2:
+			*val = *(volatile uint16_t *)raw;
+			return 0;
+		case 4:
+			*val = *(volatile uint32_t *)raw;
+			return 0;
+		case 8:
+			*val = *(volatile uint64_t *)raw;
+			return 0;
+		default:
+			return NVA_ERR_REGSZ;
+	}
+}
+
+/* a lone BAR0 access has nothing to amortize, skip the context setup */
+static inline int nva_rs_bar0(struct nva_regspace *regspace, uint32_t addr, void **raw) {
+	if (!regspace->card->bar0)
+		return NVA_ERR_MAP;
+	if (addr > regspace->card->bar0len - regspace->regsz)
+		return NVA_ERR_RANGE;
+	*raw = (uint8_t *)regspace->card->bar0 + addr;
+	return 0;
+}
+
+static int nva_rs_open(struct nva_regspace *regspace, struct nva_rsctx *ctx) {
+	ctx->rs = regspace;
+	ctx->err = 0;
+	ctx->vgaio = 0;
+	ctx->vstbase = 0;
+	ctx->vstcfgset = 0;
+	ctx->nextvalid = 0;
 	switch (regspace->type) {
 		case NVA_REGSPACE_BAR0:
-			rawbase = regspace->card->bar0;
-			rawlen = regspace->card->bar0len;
+			ctx->rawbase = regspace->card->bar0;
+			ctx->rawlen = regspace->card->bar0len;
 			goto raw;
 		case NVA_REGSPACE_BAR1:
-			rawbase = regspace->card->bar1;
-			rawlen = regspace->card->bar1len;
+			ctx->rawbase = regspace->card->bar1;
+			ctx->rawlen = regspace->card->bar1len;
 			if (!regspace->card->hasbar1)
-				return NVA_ERR_NOSPC;
+				return ctx->err = NVA_ERR_NOSPC;
 			goto raw;
 		case NVA_REGSPACE_BAR2:
-			rawbase = regspace->card->bar2;
-			rawlen = regspace->card->bar2len;
+			ctx->rawbase = regspace->card->bar2;
+			ctx->rawlen = regspace->card->bar2len;
 			if (!regspace->card->hasbar2)
-				return NVA_ERR_NOSPC;
+				return ctx->err = NVA_ERR_NOSPC;
 			goto raw;
 		raw:
-			if (!rawbase)
-				return NVA_ERR_MAP;
-			if (addr > rawlen - regspace->regsz)
-				return NVA_ERR_RANGE;
-			raw = (uint8_t *)rawbase + addr;
-			switch (regspace->regsz) {
-				case 1:
-					*(volatile uint8_t *)raw = val;
-					return 0;
-				case 2:
-					*(volatile uint16_t *)raw = val;
-					return 0;
-				case 4:
-					*(volatile uint32_t *)raw = val;
-					return 0;
-				case 8:
-					*(volatile uint64_t *)raw = val;
-					return 0;
-				default:
-					return NVA_ERR_REGSZ;
-			}
+			if (!ctx->rawbase)
+				return ctx->err = NVA_ERR_MAP;
+			if (regspace->regsz != 1 && regspace->regsz != 2 && regspace->regsz != 4 && regspace->regsz != 8)
+				return ctx->err = NVA_ERR_REGSZ;
+			return 0;
 		case NVA_REGSPACE_PDAC:
 			if (regspace->card->chipset != 0x01)
-				return NVA_ERR_NOSPC;
-			if (addr > 0x10000 - regspace->regsz)
-				return NVA_ERR_RANGE;
+				return ctx->err = NVA_ERR_NOSPC;
 			if (regspace->regsz > 8)
-				return NVA_ERR_REGSZ;
-			nva_wr32(regspace->cnum, 0x609010, addr & 0xff);
-			nva_wr32(regspace->cnum, 0x609014, addr >> 8);
-			for (i = 0; i < regspace->regsz; i++)
-				nva_wr32(regspace->cnum, 0x609018, (val >> i * 8) & 0xff);
+				return ctx->err = NVA_ERR_REGSZ;
 			return 0;
 		case NVA_REGSPACE_EEPROM:
 			if (regspace->card->chipset != 0x01)
-				return NVA_ERR_NOSPC;
+				return ctx->err = NVA_ERR_NOSPC;
 			if (regspace->regsz != 1)
-				return NVA_ERR_REGSZ;
-			if (addr >= 0x80)
-				return NVA_ERR_RANGE;
-			while (nva_rd32(regspace->cnum, 0x60a400) & 0x10000000);
-			nva_wr32(regspace->cnum, 0x60a400, 0x1000000 | addr << 8 | (val & 0xff));
-			while (nva_rd32(regspace->cnum, 0x60a400) & 0x10000000);
+				return ctx->err = NVA_ERR_REGSZ;
 			return 0;
 		case NVA_REGSPACE_VGA_CR:
-			vgaio = 0x3d4;
-			if (addr >= 0x100)
-				return NVA_ERR_RANGE;
+			ctx->vgaio = 0x3d4;
 			goto vga;
 		case NVA_REGSPACE_VGA_SR:
-			vgaio = 0x3c4;
-			if (addr >= 8)
-				return NVA_ERR_RANGE;
+			ctx->vgaio = 0x3c4;
 			goto vga;
 		case NVA_REGSPACE_VGA_GR:
-			vgaio = 0x3ce;
-			if (addr >= 0x10)
-				return NVA_ERR_RANGE;
+			ctx->vgaio = 0x3ce;
 			goto vga;
 		case NVA_REGSPACE_VGA_AR:
-			vgaio = 0x3c0;
-			if (addr >= 0x20)
-				return NVA_ERR_RANGE;
+			ctx->vgaio = 0x3c0;
 			goto vga;
 		vga:
 			if (regspace->regsz != 1)
-				return NVA_ERR_REGSZ;
+				return ctx->err = NVA_ERR_REGSZ;
 			if (regspace->card->card_type == 0x01) {
-				vgabase = 0x6d0000;
+				ctx->vgabase = 0x6d0000;
 				if (regspace->idx != 0)
-					return NVA_ERR_NOSPC;
+					return ctx->err = NVA_ERR_NOSPC;
 			} else if (regspace->card->card_type < 0x50) {
-				if (vgaio == 0x3c4 || vgaio == 0x3ce)
-					vgabase = 0x0c0000;
+				if (ctx->vgaio == 0x3c4 || ctx->vgaio == 0x3ce)
+					ctx->vgabase = 0x0c0000;
 				else
-					vgabase = 0x601000;
+					ctx->vgabase = 0x601000;
 				if (regspace->idx > 2)
-					return NVA_ERR_NOSPC;
+					return ctx->err = NVA_ERR_NOSPC;
 				if ((regspace->card->chipset < 0x17 || regspace->card->chipset == 0x1a || regspace->card->chipset == 0x20) && regspace->idx == 1)
-					return NVA_ERR_NOSPC;
-				vgabase += regspace->idx * 0x2000;
+					return ctx->err = NVA_ERR_NOSPC;
+				ctx->vgabase += regspace->idx * 0x2000;
 			} else {
-				vgabase = 0x601000;
+				ctx->vgabase = 0x601000;
 				if (regspace->idx != 0)
-					return NVA_ERR_NOSPC;
+					return ctx->err = NVA_ERR_NOSPC;
 			}
-			if (vgaio == 0x3c0) {
-				nva_rd8(regspace->cnum, vgabase + 0x3da);
-				uint8_t idx = nva_rd8(regspace->cnum, vgabase + 0x3c0);
-				nva_rd8(regspace->cnum, vgabase + 0x3da);
-				nva_wr8(regspace->cnum, vgabase + 0x3c0, addr);
-				nva_wr8(regspace->cnum, vgabase + 0x3c0, val);
-				nva_wr8(regspace->cnum, vgabase + 0x3c0, idx);
+			if (ctx->vgaio == 0x3c0) {
+				nva_rd8(regspace->cnum, ctx->vgabase + 0x3da);
+				ctx->vgaidx = nva_rd8(regspace->cnum, ctx->vgabase + 0x3c0);
 			} else {
-				uint8_t idx = nva_rd8(regspace->cnum, vgabase + vgaio);
-				nva_wr8(regspace->cnum, vgabase + vgaio, addr);
-				nva_wr8(regspace->cnum, vgabase + vgaio + 1, val);
-				nva_wr8(regspace->cnum, vgabase + vgaio, idx);
+				ctx->vgaidx = nva_rd8(regspace->cnum, ctx->vgabase + ctx->vgaio);
 			}
 			return 0;
 		case NVA_REGSPACE_VGA_ST:
 			if (regspace->card->chipset < 0x41)
-				return NVA_ERR_NOSPC;
+				return ctx->err = NVA_ERR_NOSPC;
 			if (regspace->regsz != 1)
-				return NVA_ERR_REGSZ;
-			uint32_t vstbase = 0x1380;
+				return ctx->err = NVA_ERR_REGSZ;
+			ctx->vstbase = 0x1380;
 			if (regspace->card->card_type >= 0x50)
-				vstbase = 0x619e40;
-			uint32_t savepos = nva_rd32(regspace->cnum, vstbase+0xc);
-			uint32_t savecfg = nva_rd32(regspace->cnum, vstbase+0x8);
-			nva_wr32(regspace->cnum, vstbase+0xc, addr);
-			nva_wr32(regspace->cnum, vstbase+0x8, 7);
-			nva_wr32(regspace->cnum, vstbase+0x0, val);
-			nva_wr32(regspace->cnum, vstbase+0x8, savecfg);
-			nva_wr32(regspace->cnum, vstbase+0xc, savepos);
+				ctx->vstbase = 0x619e40;
+			ctx->vstpos = nva_rd32(regspace->cnum, ctx->vstbase+0xc);
+			ctx->vstcfg = nva_rd32(regspace->cnum, ctx->vstbase+0x8);
 			return 0;
 		case NVA_REGSPACE_PIPE:
 			if (regspace->card->card_type < 0x10 || regspace->card->card_type >= 0x50)
-				return NVA_ERR_NOSPC;
+				return ctx->err = NVA_ERR_NOSPC;
 			if (regspace->regsz != 4)
-				return NVA_ERR_REGSZ;
-			nva_wr32(regspace->cnum, 0x400f50, addr);
-			nva_wr32(regspace->cnum, 0x400f54, val);
+				return ctx->err = NVA_ERR_REGSZ;
 			return 0;
 		case NVA_REGSPACE_RDI:
 			if (regspace->card->card_type < 0x20 || regspace->card->card_type >= 0x50)
-				return NVA_ERR_NOSPC;
+				return ctx->err = NVA_ERR_NOSPC;
 			if (regspace->regsz != 4)
-				return NVA_ERR_REGSZ;
-			nva_wr32(regspace->cnum, 0x400750, addr);
-			nva_wr32(regspace->cnum, 0x400754, val);
+				return ctx->err = NVA_ERR_REGSZ;
 			return 0;
 		case NVA_REGSPACE_UNK1C1_CODE:
 			if (regspace->card->chipset != 0xaf)
-				return NVA_ERR_NOSPC;
+				return ctx->err = NVA_ERR_NOSPC;
 			if (regspace->regsz != 4)
-				return NVA_ERR_REGSZ;
-			nva_wr32(regspace->cnum, 0x1c17c8, addr);
-			nva_wr32(regspace->cnum, 0x1c17cc, val);
+				return ctx->err = NVA_ERR_REGSZ;
 			return 0;
 		case NVA_REGSPACE_UNK1C1_REG:
 			if (regspace->card->chipset != 0xaf)
-				return NVA_ERR_NOSPC;
+				return ctx->err = NVA_ERR_NOSPC;
 			if (regspace->regsz != 8)
-				return NVA_ERR_REGSZ;
+				return ctx->err = NVA_ERR_REGSZ;
+			return 0;
+		default:
+			return ctx->err = NVA_ERR_NOSPC;
+	}
+}
+
+static void nva_rs_close(struct nva_rsctx *ctx) {
+	struct nva_regspace *regspace = ctx->rs;
+	if (ctx->err)
+		return;
+	if (ctx->vgaio == 0x3c0) {
+		nva_rd8(regspace->cnum, ctx->vgabase + 0x3da);
+		nva_wr8(regspace->cnum, ctx->vgabase + 0x3c0, ctx->vgaidx);
+	} else if (ctx->vgaio) {
+		nva_wr8(regspace->cnum, ctx->vgabase + ctx->vgaio, ctx->vgaidx);
+	} else if (ctx->vstbase && ctx->vstcfgset) {
+		nva_wr32(regspace->cnum, ctx->vstbase+0x8, ctx->vstcfg);
+		nva_wr32(regspace->cnum, ctx->vstbase+0xc, ctx->vstpos);
+	}
+}
+
+static int nva_rs_range(struct nva_rsctx *ctx, uint32_t addr) {
+	switch (ctx->rs->type) {
+		case NVA_REGSPACE_BAR0:
+		case NVA_REGSPACE_BAR1:
+		case NVA_REGSPACE_BAR2:
+			return addr > ctx->rawlen - ctx->rs->regsz;
+		case NVA_REGSPACE_PDAC:
+			return addr > 0x10000 - ctx->rs->regsz;
+		case NVA_REGSPACE_EEPROM:
+			return addr >= 0x80;
+		case NVA_REGSPACE_VGA_CR:
+			return addr >= 0x100;
+		case NVA_REGSPACE_VGA_SR:
+			return addr >= 8;
+		case NVA_REGSPACE_VGA_GR:
+			return addr >= 0x10;
+		case NVA_REGSPACE_VGA_AR:
+			return addr >= 0x20;
+		default:
+			return 0;
+	}
+}
+
+/* points an autoincrementing index register at addr, unless it's already there */
+static void nva_rs_seek(struct nva_rsctx *ctx, uint32_t addr, uint32_t reg) {
+	if (ctx->nextvalid && ctx->next == addr)
+		return;
+	nva_wr32(ctx->rs->cnum, reg, addr);
+	ctx->nextvalid = 1;
+}
+
+static int nva_rs_wr(struct nva_rsctx *ctx, uint32_t addr, uint64_t val) {
+	struct nva_regspace *regspace = ctx->rs;
+	int i;
+	if (ctx->err)
+		return ctx->err;
+	if (nva_rs_range(ctx, addr))
+		return NVA_ERR_RANGE;
+	switch (regspace->type) {
+		case NVA_REGSPACE_BAR0:
+		case NVA_REGSPACE_BAR1:
+		case NVA_REGSPACE_BAR2:
+			return nva_rs_rawwr((uint8_t *)ctx->rawbase + addr, regspace->regsz, val);
+		case NVA_REGSPACE_PDAC:
+			/* the index autoincrements over the whole 16-bit space, but
+			 * don't trust it to carry into the high byte */
+			if (!ctx->nextvalid || ctx->next != addr || !(addr & 0xff)) {
+				nva_wr32(regspace->cnum, 0x609010, addr & 0xff);
+				nva_wr32(regspace->cnum, 0x609014, addr >> 8);
+				ctx->nextvalid = 1;
+			}
+			for (i = 0; i < regspace->regsz; i++)
+				nva_wr32(regspace->cnum, 0x609018, (val >> i * 8) & 0xff);
+			ctx->next = addr + regspace->regsz;
+			return 0;
+		case NVA_REGSPACE_EEPROM:
+			while (nva_rd32(regspace->cnum, 0x60a400) & 0x10000000);
+			nva_wr32(regspace->cnum, 0x60a400, 0x1000000 | addr << 8 | (val & 0xff));
+			while (nva_rd32(regspace->cnum, 0x60a400) & 0x10000000);
+			return 0;
+		case NVA_REGSPACE_VGA_CR:
+		case NVA_REGSPACE_VGA_SR:
+		case NVA_REGSPACE_VGA_GR:
+		case NVA_REGSPACE_VGA_AR:
+			if (ctx->vgaio == 0x3c0) {
+				nva_rd8(regspace->cnum, ctx->vgabase + 0x3da);
+				nva_wr8(regspace->cnum, ctx->vgabase + 0x3c0, addr);
+				nva_wr8(regspace->cnum, ctx->vgabase + 0x3c0, val);
+			} else {
+				nva_wr8(regspace->cnum, ctx->vgabase + ctx->vgaio, addr);
+				nva_wr8(regspace->cnum, ctx->vgabase + ctx->vgaio + 1, val);
+			}
+			return 0;
+		case NVA_REGSPACE_VGA_ST:
+			nva_wr32(regspace->cnum, ctx->vstbase+0xc, addr);
+			if (!ctx->vstcfgset) {
+				nva_wr32(regspace->cnum, ctx->vstbase+0x8, 7);
+				ctx->vstcfgset = 1;
+			}
+			nva_wr32(regspace->cnum, ctx->vstbase+0x0, val);
+			return 0;
+		case NVA_REGSPACE_PIPE:
+			nva_rs_seek(ctx, addr, 0x400f50);
+			nva_wr32(regspace->cnum, 0x400f54, val);
+			ctx->next = addr + 4;
+			return 0;
+		case NVA_REGSPACE_RDI:
+			nva_rs_seek(ctx, addr, 0x400750);
+			nva_wr32(regspace->cnum, 0x400754, val);
+			ctx->next = addr + 4;
+			return 0;
+		case NVA_REGSPACE_UNK1C1_CODE:
+			nva_wr32(regspace->cnum, 0x1c17c8, addr);
+			nva_wr32(regspace->cnum, 0x1c17cc, val);
+			return 0;
+		case NVA_REGSPACE_UNK1C1_REG:
 			nva_wr32(regspace->cnum, 0x1c17d0, addr/8);
 			nva_wr32(regspace->cnum, 0x1c17d4, val);
 			nva_wr32(regspace->cnum, 0x1c17d8, val >> 32);
@@ -208,175 +343,71 @@ int nva_wr(struct nva_regspace *regspace, uint32_t addr, uint64_t val) {
 	}
 }
 
-int nva_rd(struct nva_regspace *regspace, uint32_t addr, uint64_t *val) {
-	void *rawbase = 0;
-	size_t rawlen;
-	void *raw;
+static int nva_rs_rd(struct nva_rsctx *ctx, uint32_t addr, uint64_t *val) {
+	struct nva_regspace *regspace = ctx->rs;
 	int i;
-	uint32_t vgaio;
-	uint32_t vgabase;
+	if (ctx->err)
+		return ctx->err;
+	if (nva_rs_range(ctx, addr))
+		return NVA_ERR_RANGE;
 	switch (regspace->type) {
 		case NVA_REGSPACE_BAR0:
-			rawbase = regspace->card->bar0;
-			rawlen = regspace->card->bar0len;
-			goto raw;
 		case NVA_REGSPACE_BAR1:
-			rawbase = regspace->card->bar1;
-			rawlen = regspace->card->bar1len;
-			goto raw;
 		case NVA_REGSPACE_BAR2:
-			rawbase = regspace->card->bar2;
-			rawlen = regspace->card->bar2len;
-			goto raw;
-		raw:
-			if (!rawbase)
-				return NVA_ERR_MAP;
-			if (addr > rawlen - regspace->regsz)
-				return NVA_ERR_RANGE;
-			raw = (uint8_t *)rawbase + addr;
-			switch (regspace->regsz) {
-				case 1:
-					*val = *(volatile uint8_t *)raw;
-					return 0;
-				case 2:
-					*val = *(volatile uint16_t *)raw;
-					return 0;
-				case 4:
-					*val = *(volatile uint32_t *)raw;
-					return 0;
-				case 8:
-					*val = *(volatile uint64_t *)raw;
-					return 0;
-				default:
-					return NVA_ERR_REGSZ;
-			}
+			return nva_rs_rawrd((uint8_t *)ctx->rawbase + addr, regspace->regsz, val);
 		case NVA_REGSPACE_PDAC:
-			if (regspace->card->chipset != 0x01)
-				return NVA_ERR_NOSPC;
-			if (addr > 0x10000 - regspace->regsz)
-				return NVA_ERR_RANGE;
-			if (regspace->regsz > 8)
-				return NVA_ERR_REGSZ;
-			nva_wr32(regspace->cnum, 0x609010, addr & 0xff);
-			nva_wr32(regspace->cnum, 0x609014, addr >> 8);
+			if (!ctx->nextvalid || ctx->next != addr || !(addr & 0xff)) {
+				nva_wr32(regspace->cnum, 0x609010, addr & 0xff);
+				nva_wr32(regspace->cnum, 0x609014, addr >> 8);
+				ctx->nextvalid = 1;
+			}
 			*val = 0;
 			for (i = 0; i < regspace->regsz; i++)
 				*val |= (uint64_t)(nva_rd32(regspace->cnum, 0x609018) & 0xff) << i * 8;
+			ctx->next = addr + regspace->regsz;
 			return 0;
 		case NVA_REGSPACE_EEPROM:
-			if (regspace->card->chipset != 0x01)
-				return NVA_ERR_NOSPC;
-			if (regspace->regsz != 1)
-				return NVA_ERR_REGSZ;
-			if (addr >= 0x80)
-				return NVA_ERR_RANGE;
 			while (nva_rd32(regspace->cnum, 0x60a400) & 0x10000000);
 			nva_wr32(regspace->cnum, 0x60a400, 0x2000000 | addr << 8);
 			while (nva_rd32(regspace->cnum, 0x60a400) & 0x10000000);
 			*val = nva_rd32(regspace->cnum, 0x60a400) & 0xff;
 			return 0;
 		case NVA_REGSPACE_VGA_CR:
-			vgaio = 0x3d4;
-			if (addr >= 0x100)
-				return NVA_ERR_RANGE;
-			goto vga;
 		case NVA_REGSPACE_VGA_SR:
-			vgaio = 0x3c4;
-			if (addr >= 8)
-				return NVA_ERR_RANGE;
-			goto vga;
 		case NVA_REGSPACE_VGA_GR:
-			vgaio = 0x3ce;
-			if (addr >= 0x10)
-				return NVA_ERR_RANGE;
-			goto vga;
 		case NVA_REGSPACE_VGA_AR:
-			vgaio = 0x3c0;
-			if (addr >= 0x20)
-				return NVA_ERR_RANGE;
-			goto vga;
-		vga:
-			if (regspace->regsz != 1)
-				return NVA_ERR_REGSZ;
-			if (regspace->card->card_type == 0x01) {
-				vgabase = 0x6d0000;
-				if (regspace->idx != 0)
-					return NVA_ERR_NOSPC;
-			} else if (regspace->card->card_type < 0x50) {
-				if (vgaio == 0x3c4 || vgaio == 0x3ce)
-					vgabase = 0x0c0000;
-				else
-					vgabase = 0x601000;
-				if (regspace->idx > 2)
-					return NVA_ERR_NOSPC;
-				if ((regspace->card->chipset < 0x17 || regspace->card->chipset == 0x1a || regspace->card->chipset == 0x20) && regspace->idx == 1)
-					return NVA_ERR_NOSPC;
-				vgabase += regspace->idx * 0x2000;
+			if (ctx->vgaio == 0x3c0) {
+				nva_rd8(regspace->cnum, ctx->vgabase + 0x3da);
+				nva_wr8(regspace->cnum, ctx->vgabase + 0x3c0, addr);
+				*val = nva_rd8(regspace->cnum, ctx->vgabase + 0x3c1);
 			} else {
-				vgabase = 0x601000;
-				if (regspace->idx != 0)
-					return NVA_ERR_NOSPC;
-			}
-			if (vgaio == 0x3c0) {
-				nva_rd8(regspace->cnum, vgabase + 0x3da);
-				uint8_t idx = nva_rd8(regspace->cnum, vgabase + 0x3c0);
-				nva_rd8(regspace->cnum, vgabase + 0x3da);
-				nva_wr8(regspace->cnum, vgabase + 0x3c0, addr);
-				*val = nva_rd8(regspace->cnum, vgabase + 0x3c1);
-				nva_rd8(regspace->cnum, vgabase + 0x3da);
-				nva_wr8(regspace->cnum, vgabase + 0x3c0, idx);
-			} else {
-				uint8_t idx = nva_rd8(regspace->cnum, vgabase + vgaio);
-				nva_wr8(regspace->cnum, vgabase + vgaio, addr);
-				*val = nva_rd8(regspace->cnum, vgabase + vgaio + 1);
-				nva_wr8(regspace->cnum, vgabase + vgaio, idx);
+				nva_wr8(regspace->cnum, ctx->vgabase + ctx->vgaio, addr);
+				*val = nva_rd8(regspace->cnum, ctx->vgabase + ctx->vgaio + 1);
 			}
 			return 0;
 		case NVA_REGSPACE_VGA_ST:
-			if (regspace->card->chipset < 0x41)
-				return NVA_ERR_NOSPC;
-			if (regspace->regsz != 1)
-				return NVA_ERR_REGSZ;
-			uint32_t vstbase = 0x1380;
-			if (regspace->card->card_type >= 0x50)
-				vstbase = 0x619e40;
-			uint32_t savepos = nva_rd32(regspace->cnum, vstbase+0xc);
-			uint32_t savecfg = nva_rd32(regspace->cnum, vstbase+0x8);
-			nva_wr32(regspace->cnum, vstbase+0xc, addr+1);
-			nva_wr32(regspace->cnum, vstbase+0x8, 7);
-			*val = nva_rd32(regspace->cnum, vstbase+0x0);
-			nva_wr32(regspace->cnum, vstbase+0x8, savecfg);
-			nva_wr32(regspace->cnum, vstbase+0xc, savepos);
+			nva_wr32(regspace->cnum, ctx->vstbase+0xc, addr+1);
+			if (!ctx->vstcfgset) {
+				nva_wr32(regspace->cnum, ctx->vstbase+0x8, 7);
+				ctx->vstcfgset = 1;
+			}
+			*val = nva_rd32(regspace->cnum, ctx->vstbase+0x0);
 			return 0;
 		case NVA_REGSPACE_PIPE:
-			if (regspace->card->card_type < 0x10 || regspace->card->card_type >= 0x50)
-				return NVA_ERR_NOSPC;
-			if (regspace->regsz != 4)
-				return NVA_ERR_REGSZ;
-			nva_wr32(regspace->cnum, 0x400f50, addr);
+			nva_rs_seek(ctx, addr, 0x400f50);
 			*val = nva_rd32(regspace->cnum, 0x400f54);
+			ctx->next = addr + 4;
 			return 0;
 		case NVA_REGSPACE_RDI:
-			if (regspace->card->card_type < 0x20 || regspace->card->card_type >= 0x50)
-				return NVA_ERR_NOSPC;
-			if (regspace->regsz != 4)
-				return NVA_ERR_REGSZ;
-			nva_wr32(regspace->cnum, 0x400750, addr);
+			nva_rs_seek(ctx, addr, 0x400750);
 			*val = nva_rd32(regspace->cnum, 0x400754);
+			ctx->next = addr + 4;
 			return 0;
 		case NVA_REGSPACE_UNK1C1_CODE:
-			if (regspace->card->chipset != 0xaf)
-				return NVA_ERR_NOSPC;
-			if (regspace->regsz != 4)
-				return NVA_ERR_REGSZ;
 			nva_wr32(regspace->cnum, 0x1c17c8, addr);
 			*val = nva_rd32(regspace->cnum, 0x1c17cc);
 			return 0;
 		case NVA_REGSPACE_UNK1C1_REG:
-			if (regspace->card->chipset != 0xaf)
-				return NVA_ERR_NOSPC;
-			if (regspace->regsz != 8)
-				return NVA_ERR_REGSZ;
 			nva_wr32(regspace->cnum, 0x1c17d0, addr/8);
 			*val = nva_rd32(regspace->cnum, 0x1c17d4);
 			*val |= (uint64_t)nva_rd32(regspace->cnum, 0x1c17d8) << 32;
@@ -386,6 +417,110 @@ int nva_rd(struct nva_regspace *regspace, uint32_t addr, uint64_t *val) {
 	}
 }
 
+int nva_wr(struct nva_regspace *regspace, uint32_t addr, uint64_t val) {
+	struct nva_rsctx ctx;
+	void *raw;
+	int res;
+	if (regspace->type == NVA_REGSPACE_BAR0) {
+		res = nva_rs_bar0(regspace, addr, &raw);
+		return res ? res : nva_rs_rawwr(raw, regspace->regsz, val);
+	}
+	nva_rs_open(regspace, &ctx);
+	res = nva_rs_wr(&ctx, addr, val);
+	nva_rs_close(&ctx);
+	return res;
+}
+
+int nva_rd(struct nva_regspace *regspace, uint32_t addr, uint64_t *val) {
+	struct nva_rsctx ctx;
+	void *raw;
+	int res;
+	if (regspace->type == NVA_REGSPACE_BAR0) {
+		res = nva_rs_bar0(regspace, addr, &raw);
+		return res ? res : nva_rs_rawrd(raw, regspace->regsz, val);
+	}
+	nva_rs_open(regspace, &ctx);
+	res = nva_rs_rd(&ctx, addr, val);
+	nva_rs_close(&ctx);
+	return res;
+}
+
+/* addrs == NULL means a contiguous range of registers starting at addr */
+static uint32_t nva_rs_vaddr(struct nva_regspace *regspace, const uint32_t *addrs, uint32_t addr, int i) {
+	return addrs ? addrs[i] : addr + i * regspace->regsz;
+}
+
+static int nva_rs_rdv(struct nva_regspace *regspace, const uint32_t *addrs, uint32_t addr, int num, uint64_t *vals, int *errs) {
+	struct nva_rsctx ctx;
+	int i, res = 0;
+	nva_rs_open(regspace, &ctx);
+	for (i = 0; i < num; i++) {
+		vals[i] = 0;
+		int err = nva_rs_rd(&ctx, nva_rs_vaddr(regspace, addrs, addr, i), &vals[i]);
+		if (errs)
+			errs[i] = err;
+		if (err && !res)
+			res = err;
+	}
+	nva_rs_close(&ctx);
+	return res;
+}
+
+static int nva_rs_wrv(struct nva_regspace *regspace, const uint32_t *addrs, uint32_t addr, int num, const uint64_t *vals, int *errs) {
+	struct nva_rsctx ctx;
+	int i, res = 0;
+	nva_rs_open(regspace, &ctx);
+	for (i = 0; i < num; i++) {
+		int err = nva_rs_wr(&ctx, nva_rs_vaddr(regspace, addrs, addr, i), vals[i]);
+		if (errs)
+			errs[i] = err;
+		if (err && !res)
+			res = err;
+	}
+	nva_rs_close(&ctx);
+	return res;
+}
+
+int nva_rdv(struct nva_regspace *regspace, const uint32_t *addrs, int num, uint64_t *vals, int *errs) {
+	return nva_rs_rdv(regspace, addrs, 0, num, vals, errs);
+}
+
+int nva_wrv(struct nva_regspace *regspace, const uint32_t *addrs, int num, const uint64_t *vals, int *errs) {
+	return nva_rs_wrv(regspace, addrs, 0, num, vals, errs);
+}
+
+int nva_rdrange(struct nva_regspace *regspace, uint32_t addr, int num, uint64_t *vals, int *errs) {
+	return nva_rs_rdv(regspace, 0, addr, num, vals, errs);
+}
+
+int nva_wrrange(struct nva_regspace *regspace, uint32_t addr, int num, const uint64_t *vals, int *errs) {
+	return nva_rs_wrv(regspace, 0, addr, num, vals, errs);
+}
+
+int nva_scanrange(struct nva_regspace *regspace, uint32_t addr, int num, struct nva_rsscan *res) {
+	struct nva_rsctx ctx;
+	int i, ret = 0;
+	nva_rs_open(regspace, &ctx);
+	for (i = 0; i < num; i++) {
+		struct nva_rsscan *r = &res[i];
+		uint32_t a = addr + i * regspace->regsz;
+		memset(r, 0, sizeof *r);
+		r->err = nva_rs_rd(&ctx, a, &r->orig);
+		if (r->err) {
+			if (!ret)
+				ret = r->err;
+			continue;
+		}
+		r->werr |= nva_rs_wr(&ctx, a, -1ll);
+		r->oneserr = nva_rs_rd(&ctx, a, &r->ones);
+		r->werr |= nva_rs_wr(&ctx, a, 0);
+		r->zeroserr = nva_rs_rd(&ctx, a, &r->zeros);
+		r->werr |= nva_rs_wr(&ctx, a, r->orig);
+	}
+	nva_rs_close(&ctx);
+	return ret;
+}
+
 int nva_rstype(const char *name) {
 	if (!strcmp(name, "bar0"))
 		return NVA_REGSPACE_BAR0;
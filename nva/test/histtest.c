@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Feeds the streaming histogram synthetic data and compares it with exact
+ * counts: exact while the distinct values fit, within the Misra-Gries error
+ * bound once they don't.
+ */
+
+#include "nva.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define MAXLOG2 8
+#define NUM 2000000
+
+struct exact {
+	uint32_t val;
+	uint64_t cnt;
+};
+
+static int exact_cmp(const void *pa, const void *pb) {
+	const struct exact *a = pa;
+	const struct exact *b = pb;
+	return (a->val > b->val) - (a->val < b->val);
+}
+
+/* exact counts by sorting the whole stream */
+static int exact_counts(uint32_t *vals, int num, struct exact *res) {
+	int i, n = 0;
+	uint32_t *tmp = malloc(num * sizeof *tmp);
+	memcpy(tmp, vals, num * sizeof *tmp);
+	qsort(tmp, num, sizeof *tmp, exact_cmp);
+	for (i = 0; i < num; i++) {
+		if (!n || res[n-1].val != tmp[i]) {
+			res[n].val = tmp[i];
+			res[n].cnt = 0;
+			n++;
+		}
+		res[n-1].cnt++;
+	}
+	free(tmp);
+	return n;
+}
+
+static int check(const char *name, uint32_t *vals, int num) {
+	struct nva_hist h;
+	struct nva_hist_ent *ents;
+	struct exact *ex = malloc(num * sizeof *ex);
+	int exn = exact_counts(vals, num, ex);
+	int i, j, n, bad = 0;
+	nva_hist_init(&h, MAXLOG2);
+	for (i = 0; i < num; i++)
+		nva_hist_add(&h, vals[i]);
+	n = nva_hist_sorted(&h, &ents);
+	if (h.total != num) {
+		fprintf(stderr, "%s: total %"PRIu64", expected %d\n", name, h.total, num);
+		bad = 1;
+	}
+	if (exn <= h.max && (h.err || n != exn)) {
+		fprintf(stderr, "%s: %d distinct values should have been exact, got %d entries, err %"PRIu64"\n", name, exn, n, h.err);
+		bad = 1;
+	}
+	if (h.err > (uint64_t)num / (h.max + 1)) {
+		fprintf(stderr, "%s: err %"PRIu64" over the bound\n", name, h.err);
+		bad = 1;
+	}
+	for (i = 0, j = 0; i < exn && !bad; i++) {
+		while (j < n && ents[j].val < ex[i].val)
+			j++;
+		int found = j < n && ents[j].val == ex[i].val;
+		uint64_t cnt = found ? ents[j].cnt : 0;
+		if (cnt > ex[i].cnt || cnt + h.err < ex[i].cnt) {
+			fprintf(stderr, "%s: %08x counted %"PRIu64", really %"PRIu64", err %"PRIu64"\n", name, ex[i].val, cnt, ex[i].cnt, h.err);
+			bad = 1;
+		}
+	}
+	nva_hist_fini(&h);
+	free(ents);
+	free(ex);
+	return bad;
+}
+
+int main() {
+	uint32_t *vals = malloc(NUM * sizeof *vals);
+	int i, res = 0;
+	srand(1);
+	/* a handful of values, like a status register */
+	for (i = 0; i < NUM; i++)
+		vals[i] = 0x80000000 | rand() % 5;
+	res |= check("few", vals, NUM);
+	/* exactly as many distinct values as fit */
+	for (i = 0; i < NUM; i++)
+		vals[i] = rand() % (1 << MAXLOG2);
+	res |= check("full", vals, NUM);
+	/* a counter - nothing repeats */
+	for (i = 0; i < NUM; i++)
+		vals[i] = i * 7;
+	res |= check("counter", vals, NUM);
+	/* a few heavy values drowned in noise */
+	for (i = 0; i < NUM; i++)
+		vals[i] = rand() % 4 ? rand() % 3 : rand();
+	res |= check("heavy", vals, NUM);
+	free(vals);
+	if (res)
+		return 1;
+	printf("All ok\n");
+	return 0;
+}
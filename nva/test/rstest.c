@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Checks the bulk register space accessors against single accesses, on fake
+ * cards: BAR0 is plain memory and the indirect spaces are modelled behind
+ * their index registers, counting how often the index gets written.
+ */
+
+#include "nva.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#define NUM_ACCESSES 2000
+
+struct fake {
+	uint8_t *bar0;
+	uint32_t vgabase, srbase;
+	uint8_t cr[0x100], sr[8], gr[0x10], ar[0x20];
+	uint8_t cridx, sridx, gridx, aridx;
+	int arff;
+	uint32_t pipe[0x4000], pipeaddr;
+	uint32_t rdi[0x4000], rdiaddr;
+	uint8_t pdac[0x10000];
+	uint32_t pdacaddr;
+	int idxwrites;
+};
+
+static uint32_t pipe_mask(uint32_t addr) {
+	return addr & 0x40 ? 0x00ffffff : 0xffffffff;
+}
+
+static uint32_t fake_rd32(struct nva_card *card, uint32_t addr) {
+	struct fake *f = card->priv;
+	uint32_t res;
+	switch (addr) {
+		case 0x400f54:
+			res = f->pipe[f->pipeaddr >> 2 & 0x3fff];
+			f->pipeaddr += 4;
+			return res;
+		case 0x400754:
+			res = f->rdi[f->rdiaddr >> 2 & 0x3fff];
+			f->rdiaddr += 4;
+			return res;
+		case 0x609018:
+			return f->pdac[f->pdacaddr++ & 0xffff];
+	}
+	return *(uint32_t *)(f->bar0 + addr);
+}
+
+static void fake_wr32(struct nva_card *card, uint32_t addr, uint32_t val) {
+	struct fake *f = card->priv;
+	switch (addr) {
+		case 0x400f50:
+			f->pipeaddr = val;
+			f->idxwrites++;
+			return;
+		case 0x400f54:
+			f->pipe[f->pipeaddr >> 2 & 0x3fff] = val & pipe_mask(f->pipeaddr);
+			f->pipeaddr += 4;
+			return;
+		case 0x400750:
+			f->rdiaddr = val;
+			f->idxwrites++;
+			return;
+		case 0x400754:
+			f->rdi[f->rdiaddr >> 2 & 0x3fff] = val;
+			f->rdiaddr += 4;
+			return;
+		case 0x609010:
+			f->pdacaddr = (f->pdacaddr & 0xff00) | (val & 0xff);
+			f->idxwrites++;
+			return;
+		case 0x609014:
+			f->pdacaddr = (f->pdacaddr & 0xff) | (val & 0xff) << 8;
+			f->idxwrites++;
+			return;
+		case 0x609018:
+			f->pdac[f->pdacaddr++ & 0xffff] = val;
+			return;
+	}
+	*(uint32_t *)(f->bar0 + addr) = val;
+}
+
+static uint32_t fake_rd8(struct nva_card *card, uint32_t addr) {
+	struct fake *f = card->priv;
+	if (addr == f->vgabase + 0x3d4)
+		return f->cridx;
+	if (addr == f->vgabase + 0x3d5)
+		return f->cr[f->cridx];
+	if (addr == f->srbase + 0x3c4)
+		return f->sridx;
+	if (addr == f->srbase + 0x3c5)
+		return f->sr[f->sridx & 7];
+	if (addr == f->srbase + 0x3ce)
+		return f->gridx;
+	if (addr == f->srbase + 0x3cf)
+		return f->gr[f->gridx & 0xf];
+	if (addr == f->vgabase + 0x3c0)
+		return f->aridx;
+	if (addr == f->vgabase + 0x3c1)
+		return f->ar[f->aridx & 0x1f];
+	if (addr == f->vgabase + 0x3da) {
+		f->arff = 0;
+		return 0;
+	}
+	return f->bar0[addr];
+}
+
+static void fake_wr8(struct nva_card *card, uint32_t addr, uint32_t val) {
+	struct fake *f = card->priv;
+	if (addr == f->vgabase + 0x3d4) {
+		f->cridx = val;
+		f->idxwrites++;
+	} else if (addr == f->vgabase + 0x3d5) {
+		f->cr[f->cridx] = val;
+	} else if (addr == f->srbase + 0x3c4) {
+		f->sridx = val;
+		f->idxwrites++;
+	} else if (addr == f->srbase + 0x3c5) {
+		f->sr[f->sridx & 7] = val;
+	} else if (addr == f->srbase + 0x3ce) {
+		f->gridx = val;
+		f->idxwrites++;
+	} else if (addr == f->srbase + 0x3cf) {
+		f->gr[f->gridx & 0xf] = val;
+	} else if (addr == f->vgabase + 0x3c0) {
+		if (!f->arff) {
+			f->aridx = val;
+			f->idxwrites++;
+		} else {
+			f->ar[f->aridx & 0x1f] = val;
+		}
+		f->arff ^= 1;
+	} else {
+		f->bar0[addr] = val;
+	}
+}
+
+static const struct nva_backend fake_backend = {
+	fake_rd32, fake_wr32, fake_rd8, fake_wr8,
+};
+
+static int fake_card(int chipset, struct fake *f) {
+	memset(f, 0, sizeof *f);
+	f->bar0 = calloc(0x1000000, 1);
+	if (chipset == 0x01) {
+		f->vgabase = f->srbase = 0x6d0000;
+	} else {
+		f->vgabase = 0x601000;
+		f->srbase = 0x0c0000;
+	}
+	int cnum = nva_add_card(chipset, &fake_backend, f);
+	nva_cards[cnum].bar0 = f->bar0;
+	nva_cards[cnum].bar0len = 0x1000000;
+	return cnum;
+}
+
+static const struct {
+	int chipset;
+	const char *space;
+	int regsz;
+	uint32_t limit;	/* accesses go up to a bit past this, to check range errors */
+} spaces[] = {
+	{ 0x34, "bar0", 1, 0x1000000 },
+	{ 0x34, "bar0", 2, 0x1000000 },
+	{ 0x34, "bar0", 4, 0x1000000 },
+	{ 0x34, "bar0", 8, 0x1000000 },
+	{ 0x34, "cr", 1, 0x100 },
+	{ 0x34, "sr", 1, 8 },
+	{ 0x34, "gr", 1, 0x10 },
+	{ 0x34, "ar", 1, 0x20 },
+	{ 0x34, "pipe", 4, 0x8000 },
+	{ 0x34, "rdi", 4, 0x8000 },
+	{ 0x34, "pdac", 1, 0x10000 },
+	{ 0x01, "pdac", 2, 0x10000 },
+	{ 0x01, "cr", 1, 0x100 },
+	{ 0x01, "pipe", 4, 0x8000 },
+};
+
+static uint32_t rand_addr(uint32_t limit, int regsz) {
+	uint32_t addr = (rand() % (limit + limit / 16)) & -regsz;
+	if (limit == 0x1000000 && addr < limit && rand() & 1)
+		addr = 0x700000 + (rand() & 0xfff & -regsz);	/* keep clear of the modelled registers */
+	else if (limit == 0x1000000 && addr < limit)
+		addr = (addr & 0x3ffff) | 0x800000;
+	return addr;
+}
+
+int main() {
+	static uint32_t addrs[NUM_ACCESSES];
+	static uint64_t vals[NUM_ACCESSES], rvals[NUM_ACCESSES];
+	static int errs[NUM_ACCESSES], rerrs[NUM_ACCESSES];
+	struct fake fakes[2];
+	int cnums[2];
+	int si, i, fails = 0;
+	srand(0x1234);
+	cnums[0] = fake_card(0x34, &fakes[0]);
+	cnums[1] = fake_card(0x01, &fakes[1]);
+	for (si = 0; si < sizeof spaces / sizeof *spaces; si++) {
+		int fi = spaces[si].chipset == 0x01;
+		struct fake *f = &fakes[fi];
+		struct nva_regspace rs = { 0 };
+		rs.cnum = cnums[fi];
+		rs.card = &nva_cards[rs.cnum];
+		rs.type = nva_rstype(spaces[si].space);
+		rs.regsz = spaces[si].regsz;
+		uint64_t mask = rs.regsz == 8 ? -1ull : (1ull << rs.regsz * 8) - 1;
+		for (i = 0; i < NUM_ACCESSES; i++) {
+			addrs[i] = rand_addr(spaces[si].limit, rs.regsz);
+			vals[i] = ((uint64_t)rand() << 32 ^ rand()) & mask;
+		}
+		/* bulk writes must end up exactly where single writes would */
+		f->cridx = 0x55;
+		nva_wrv(&rs, addrs, NUM_ACCESSES, vals, errs);
+		if (f->cridx != 0x55) {
+			printf("%02x %s: index not restored\n", spaces[si].chipset, spaces[si].space);
+			fails++;
+		}
+		for (i = 0; i < NUM_ACCESSES; i++) {
+			uint64_t val = 0;
+			int err = nva_rd(&rs, addrs[i], &val);
+			if (err != errs[i]) {
+				printf("%02x %s: write error %d, read error %d at %x\n", spaces[si].chipset, spaces[si].space, errs[i], err, addrs[i]);
+				fails++;
+				break;
+			}
+			int j, last = i;
+			for (j = i + 1; j < NUM_ACCESSES; j++)
+				if (addrs[j] == addrs[i])
+					last = j;
+			uint64_t exp = vals[last];
+			if (rs.type == NVA_REGSPACE_PIPE)
+				exp &= pipe_mask(addrs[i]);
+			if (!err && val != exp) {
+				printf("%02x %s: %x is %"PRIx64", expected %"PRIx64"\n", spaces[si].chipset, spaces[si].space, addrs[i], val, exp);
+				fails++;
+				break;
+			}
+		}
+		/* bulk reads, scattered and ranged, against single reads */
+		nva_rdv(&rs, addrs, NUM_ACCESSES, rvals, rerrs);
+		for (i = 0; i < NUM_ACCESSES; i++) {
+			uint64_t val = 0;
+			int err = nva_rd(&rs, addrs[i], &val);
+			if (err != rerrs[i] || (!err && val != rvals[i])) {
+				printf("%02x %s: rdv mismatch at %x\n", spaces[si].chipset, spaces[si].space, addrs[i]);
+				fails++;
+				break;
+			}
+		}
+		int num = 0x200 / rs.regsz;
+		uint32_t base = spaces[si].limit == 0x1000000 ? 0x800000 : 0;
+		f->idxwrites = 0;
+		nva_rdrange(&rs, base, num, rvals, rerrs);
+		int idxwrites = f->idxwrites;
+		for (i = 0; i < num; i++) {
+			uint64_t val = 0;
+			int err = nva_rd(&rs, base + i * rs.regsz, &val);
+			if (err != rerrs[i] || (!err && val != rvals[i])) {
+				printf("%02x %s: rdrange mismatch at %x\n", spaces[si].chipset, spaces[si].space, base + i * rs.regsz);
+				fails++;
+				break;
+			}
+		}
+		/* autoincrementing indices only get set up once (per 0x100 bytes for PDAC) */
+		int maxidx = num;
+		if (rs.type == NVA_REGSPACE_PIPE || rs.type == NVA_REGSPACE_RDI)
+			maxidx = 1;
+		if (rs.type == NVA_REGSPACE_PDAC)
+			maxidx = 4;
+		if (rs.type >= NVA_REGSPACE_VGA_CR && rs.type <= NVA_REGSPACE_VGA_GR)
+			maxidx = spaces[si].limit + 1;
+		if (!rerrs[0] && idxwrites > maxidx) {
+			printf("%02x %s: %d index writes for %d registers\n", spaces[si].chipset, spaces[si].space, idxwrites, num);
+			fails++;
+		}
+		/* scans see the writable bits and leave the registers alone */
+		static struct nva_rsscan scan[0x200];
+		nva_rdrange(&rs, base, num, vals, errs);
+		nva_scanrange(&rs, base, num, scan);
+		nva_rdrange(&rs, base, num, rvals, rerrs);
+		for (i = 0; i < num; i++) {
+			uint32_t addr = base + i * rs.regsz;
+			uint64_t ones = mask;
+			if (rs.type == NVA_REGSPACE_PIPE)
+				ones &= pipe_mask(addr);
+			if (scan[i].err != errs[i] || rerrs[i] != errs[i] || (!errs[i] && (scan[i].orig != vals[i] || rvals[i] != vals[i] || scan[i].ones != ones || scan[i].zeros || scan[i].werr))) {
+				printf("%02x %s: scan mismatch at %x\n", spaces[si].chipset, spaces[si].space, addr);
+				fails++;
+				break;
+			}
+		}
+	}
+	if (fails)
+		return 1;
+	printf("All ok\n");
+	return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Runs the register sampler against a synthetic card.  Every read of the
+ * counter register bumps it, so each sample's value must be exactly the
+ * previous one plus one plus the number of samples reported lost in between.
+ */
+
+#include "nva.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <inttypes.h>
+
+#define REG_CNT		0x1000	/* incremented on every read */
+#define REG_CNT3	0x1004	/* 3 * the last counter value */
+#define REG_SLOW	0x1008	/* counter / 1000 */
+#define PTIMER_STEP	0x1000000
+
+struct synth {
+	uint32_t cnt;
+	uint64_t ptimer;
+};
+
+static uint32_t synth_rd32(struct nva_card *card, uint32_t addr) {
+	struct synth *s = card->priv;
+	switch (addr) {
+		case REG_CNT:
+			return ++s->cnt;
+		case REG_CNT3:
+			return s->cnt * 3;
+		case REG_SLOW:
+			return ++s->cnt / 1000;
+		/* advances fast enough for the low word to wrap under the reader */
+		case 0x9400:
+			return s->ptimer += PTIMER_STEP;
+		case 0x9410:
+			return (s->ptimer += PTIMER_STEP) >> 32;
+	}
+	return 0;
+}
+
+static void synth_wr32(struct nva_card *card, uint32_t addr, uint32_t val) {
+}
+
+static const struct nva_backend synth_backend = {
+	synth_rd32, synth_wr32, synth_rd32, synth_wr32,
+};
+
+struct check {
+	uint64_t recs;
+	uint64_t instream_lost;
+	uint32_t prev;
+	uint64_t ptime;
+	int bad;
+};
+
+static void check_recs(struct check *c, const uint32_t *recs, int num, int stride, int flags, int slow) {
+	int i;
+	for (i = 0; i < num; i++) {
+		const uint32_t *rec = recs + i * stride;
+		uint64_t time = (uint64_t)rec[1] << 32 | rec[0];
+		uint32_t val = rec[NVA_WATCH_HDR];
+		if (c->recs) {
+			if (slow) {
+				/* only changes are recorded */
+				if (!rec[2] && val != c->prev + 1) {
+					fprintf(stderr, "record %"PRIu64": %08x after %08x\n", c->recs, val, c->prev);
+					c->bad = 1;
+				}
+			} else if (val != c->prev + 1 + rec[2]) {
+				fprintf(stderr, "record %"PRIu64": %08x after %08x with %u lost\n", c->recs, val, c->prev, rec[2]);
+				c->bad = 1;
+			}
+			/* a torn read is off by 1 << 32 */
+			if ((flags & NVA_WATCH_TIME) && (time <= c->ptime || (!slow && time - c->ptime > 5 * PTIMER_STEP))) {
+				fprintf(stderr, "record %"PRIu64": time %016"PRIx64" after %016"PRIx64"\n", c->recs, time, c->ptime);
+				c->bad = 1;
+			}
+		}
+		if (!slow && rec[NVA_WATCH_HDR + 1] != val * 3) {
+			fprintf(stderr, "record %"PRIu64": registers out of step\n", c->recs);
+			c->bad = 1;
+		}
+		c->prev = val;
+		c->ptime = time;
+		c->instream_lost += rec[2];
+		c->recs++;
+	}
+}
+
+static int run(int cnum, const uint32_t *regs, int regsnum, int flags, int ringlog2, int cpu, int delay, int slow) {
+	struct nva_watch *w = nva_watch_new(cnum, regs, regsnum, flags, ringlog2);
+	struct check c = { 0 };
+	const uint32_t *recs;
+	uint64_t samples, lost;
+	int num;
+	if (nva_watch_start(w, cpu, 50000000)) {
+		fprintf(stderr, "can't start the poller\n");
+		return 1;
+	}
+	while ((num = nva_watch_wait(w, &recs))) {
+		check_recs(&c, recs, num, nva_watch_stride(w), flags, slow);
+		nva_watch_consume(w, num);
+		if (delay)
+			usleep(delay);
+	}
+	nva_watch_stats(w, &samples, &lost);
+	nva_watch_free(w);
+	if (c.recs + lost != samples || c.instream_lost > lost) {
+		fprintf(stderr, "%"PRIu64" records, %"PRIu64" (%"PRIu64" reported) lost, %"PRIu64" samples\n", c.recs, lost, c.instream_lost, samples);
+		c.bad = 1;
+	}
+	if (!c.recs) {
+		fprintf(stderr, "no records\n");
+		c.bad = 1;
+	}
+	if (delay && !lost) {
+		fprintf(stderr, "slow consumer didn't lose anything\n");
+		c.bad = 1;
+	}
+	return c.bad;
+}
+
+int main() {
+	struct synth s = { 0, 0 };
+	int cnum = nva_add_card(0x50, &synth_backend, &s);
+	static const uint32_t regs[] = { REG_CNT, REG_CNT3 };
+	static const uint32_t slowregs[] = { REG_SLOW };
+	int res = 0;
+	/* plenty of space, every sample kept */
+	res |= run(cnum, regs, 2, NVA_WATCH_ALL | NVA_WATCH_TIME, 20, -1, 0, 0);
+	/* tiny ring and a slow consumer */
+	res |= run(cnum, regs, 2, NVA_WATCH_ALL, 4, -1, 1000, 0);
+	/* changes only, poller pinned */
+	res |= run(cnum, slowregs, 1, NVA_WATCH_TIME, 16, 0, 0, 1);
+	if (res)
+		return 1;
+	printf("All ok\n");
+	return 0;
+}
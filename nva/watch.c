@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Register sampler: a poller thread reads a set of registers in a loop and
+ * pushes records into a single-producer single-consumer ring, the consumer
+ * takes them out in contiguous batches.  head is only written by the poller
+ * and tail only by the consumer; record contents are published by the
+ * release store of head and freed by the release store of tail.
+ *
+ * When the ring is full the poller doesn't wait - the sample is dropped and
+ * counted in the lost field of the next record that makes it in.
+ */
+
+#define _GNU_SOURCE
+#include "nva.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NVA_WATCH_CLINE 64
+
+struct nva_watch {
+	int cnum;
+	uint32_t *regs;
+	int regsnum;
+	int flags;
+	int stride;
+	uint32_t *ring;
+	uint32_t mask;
+	pthread_t thr;
+	int running;
+	uint64_t deadline;
+	/* poller side */
+	char pad0[NVA_WATCH_CLINE];
+	uint32_t head;
+	uint32_t tailcache;
+	uint32_t pendlost;
+	uint64_t samples;
+	uint64_t lost;
+	int done;
+	/* consumer side */
+	char pad1[NVA_WATCH_CLINE];
+	uint32_t tail;
+	int stop;
+	char pad2[NVA_WATCH_CLINE];
+};
+
+static uint64_t nva_watch_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+/* 64-bit PTIMER, rereading the low word if the high word changed under us */
+static uint64_t nva_watch_ptimer(int cnum) {
+	uint32_t hi = nva_rd32(cnum, 0x9410);
+	uint32_t lo = nva_rd32(cnum, 0x9400);
+	uint32_t hi2 = nva_rd32(cnum, 0x9410);
+	if (hi != hi2) {
+		lo = nva_rd32(cnum, 0x9400);
+		hi = hi2;
+	}
+	return (uint64_t)hi << 32 | lo;
+}
+
+static void *nva_watch_poll(void *arg) {
+	struct nva_watch *w = arg;
+	uint32_t *prev = calloc(w->regsnum, sizeof *prev);
+	uint32_t *cur = calloc(w->regsnum, sizeof *cur);
+	uint32_t size = w->mask + 1;
+	uint64_t time = 0;
+	int first = 1;
+	unsigned iter = 0;
+	int i;
+	while (!__atomic_load_n(&w->stop, __ATOMIC_RELAXED)) {
+		if (w->deadline && !(iter++ & 0xff) && nva_watch_now() >= w->deadline)
+			break;
+		for (i = 0; i < w->regsnum; i++)
+			cur[i] = nva_rd32(w->cnum, w->regs[i]);
+		if (w->flags & NVA_WATCH_TIME)
+			time = nva_watch_ptimer(w->cnum);
+		if (!first && !(w->flags & NVA_WATCH_ALL) && !memcmp(cur, prev, w->regsnum * sizeof *cur))
+			continue;
+		first = 0;
+		memcpy(prev, cur, w->regsnum * sizeof *cur);
+		w->samples++;
+		if (w->head - w->tailcache == size) {
+			w->tailcache = __atomic_load_n(&w->tail, __ATOMIC_ACQUIRE);
+			if (w->head - w->tailcache == size) {
+				w->pendlost++;
+				w->lost++;
+				continue;
+			}
+		}
+		uint32_t *rec = &w->ring[(w->head & w->mask) * w->stride];
+		rec[0] = time;
+		rec[1] = time >> 32;
+		rec[2] = w->pendlost;
+		memcpy(rec + NVA_WATCH_HDR, cur, w->regsnum * sizeof *cur);
+		w->pendlost = 0;
+		__atomic_store_n(&w->head, w->head + 1, __ATOMIC_RELEASE);
+	}
+	free(prev);
+	free(cur);
+	__atomic_store_n(&w->done, 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+struct nva_watch *nva_watch_new(int cnum, const uint32_t *regs, int regsnum, int flags, int ringlog2) {
+	struct nva_watch *w;
+	if (regsnum < 1 || ringlog2 < 1 || ringlog2 > 30)
+		return 0;
+	w = calloc(1, sizeof *w);
+	w->cnum = cnum;
+	w->regs = malloc(regsnum * sizeof *w->regs);
+	memcpy(w->regs, regs, regsnum * sizeof *w->regs);
+	w->regsnum = regsnum;
+	w->flags = flags;
+	w->stride = NVA_WATCH_HDR + regsnum;
+	w->mask = (1u << ringlog2) - 1;
+	w->ring = calloc((size_t)w->stride << ringlog2, sizeof *w->ring);
+	if (!w->ring) {
+		free(w->regs);
+		free(w);
+		return 0;
+	}
+	return w;
+}
+
+int nva_watch_start(struct nva_watch *w, int cpu, uint64_t duration_ns) {
+	pthread_attr_t attr;
+	int res;
+	pthread_attr_init(&attr);
+	if (cpu >= 0) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu, &set);
+		res = pthread_attr_setaffinity_np(&attr, sizeof set, &set);
+		if (res) {
+			pthread_attr_destroy(&attr);
+			return -res;
+		}
+	}
+	w->deadline = duration_ns ? nva_watch_now() + duration_ns : 0;
+	res = pthread_create(&w->thr, &attr, nva_watch_poll, w);
+	pthread_attr_destroy(&attr);
+	if (res)
+		return -res;
+	w->running = 1;
+	return 0;
+}
+
+int nva_watch_peek(struct nva_watch *w, const uint32_t **recs) {
+	uint32_t head = __atomic_load_n(&w->head, __ATOMIC_ACQUIRE);
+	uint32_t idx = w->tail & w->mask;
+	uint32_t num = head - w->tail;
+	/* only hand out the part up to the end of the ring */
+	if (num > w->mask + 1 - idx)
+		num = w->mask + 1 - idx;
+	*recs = &w->ring[idx * w->stride];
+	return num;
+}
+
+void nva_watch_consume(struct nva_watch *w, int num) {
+	__atomic_store_n(&w->tail, w->tail + num, __ATOMIC_RELEASE);
+}
+
+int nva_watch_wait(struct nva_watch *w, const uint32_t **recs) {
+	int num;
+	while (!(num = nva_watch_peek(w, recs))) {
+		if (__atomic_load_n(&w->done, __ATOMIC_ACQUIRE)) {
+			/* the poller may have pushed more just before finishing */
+			return nva_watch_peek(w, recs);
+		}
+		usleep(100);
+	}
+	return num;
+}
+
+/* only sets a flag, so it can be called from a signal handler */
+void nva_watch_interrupt(struct nva_watch *w) {
+	__atomic_store_n(&w->stop, 1, __ATOMIC_RELAXED);
+}
+
+void nva_watch_stop(struct nva_watch *w) {
+	if (!w->running)
+		return;
+	nva_watch_interrupt(w);
+	pthread_join(w->thr, 0);
+	w->running = 0;
+}
+
+int nva_watch_stride(struct nva_watch *w) {
+	return w->stride;
+}
+
+/* only valid once the poller is done, ie. after nva_watch_stop or nva_watch_wait returned 0 */
+void nva_watch_stats(struct nva_watch *w, uint64_t *samples, uint64_t *lost) {
+	if (samples)
+		*samples = w->samples;
+	if (lost)
+		*lost = w->lost;
+}
+
+void nva_watch_free(struct nva_watch *w) {
+	nva_watch_stop(w);
+	free(w->ring);
+	free(w->regs);
+	free(w);
+}
@@ -0,0 +1,325 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Batch mode: parses a whole directory or manifest of VBIOS images in
+ * parallel and prints one JSON record per image, in input order.
+ *
+ * Images are mmapped and hashed first, byte-identical images are then only
+ * parsed once and reported as duplicates of the first one seen.  Every image
+ * gets its own struct envy_bios - nothing here touches nvbios.c globals - and
+ * whatever the parser complains about goes into that image's record.
+ */
+
+#include "bios.h"
+#include "util.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct batch_image {
+	char *filename;
+	uint8_t *data;
+	unsigned int length;
+	uint64_t hash;
+	int err;	/* errno from reading the image */
+	int dup;	/* index of the first identical image, or -1 */
+	int parse_err;
+	char *log;	/* parser complaints */
+	size_t loglen;
+	struct envy_bios bios;
+};
+
+struct batch {
+	struct batch_image *images;
+	int imagesnum;
+	int imagesmax;
+	int next;
+	void (*fn) (struct batch_image *img);
+};
+
+/* FNV-1a */
+static uint64_t batch_hash(const uint8_t *data, unsigned int length) {
+	uint64_t h = 0xcbf29ce484222325ull;
+	unsigned int i;
+	for (i = 0; i < length; i++) {
+		h ^= data[i];
+		h *= 0x100000001b3ull;
+	}
+	return h;
+}
+
+static void batch_add(struct batch *b, char *filename) {
+	struct batch_image img = { 0 };
+	img.filename = filename;
+	img.dup = -1;
+	ADDARRAY(b->images, img);
+}
+
+static int batch_read_dir(struct batch *b, const char *path) {
+	struct dirent **ents;
+	int n = scandir(path, &ents, 0, alphasort);
+	int i;
+	if (n < 0) {
+		perror(path);
+		return 1;
+	}
+	for (i = 0; i < n; i++) {
+		struct stat st;
+		char *filename = aprintf("%s/%s", path, ents[i]->d_name);
+		if (!stat(filename, &st) && S_ISREG(st.st_mode))
+			batch_add(b, filename);
+		else
+			free(filename);
+		free(ents[i]);
+	}
+	free(ents);
+	return 0;
+}
+
+static int batch_read_manifest(struct batch *b, const char *path) {
+	FILE *f = fopen(path, "r");
+	char *line = 0;
+	size_t linesz = 0;
+	ssize_t len;
+	if (!f) {
+		perror(path);
+		return 1;
+	}
+	while ((len = getline(&line, &linesz, f)) != -1) {
+		while (len && (line[len-1] == '\n' || line[len-1] == '\r'))
+			line[--len] = 0;
+		if (!len || line[0] == '#')
+			continue;
+		batch_add(b, strdup(line));
+	}
+	free(line);
+	fclose(f);
+	return 0;
+}
+
+static void batch_map(struct batch_image *img) {
+	struct stat st;
+	int fd = open(img->filename, O_RDONLY);
+	if (fd == -1) {
+		img->err = errno;
+		return;
+	}
+	if (fstat(fd, &st)) {
+		img->err = errno;
+		close(fd);
+		return;
+	}
+	if (!st.st_size) {
+		img->err = EINVAL;
+		close(fd);
+		return;
+	}
+	img->data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (img->data == MAP_FAILED) {
+		img->err = errno;
+		img->data = 0;
+		return;
+	}
+	img->length = st.st_size;
+	img->hash = batch_hash(img->data, img->length);
+}
+
+static void batch_parse(struct batch_image *img) {
+	if (!img->err && img->dup == -1) {
+		img->bios.data = img->data;
+		img->bios.origlength = img->length;
+		envy_bios_log = open_memstream(&img->log, &img->loglen);
+		img->parse_err = envy_bios_parse(&img->bios);
+		if (envy_bios_log)
+			fclose(envy_bios_log);
+		envy_bios_log = 0;
+	}
+	if (img->data)
+		munmap(img->data, img->length);
+	img->data = 0;
+	img->bios.data = 0;
+}
+
+static void *batch_worker(void *arg) {
+	struct batch *b = arg;
+	int i;
+	while ((i = __sync_fetch_and_add(&b->next, 1)) < b->imagesnum)
+		b->fn(&b->images[i]);
+	return 0;
+}
+
+static void batch_run(struct batch *b, int jobs, void (*fn) (struct batch_image *img)) {
+	pthread_t *threads = calloc(jobs, sizeof *threads);
+	int i;
+	b->next = 0;
+	b->fn = fn;
+	for (i = 0; i < jobs; i++)
+		if (pthread_create(&threads[i], 0, batch_worker, b)) {
+			/* run whatever is left in this thread */
+			batch_worker(b);
+			break;
+		}
+	jobs = i;
+	for (i = 0; i < jobs; i++)
+		pthread_join(threads[i], 0);
+	free(threads);
+}
+
+static struct batch *dedup_batch;
+
+static int batch_cmp(const void *a, const void *b) {
+	const struct batch_image *ia = &dedup_batch->images[*(const int *)a];
+	const struct batch_image *ib = &dedup_batch->images[*(const int *)b];
+	if (ia->hash != ib->hash)
+		return ia->hash < ib->hash ? -1 : 1;
+	if (ia->length != ib->length)
+		return ia->length < ib->length ? -1 : 1;
+	return *(const int *)a - *(const int *)b;
+}
+
+static void batch_dedup(struct batch *b) {
+	int *order = calloc(b->imagesnum, sizeof *order);
+	int i, j, n = 0;
+	for (i = 0; i < b->imagesnum; i++)
+		if (!b->images[i].err)
+			order[n++] = i;
+	dedup_batch = b;
+	qsort(order, n, sizeof *order, batch_cmp);
+	for (i = 0; i < n; i++) {
+		struct batch_image *img = &b->images[order[i]];
+		/* walk back over the earlier images with the same hash and length */
+		for (j = i - 1; j >= 0; j--) {
+			struct batch_image *prev = &b->images[order[j]];
+			if (prev->hash != img->hash || prev->length != img->length)
+				break;
+			if (prev->dup == -1 && !memcmp(prev->data, img->data, img->length)) {
+				img->dup = order[j];
+				break;
+			}
+		}
+	}
+	free(order);
+}
+
+static void batch_print_str(FILE *out, const char *str) {
+	fputc('"', out);
+	for (; *str; str++) {
+		unsigned char c = *str;
+		if (c == '"' || c == '\\')
+			fprintf(out, "\\%c", c);
+		else if (c < 0x20 || c >= 0x7f)
+			fprintf(out, "\\u%04x", c);
+		else
+			fputc(c, out);
+	}
+	fputc('"', out);
+}
+
+static void batch_print(struct batch *b, struct batch_image *img, FILE *out) {
+	struct envy_bios *bios = &img->bios;
+	static const char *const types[] = { "unknown", "nv01", "nv03", "nv04" };
+	fprintf(out, "{\"file\": ");
+	batch_print_str(out, img->filename);
+	if (img->err) {
+		fprintf(out, ", \"status\": ");
+		batch_print_str(out, strerror(img->err));
+		fprintf(out, "}\n");
+		return;
+	}
+	fprintf(out, ", \"size\": %u, \"hash\": \"%016"PRIx64"\"", img->length, img->hash);
+	if (img->dup != -1) {
+		fprintf(out, ", \"status\": \"duplicate\", \"dup_of\": ");
+		batch_print_str(out, b->images[img->dup].filename);
+		fprintf(out, "}\n");
+		return;
+	}
+	if (img->log && img->loglen) {
+		fprintf(out, ", \"log\": ");
+		batch_print_str(out, img->log);
+	}
+	if (img->parse_err) {
+		fprintf(out, ", \"status\": ");
+		batch_print_str(out, strerror(-img->parse_err));
+		fprintf(out, "}\n");
+		return;
+	}
+	fprintf(out, ", \"status\": \"ok\", \"type\": \"%s\"", types[bios->type]);
+	fprintf(out, ", \"length\": %u, \"parts\": %d, \"broken_part\": %s", bios->length, bios->partsnum, bios->broken_part ? "true" : "false");
+	fprintf(out, ", \"pciid\": \"%04x:%04x\"", bios->parts[0].pcir_vendor, bios->parts[0].pcir_device);
+	fprintf(out, ", \"subsystem\": \"%04x:%04x\"", bios->subsystem_vendor, bios->subsystem_device);
+	if (bios->chipset)
+		fprintf(out, ", \"chipset\": \"%02x\"", bios->chipset);
+	if (bios->info.valid) {
+		fprintf(out, ", \"version\": \"%02x.%02x.%02x.%02x.%02x\", \"date\": ", bios->info.version[0], bios->info.version[1], bios->info.version[2], bios->info.version[3], bios->info.version[4]);
+		batch_print_str(out, bios->info.date);
+	}
+	if (bios->bmp_offset)
+		fprintf(out, ", \"bmp\": \"%02x.%02x\"", bios->bmp_ver_major, bios->bmp_ver_minor);
+	if (bios->bit.offset)
+		fprintf(out, ", \"bit\": %d, \"bit_entries\": %d", bios->bit.version, bios->bit.entriesnum);
+	if (bios->dcb.offset)
+		fprintf(out, ", \"dcb\": \"%d.%d\", \"dcb_entries\": %d", bios->dcb.version >> 4, bios->dcb.version & 0xf, bios->dcb.entriesnum);
+	if (bios->gpio.valid)
+		fprintf(out, ", \"gpio_entries\": %d", bios->gpio.entriesnum);
+	if (bios->conn.valid)
+		fprintf(out, ", \"conn_entries\": %d", bios->conn.entriesnum);
+	fprintf(out, ", \"blocks\": %d, \"unused\": %u}\n", bios->blocksnum, envy_bios_unused_bytes(bios));
+}
+
+int nvbios_batch(const char *path, int jobs, FILE *out) {
+	struct batch b = { 0 };
+	struct stat st;
+	int i, res;
+	if (stat(path, &st)) {
+		perror(path);
+		return 1;
+	}
+	if (S_ISDIR(st.st_mode))
+		res = batch_read_dir(&b, path);
+	else
+		res = batch_read_manifest(&b, path);
+	if (res)
+		return res;
+	if (jobs < 1)
+		jobs = 1;
+	batch_run(&b, jobs, batch_map);
+	batch_dedup(&b);
+	batch_run(&b, jobs, batch_parse);
+	for (i = 0; i < b.imagesnum; i++) {
+		batch_print(&b, &b.images[i], out);
+		envy_bios_free(&b.images[i].bios);
+	}
+	for (i = 0; i < b.imagesnum; i++) {
+		free(b.images[i].filename);
+		free(b.images[i].log);
+	}
+	free(b.images);
+	return 0;
+}
@@ -26,6 +26,8 @@
 #include "util.h"
 #include <string.h>
 
+__thread FILE *envy_bios_log;
+
 static int parse_pcir (struct envy_bios *bios) {
 	bios->length = bios->origlength;
 	unsigned int curpos = 0;
@@ -101,9 +103,14 @@ broken_part:
 			uint8_t init_ilen;
 			bios_u8(bios, curpos + 2, &init_ilen);
 			bios->parts[num].init_length = init_ilen * 0x200;
-			for (i = 0; i < bios->parts[num].init_length; i++)
-				sum += bios->data[curpos + i];
-			bios->parts[num].chksum_pass = (sum == 0);
+			if (curpos + bios->parts[num].init_length > bios->origlength) {
+				ENVY_BIOS_ERR("Init length 0x%x of part %d runs past the end of the image\n", bios->parts[num].init_length, num);
+				bios->parts[num].chksum_pass = 0;
+			} else {
+				for (i = 0; i < bios->parts[num].init_length; i++)
+					sum += bios->data[curpos + i];
+				bios->parts[num].chksum_pass = (sum == 0);
+			}
 		}
 		curpos += bios->parts[num].length;
 	}
@@ -311,6 +318,32 @@ int envy_bios_parse (struct envy_bios *bios) {
 	return 0;
 }
 
+void envy_bios_free (struct envy_bios *bios) {
+	int i;
+	free(bios->parts);
+	free(bios->mmioinits);
+	for (i = 0; i < bios->hwea_entriesnum; i++)
+		free(bios->hwea_entries[i].data);
+	free(bios->hwea_entries);
+	free(bios->bit.entries);
+	free(bios->dacload.entries);
+	free(bios->iunk21.entries);
+	free(bios->dcb.entries);
+	free(bios->i2c.entries);
+	free(bios->gpio.entries);
+	if (bios->gpio.xpiodir.entries)
+		for (i = 0; i < bios->gpio.xpiodir.entriesnum; i++)
+			free(bios->gpio.xpiodir.entries[i].entries);
+	free(bios->gpio.xpiodir.entries);
+	free(bios->dunk0c.entries);
+	free(bios->dunk10.entries);
+	free(bios->extdev.entries);
+	free(bios->conn.entries);
+	free(bios->dunk17.entries);
+	free(bios->mux.entries);
+	envy_bios_block_free(bios);
+}
+
 const char *find_enum(struct enum_val *evals, int val) {
 	int i;
 	for (i = 0; evals[i].str; i++)
@@ -318,8 +351,3 @@ const char *find_enum(struct enum_val *evals, int val) {
 			return evals[i].str;
 	return "???";
 }
-
-void envy_bios_block(struct envy_bios *bios, unsigned start, unsigned len, const char *name, int idx) {
-	struct envy_bios_block block = { start, len, name, idx };
-	ADDARRAY(bios->blocks, block);
-}
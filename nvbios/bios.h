@@ -29,8 +29,11 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
-#define ENVY_BIOS_ERR(fmt, arg...) fprintf(stderr, fmt, ##arg)
-#define ENVY_BIOS_WARN(fmt, arg...) fprintf(stderr, fmt, ##arg)
+/* where parser complaints go instead of stderr, per thread for batch mode */
+extern __thread FILE *envy_bios_log;
+
+#define ENVY_BIOS_ERR(fmt, arg...) fprintf(envy_bios_log ? envy_bios_log : stderr, fmt, ##arg)
+#define ENVY_BIOS_WARN(fmt, arg...) fprintf(envy_bios_log ? envy_bios_log : stderr, fmt, ##arg)
 
 struct envy_bios_part {
 	unsigned int start;
@@ -574,6 +577,46 @@ struct envy_bios_block {
 	int idx;
 };
 
+struct envy_bios_block_node;
+
+struct envy_bios_script_op {
+	unsigned int start;
+	unsigned int len;	/* including all items */
+	uint8_t op;
+	uint8_t cnt;		/* number of items */
+};
+
+struct envy_bios_script {
+	unsigned int start;
+	unsigned int end;	/* first byte after the last decoded op */
+	int rrgc;		/* RAM restrict group count it was decoded with */
+	int truncated;		/* ran off the end of the image before DONE */
+	struct envy_bios_script_op *ops;
+	int opsnum;
+	int opsmax;
+};
+
+struct envy_bios_script_opinfo {
+	const char *name;
+	uint8_t hlen;		/* length of the fixed part */
+	uint8_t cntpos;		/* position of the item count in the fixed part, 0 if none */
+	uint8_t isize;		/* item size */
+	uint8_t flags;
+};
+
+#define ENVY_BIOS_SCRIPT_RRG_COUNT	1	/* item count is the RAM restrict group count */
+#define ENVY_BIOS_SCRIPT_RRG_ITEM	2	/* item size is multiplied by it */
+#define ENVY_BIOS_SCRIPT_END		4
+
+extern const struct envy_bios_script_opinfo envy_bios_script_ops[0x100];
+
+struct envy_bios_script_cache {
+	struct envy_bios_script scratch;
+	struct envy_bios_script **scripts;	/* sorted by start, rrgc */
+	int scriptsnum;
+	int scriptsmax;
+};
+
 struct envy_bios {
 	uint8_t *data;
 	unsigned int length;
@@ -644,6 +687,9 @@ struct envy_bios {
 	struct envy_bios_block *blocks;
 	int blocksnum;
 	int blocksmax;
+	struct envy_bios_block_node *blocktree;
+	struct envy_bios_block_node *covered;
+	unsigned int covered_len;
 };
 
 static inline int bios_u8(struct envy_bios *bios, unsigned int offs, uint8_t *res) {
@@ -715,6 +761,8 @@ static inline int bios_string(struct envy_bios *bios, unsigned int offs, char *r
 #define ENVY_BIOS_PRINT_VERBOSE		0x80000000
 
 int envy_bios_parse (struct envy_bios *bios);
+/* frees everything envy_bios_parse allocated - data is left alone */
+void envy_bios_free (struct envy_bios *bios);
 void envy_bios_dump_hex (struct envy_bios *bios, FILE *out, unsigned int start, unsigned int length, unsigned mask);
 void envy_bios_print (struct envy_bios *bios, FILE *out, unsigned mask);
 void envy_bios_mmioinit (struct envy_bios *bios, FILE *out, unsigned mask);
@@ -755,6 +803,11 @@ void envy_bios_print_dunk17 (struct envy_bios *bios, FILE *out, unsigned mask);
 int envy_bios_parse_mux (struct envy_bios *bios);
 void envy_bios_print_mux (struct envy_bios *bios, FILE *out, unsigned mask);
 
+int envy_bios_script_decode (struct envy_bios *bios, unsigned int start, int rrgc, struct envy_bios_script *script);
+void envy_bios_script_fini (struct envy_bios_script *script);
+const struct envy_bios_script *envy_bios_script_cache_get (struct envy_bios *bios, struct envy_bios_script_cache *cache, unsigned int start, int rrgc);
+void envy_bios_script_cache_fini (struct envy_bios_script_cache *cache);
+
 struct enum_val {
 	int val;
 	const char *str;
@@ -763,5 +816,10 @@ struct enum_val {
 const char *find_enum(struct enum_val *evals, int val);
 
 void envy_bios_block(struct envy_bios *bios, unsigned start, unsigned len, const char *name, int idx);
+struct envy_bios_block *envy_bios_block_find (struct envy_bios *bios, unsigned int offs);
+int envy_bios_next_unused (struct envy_bios *bios, unsigned int offs, unsigned int *start, unsigned int *end);
+unsigned int envy_bios_unused_bytes (struct envy_bios *bios);
+void envy_bios_block_order (struct envy_bios *bios, int *order);
+void envy_bios_block_free (struct envy_bios *bios);
 
 #endif
@@ -0,0 +1,233 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Block map.  Every block goes into bios->blocks as before, and is also
+ * inserted into two treaps:
+ *
+ *  - blocktree: all blocks keyed by start (ties broken by insertion order),
+ *    with each node remembering the largest end in its subtree, so a block
+ *    covering a given offset can be found in O(log n).
+ *  - covered: the union of all blocks as disjoint, non-adjacent ranges keyed
+ *    by start, plus a running count of covered bytes.  A new block absorbs
+ *    the ranges it touches, so the first uncovered byte after a given offset
+ *    and the number of unused bytes are available at any time.
+ */
+
+#include "bios.h"
+#include "util.h"
+#include <errno.h>
+
+struct envy_bios_block_node {
+	struct envy_bios_block_node *l, *r;
+	unsigned int start;
+	unsigned int end;
+	unsigned int maxend;
+	uint32_t prio;
+	int idx;
+};
+
+static uint32_t block_prio (unsigned int start, int idx) {
+	uint32_t x = start * 0x9e3779b1u ^ idx * 0x85ebca77u;
+	x ^= x >> 15;
+	x *= 0x2c1b3c6du;
+	x ^= x >> 12;
+	return x;
+}
+
+static struct envy_bios_block_node *block_node (unsigned int start, unsigned int end, int idx) {
+	struct envy_bios_block_node *n = calloc(sizeof *n, 1);
+	n->start = start;
+	n->end = n->maxend = end;
+	n->idx = idx;
+	n->prio = block_prio(start, idx);
+	return n;
+}
+
+static void block_update (struct envy_bios_block_node *n) {
+	n->maxend = n->end;
+	if (n->l && n->l->maxend > n->maxend)
+		n->maxend = n->l->maxend;
+	if (n->r && n->r->maxend > n->maxend)
+		n->maxend = n->r->maxend;
+}
+
+/* splits t into nodes ordered before (start, idx) and the rest */
+static void block_split (struct envy_bios_block_node *t, unsigned int start, int idx, struct envy_bios_block_node **l, struct envy_bios_block_node **r) {
+	if (!t) {
+		*l = *r = 0;
+		return;
+	}
+	if (t->start < start || (t->start == start && t->idx < idx)) {
+		block_split(t->r, start, idx, &t->r, r);
+		*l = t;
+	} else {
+		block_split(t->l, start, idx, l, &t->l);
+		*r = t;
+	}
+	block_update(t);
+}
+
+static struct envy_bios_block_node *block_merge (struct envy_bios_block_node *a, struct envy_bios_block_node *b) {
+	if (!a)
+		return b;
+	if (!b)
+		return a;
+	if (a->prio > b->prio) {
+		a->r = block_merge(a->r, b);
+		block_update(a);
+		return a;
+	} else {
+		b->l = block_merge(a, b->l);
+		block_update(b);
+		return b;
+	}
+}
+
+static void block_free_tree (struct envy_bios_block_node *n) {
+	if (!n)
+		return;
+	block_free_tree(n->l);
+	block_free_tree(n->r);
+	free(n);
+}
+
+/* frees a subtree of the covered map, returning the number of bytes it covered */
+static unsigned int block_absorb (struct envy_bios_block_node *n, unsigned int *end) {
+	unsigned int res;
+	if (!n)
+		return 0;
+	if (n->end > *end)
+		*end = n->end;
+	res = n->end - n->start + block_absorb(n->l, end) + block_absorb(n->r, end);
+	free(n);
+	return res;
+}
+
+static void block_cover (struct envy_bios *bios, unsigned int start, unsigned int end) {
+	struct envy_bios_block_node *a, *b, *c, *d, *m;
+	block_split(bios->covered, start, 0, &a, &b);
+	/* the last range before start may reach into (or touch) the new one */
+	for (m = a; m && m->r; m = m->r);
+	if (m && m->end >= start) {
+		block_split(a, m->start, 0, &a, &m);
+		start = m->start;
+		bios->covered_len -= block_absorb(m, &end);
+	}
+	/* and everything starting up to end gets merged in */
+	block_split(b, end, 1, &c, &d);
+	bios->covered_len -= block_absorb(c, &end);
+	bios->covered_len += end - start;
+	bios->covered = block_merge(block_merge(a, block_node(start, end, 0)), d);
+}
+
+void envy_bios_block(struct envy_bios *bios, unsigned start, unsigned len, const char *name, int idx) {
+	struct envy_bios_block block = { start, len, name, idx };
+	struct envy_bios_block_node *l, *r;
+	ADDARRAY(bios->blocks, block);
+	block_split(bios->blocktree, start, bios->blocksnum - 1, &l, &r);
+	bios->blocktree = block_merge(block_merge(l, block_node(start, start + len, bios->blocksnum - 1)), r);
+	if (len)
+		block_cover(bios, start, start + len);
+}
+
+/* returns a block covering offs, or NULL */
+struct envy_bios_block *envy_bios_block_find (struct envy_bios *bios, unsigned int offs) {
+	struct envy_bios_block_node *n = bios->blocktree;
+	while (n) {
+		if (n->start <= offs && offs < n->end)
+			return &bios->blocks[n->idx];
+		/* if anything in the left subtree ends past offs and doesn't
+		 * cover it, it starts past offs, and so does the right subtree */
+		if (n->l && n->l->maxend > offs)
+			n = n->l;
+		else
+			n = n->r;
+	}
+	return 0;
+}
+
+/* finds the first uncovered range at or after offs within the image */
+int envy_bios_next_unused (struct envy_bios *bios, unsigned int offs, unsigned int *start, unsigned int *end) {
+	struct envy_bios_block_node *n = bios->covered;
+	unsigned int next = bios->length;
+	while (n) {
+		if (n->start <= offs) {
+			if (offs < n->end)
+				offs = n->end;
+			n = n->r;
+		} else {
+			next = n->start;
+			n = n->l;
+		}
+	}
+	if (offs >= bios->length)
+		return -ENOENT;
+	if (next > bios->length)
+		next = bios->length;
+	*start = offs;
+	*end = next;
+	return 0;
+}
+
+static unsigned int block_cover_above (struct envy_bios_block_node *n, unsigned int limit) {
+	unsigned int res;
+	if (!n)
+		return 0;
+	res = block_cover_above(n->r, limit);
+	if (n->end > limit) {
+		res += n->end - (n->start > limit ? n->start : limit);
+		res += block_cover_above(n->l, limit);
+	}
+	return res;
+}
+
+unsigned int envy_bios_unused_bytes (struct envy_bios *bios) {
+	return bios->length - (bios->covered_len - block_cover_above(bios->covered, bios->length));
+}
+
+static void block_walk (struct envy_bios_block_node *n, int *order, int *pos) {
+	if (!n)
+		return;
+	block_walk(n->l, order, pos);
+	order[(*pos)++] = n->idx;
+	block_walk(n->r, order, pos);
+}
+
+/* fills order with indices of bios->blocks sorted by start */
+void envy_bios_block_order (struct envy_bios *bios, int *order) {
+	int pos = 0;
+	block_walk(bios->blocktree, order, &pos);
+}
+
+void envy_bios_block_free (struct envy_bios *bios) {
+	free(bios->blocks);
+	bios->blocks = 0;
+	bios->blocksnum = bios->blocksmax = 0;
+	block_free_tree(bios->blocktree);
+	block_free_tree(bios->covered);
+	bios->blocktree = bios->covered = 0;
+	bios->covered_len = 0;
+}
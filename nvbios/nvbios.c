@@ -86,6 +86,10 @@ int subsnum = 0, subsmax = 0;
 uint16_t *calls = 0;
 int callsnum = 0, callsmax = 0;
 
+int cache_scripts = 0;
+struct envy_bios_script script_buf;
+struct envy_bios_script_cache script_cache;
+
 struct {
 	const char *name;
 	unsigned mask;
@@ -114,6 +118,8 @@ struct {
 	{ "dunk",	ENVY_BIOS_PRINT_DUNK },
 };
 
+int nvbios_batch(const char *path, int jobs, FILE *out);
+
 int usage(char* name) {
 	int i;
 
@@ -123,9 +129,13 @@ int usage(char* name) {
 	printf(" -m XX     set tCWL (for timing entry size < 20)\n");
 	printf(" -s XX     set the trap register\n");
 	printf(" -i XXXX   print init script at XXXX and exit\n");
+	printf(" -c        cache decoded init scripts by offset\n");
 	printf(" -v        be verbose\n");
 	printf(" -u        print unused\n");
 	printf(" -b        print blocks\n");
+	printf(" -B PATH   batch mode: parse all images in directory PATH, or listed\n");
+	printf("           one per line in manifest file PATH, one JSON record per image\n");
+	printf(" -j N      use N threads in batch mode\n");
 	printf(" -p XXXX   set print mask, XXXX can be: ");
 	for (i = 0; i < sizeof(printmasks) / sizeof(*printmasks) - 1; i++)
 		printf("%s, ", printmasks[i].name);
@@ -239,404 +249,380 @@ uint8_t parse_memtm_mapping_entry_11(uint16_t pos, uint16_t len, uint16_t hdr_po
 	return bios->data[pos];
 }
 
-void printscript (uint16_t soff) {
-	while (1) {
-		uint8_t op = bios->data[soff];
-		uint32_t dst;
-		uint8_t incr;
-		uint8_t cnt;
-		int i;
-		uint32_t x;
-		switch (op) {
-			case 0x32:
-				printcmd (soff, 11);
-				printf ("IO_RESTRICT_PROG\tR[0x%06x] = (0x%04x[0x%02x] & 0x%02x) >> %d) [{\n", le32(soff+7), le16(soff+1), bios->data[soff+3], bios->data[soff+4], bios->data[soff+5]);
-				cnt = bios->data[soff+6];
-				soff += 11;
-				while (cnt--) {
-					printcmd (soff, 4);
-					printf ("\t0x%08x\n", le32(soff));
-					soff += 4;
-				}
-				printcmd (soff, 0);
-				printf ("}]\n");
-				break;
-			case 0x33:
+static void printscript_op (const struct envy_bios_script_op *sop) {
+	uint16_t soff = sop->start;
+	uint32_t dst;
+	uint8_t incr;
+	uint8_t cnt;
+	int i;
+	uint32_t x;
+	switch (sop->op) {
+		case 0x32:
+			printcmd (soff, 11);
+			printf ("IO_RESTRICT_PROG\tR[0x%06x] = (0x%04x[0x%02x] & 0x%02x) >> %d) [{\n", le32(soff+7), le16(soff+1), bios->data[soff+3], bios->data[soff+4], bios->data[soff+5]);
+			cnt = sop->cnt;
+			soff += 11;
+			while (cnt--) {
+				printcmd (soff, 4);
+				printf ("\t0x%08x\n", le32(soff));
+				soff += 4;
+			}
+			printcmd (soff, 0);
+			printf ("}]\n");
+			break;
+		case 0x33:
+			printcmd (soff, 2);
+			printf ("REPEAT\t0x%02x\n", bios->data[soff+1]);
+			break;
+		case 0x34:
+			printcmd (soff, 12);
+			printf ("IO_RESTRICT_PLL\tR[0x%06x] =PLL= (0x%04x[0x%02x] & 0x%02x) >> %d) IOFCOND 0x%02x [{\n", le32(soff+8), le16(soff+1), bios->data[soff+3], bios->data[soff+4], bios->data[soff+5], bios->data[soff+6]);
+			if (bios->data[soff+6] > maxiofcond && bios->data[soff+6] != 0xff)
+				maxiofcond = bios->data[soff+6];
+			cnt = sop->cnt;
+			soff += 12;
+			while (cnt--) {
 				printcmd (soff, 2);
-				printf ("REPEAT\t0x%02x\n", bios->data[soff+1]);
+				printf ("\t%dkHz\n", le16(soff) * 10);
 				soff += 2;
-				break;
-			case 0x34:
-				printcmd (soff, 12);
-				printf ("IO_RESTRICT_PLL\tR[0x%06x] =PLL= (0x%04x[0x%02x] & 0x%02x) >> %d) IOFCOND 0x%02x [{\n", le32(soff+8), le16(soff+1), bios->data[soff+3], bios->data[soff+4], bios->data[soff+5], bios->data[soff+6]);
-				if (bios->data[soff+6] > maxiofcond && bios->data[soff+6] != 0xff)
-					maxiofcond = bios->data[soff+6];
-				cnt = bios->data[soff+7];
-				soff += 12;
-				while (cnt--) {
-					printcmd (soff, 2);
-					printf ("\t%dkHz\n", le16(soff) * 10);
-					soff += 2;
-				}
-				printcmd (soff, 0);
-				printf ("}]\n");
-				break;
-			case 0x36:
-				printcmd (soff, 1);
-				printf ("END_REPEAT\n");
-				soff++;
-				break;
-			case 0x37:
-				printcmd (soff, 11);
-				printf ("COPY\t0x%04x[0x%02x] & ~0x%02x |= (R[0x%06x] %s 0x%02x) & 0x%08x\n",
-						le16(soff+7), bios->data[soff+9], bios->data[soff+10], le32(soff+1), bios->data[soff+5]&0x80?"<<":">>",
-						bios->data[soff+5]&0x80?0x100-bios->data[soff+5]:bios->data[soff+5], bios->data[soff+6]);
-				soff += 11;
-				break;
-			case 0x38:
-				printcmd (soff, 1);
-				printf ("NOT\n");
-				soff++;
-				break;
-			case 0x39:
+			}
+			printcmd (soff, 0);
+			printf ("}]\n");
+			break;
+		case 0x36:
+			printcmd (soff, 1);
+			printf ("END_REPEAT\n");
+			break;
+		case 0x37:
+			printcmd (soff, 11);
+			printf ("COPY\t0x%04x[0x%02x] & ~0x%02x |= (R[0x%06x] %s 0x%02x) & 0x%08x\n",
+					le16(soff+7), bios->data[soff+9], bios->data[soff+10], le32(soff+1), bios->data[soff+5]&0x80?"<<":">>",
+					bios->data[soff+5]&0x80?0x100-bios->data[soff+5]:bios->data[soff+5], bios->data[soff+6]);
+			break;
+		case 0x38:
+			printcmd (soff, 1);
+			printf ("NOT\n");
+			break;
+		case 0x39:
+			printcmd (soff, 2);
+			printf ("IO_FLAG_CONDITION\t0x%02x\n", bios->data[soff+1]);
+			if (bios->data[soff+1] > maxiofcond)
+				maxiofcond = bios->data[soff+1];
+			break;
+		case 0x49:
+			printcmd (soff, 9);
+			printf ("INDEX_ADDRESS_LATCHED\tR[0x%06x] : R[0x%06x]\n", le32(soff+1), le32(soff+5));
+			soff += 9;
+			printcmd (soff, 9);
+			printf ("\tCTRL &= 0x%08x |= 0x%08x\n", le32(soff), le32(soff+4));
+			cnt = sop->cnt;
+			soff += 9;
+			while (cnt--) {
 				printcmd (soff, 2);
-				printf ("IO_FLAG_CONDITION\t0x%02x\n", bios->data[soff+1]);
-				if (bios->data[soff+1] > maxiofcond)
-					maxiofcond = bios->data[soff+1];
+				printf("\t[0x%02x] = 0x%02x\n", bios->data[soff], bios->data[soff+1]);
 				soff += 2;
-				break;
-			case 0x49:
-				printcmd (soff, 9);
-				printf ("INDEX_ADDRESS_LATCHED\tR[0x%06x] : R[0x%06x]\n", le32(soff+1), le32(soff+5));
-				soff += 9;
-				printcmd (soff, 9);
-				printf ("\tCTRL &= 0x%08x |= 0x%08x\n", le32(soff), le32(soff+4));
-				cnt = bios->data[soff+8];
-				soff += 9;
-				while (cnt--) {
-					printcmd (soff, 2);
-					printf("\t[0x%02x] = 0x%02x\n", bios->data[soff], bios->data[soff+1]);
-					soff += 2;
-				}
-				break;
-			case 0x4a:
-				printcmd (soff, 11);
-				printf ("IO_RESTRICT_PLL2\tR[0x%06x] =PLL= (0x%04x[0x%02x] & 0x%02x) >> %d) [{\n", le32(soff+7), le16(soff+1), bios->data[soff+3], bios->data[soff+4], bios->data[soff+5]);
-				cnt = bios->data[soff+6];
-				soff += 11;
-				while (cnt--) {
-					printcmd (soff, 4);
-					printf ("\t%dkHz\n", le32(soff));
-					soff += 4;
-				}
-				printcmd (soff, 0);
-				printf ("}]\n");
-				break;
-			case 0x4b:
-				printcmd (soff, 9);
-				printf ("PLL2\tR[0x%06x] =PLL= %dkHz\n", le32(soff+1), le32(soff+5));
-				soff += 9;
-				break;
-			case 0x4c:
-				printcmd (soff, 4);
-				printf ("I2C_BYTE\tI2C[0x%02x][0x%02x]\n", bios->data[soff+1], bios->data[soff+2]);
-				cnt = bios->data[soff+3];
-				soff += 4;
-				while (cnt--) {
-					printcmd (soff, 3);
-					printf ("\t[0x%02x] &= 0x%02x |= 0x%02x\n", bios->data[soff], bios->data[soff+1], bios->data[soff+2]);
-					soff += 3;
-				}
-				break;
-			case 0x4d:
-				printcmd (soff, 4);
-				printf ("ZM_I2C_BYTE\tI2C[0x%02x][0x%02x]\n", bios->data[soff+1], bios->data[soff+2]);
-				cnt = bios->data[soff+3];
-				soff += 4;
-				while (cnt--) {
-					printcmd (soff, 2);
-					printf ("\t[0x%02x] = 0x%02x\n", bios->data[soff], bios->data[soff+1]);
-					soff += 2;
-				}
-				break;
-			case 0x50:
-				printcmd (soff, 3);
-				printf ("TMDS_ZM_GROUP\tT[0x%02x]\n", bios->data[soff+1]);
-				cnt = bios->data[soff+2];
-				soff += 3;
-				while (cnt--) {
-					printcmd (soff, 2);
-					printf ("\t[0x%02x] = 0x%02x\n", bios->data[soff], bios->data[soff+1]);
-					soff += 2;
-				}
-				break;
-			case 0x51:
-				printcmd (soff, 5);
-				cnt = bios->data[soff+4];
-				dst = bios->data[soff+3];
-				printf ("CR_INDEX_ADDR C[0x%02x] C[0x%02x] 0x%02x 0x%02x\n", bios->data[soff+1], bios->data[soff+2], bios->data[soff+3], bios->data[soff+4]);
-				soff += 5;
-				while (cnt--) {
-					printcmd(soff, 1);
-					printf ("\t\t[0x%02x] = 0x%02x\n", dst, bios->data[soff]);
-					soff++;
-					dst++;
-				}
-				break;
-			case 0x52:
+			}
+			break;
+		case 0x4a:
+			printcmd (soff, 11);
+			printf ("IO_RESTRICT_PLL2\tR[0x%06x] =PLL= (0x%04x[0x%02x] & 0x%02x) >> %d) [{\n", le32(soff+7), le16(soff+1), bios->data[soff+3], bios->data[soff+4], bios->data[soff+5]);
+			cnt = sop->cnt;
+			soff += 11;
+			while (cnt--) {
 				printcmd (soff, 4);
-				printf ("CR\t\tC[0x%02x] &= 0x%02x |= 0x%02x\n", bios->data[soff+1], bios->data[soff+2], bios->data[soff+3]);
+				printf ("\t%dkHz\n", le32(soff));
 				soff += 4;
-				break;
-			case 0x53:
-				printcmd (soff, 3);
-				printf ("ZM_CR\tC[0x%02x] = 0x%02x\n", bios->data[soff+1], bios->data[soff+2]);
-				soff += 3;
-				break;
-			case 0x54:
-				printcmd (soff, 2);
-				printf ("ZM_CR_GROUP\n");
-				cnt = bios->data[soff+1];
-				soff += 2;
-				while (cnt--) {
-					printcmd(soff, 2);
-					printf ("\t\tC[0x%02x] = 0x%02x\n", bios->data[soff], bios->data[soff+1]);
-					soff += 2;
-				}
-				break;
-			case 0x56:
-				printcmd (soff, 3);
-				printf ("CONDITION_TIME\t0x%02x 0x%02x\n", bios->data[soff+1], bios->data[soff+2]);
-				if (bios->data[soff+1] > maxcond)
-					maxcond = bios->data[soff+1];
-				soff += 3;
-				break;
-			case 0x57:
-				printcmd (soff, 3);
-				printf ("LTIME\t0x%04x\n", le16(soff+1));
-				soff += 3;
-				break;
-			case 0x58:
-				printcmd (soff, 6);
-				dst = le32(soff+1);
-				cnt = bios->data[soff+5];
-				soff += 6;
-				printf ("ZM_REG_SEQUENCE\t0x%02x\n", cnt);
-				while (cnt--) {
-					printcmd (soff, 4);
-					printf ("\t\tR[0x%06x] = 0x%08x\n", dst, le32(soff));
-					dst += 4;
-					soff += 4;
-				}
-				break;
-			case 0x5b:
+			}
+			printcmd (soff, 0);
+			printf ("}]\n");
+			break;
+		case 0x4b:
+			printcmd (soff, 9);
+			printf ("PLL2\tR[0x%06x] =PLL= %dkHz\n", le32(soff+1), le32(soff+5));
+			break;
+		case 0x4c:
+			printcmd (soff, 4);
+			printf ("I2C_BYTE\tI2C[0x%02x][0x%02x]\n", bios->data[soff+1], bios->data[soff+2]);
+			cnt = sop->cnt;
+			soff += 4;
+			while (cnt--) {
 				printcmd (soff, 3);
-				x = le16(soff+1);
-				printf ("CALL\t0x%04x\n", le16(soff+1));
+				printf ("\t[0x%02x] &= 0x%02x |= 0x%02x\n", bios->data[soff], bios->data[soff+1], bios->data[soff+2]);
 				soff += 3;
-				for (i = 0; i < callsnum; i++)
-					if (calls[i] == x)
-						break;
-				if (i == callsnum)
-					ADDARRAY(calls, x);
-				break;
-			case 0x5e:
-				printcmd (soff, 6);
-				printf ("I2C_IF\tI2C[0x%02x][0x%02x][0x%02x] & 0x%02x == 0x%02x\n", bios->data[soff+1], bios->data[soff+2], bios->data[soff+3], bios->data[soff+4], bios->data[soff+5]);
-				soff += 6;
-				break;
-			case 0x5f:
-				printcmd (soff, 16);
-				printf ("\n");
-				printcmd (soff+16, 6);
-				printf ("COPY_NV_REG\tR[0x%06x] & ~0x%08x = (R[0x%06x] %s 0x%02x) & 0x%08x ^ 0x%08x\n",
-						le32(soff+14), le32(soff+18), le32(soff+1), bios->data[soff+5]&0x80?"<<":">>",
-						bios->data[soff+5]&0x80?0x100-bios->data[soff+5]:bios->data[soff+5], le32(soff+6), le32(soff+10));
-				soff += 22;
-				break;
-			case 0x62:
-				printcmd (soff, 5);
-				printf ("ZM_INDEX_IO\tI[0x%04x][0x%02x] = 0x%02x\n", le16(soff+1), bios->data[soff+3], bios->data[soff+4]);
-				soff += 5;
-				break;
-			case 0x63:
-				printcmd (soff, 1);
-				printf ("COMPUTE_MEM\n");
-				soff++;
-				break;
-			case 0x65:
-				printcmd (soff, 13);
-				printf ("RESET\tR[0x%06x] = 0x%08x, 0x%08x\n", le32(soff+1), le32(soff+5), le32(soff+9));
-				soff += 13;
-				break;
-			case 0x66:
-				printcmd (soff, 1);
-				printf ("CONFIGURE_MEM\n");
-				soff += 1;
-				break;
-			case 0x67:
-				printcmd (soff, 1);
-				printf ("CONFIGURE_CLOCK\n");
-				soff += 1;
-				break;
-			case 0x68:
-				printcmd (soff, 1);
-				printf ("CONFIGURE_PREINIT\n");
-				soff += 1;
-				break;
-			case 0x69:
-				printcmd (soff, 5);
-				printf ("IO\t\tI[0x%04x] &= 0x%02x |= 0x%02x\n", le16(soff+1), bios->data[soff+3], bios->data[soff+4]);
-				soff += 5;
-				break;
-			case 0x6b:
+			}
+			break;
+		case 0x4d:
+			printcmd (soff, 4);
+			printf ("ZM_I2C_BYTE\tI2C[0x%02x][0x%02x]\n", bios->data[soff+1], bios->data[soff+2]);
+			cnt = sop->cnt;
+			soff += 4;
+			while (cnt--) {
 				printcmd (soff, 2);
-				printf ("SUB\t0x%02x\n", bios->data[soff+1]);
-				x = bios->data[soff+1];
+				printf ("\t[0x%02x] = 0x%02x\n", bios->data[soff], bios->data[soff+1]);
 				soff += 2;
-				for (i = 0; i < subsnum; i++)
-					if (subs[i] == x)
-						break;
-				if (i == subsnum)
-					ADDARRAY(subs, x);
-				break;
-			case 0x6e:
-				printcmd (soff, 13);
-				printf ("NV_REG\tR[0x%06x] &= 0x%08x |= 0x%08x\n", le32(soff+1), le32(soff+5), le32(soff+9));
-				soff += 13;
-				break;
-			case 0x6f:
+			}
+			break;
+		case 0x50:
+			printcmd (soff, 3);
+			printf ("TMDS_ZM_GROUP\tT[0x%02x]\n", bios->data[soff+1]);
+			cnt = sop->cnt;
+			soff += 3;
+			while (cnt--) {
 				printcmd (soff, 2);
-				printf ("MACRO\t0x%02x\n", bios->data[soff+1]);
-				if (bios->data[soff+1] > maxmi)
-					maxmi = bios->data[soff+1];
+				printf ("\t[0x%02x] = 0x%02x\n", bios->data[soff], bios->data[soff+1]);
 				soff += 2;
-				break;
-			case 0x71:
-				printcmd (soff, 1);
-				printf ("DONE\n");
-				return;
-			case 0x72:
-				printcmd (soff, 1);
-				printf ("RESUME\n");
+			}
+			break;
+		case 0x51:
+			printcmd (soff, 5);
+			cnt = sop->cnt;
+			dst = bios->data[soff+3];
+			printf ("CR_INDEX_ADDR C[0x%02x] C[0x%02x] 0x%02x 0x%02x\n", bios->data[soff+1], bios->data[soff+2], bios->data[soff+3], bios->data[soff+4]);
+			soff += 5;
+			while (cnt--) {
+				printcmd(soff, 1);
+				printf ("\t\t[0x%02x] = 0x%02x\n", dst, bios->data[soff]);
 				soff++;
-				break;
-			case 0x74:
-				printcmd (soff, 3);
-				printf ("TIME\t0x%04x\n", le16(soff+1));
-				soff += 3;
-				break;
-			case 0x75:
-				printcmd (soff, 2);
-				printf ("CONDITION\t0x%02x\n", bios->data[soff+1]);
-				if (bios->data[soff+1] > maxcond)
-					maxcond = bios->data[soff+1];
-				soff += 2;
-				break;
-			case 0x76:
-				printcmd (soff, 2);
-				printf ("IO_CONDITION\t0x%02x\n", bios->data[soff+1]);
-				if (bios->data[soff+1] > maxiocond)
-					maxiocond = bios->data[soff+1];
-				soff += 2;
-				break;
-			case 0x78:
-				printcmd (soff, 6);
-				printf ("INDEX_IO\tI[0x%04x][0x%02x] &= 0x%02x |= 0x%02x\n", le16(soff+1), bios->data[soff+3], bios->data[soff+4], bios->data[soff+5]);
-				soff += 6;
-				break;
-			case 0x79:
-				printcmd (soff, 7);
-				printf ("PLL\tR[0x%06x] =PLL= %dkHz\n", le32(soff+1), le16(soff+5) * 10);
-				soff += 7;
-				break;
-			case 0x7a:
-				printcmd (soff, 9);
-				printf ("ZM_REG\tR[0x%06x] = 0x%08x\n", le32(soff+1), le32(soff+5));
-				soff += 9;
-				break;
-			case 0x87:
-				printcmd (soff, 2);
-				printf ("RAM_RESTRICT_PLL 0x%02x\n", bios->data[soff+1]);
+				dst++;
+			}
+			break;
+		case 0x52:
+			printcmd (soff, 4);
+			printf ("CR\t\tC[0x%02x] &= 0x%02x |= 0x%02x\n", bios->data[soff+1], bios->data[soff+2], bios->data[soff+3]);
+			break;
+		case 0x53:
+			printcmd (soff, 3);
+			printf ("ZM_CR\tC[0x%02x] = 0x%02x\n", bios->data[soff+1], bios->data[soff+2]);
+			break;
+		case 0x54:
+			printcmd (soff, 2);
+			printf ("ZM_CR_GROUP\n");
+			cnt = sop->cnt;
+			soff += 2;
+			while (cnt--) {
+				printcmd(soff, 2);
+				printf ("\t\tC[0x%02x] = 0x%02x\n", bios->data[soff], bios->data[soff+1]);
 				soff += 2;
+			}
+			break;
+		case 0x56:
+			printcmd (soff, 3);
+			printf ("CONDITION_TIME\t0x%02x 0x%02x\n", bios->data[soff+1], bios->data[soff+2]);
+			if (bios->data[soff+1] > maxcond)
+				maxcond = bios->data[soff+1];
+			break;
+		case 0x57:
+			printcmd (soff, 3);
+			printf ("LTIME\t0x%04x\n", le16(soff+1));
+			break;
+		case 0x58:
+			printcmd (soff, 6);
+			dst = le32(soff+1);
+			cnt = sop->cnt;
+			soff += 6;
+			printf ("ZM_REG_SEQUENCE\t0x%02x\n", cnt);
+			while (cnt--) {
+				printcmd (soff, 4);
+				printf ("\t\tR[0x%06x] = 0x%08x\n", dst, le32(soff));
+				dst += 4;
+				soff += 4;
+			}
+			break;
+		case 0x5b:
+			printcmd (soff, 3);
+			x = le16(soff+1);
+			printf ("CALL\t0x%04x\n", le16(soff+1));
+			for (i = 0; i < callsnum; i++)
+				if (calls[i] == x)
+					break;
+			if (i == callsnum)
+				ADDARRAY(calls, x);
+			break;
+		case 0x5e:
+			printcmd (soff, 6);
+			printf ("I2C_IF\tI2C[0x%02x][0x%02x][0x%02x] & 0x%02x == 0x%02x\n", bios->data[soff+1], bios->data[soff+2], bios->data[soff+3], bios->data[soff+4], bios->data[soff+5]);
+			break;
+		case 0x5f:
+			printcmd (soff, 16);
+			printf ("\n");
+			printcmd (soff+16, 6);
+			printf ("COPY_NV_REG\tR[0x%06x] & ~0x%08x = (R[0x%06x] %s 0x%02x) & 0x%08x ^ 0x%08x\n",
+					le32(soff+14), le32(soff+18), le32(soff+1), bios->data[soff+5]&0x80?"<<":">>",
+					bios->data[soff+5]&0x80?0x100-bios->data[soff+5]:bios->data[soff+5], le32(soff+6), le32(soff+10));
+			break;
+		case 0x62:
+			printcmd (soff, 5);
+			printf ("ZM_INDEX_IO\tI[0x%04x][0x%02x] = 0x%02x\n", le16(soff+1), bios->data[soff+3], bios->data[soff+4]);
+			break;
+		case 0x63:
+			printcmd (soff, 1);
+			printf ("COMPUTE_MEM\n");
+			break;
+		case 0x65:
+			printcmd (soff, 13);
+			printf ("RESET\tR[0x%06x] = 0x%08x, 0x%08x\n", le32(soff+1), le32(soff+5), le32(soff+9));
+			break;
+		case 0x66:
+			printcmd (soff, 1);
+			printf ("CONFIGURE_MEM\n");
+			break;
+		case 0x67:
+			printcmd (soff, 1);
+			printf ("CONFIGURE_CLOCK\n");
+			break;
+		case 0x68:
+			printcmd (soff, 1);
+			printf ("CONFIGURE_PREINIT\n");
+			break;
+		case 0x69:
+			printcmd (soff, 5);
+			printf ("IO\t\tI[0x%04x] &= 0x%02x |= 0x%02x\n", le16(soff+1), bios->data[soff+3], bios->data[soff+4]);
+			break;
+		case 0x6b:
+			printcmd (soff, 2);
+			printf ("SUB\t0x%02x\n", bios->data[soff+1]);
+			x = bios->data[soff+1];
+			for (i = 0; i < subsnum; i++)
+				if (subs[i] == x)
+					break;
+			if (i == subsnum)
+				ADDARRAY(subs, x);
+			break;
+		case 0x6e:
+			printcmd (soff, 13);
+			printf ("NV_REG\tR[0x%06x] &= 0x%08x |= 0x%08x\n", le32(soff+1), le32(soff+5), le32(soff+9));
+			break;
+		case 0x6f:
+			printcmd (soff, 2);
+			printf ("MACRO\t0x%02x\n", bios->data[soff+1]);
+			if (bios->data[soff+1] > maxmi)
+				maxmi = bios->data[soff+1];
+			break;
+		case 0x71:
+			printcmd (soff, 1);
+			printf ("DONE\n");
+			break;
+		case 0x72:
+			printcmd (soff, 1);
+			printf ("RESUME\n");
+			break;
+		case 0x74:
+			printcmd (soff, 3);
+			printf ("TIME\t0x%04x\n", le16(soff+1));
+			break;
+		case 0x75:
+			printcmd (soff, 2);
+			printf ("CONDITION\t0x%02x\n", bios->data[soff+1]);
+			if (bios->data[soff+1] > maxcond)
+				maxcond = bios->data[soff+1];
+			break;
+		case 0x76:
+			printcmd (soff, 2);
+			printf ("IO_CONDITION\t0x%02x\n", bios->data[soff+1]);
+			if (bios->data[soff+1] > maxiocond)
+				maxiocond = bios->data[soff+1];
+			break;
+		case 0x78:
+			printcmd (soff, 6);
+			printf ("INDEX_IO\tI[0x%04x][0x%02x] &= 0x%02x |= 0x%02x\n", le16(soff+1), bios->data[soff+3], bios->data[soff+4], bios->data[soff+5]);
+			break;
+		case 0x79:
+			printcmd (soff, 7);
+			printf ("PLL\tR[0x%06x] =PLL= %dkHz\n", le32(soff+1), le16(soff+5) * 10);
+			break;
+		case 0x7a:
+			printcmd (soff, 9);
+			printf ("ZM_REG\tR[0x%06x] = 0x%08x\n", le32(soff+1), le32(soff+5));
+			break;
+		case 0x87:
+			printcmd (soff, 2);
+			printf ("RAM_RESTRICT_PLL 0x%02x\n", bios->data[soff+1]);
+			soff += 2;
+			for (i = 0; i < sop->cnt; i++) {
+				printcmd(soff, 4);
+				printf("\t[0x%02x] 0x%08x\n", i, le32(soff));
+				soff += 4;
+			}
+			break;
+		case 0x8c:
+			printcmd (soff, 1);
+			printf ("UNK8C\n");
+			break;
+		case 0x8d:
+			printcmd (soff, 1);
+			printf ("UNK8D\n");
+			break;
+		case 0x8e:
+			printcmd (soff, 1);
+			printf ("GPIO\n");
+			break;
+		case 0x8f:
+			printcmd (soff, 7);
+			printf ("RAM_RESTRICT_ZM_REG_GROUP\tR[0x%06x] 0x%02x 0x%02x\n", le32(soff+1), bios->data[soff+5], bios->data[soff+6]);
+			incr = bios->data[soff+5];
+			cnt = sop->cnt;
+			dst = le32(soff+1);
+			soff += 7;
+			while (cnt--) {
+				printcmd (soff, 0);
+				printf ("\tR[0x%06x] = {\n", dst);
 				for (i = 0; i < ram_restrict_group_count; i++) {
-					printcmd(soff, 4);
-					printf("\t[0x%02x] 0x%08x\n", i, le32(soff));
-					soff += 4;
-				}
-				break;
-			case 0x8c:
-				printcmd (soff, 1);
-				printf ("UNK8C\n");
-				soff++;
-				break;
-			case 0x8d:
-				printcmd (soff, 1);
-				printf ("UNK8D\n");
-				soff++;
-				break;
-			case 0x8e:
-				printcmd (soff, 1);
-				printf ("GPIO\n");
-				soff++;
-				break;
-			case 0x8f:
-				printcmd (soff, 7);
-				printf ("RAM_RESTRICT_ZM_REG_GROUP\tR[0x%06x] 0x%02x 0x%02x\n", le32(soff+1), bios->data[soff+5], bios->data[soff+6]);
-				incr = bios->data[soff+5];
-				cnt = bios->data[soff+6];
-				dst = le32(soff+1);
-				soff += 7;
-				while (cnt--) {
-					printcmd (soff, 0);
-					printf ("\tR[0x%06x] = {\n", dst);
-					for (i = 0; i < ram_restrict_group_count; i++) {
-						printcmd (soff, 4);
-						printf ("\t\t0x%08x\n", le32(soff));
-						soff += 4;
-					}
-					printcmd (soff, 0);
-					printf ("\t}\n");
-					dst += incr;
-				}
-				break;
-			case 0x90:
-				printcmd (soff, 9);
-				printf ("COPY_ZM_REG\tR[0x%06x] = R[0x%06x]\n", le32(soff+5), le32(soff+1));
-				soff += 9;
-				break;
-			case 0x91:
-				printcmd (soff, 7);
-				printf ("ZM_REG_GROUP\tR[0x%06x] =\n", le32(soff+1));
-				cnt = bios->data[soff+5];
-				soff += 6;
-				while (cnt--) {
 					printcmd (soff, 4);
 					printf ("\t\t0x%08x\n", le32(soff));
 					soff += 4;
 				}
-				break;
-			case 0x92:
-				printcmd (soff, 1);
-				printf ("UNK92\n");
-				soff++;
-				break;
-			case 0x97:
-				printcmd (soff, 13);
-				printf ("ZM_MASK_ADD\tR[0x%06x] & ~0x%08x += 0x%08x\n", le32(soff+1), le32(soff+5), le32(soff+9));
-				soff += 13;
-				break;
-			case 0x9a:
-				printcmd (soff, 7);
-				printf ("I2C_IF_LONG\tI2C[0x%02x][0x%02x][0x%02x:0x%02x] & 0x%02x == 0x%02x\n", bios->data[soff+1], bios->data[soff+2], bios->data[soff+4], bios->data[soff+3], bios->data[soff+5], bios->data[soff+6]);
-				soff += 7;
-				break;
-			default:
-				printcmd (soff, 1);
-				printf ("???\n");
-				soff++;
-				break;
-		}
+				printcmd (soff, 0);
+				printf ("\t}\n");
+				dst += incr;
+			}
+			break;
+		case 0x90:
+			printcmd (soff, 9);
+			printf ("COPY_ZM_REG\tR[0x%06x] = R[0x%06x]\n", le32(soff+5), le32(soff+1));
+			break;
+		case 0x91:
+			printcmd (soff, 7);
+			printf ("ZM_REG_GROUP\tR[0x%06x] =\n", le32(soff+1));
+			cnt = sop->cnt;
+			soff += 6;
+			while (cnt--) {
+				printcmd (soff, 4);
+				printf ("\t\t0x%08x\n", le32(soff));
+				soff += 4;
+			}
+			break;
+		case 0x92:
+			printcmd (soff, 1);
+			printf ("UNK92\n");
+			break;
+		case 0x97:
+			printcmd (soff, 13);
+			printf ("ZM_MASK_ADD\tR[0x%06x] & ~0x%08x += 0x%08x\n", le32(soff+1), le32(soff+5), le32(soff+9));
+			break;
+		case 0x9a:
+			printcmd (soff, 7);
+			printf ("I2C_IF_LONG\tI2C[0x%02x][0x%02x][0x%02x:0x%02x] & 0x%02x == 0x%02x\n", bios->data[soff+1], bios->data[soff+2], bios->data[soff+4], bios->data[soff+3], bios->data[soff+5], bios->data[soff+6]);
+			break;
+		default:
+			printcmd (soff, 1);
+			printf ("???\n");
+			break;
+	}
+}
+
+void printscript (uint16_t soff) {
+	const struct envy_bios_script *script;
+	int i;
+	if (cache_scripts) {
+		script = envy_bios_script_cache_get(bios, &script_cache, soff, ram_restrict_group_count);
+	} else {
+		envy_bios_script_decode(bios, soff, ram_restrict_group_count, &script_buf);
+		script = &script_buf;
+	}
+	for (i = 0; i < script->opsnum; i++)
+		printscript_op(&script->ops[i]);
+	if (script->truncated) {
+		printf ("0x%04x: ** script runs past the end of the image **\n", script->end);
 	}
 }
 
@@ -784,7 +770,9 @@ const char * mem_type(uint8_t version, uint16_t start)
 int main(int argc, char **argv) {
 	int i;
 	int c;
-	while ((c = getopt (argc, argv, "m:s:i:p:vubh")) != -1)
+	const char *batch_path = 0;
+	int batch_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	while ((c = getopt (argc, argv, "m:s:i:cp:vubB:j:h")) != -1)
 		switch (c) {
 			case 'm':
 				sscanf(optarg,"%2hhx",&tCWL);
@@ -800,6 +788,9 @@ int main(int argc, char **argv) {
 			case 'i':
 				sscanf(optarg,"%4hx",&script_print);
 				break;
+			case 'c':
+				cache_scripts = 1;
+				break;
 			case 'v':
 				printmask |= ENVY_BIOS_PRINT_VERBOSE;
 				break;
@@ -809,6 +800,12 @@ int main(int argc, char **argv) {
 			case 'b':
 				printmask |= ENVY_BIOS_PRINT_BLOCKS;
 				break;
+			case 'B':
+				batch_path = optarg;
+				break;
+			case 'j':
+				batch_jobs = atoi(optarg);
+				break;
 			case 'p':
 				for (i = 0; i < sizeof printmasks / sizeof *printmasks; i++) {
 					if (!strcmp(printmasks[i].name, optarg))
@@ -819,6 +816,9 @@ int main(int argc, char **argv) {
 				return usage(argv[0]);
 		}
 
+	if (batch_path)
+		return nvbios_batch(batch_path, batch_jobs, stdout);
+
 	if (!(printmask & ENVY_BIOS_PRINT_ALL))
 		printmask |= ENVY_BIOS_PRINT_ALL;
 
@@ -964,9 +964,12 @@ int main(int argc, char **argv) {
 
 	if (bios->hwsq_offset && (printmask & ENVY_BIOS_PRINT_HWSQ)) {
 		uint8_t entry_count, bytes_to_write, i;
+		int pos;
 		const struct disisa *hwsq_isa = ed_getisa("hwsq");
 		struct varinfo *hwsq_var_nv41 = varinfo_new(hwsq_isa->vardata);
 		varinfo_set_variant(hwsq_var_nv41, "nv41");
+		struct ed_decoder *hwsq_dec = ed_decoder_new(hwsq_isa, hwsq_var_nv41);
+		struct ed_insn insn;
 
 		bios->hwsq_offset += 4;
 
@@ -981,10 +984,15 @@ int main(int argc, char **argv) {
 			//uint8_t bytes_written = 4;
 
 			printf("-- HWSQ entry %u at 0x%x: sequencer control = %u\n", i, entry_offset, sequencer);
-			envydis(hwsq_isa, stdout, bios->data + entry_offset + 4, 0, bytes_to_write - 4, hwsq_var_nv41, 0, 0, 0, discolors);
+			for (pos = 0; pos < bytes_to_write - 4; pos += insn.oplen) {
+				ed_decode(hwsq_dec, bios->data + entry_offset + 4 + pos, bytes_to_write - 4 - pos, pos, &insn);
+				ed_print_insn(hwsq_dec, stdout, discolors, &insn, 0);
+				ed_insn_fini(&insn);
+			}
 			printf ("\n");
 		}
 		printf ("\n");
+		ed_decoder_del(hwsq_dec);
 	}
 
 	if (pll_limit_tbl_ptr && (printmask & ENVY_BIOS_PRINT_PLL)) {
@@ -288,16 +288,6 @@ static void print_nv01_init_script(struct envy_bios *bios, FILE *out, unsigned o
 	}
 }
 
-static int block_cmp(const void *va, const void *vb) {
-	const struct envy_bios_block *a = va;
-	const struct envy_bios_block *b = vb;
-	if (a->start < b->start)
-		return -1;
-	if (a->start > b->start)
-		return 1;
-	return 0;
-}
-
 void envy_bios_print (struct envy_bios *bios, FILE *out, unsigned mask) {
 	print_pcir(bios, out, mask);
 	switch (bios->type) {
@@ -413,28 +403,33 @@ void envy_bios_print (struct envy_bios *bios, FILE *out, unsigned mask) {
 		break;
 	}
 	if (mask & ENVY_BIOS_PRINT_BLOCKS) {
-		qsort(bios->blocks, bios->blocksnum, sizeof *bios->blocks, block_cmp);
+		int *order = malloc(bios->blocksnum * sizeof *order);
 		int i;
 		unsigned last = 0;
+		envy_bios_block_order(bios, order);
 		for (i = 0; i < bios->blocksnum; i++) {
-			unsigned start = bios->blocks[i].start;
-			unsigned end = start + bios->blocks[i].len;
+			struct envy_bios_block *block = &bios->blocks[order[i]];
+			unsigned start = block->start;
+			unsigned end = start + block->len;
 			if (start > last) {
 				fprintf(out, "0x%08x:0x%08x ???\n", last, start);
 			}
 			if (start < last) {
 				fprintf(out, "overlap detected!\n");
 			}
-			fprintf(out, "0x%08x:0x%08x %s", start, end, bios->blocks[i].name);
-			if (bios->blocks[i].idx != -1) {
-				if (!strcmp(bios->blocks[i].name, "BIT"))
-					fprintf(out, " '%c'", bios->blocks[i].idx);
+			fprintf(out, "0x%08x:0x%08x %s", start, end, block->name);
+			if (block->idx != -1) {
+				if (!strcmp(block->name, "BIT"))
+					fprintf(out, " '%c'", block->idx);
 				else
-					fprintf(out, "[%d]", bios->blocks[i].idx);
+					fprintf(out, "[%d]", block->idx);
 			}
 			fprintf(out, "\n");
 			last = end;
 		}
+		free(order);
+		if (mask & ENVY_BIOS_PRINT_UNUSED)
+			fprintf(out, "0x%x of 0x%x bytes not covered by any block\n", envy_bios_unused_bytes(bios), bios->length);
 		fprintf(out, "\n");
 	}
 }
@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Init script decoder.  Every opcode is described by its fixed part length
+ * and, for ops with a variable tail, by where its item count lives and how
+ * big the items are.  Decoding a script only walks the ops and stores one
+ * small record per op - formatting is left to the consumer.
+ */
+
+#include "bios.h"
+#include "util.h"
+#include <errno.h>
+#include <string.h>
+
+#define RRG_COUNT ENVY_BIOS_SCRIPT_RRG_COUNT
+#define RRG_ITEM ENVY_BIOS_SCRIPT_RRG_ITEM
+#define END ENVY_BIOS_SCRIPT_END
+
+const struct envy_bios_script_opinfo envy_bios_script_ops[0x100] = {
+	[0x32] = { "IO_RESTRICT_PROG", 11, 6, 4 },
+	[0x33] = { "REPEAT", 2 },
+	[0x34] = { "IO_RESTRICT_PLL", 12, 7, 2 },
+	[0x36] = { "END_REPEAT", 1 },
+	[0x37] = { "COPY", 11 },
+	[0x38] = { "NOT", 1 },
+	[0x39] = { "IO_FLAG_CONDITION", 2 },
+	[0x49] = { "INDEX_ADDRESS_LATCHED", 18, 17, 2 },
+	[0x4a] = { "IO_RESTRICT_PLL2", 11, 6, 4 },
+	[0x4b] = { "PLL2", 9 },
+	[0x4c] = { "I2C_BYTE", 4, 3, 3 },
+	[0x4d] = { "ZM_I2C_BYTE", 4, 3, 2 },
+	[0x50] = { "TMDS_ZM_GROUP", 3, 2, 2 },
+	[0x51] = { "CR_INDEX_ADDR", 5, 4, 1 },
+	[0x52] = { "CR", 4 },
+	[0x53] = { "ZM_CR", 3 },
+	[0x54] = { "ZM_CR_GROUP", 2, 1, 2 },
+	[0x56] = { "CONDITION_TIME", 3 },
+	[0x57] = { "LTIME", 3 },
+	[0x58] = { "ZM_REG_SEQUENCE", 6, 5, 4 },
+	[0x5b] = { "CALL", 3 },
+	[0x5e] = { "I2C_IF", 6 },
+	[0x5f] = { "COPY_NV_REG", 22 },
+	[0x62] = { "ZM_INDEX_IO", 5 },
+	[0x63] = { "COMPUTE_MEM", 1 },
+	[0x65] = { "RESET", 13 },
+	[0x66] = { "CONFIGURE_MEM", 1 },
+	[0x67] = { "CONFIGURE_CLOCK", 1 },
+	[0x68] = { "CONFIGURE_PREINIT", 1 },
+	[0x69] = { "IO", 5 },
+	[0x6b] = { "SUB", 2 },
+	[0x6e] = { "NV_REG", 13 },
+	[0x6f] = { "MACRO", 2 },
+	[0x71] = { "DONE", 1, 0, 0, END },
+	[0x72] = { "RESUME", 1 },
+	[0x74] = { "TIME", 3 },
+	[0x75] = { "CONDITION", 2 },
+	[0x76] = { "IO_CONDITION", 2 },
+	[0x78] = { "INDEX_IO", 6 },
+	[0x79] = { "PLL", 7 },
+	[0x7a] = { "ZM_REG", 9 },
+	[0x87] = { "RAM_RESTRICT_PLL", 2, 0, 4, RRG_COUNT },
+	[0x8c] = { "UNK8C", 1 },
+	[0x8d] = { "UNK8D", 1 },
+	[0x8e] = { "GPIO", 1 },
+	[0x8f] = { "RAM_RESTRICT_ZM_REG_GROUP", 7, 6, 4, RRG_ITEM },
+	[0x90] = { "COPY_ZM_REG", 9 },
+	[0x91] = { "ZM_REG_GROUP", 6, 5, 4 },
+	[0x92] = { "UNK92", 1 },
+	[0x97] = { "ZM_MASK_ADD", 13 },
+	[0x9a] = { "I2C_IF_LONG", 7 },
+};
+
+/* decodes the script at start into script, reusing its ops array */
+int envy_bios_script_decode (struct envy_bios *bios, unsigned int start, int rrgc, struct envy_bios_script *script) {
+	unsigned int pos = start;
+	script->start = start;
+	script->rrgc = rrgc;
+	script->truncated = 0;
+	script->opsnum = 0;
+	while (1) {
+		struct envy_bios_script_op op;
+		const struct envy_bios_script_opinfo *info;
+		unsigned int isize;
+		if (pos >= bios->length)
+			break;
+		op.op = bios->data[pos];
+		info = &envy_bios_script_ops[op.op];
+		op.start = pos;
+		op.len = info->name ? info->hlen : 1;
+		op.cnt = 0;
+		if (info->flags & RRG_COUNT) {
+			op.cnt = rrgc;
+		} else if (info->cntpos) {
+			if (pos + info->cntpos >= bios->length)
+				break;
+			op.cnt = bios->data[pos + info->cntpos];
+		}
+		isize = info->isize;
+		if (info->flags & RRG_ITEM)
+			isize *= rrgc;
+		op.len += op.cnt * isize;
+		if (pos + op.len > bios->length)
+			break;
+		ADDARRAY(script->ops, op);
+		pos += op.len;
+		if (info->flags & END) {
+			script->end = pos;
+			return 0;
+		}
+	}
+	script->end = pos;
+	script->truncated = 1;
+	ENVY_BIOS_ERR("Init script at 0x%04x runs past the end of the image\n", start);
+	return -EFAULT;
+}
+
+void envy_bios_script_fini (struct envy_bios_script *script) {
+	free(script->ops);
+	script->ops = 0;
+	script->opsnum = script->opsmax = 0;
+}
+
+static int script_cache_cmp (const struct envy_bios_script *script, unsigned int start, int rrgc) {
+	if (script->start != start)
+		return script->start < start ? -1 : 1;
+	return script->rrgc - rrgc;
+}
+
+/*
+ * Returns the decoded script at start, decoding it on first use.  The
+ * result stays valid until the cache is destroyed.  A cache must only be
+ * used with a single image.
+ */
+const struct envy_bios_script *envy_bios_script_cache_get (struct envy_bios *bios, struct envy_bios_script_cache *cache, unsigned int start, int rrgc) {
+	struct envy_bios_script *script;
+	int lo = 0, hi = cache->scriptsnum;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		int c = script_cache_cmp(cache->scripts[mid], start, rrgc);
+		if (!c)
+			return cache->scripts[mid];
+		if (c < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	envy_bios_script_decode(bios, start, rrgc, &cache->scratch);
+	script = malloc(sizeof *script);
+	*script = cache->scratch;
+	script->ops = malloc(script->opsnum * sizeof *script->ops);
+	memcpy(script->ops, cache->scratch.ops, script->opsnum * sizeof *script->ops);
+	script->opsmax = script->opsnum;
+	ADDARRAY(cache->scripts, script);
+	memmove(&cache->scripts[lo + 1], &cache->scripts[lo], (cache->scriptsnum - 1 - lo) * sizeof *cache->scripts);
+	cache->scripts[lo] = script;
+	return script;
+}
+
+void envy_bios_script_cache_fini (struct envy_bios_script_cache *cache) {
+	int i;
+	for (i = 0; i < cache->scriptsnum; i++) {
+		envy_bios_script_fini(cache->scripts[i]);
+		free(cache->scripts[i]);
+	}
+	free(cache->scripts);
+	cache->scripts = 0;
+	cache->scriptsnum = cache->scriptsmax = 0;
+	envy_bios_script_fini(&cache->scratch);
+}
@@ -221,7 +221,7 @@ int comp_format_bpp(int chipset, int format) {
 	}
 }
 
-static void comp_z16_grad_decompress(int chipset, int ms, uint64_t w0, uint64_t w1, int is_const, uint16_t od16[4][16]) {
+static void comp_z16_grad_decompress(int ctype, int ms, uint64_t w0, uint64_t w1, int is_const, uint16_t od16[4][16]) {
 	uint32_t rdelta[29];
 	uint32_t base = w0 & 0xffff;
 	uint32_t dx = w0 >> 16 & 0xfff;
@@ -230,7 +230,7 @@ static void comp_z16_grad_decompress(int chipset, int ms, uint64_t w0, uint64_t
 	int wpos = 0;
 	int i, x, y;
 	int x0, y0 = 0;
-	if (comp_type(chipset) == COMP_NV20)
+	if (ctype == COMP_NV20)
 		x0 = 2;
 	else
 		x0 = 3;
@@ -257,7 +257,7 @@ static void comp_z16_grad_decompress(int chipset, int ms, uint64_t w0, uint64_t
 	if (dy & 0x800)
 		dy |= 0xfffff000;
 	int di = 0;
-	int half_dx = comp_type(chipset) >= COMP_NV30;
+	int half_dx = ctype >= COMP_NV30;
 	for (y = 0; y < 4; y++) {
 		for (x = 0; x < 8; x++) {
 			int need_delta = 1;
@@ -274,7 +274,7 @@ static void comp_z16_grad_decompress(int chipset, int ms, uint64_t w0, uint64_t
 			int ry = 2 * (y - y0);
 			if (ms == 1)
 				ry -= (x - x0) & 1;
-			if (comp_type(chipset) < COMP_NV30)
+			if (ctype < COMP_NV30)
 				dz -= ry >= 0;
 			dz += dx * rx * (2 - half_dx);
 			dz += dy * ry * 2;
@@ -288,7 +288,7 @@ static void comp_z16_grad_decompress(int chipset, int ms, uint64_t w0, uint64_t
 	}
 }
 
-static void comp_z24s8_grad_decompress(int chipset, int ms, uint64_t w0, uint64_t w1, int is_const, uint32_t od32[4][8]) {
+static void comp_z24s8_grad_decompress(int ctype, int ms, uint64_t w0, uint64_t w1, int is_const, uint32_t od32[4][8]) {
 	uint32_t rdelta[13];
 	uint8_t stencil = w0 & 0xff;
 	uint32_t base = w0 >> 8 & 0xffffff;
@@ -360,7 +360,7 @@ static uint32_t sext(uint32_t a, int b) {
 	return res;
 }
 
-static void comp_a8r8g8b8_grad_decompress(int chipset, uint64_t w0, uint64_t w1, int is_const, uint32_t od32[4][8]) {
+static void comp_a8r8g8b8_grad_decompress(int ctype, uint64_t w0, uint64_t w1, int is_const, uint32_t od32[4][8]) {
 	uint8_t base[4];
 	int8_t dx[3], dy[3];
 	int8_t delta[5][3];
@@ -394,7 +394,7 @@ static void comp_a8r8g8b8_grad_decompress(int chipset, uint64_t w0, uint64_t w1,
 	int x, y;
 	int x0 = 0;
 	int y0 = 1;
-	int twidth = comp_type(chipset) >= COMP_NV40 ? 8 : 4;
+	int twidth = ctype >= COMP_NV40 ? 8 : 4;
 	int theight = 4;
 	int di = 0;
 	for (y = 0; y < theight; y++) {
@@ -428,6 +428,105 @@ static void comp_a8r8g8b8_grad_decompress(int chipset, uint64_t w0, uint64_t w1,
 	}
 }
 
+static const int8_t comp_interp_weight[16][4][4] = {
+	{
+		{ 3, 4, 2, 1 },
+		{ 2, 3, 1, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 2, 3 },
+		{ 0, 0, 3, 4 },
+		{ 0, 0, 1, 2 },
+		{ 0, 0, 0, 1 },
+	},
+	{
+		{ 1, 0, 0, 0 },
+		{ 2, 1, 0, 0 },
+		{ 4, 3, 0, 0 },
+		{ 3, 2, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 1, 3, 2 },
+		{ 1, 2, 4, 3 },
+	},
+	{
+		{ 0, 0, 4, 2 },
+		{ 0, 0, 2, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+	},
+	{
+		{ 2, 0, 0, 0 },
+		{ 4, 2, 0, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 2, 4 },
+		{ 0, 0, 0, 2 },
+	},
+	{
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 2, 0, 0 },
+		{ 2, 4, 0, 0 },
+	},
+	{
+		{ 4, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 4 },
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 0 },
+		{ 0, 4, 0, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 4, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 4, 0, 0 },
+		{ 0, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 4, 0 },
+		{ 0, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+		{ 4, 0, 0, 0 },
+	},
+	{
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 0 },
+		{ 0, 0, 0, 4 },
+	},
+};
+
 static int rbits(char *bit, int *ppos, int n) {
 	int i;
 	int res = 0;
@@ -438,7 +537,7 @@ static int rbits(char *bit, int *ppos, int n) {
 	return res;
 }
 
-static void comp_a8r8g8b8_interp_decompress(int chipset, uint32_t cd[8], uint32_t od32[4][8]) {
+static void comp_a8r8g8b8_interp_decompress(int ctype, uint32_t cd[8], uint32_t od32[4][8]) {
 	/* fuck performance. */
 	char bit[255];
 	int mode;
@@ -486,104 +585,6 @@ static void comp_a8r8g8b8_interp_decompress(int chipset, uint32_t cd[8], uint32_
 		if (i == 0)
 			alpha = rbits(bit, &pos, mode == 1 ? 1 : 8);
 	}
-	static const int8_t weight[16][4][4] = {
-		{
-			{ 3, 4, 2, 1 },
-			{ 2, 3, 1, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-		},
-		{
-			{ 0, 0, 2, 3 },
-			{ 0, 0, 3, 4 },
-			{ 0, 0, 1, 2 },
-			{ 0, 0, 0, 1 },
-		},
-		{
-			{ 1, 0, 0, 0 },
-			{ 2, 1, 0, 0 },
-			{ 4, 3, 0, 0 },
-			{ 3, 2, 0, 0 },
-		},
-		{
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 1, 3, 2 },
-			{ 1, 2, 4, 3 },
-		},
-		{
-			{ 0, 0, 4, 2 },
-			{ 0, 0, 2, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-		},
-		{
-			{ 2, 0, 0, 0 },
-			{ 4, 2, 0, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-		},
-		{
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 2, 4 },
-			{ 0, 0, 0, 2 },
-		},
-		{
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 2, 0, 0 },
-			{ 2, 4, 0, 0 },
-		},
-		{
-			{ 4, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-		},
-		{
-			{ 0, 0, 0, 4 },
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-		},
-		{
-			{ 0, 0, 0, 0 },
-			{ 0, 4, 0, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-		},
-		{
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 4, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-		},
-		{
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 4, 0, 0 },
-			{ 0, 0, 0, 0 },
-		},
-		{
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 4, 0 },
-			{ 0, 0, 0, 0 },
-		},
-		{
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-			{ 4, 0, 0, 0 },
-		},
-		{
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 0 },
-			{ 0, 0, 0, 4 },
-		},
-	};
 	int y, x;
 	for (y = 0; y < 4; y++) {
 		for (x = 0; x < 4; x++) {
@@ -594,7 +595,7 @@ static void comp_a8r8g8b8_interp_decompress(int chipset, uint32_t cd[8], uint32_
 					pixel = raw[0][k];
 				} else {
 					for (i = 0; i < 16; i++)
-						pixel += raw[i][k] * weight[i][y][x];
+						pixel += raw[i][k] * comp_interp_weight[i][y][x];
 					pixel >>= 2;
 				}
 				res |= (pixel & 0xff) << 8 * k;
@@ -605,7 +606,113 @@ static void comp_a8r8g8b8_interp_decompress(int chipset, uint32_t cd[8], uint32_
 	}
 }
 
-static void comp_z24_grad_decompress(int chipset, int ms, uint32_t cd[8], uint32_t od32[4][8]) {
+/* reads n bits from a bit stream packed into 64-bit words */
+static int rbits64(const uint64_t *s, int *ppos, int n) {
+	int pos = *ppos;
+	uint64_t w = s[pos >> 6] >> (pos & 63);
+	if ((pos & 63) + n > 64)
+		w |= s[(pos >> 6) + 1] << (64 - (pos & 63));
+	*ppos = pos + n;
+	int res = w & ((1 << n) - 1);
+	if (res & 1 << (n-1))
+		res |= -1 << n;
+	return res;
+}
+
+/*
+ * Same as comp_a8r8g8b8_interp_decompress, but the bit stream is built with
+ * a few 64-bit shifts instead of one byte per bit, and the 16 weight
+ * tables are only walked for the endpoints that actually have weight at
+ * a given pixel.
+ */
+static void comp_a8r8g8b8_interp_decompress_fast(const uint32_t cd[8], uint32_t od32[4][8]) {
+	static const uint8_t wsrc[4][4][4] = {
+		{ { 0, 2, 5, 8 }, { 0, 0, 0, 0 }, { 0, 1, 4, 0 }, { 0, 1, 4, 9 } },
+		{ { 0, 2, 5, 0 }, { 0, 2, 5, 10 }, { 0, 1, 4, 11 }, { 1, 0, 0, 0 } },
+		{ { 2, 0, 0, 0 }, { 2, 3, 7, 12 }, { 1, 3, 6, 13 }, { 1, 3, 6, 0 } },
+		{ { 2, 3, 7, 14 }, { 2, 3, 7, 0 }, { 3, 0, 0, 0 }, { 1, 3, 6, 15 } },
+	};
+	static const uint8_t wnum[4][4] = {
+		{ 4, 1, 3, 4 },
+		{ 3, 4, 4, 1 },
+		{ 1, 4, 4, 3 },
+		{ 4, 3, 1, 4 },
+	};
+	uint64_t lo[2], hi[2], s[4];
+	int mode;
+	if (cd[3] & 1 << 31) {
+		if (cd[3] & 1 << 30)
+			mode = 2;
+		else
+			mode = 1;
+	} else {
+		mode = 0;
+	}
+	/* the top mode+1 bits of the first half are skipped */
+	int lobits = 127 - mode;
+	lo[0] = cd[0] | (uint64_t)cd[1] << 32;
+	lo[1] = (cd[2] | (uint64_t)cd[3] << 32) & (((uint64_t)1 << (lobits - 64)) - 1);
+	hi[0] = cd[4] | (uint64_t)cd[5] << 32;
+	hi[1] = cd[6] | (uint64_t)cd[7] << 32;
+	s[0] = lo[0];
+	s[1] = lo[1] | hi[0] << (lobits - 64);
+	s[2] = hi[0] >> (128 - lobits) | hi[1] << (lobits - 64);
+	s[3] = hi[1] >> (128 - lobits);
+	int pos = 0;
+	int i, k, x, y;
+	uint16_t raw[16][3];
+	uint8_t alpha = 0;
+	for (i = 0; i < (mode == 2 ? 1 : 16); i++) {
+		int rbsize, gsize, is_l;
+		if (i < 4)
+			rbsize = gsize = 8, is_l = 0;
+		else if (!mode) {
+			if (i < 11)
+				rbsize = 4, gsize = 5, is_l = 1;
+			else
+				rbsize = gsize = 4, is_l = 1;
+		} else {
+			if (i < 5)
+				rbsize = 4, gsize = 6, is_l = 1;
+			else
+				rbsize = 4, gsize = 5, is_l = 1;
+		}
+		int b = rbits64(s, &pos, rbsize);
+		int g = rbits64(s, &pos, gsize);
+		int r = rbits64(s, &pos, rbsize);
+		if (is_l)
+			r += g, b += g;
+		else
+			r &= 0xff, g &= 0xff, b &= 0xff;
+		raw[i][0] = b;
+		raw[i][1] = g;
+		raw[i][2] = r;
+		if (i == 0)
+			alpha = rbits64(s, &pos, mode == 1 ? 1 : 8);
+	}
+	for (y = 0; y < 4; y++) {
+		for (x = 0; x < 4; x++) {
+			uint32_t res = alpha << 24;
+			for (k = 0; k < 3; k++) {
+				int pixel = 3;
+				if (mode == 2) {
+					pixel = raw[0][k];
+				} else {
+					for (i = 0; i < wnum[y][x]; i++) {
+						int src = wsrc[y][x][i];
+						pixel += raw[src][k] * comp_interp_weight[src][y][x];
+					}
+					pixel >>= 2;
+				}
+				res |= (pixel & 0xff) << 8 * k;
+			}
+			od32[y][2*x] = res;
+			od32[y][2*x+1] = res;
+		}
+	}
+}
+
+static void comp_z24_grad_decompress(int ctype, int ms, uint32_t cd[8], uint32_t od32[4][8]) {
 	int is_const = cd[3] >> 31 & 1;
 	uint32_t base = cd[0] & 0xffffff;
 	uint32_t dxp = sext(cd[0] >> 24 | cd[1] << 8, 17);
@@ -673,17 +780,43 @@ static void comp_z24_grad_decompress(int chipset, int ms, uint32_t cd[8], uint32
 	}
 }
 
-void comp_decompress(int chipset, int format, uint8_t *data, int tag) {
-	int ftype = comp_format_type(chipset, format);
+/* everything about a format that doesn't depend on the tile contents */
+struct comp_params {
+	int ctype;
+	int format;
+	int ftype;
+	int ms;
+	int is_be;
+	int bpp;
+	int twidth;
+	int theight;
+};
+
+static void comp_get_params(int chipset, int format, struct comp_params *p) {
+	p->ctype = comp_type(chipset);
+	p->format = format;
+	p->ftype = comp_format_type(chipset, format);
+	p->twidth = p->ctype >= COMP_NV40 ? 0x20 : 0x10;
+	p->theight = 4;
+	p->ms = p->is_be = p->bpp = 0;
+	if (p->ftype == COMP_FORMAT_OFF)
+		return;
+	if (p->ftype != COMP_FORMAT_FLAT && p->ftype != COMP_FORMAT_Z24S8_SPLIT)
+		p->ms = comp_format_ms(chipset, format);
+	p->is_be = comp_format_endian(chipset, format);
+	p->bpp = comp_format_bpp(chipset, format);
+}
+
+/* decodes one tile into od32/od16, returns 0 if the tile is to be left alone */
+static int comp_decode_tile(const struct comp_params *p, const uint8_t *data, int tag, int fast, uint32_t od32[4][8], uint16_t od16[4][16]) {
+	int ftype = p->ftype;
+	int twidth = p->twidth;
+	int theight = p->theight;
 	uint32_t cd[8];
-	uint32_t od32[4][8];
-	uint16_t od16[4][16];
 	int i, x, y;
-	int twidth = comp_type(chipset) >= COMP_NV40 ? 0x20 : 0x10;
-	int theight = 4;
 	for (i = 0; i < 8; i++) {
 		int dp;
-		if (comp_type(chipset) < COMP_NV40) {
+		if (p->ctype < COMP_NV40) {
 			dp = 4*i;
 		} else {
 			dp = 4 * (4 + (i & 3) + (~i >> 2 & 1) * 8);
@@ -692,11 +825,11 @@ void comp_decompress(int chipset, int format, uint8_t *data, int tag) {
 	}
 	switch (ftype) {
 		case COMP_FORMAT_OFF: {
-			return;
+			return 0;
 		}
 		case COMP_FORMAT_FLAT: {
 			if (!tag)
-				return;
+				return 0;
 			for (x = 0; x < twidth/4; x++)
 				for (y = 0; y < theight; y++)
 					od32[y][x] = cd[(x >> 1) + (y >> 1) * (twidth >> 3)];
@@ -706,35 +839,37 @@ void comp_decompress(int chipset, int format, uint8_t *data, int tag) {
 		case COMP_FORMAT_Z24S8_GRAD:
 		case COMP_FORMAT_A8R8G8B8_GRAD: {
 			if (!tag)
-				return;
+				return 0;
 			uint64_t w0 = cd[0] | (uint64_t)cd[1] << 32;
 			uint64_t w1 = cd[2] | (uint64_t)cd[3] << 32;
 			int is_const = 0;
-			int ms = comp_format_ms(chipset, format);
 			if (w0 & (uint64_t)1 << 63) {
-				if (comp_type(chipset) < COMP_NV30)
+				if (p->ctype < COMP_NV30)
 					w1 = 0;
 				else
 					is_const = 1;
 			}
 			if (ftype == COMP_FORMAT_Z16_GRAD) {
-				comp_z16_grad_decompress(chipset, ms, w0, w1, is_const, od16);
+				comp_z16_grad_decompress(p->ctype, p->ms, w0, w1, is_const, od16);
 			} else if (ftype == COMP_FORMAT_Z24S8_GRAD) {
-				comp_z24s8_grad_decompress(chipset, ms, w0, w1, is_const, od32);
+				comp_z24s8_grad_decompress(p->ctype, p->ms, w0, w1, is_const, od32);
 			} else {
-				comp_a8r8g8b8_grad_decompress(chipset, w0, w1, is_const, od32);
+				comp_a8r8g8b8_grad_decompress(p->ctype, w0, w1, is_const, od32);
 			}
 			break;
 		}
 		case COMP_FORMAT_A8R8G8B8_INTERP: {
 			if (!tag)
-				return;
-			comp_a8r8g8b8_interp_decompress(chipset, cd, od32);
+				return 0;
+			if (fast)
+				comp_a8r8g8b8_interp_decompress_fast(cd, od32);
+			else
+				comp_a8r8g8b8_interp_decompress(p->ctype, cd, od32);
 			break;
 		}
 		case COMP_FORMAT_Z24S8_SPLIT_GRAD: {
 			if (tag) {
-				comp_z24_grad_decompress(chipset, comp_format_ms(chipset, format), cd, od32);
+				comp_z24_grad_decompress(p->ctype, p->ms, cd, od32);
 			} else {
 				uint8_t rbuf[0x60];
 				case COMP_FORMAT_Z24S8_SPLIT:
@@ -757,8 +892,21 @@ void comp_decompress(int chipset, int format, uint8_t *data, int tag) {
 		default:
 			abort();
 	}
-	int is_be = comp_format_endian(chipset, format);
-	int bpp = comp_format_bpp(chipset, format);
+	return 1;
+}
+
+void comp_decompress(int chipset, int format, uint8_t *data, int tag) {
+	struct comp_params p;
+	uint32_t od32[4][8];
+	uint16_t od16[4][16];
+	int x, y;
+	comp_get_params(chipset, format, &p);
+	if (!comp_decode_tile(&p, data, tag, 0, od32, od16))
+		return;
+	int twidth = p.twidth;
+	int theight = p.theight;
+	int is_be = p.is_be;
+	int bpp = p.bpp;
 	for (x = 0; x < twidth; x++)
 		for (y = 0; y < theight; y++)
 			if (bpp == 16)
@@ -768,3 +916,73 @@ void comp_decompress(int chipset, int format, uint8_t *data, int tag) {
 			else
 				abort();
 }
+
+int comp_tile_size(int chipset) {
+	return (comp_type(chipset) >= COMP_NV40 ? 0x20 : 0x10) * 4;
+}
+
+/* the bulk path: whole words at a time, byte-swapped for big endian formats */
+static void comp_store_tile(const struct comp_params *p, uint8_t *data, uint32_t od32[4][8], uint16_t od16[4][16]) {
+	int x, y;
+	for (y = 0; y < p->theight; y++) {
+		uint8_t *row = data + y * p->twidth;
+		if (p->bpp == 16) {
+			for (x = 0; x < p->twidth/2; x++) {
+				uint16_t v = od16[y][x];
+				if (p->is_be)
+					v = v >> 8 | v << 8;
+				row[2*x] = v;
+				row[2*x+1] = v >> 8;
+			}
+		} else {
+			for (x = 0; x < p->twidth/4; x++) {
+				uint32_t v = od32[y][x];
+				if (p->is_be)
+					v = __builtin_bswap32(v);
+				row[4*x] = v;
+				row[4*x+1] = v >> 8;
+				row[4*x+2] = v >> 16;
+				row[4*x+3] = v >> 24;
+			}
+		}
+	}
+}
+
+struct comp_bulk {
+	const struct comp_params *p;
+	uint8_t *data;
+	const int *tags;
+	int tsize;
+};
+
+#define COMP_BULK_CHUNK 256
+
+static void comp_bulk_tiles(void *arg, int start, int end) {
+	struct comp_bulk *b = arg;
+	uint32_t od32[4][8];
+	uint16_t od16[4][16];
+	int i;
+	for (i = start; i < end; i++) {
+		uint8_t *tile = b->data + (size_t)i * b->tsize;
+		if (comp_decode_tile(b->p, tile, b->tags ? b->tags[i] : 1, 1, od32, od16))
+			comp_store_tile(b->p, tile, od32, od16);
+	}
+}
+
+/*
+ * Decompresses num consecutive tiles of comp_tile_size(chipset) bytes each,
+ * tile i with tag tags[i] (or all tagged if tags is NULL), using up to jobs
+ * threads.  The result is identical to calling comp_decompress on each tile.
+ */
+void comp_decompress_tiles(int chipset, int format, uint8_t *data, const int *tags, int num, int jobs) {
+	struct comp_params p;
+	struct comp_bulk b;
+	comp_get_params(chipset, format, &p);
+	if (p.ftype == COMP_FORMAT_OFF || num <= 0)
+		return;
+	b.p = &p;
+	b.data = data;
+	b.tags = tags;
+	b.tsize = p.twidth * p.theight;
+	nvhw_run_chunks(num, COMP_BULK_CHUNK, jobs, comp_bulk_tiles, &b);
+}
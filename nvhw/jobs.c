@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "nvhw.h"
+#include <pthread.h>
+#include <stdlib.h>
+
+struct nvhw_chunks {
+	int num;
+	int chunk;
+	int next;
+	void (*fn) (void *arg, int start, int end);
+	void *arg;
+};
+
+static void *nvhw_chunks_worker(void *arg) {
+	struct nvhw_chunks *c = arg;
+	int start;
+	while ((start = __sync_fetch_and_add(&c->next, c->chunk)) < c->num)
+		c->fn(c->arg, start, start + c->chunk < c->num ? start + c->chunk : c->num);
+	return 0;
+}
+
+/*
+ * Calls fn on consecutive [start, end) ranges of at most chunk items covering
+ * [0, num), from up to jobs threads.  The calling thread always takes part,
+ * so this works even if no threads can be started.
+ */
+void nvhw_run_chunks(int num, int chunk, int jobs, void (*fn) (void *arg, int start, int end), void *arg) {
+	struct nvhw_chunks c = { num, chunk, 0, fn, arg };
+	pthread_t *threads;
+	int i;
+	if (jobs > (num + chunk - 1) / chunk)
+		jobs = (num + chunk - 1) / chunk;
+	if (jobs <= 1) {
+		nvhw_chunks_worker(&c);
+		return;
+	}
+	/* the calling thread is one of the jobs */
+	threads = calloc(jobs - 1, sizeof *threads);
+	for (i = 0; i < jobs - 1; i++)
+		if (pthread_create(&threads[i], 0, nvhw_chunks_worker, &c))
+			break;
+	nvhw_chunks_worker(&c);
+	jobs = i;
+	for (i = 0; i < jobs; i++)
+		pthread_join(threads[i], 0);
+	free(threads);
+}
@@ -0,0 +1,96 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Checks comp_decompress_tiles against comp_decompress on random tiles, for
+ * every compression type, every format and both tag states.
+ */
+
+#include "nvhw.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_TILES 2000
+
+int main() {
+	static const int chipsets[] = { 0x20, 0x25, 0x30, 0x35, 0x36, 0x40, 0x41, 0x47 };
+	int seen[COMP_FORMAT_Z24S8_SPLIT_GRAD + 1] = { 0 };
+	int ci, format, i, jobs;
+	int fails = 0;
+	srand(0x1234);
+	for (ci = 0; ci < sizeof chipsets / sizeof *chipsets; ci++) {
+		int chipset = chipsets[ci];
+		int tsize = comp_tile_size(chipset);
+		uint8_t *src = malloc(NUM_TILES * tsize);
+		uint8_t *ref = malloc(NUM_TILES * tsize);
+		uint8_t *res = malloc(NUM_TILES * tsize);
+		int *tags = malloc(NUM_TILES * sizeof *tags);
+		for (format = 0; format < 0x20; format++) {
+			int ftype = comp_format_type(chipset, format);
+			if (ftype == COMP_FORMAT_OFF)
+				continue;
+			seen[ftype] = 1;
+			for (i = 0; i < NUM_TILES * tsize; i++)
+				src[i] = rand();
+			/* make sure the const and mode bits get both values often */
+			for (i = 0; i < NUM_TILES; i++) {
+				tags[i] = rand() % 3 != 0;
+				if (rand() & 1)
+					src[i * tsize + 7] |= 0x80;
+				if (rand() & 1)
+					src[i * tsize + (tsize == 0x80 ? 0x1f : 0xf)] |= 0xc0;
+			}
+			memcpy(ref, src, NUM_TILES * tsize);
+			for (i = 0; i < NUM_TILES; i++)
+				comp_decompress(chipset, format, ref + i * tsize, tags[i]);
+			for (jobs = 1; jobs <= 4; jobs += 3) {
+				memcpy(res, src, NUM_TILES * tsize);
+				comp_decompress_tiles(chipset, format, res, tags, NUM_TILES, jobs);
+				for (i = 0; i < NUM_TILES; i++) {
+					if (memcmp(ref + i * tsize, res + i * tsize, tsize)) {
+						printf("Mismatch: chipset %02x format %02x tile %d tag %d jobs %d\n", chipset, format, i, tags[i], jobs);
+						fails++;
+						break;
+					}
+				}
+			}
+		}
+		free(src);
+		free(ref);
+		free(res);
+		free(tags);
+	}
+	for (i = COMP_FORMAT_FLAT; i <= COMP_FORMAT_Z24S8_SPLIT_GRAD; i++) {
+		if (!seen[i]) {
+			printf("Format type %d not covered\n", i);
+			fails++;
+		}
+	}
+	if (fails)
+		return 1;
+	printf("All ok\n");
+	return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Checks tile plans against tile_translate_addr on random surface
+ * configurations of every tiling PFB type: address, partition and tag
+ * translation, then whole buffer detiling and retiling.
+ */
+
+#include "nvhw.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NUM_CONFIGS 24
+#define NUM_ADDRS 20000
+#define BUF_SIZE 0x10000
+
+static uint32_t rand_pitch(int chipset) {
+	while (1) {
+		uint32_t pitch = (rand() % 0x100 + 1) << 8;
+		if (rand() & 1)
+			pitch &= -pitch << 2;	/* favour small factors */
+		if (tile_pitch_valid(chipset, pitch, 0, 0))
+			return pitch;
+	}
+}
+
+int main() {
+	static const int chipsets[] = { 0x10, 0x11, 0x17, 0x34, 0x20, 0x25, 0x30, 0x35, 0x40, 0x45, 0x41, 0x43, 0x47, 0x44, 0x4a, 0x4c, 0x4e };
+	int seen[PFB_NVC0 + 1] = { 0 };
+	uint8_t *tiled = malloc(BUF_SIZE);
+	uint8_t *linear = malloc(BUF_SIZE);
+	uint8_t *refdet = malloc(BUF_SIZE);
+	uint8_t *refret = malloc(BUF_SIZE);
+	uint8_t *res = malloc(BUF_SIZE);
+	int ci, cfg, i, jobs;
+	int fails = 0;
+	srand(0x1234);
+	for (ci = 0; ci < sizeof chipsets / sizeof *chipsets; ci++) {
+		int chipset = chipsets[ci];
+		seen[pfb_type(chipset)] = 1;
+		for (cfg = 0; cfg < NUM_CONFIGS; cfg++) {
+			struct mc_config mcc = { 0 };
+			mcc.mcbits = 2 + rand() % 2;
+			mcc.partbits = rand() % 3;
+			mcc.parts = 1 << mcc.partbits;
+			mcc.colbits = mcc.colbits_lo = 8 + rand() % 2;
+			mcc.burstbits = rand() % 3;
+			mcc.partshift = 7 + rand() % 2;
+			int mode = rand() % 2 ? 1 : 2;
+			int bankoff = rand() & ((1 << tile_bankoff_bits(chipset)) - 1);
+			uint32_t pitch = rand_pitch(chipset);
+			struct tile_plan *plan = tile_plan_new(chipset, pitch, mode, bankoff, &mcc);
+			if (!plan) {
+				printf("No plan: chipset %02x pitch %05x\n", chipset, pitch);
+				fails++;
+				continue;
+			}
+			for (i = 0; i < NUM_ADDRS; i++) {
+				/* the first few periods densely, then anywhere */
+				uint32_t addr = i < NUM_ADDRS / 2 ? i * 0x1c5 % (plan->period * 3) : (uint32_t)rand() << 8 ^ rand();
+				int part = 0, tag = 0, ppart, ptag;
+				uint32_t exp, got;
+				if (plan->has_tag)
+					exp = tile_translate_addr(chipset, pitch, addr, mode, bankoff, &mcc, &part, &tag);
+				else
+					exp = tile_translate_addr(chipset, pitch, addr, mode, bankoff, &mcc, 0, 0);
+				got = tile_plan_translate(plan, addr, &ppart, &ptag);
+				if (exp != got || part != ppart || tag != ptag) {
+					printf("Mismatch: chipset %02x pitch %05x mode %d bankoff %d mcbits %d partbits %d colbits %d addr %08x: %08x/%d/%d vs %08x/%d/%d\n",
+						chipset, pitch, mode, bankoff, mcc.mcbits, mcc.partbits, mcc.colbits_lo, addr, exp, part, tag, got, ppart, ptag);
+					fails++;
+					break;
+				}
+			}
+			/* an odd size, so the last line and unit are partial */
+			uint32_t size = BUF_SIZE - rand() % pitch - 7;
+			for (i = 0; i < BUF_SIZE; i++)
+				tiled[i] = rand(), linear[i] = rand();
+			memcpy(refdet, linear, BUF_SIZE);
+			memcpy(refret, tiled, BUF_SIZE);
+			for (i = 0; i < size; i++) {
+				uint32_t t = tile_translate_addr(chipset, pitch, i, mode, bankoff, &mcc, 0, 0);
+				if (t < size) {
+					refdet[i] = tiled[t];
+					refret[t] = linear[i];
+				}
+			}
+			for (jobs = 1; jobs <= 4; jobs += 3) {
+				memcpy(res, linear, BUF_SIZE);
+				tile_detile(plan, res, tiled, size, jobs);
+				if (memcmp(refdet, res, BUF_SIZE)) {
+					printf("Detile mismatch: chipset %02x pitch %05x size %05x jobs %d\n", chipset, pitch, size, jobs);
+					fails++;
+				}
+				memcpy(res, tiled, BUF_SIZE);
+				tile_retile(plan, res, linear, size, jobs);
+				if (memcmp(refret, res, BUF_SIZE)) {
+					printf("Retile mismatch: chipset %02x pitch %05x size %05x jobs %d\n", chipset, pitch, size, jobs);
+					fails++;
+				}
+			}
+			tile_plan_free(plan);
+		}
+	}
+	for (i = PFB_NV10; i <= PFB_NV44; i++) {
+		if (!seen[i]) {
+			printf("PFB type %d not covered\n", i);
+			fails++;
+		}
+	}
+	free(tiled);
+	free(linear);
+	free(refdet);
+	free(refret);
+	free(res);
+	if (fails)
+		return 1;
+	printf("All ok\n");
+	return 0;
+}
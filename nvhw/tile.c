@@ -24,6 +24,7 @@
 
 #include "nvhw.h"
 #include <stdlib.h>
+#include <string.h>
 
 int has_large_tile(int chipset) {
 	return pfb_type(chipset) == PFB_NV40 || pfb_type(chipset) == PFB_NV41;
@@ -101,13 +102,21 @@ int num_tile_regions(int chipset) {
 	return is_g7x(chipset) ? 15 : 12;
 }
 
-uint32_t tile_translate_addr(int chipset, uint32_t pitch, uint32_t address, int mode, int bankoff, const struct mc_config *mcc, int *ppart, int *ptag) {
-	int bankshift = mcc->mcbits + mcc->partbits + mcc->colbits_lo;
+/* log2 of the tile size: one 256-byte wide column of a tile row */
+static int tile_bankshift(int chipset, int mode, const struct mc_config *mcc) {
 	int is_vram = mode == 1 || mode == 4;
 	if (is_igp(chipset))
 		is_vram = 0;
 	if (!is_vram)
-		bankshift = 12;
+		return 12;
+	return mcc->mcbits + mcc->partbits + mcc->colbits_lo;
+}
+
+uint32_t tile_translate_addr(int chipset, uint32_t pitch, uint32_t address, int mode, int bankoff, const struct mc_config *mcc, int *ppart, int *ptag) {
+	int bankshift = tile_bankshift(chipset, mode, mcc);
+	int is_vram = mode == 1 || mode == 4;
+	if (is_igp(chipset))
+		is_vram = 0;
 	int shift, factor;
 	if (!tile_pitch_valid(chipset, pitch, &shift, &factor))
 		abort();
@@ -253,6 +262,141 @@ uint32_t tile_translate_addr(int chipset, uint32_t pitch, uint32_t address, int
 	return iaddr | baddr << bankshift;
 }
 
+/*
+ * A tile plan caches tile_translate_addr results for one surface
+ * configuration.  Translation keeps the low 4 address bits and is periodic
+ * in whole tile rows: moving down by a multiple of 4 tile rows leaves all
+ * bank, partition and intra-tile swizzling alone and just moves the result
+ * and the tag by a constant.  Partition swizzling on NV40 also looks at
+ * address bits up to 14, so the period is stretched until the move doesn't
+ * touch those.  The plan thus only stores one period of rows, at 16-byte
+ * granularity.
+ */
+struct tile_plan *tile_plan_new(int chipset, uint32_t pitch, int mode, int bankoff, const struct mc_config *mcc) {
+	int shift, factor;
+	if (pfb_type(chipset) < PFB_NV10 || pfb_type(chipset) > PFB_NV44)
+		return 0;
+	if (!tile_pitch_valid(chipset, pitch, &shift, &factor))
+		return 0;
+	struct tile_plan *plan = calloc(sizeof *plan, 1);
+	int bankshift = tile_bankshift(chipset, mode, mcc);
+	int tilerowsbits = 2;
+	while (bankshift + shift + tilerowsbits < 15)
+		tilerowsbits++;
+	uint32_t tilerows = 1 << tilerowsbits;
+	plan->pitch = pitch;
+	plan->units = pitch >> 4;
+	plan->rows = tilerows << (bankshift - 8);
+	plan->period = pitch * plan->rows;
+	plan->has_tag = pfb_type(chipset) == PFB_NV20 || pfb_type(chipset) == PFB_NV40 || pfb_type(chipset) == PFB_NV41;
+	plan->addr = malloc(plan->rows * plan->units * sizeof *plan->addr);
+	if (plan->has_tag) {
+		plan->part = malloc(plan->rows * plan->units * sizeof *plan->part);
+		plan->tag = malloc(plan->rows * plan->units * sizeof *plan->tag);
+	}
+	uint32_t i;
+	for (i = 0; i < plan->rows * plan->units; i++) {
+		if (plan->has_tag) {
+			int part, tag;
+			plan->addr[i] = tile_translate_addr(chipset, pitch, i << 4, mode, bankoff, mcc, &part, &tag);
+			plan->part[i] = part;
+			plan->tag[i] = tag;
+		} else {
+			plan->addr[i] = tile_translate_addr(chipset, pitch, i << 4, mode, bankoff, mcc, 0, 0);
+		}
+	}
+	/* one period down moves the bank address by this many tiles */
+	plan->period_addr = tilerows * (pitch >> 8) << bankshift;
+	if (plan->has_tag) {
+		int tag;
+		tile_translate_addr(chipset, pitch, plan->period, mode, bankoff, mcc, 0, &tag);
+		plan->period_tag = tag - plan->tag[0];
+	}
+	return plan;
+}
+
+void tile_plan_free(struct tile_plan *plan) {
+	if (!plan)
+		return;
+	free(plan->addr);
+	free(plan->part);
+	free(plan->tag);
+	free(plan);
+}
+
+uint32_t tile_plan_translate(const struct tile_plan *plan, uint32_t address, int *ppart, int *ptag) {
+	uint32_t k = address / plan->period;
+	uint32_t i = address % plan->period >> 4;
+	if (ppart)
+		*ppart = plan->has_tag ? plan->part[i] : 0;
+	if (ptag)
+		*ptag = plan->has_tag ? plan->tag[i] + k * plan->period_tag : 0;
+	return (plan->addr[i] + k * plan->period_addr) | (address & 0xf);
+}
+
+struct tile_bulk {
+	const struct tile_plan *plan;
+	uint8_t *linear;
+	uint8_t *tiled;
+	uint32_t size;
+	int retile;
+};
+
+#define TILE_BULK_LINES 16
+
+static void tile_bulk_line(struct tile_bulk *b, uint32_t line) {
+	const struct tile_plan *plan = b->plan;
+	uint32_t start = line * plan->pitch;
+	uint32_t end = start + plan->pitch;
+	uint32_t base = start / plan->period * plan->period_addr;
+	const uint32_t *tab = plan->addr + (start % plan->period >> 4);
+	uint32_t a, u;
+	if (end > b->size)
+		end = b->size;
+	for (a = start, u = 0; a < end; a += 16, u++) {
+		uint32_t t = tab[u] + base;
+		uint32_t len = end - a < 16 ? end - a : 16;
+		if (t >= b->size)
+			continue;
+		if (b->size - t < len)
+			len = b->size - t;
+		if (b->retile)
+			memcpy(b->tiled + t, b->linear + a, len);
+		else
+			memcpy(b->linear + a, b->tiled + t, len);
+	}
+}
+
+static void tile_bulk_lines(void *arg, int start, int end) {
+	struct tile_bulk *b = arg;
+	int i;
+	for (i = start; i < end; i++)
+		tile_bulk_line(b, i);
+}
+
+static void tile_bulk_run(const struct tile_plan *plan, uint8_t *linear, uint8_t *tiled, uint32_t size, int retile, int jobs) {
+	struct tile_bulk b;
+	b.plan = plan;
+	b.linear = linear;
+	b.tiled = tiled;
+	b.size = size;
+	b.retile = retile;
+	nvhw_run_chunks((size + plan->pitch - 1) / plan->pitch, TILE_BULK_LINES, jobs, tile_bulk_lines, &b);
+}
+
+/*
+ * Converts size bytes of a tiled surface to linear layout and back, using up
+ * to jobs threads.  Both buffers are size bytes long, bytes that translate
+ * to outside of the tiled buffer are left alone.
+ */
+void tile_detile(const struct tile_plan *plan, uint8_t *linear, const uint8_t *tiled, uint32_t size, int jobs) {
+	tile_bulk_run(plan, linear, (uint8_t *)tiled, size, 0, jobs);
+}
+
+void tile_retile(const struct tile_plan *plan, uint8_t *tiled, const uint8_t *linear, uint32_t size, int jobs) {
+	tile_bulk_run(plan, (uint8_t *)linear, tiled, size, 1, jobs);
+}
+
 uint32_t tile_mmio_region(int chipset) {
 	switch (pfb_type(chipset)) {
 		case PFB_NV10:
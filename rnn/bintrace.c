@@ -0,0 +1,207 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#include "bintrace.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define TEXTSIZE(len) (((len) + 8) & ~7)
+
+int bintrace_open(struct bintrace *bt, const char *path) {
+	struct bintrace_header hdr;
+	struct stat st;
+	int fd = open(path, O_RDONLY);
+	if (fd == -1)
+		return 1;	/* let the text path complain */
+	if (read(fd, &hdr, sizeof hdr) != sizeof hdr || memcmp(hdr.magic, BINTRACE_MAGIC, sizeof hdr.magic)) {
+		close(fd);
+		return 1;
+	}
+	if (hdr.version != BINTRACE_VERSION) {
+		fprintf(stderr, "%s: unsupported binary trace version %d\n", path, hdr.version);
+		close(fd);
+		return -1;
+	}
+	if (fstat(fd, &st)) {
+		perror(path);
+		close(fd);
+		return -1;
+	}
+	bt->data = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (bt->data == MAP_FAILED) {
+		perror(path);
+		return -1;
+	}
+	madvise((void *)bt->data, st.st_size, MADV_SEQUENTIAL);
+	bt->size = st.st_size;
+	bt->pos = sizeof hdr;
+	bt->kind = hdr.kind;
+	return 0;
+}
+
+void bintrace_close(struct bintrace *bt) {
+	munmap((void *)bt->data, bt->size);
+	bt->data = 0;
+}
+
+const struct bintrace_rec *bintrace_next(struct bintrace *bt, const char **text) {
+	const struct bintrace_rec *rec = (const void *)(bt->data + bt->pos);
+	size_t len;
+	if (bt->pos == bt->size)
+		return 0;
+	len = sizeof *rec;
+	if (bt->size - bt->pos >= len && rec->textlen)
+		len += TEXTSIZE(rec->textlen);
+	if (bt->size - bt->pos < len) {
+		fprintf(stderr, "binary trace truncated at offset %zu, ignoring the last %zu bytes\n", bt->pos, bt->size - bt->pos);
+		bt->pos = bt->size;
+		return 0;
+	}
+	if (text)
+		*text = rec->textlen ? (const char *)(rec + 1) : "";
+	bt->pos += len;
+	return rec;
+}
+
+static int hexval(char c) {
+	return (c >= '0' && c <= '9' ? c - '0' :
+		c >= 'a' && c <= 'f' ? c - 'a' + 10 :
+		c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1);
+}
+
+int bintrace_scan_hex(const char **pp, uint32_t *val) {
+	const char *p = *pp;
+	uint32_t x = 0;
+	while (*p == ' ' || *p == '\t')
+		p++;
+	if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && hexval(p[2]) >= 0)
+		p += 2;
+	if (hexval(*p) < 0)
+		return 0;
+	for (; hexval(*p) >= 0; p++)
+		x = x << 4 | hexval(*p);
+	*val = x;
+	*pp = p;
+	return 1;
+}
+
+int bintrace_scan_dec(const char **pp, uint32_t *val) {
+	const char *p = *pp;
+	uint32_t x = 0;
+	while (*p == ' ' || *p == '\t')
+		p++;
+	if (*p < '0' || *p > '9')
+		return 0;
+	for (; *p >= '0' && *p <= '9'; p++)
+		x = x * 10 + (*p - '0');
+	*val = x;
+	*pp = p;
+	return 1;
+}
+
+int bintrace_scan_str(const char **pp, const char *str) {
+	size_t n = strlen(str);
+	if (strncmp(*pp, str, n))
+		return 0;
+	*pp += n;
+	return 1;
+}
+
+/*
+ * valgrind-mmt lines look like "--pid-- w map:addr, val[,val...]" or
+ * "--pid-- create gpu object 0xparent:0xhandle type 0xclass".  A write of
+ * several words lists them last word first.
+ */
+int bintrace_parse_mmt(const char *p, struct bintrace_mmt *res) {
+	uint32_t x, *val = res->val;
+	int k;
+	if (p[0] != '-' || p[1] != '-')
+		return 0;
+	for (p += 2; *p >= '0' && *p <= '9'; p++)
+		;
+	if (!bintrace_scan_str(&p, "-- "))
+		return 0;
+
+	if (p[0] == 'w' && p[1] == ' ') {
+		p += 2;
+		if (!bintrace_scan_dec(&p, &res->map) || *p++ != ':' ||
+				!bintrace_scan_hex(&p, &res->addr) || *p++ != ',')
+			return 0;
+		for (k = 0; k < 4 && bintrace_scan_hex(&p, &val[k]); ) {
+			k++;
+			if (*p++ != ',')
+				break;
+		}
+		if (k == 2) {
+			/* reorder words (2,1) => (1,2) */
+			x = val[0];
+			val[0] = val[1];
+			val[1] = x;
+		} else if (k == 4) {
+			/* reorder words (4,3,2,1) => (1,2,3,4) */
+			x = val[0];
+			val[0] = val[3];
+			val[3] = x;
+			x = val[1];
+			val[1] = val[2];
+			val[2] = x;
+		}
+		res->type = BINTRACE_WRITE;
+		res->valsnum = k;
+		return 1;
+	}
+
+	if (bintrace_scan_str(&p, "create gpu object ") && bintrace_scan_hex(&p, &x) && *p++ == ':' &&
+			bintrace_scan_hex(&p, &res->addr) && bintrace_scan_str(&p, " type ") &&
+			bintrace_scan_hex(&p, &val[0])) {
+		res->type = BINTRACE_OBJECT;
+		res->valsnum = 1;
+		return 1;
+	}
+	return 0;
+}
+
+int bintrace_write_header(FILE *f, int kind) {
+	struct bintrace_header hdr = { BINTRACE_MAGIC, BINTRACE_VERSION, kind };
+	return fwrite(&hdr, sizeof hdr, 1, f) == 1 ? 0 : -1;
+}
+
+int bintrace_write(FILE *f, const struct bintrace_rec *rec, const char *text) {
+	static const char zero[8];
+	if (fwrite(rec, sizeof *rec, 1, f) != 1)
+		return -1;
+	if (!rec->textlen)
+		return 0;
+	if (fwrite(text, rec->textlen, 1, f) != 1)
+		return -1;
+	if (fwrite(zero, TEXTSIZE(rec->textlen) - rec->textlen, 1, f) != 1)
+		return -1;
+	return 0;
+}
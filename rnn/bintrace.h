@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+#ifndef BINTRACE_H
+#define BINTRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * Binary form of the traces read by demmio, dedma and demsm, written by
+ * trace2bin.  A header is followed by fixed size records in host byte
+ * order, every record may carry some text, NUL padded to 8 bytes.
+ */
+
+#define BINTRACE_MAGIC "ENVYTRC"
+#define BINTRACE_VERSION 1
+
+enum bintrace_kind {
+	BINTRACE_MMIOTRACE = 1,
+	BINTRACE_MMT,		/* valgrind-mmt */
+	BINTRACE_MSM,		/* msm dmesg or debugfs log */
+};
+
+enum bintrace_type {
+	BINTRACE_READ,
+	BINTRACE_WRITE,
+	BINTRACE_TEXT,		/* line printed as is, text holds it */
+	BINTRACE_PCIDEV,	/* mmiotrace PCIDEV line, text holds it */
+	BINTRACE_REGION,	/* msm register region line, text holds it */
+	BINTRACE_OBJECT,	/* mmt object creation, addr is the handle,
+				 * value the class */
+};
+
+struct bintrace_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t kind;
+};
+
+struct bintrace_rec {
+	uint8_t type;
+	uint8_t width;		/* in bytes */
+	uint16_t textlen;	/* without the padding */
+	uint32_t map;
+	uint64_t time;		/* in ns */
+	uint64_t addr;
+	uint64_t value;
+};
+
+struct bintrace {
+	const uint8_t *data;
+	size_t size;
+	size_t pos;
+	int kind;
+};
+
+/* 0 if path is a binary trace, 1 if it isn't or can't be opened, -1 if
+ * it's a binary trace we can't read (the reason gets printed) */
+int bintrace_open(struct bintrace *bt, const char *path);
+void bintrace_close(struct bintrace *bt);
+
+/* next record, and its text if text is non-NULL; NULL at the end */
+const struct bintrace_rec *bintrace_next(struct bintrace *bt, const char **text);
+
+/*
+ * Tokenizer for the text traces, shared by the text parsers and trace2bin so
+ * that a converted trace decodes exactly like the original.  The scan
+ * functions return 0 without touching *pp if nothing matched; the numbers
+ * match what %x and %u would, leading blanks included.
+ */
+int bintrace_scan_hex(const char **pp, uint32_t *val);
+int bintrace_scan_dec(const char **pp, uint32_t *val);
+int bintrace_scan_str(const char **pp, const char *str);
+
+/* a valgrind-mmt write or object creation line */
+struct bintrace_mmt {
+	int type;		/* BINTRACE_WRITE or BINTRACE_OBJECT */
+	uint32_t map;
+	uint32_t addr;		/* or the object handle */
+	uint32_t val[4];	/* in address order; or val[0] the object class */
+	int valsnum;
+};
+
+/* 0 if line is neither a write nor an object creation */
+int bintrace_parse_mmt(const char *line, struct bintrace_mmt *res);
+
+int bintrace_write_header(FILE *f, int kind);
+int bintrace_write(FILE *f, const struct bintrace_rec *rec, const char *text);
+
+#endif
@@ -24,63 +24,138 @@
 
 #include "dedma.h"
 #include "util.h"
+#include <limits.h>
 
-void
-add_object(struct state *s, uint32_t handle, uint32_t class)
+static struct objctx *
+get_objctx(struct state *s, uint32_t class)
 {
 	struct rnnenum *chs = rnn_findenum(s->db, "chipset");
 	struct rnnenum *cls = rnn_findenum(s->db, "obj-class");
+	struct rnndeccontext *ctx;
 	struct rnnvalue *v;
-	struct obj *obj;
+	struct objctx oc;
 	int i;
 
+	for (i = 0; i < s->ctxsnum; i++) {
+		if (s->ctxs[i].chipset == s->chipset &&
+		    s->ctxs[i].class == class)
+			return &s->ctxs[i];
+	}
+
 	if (!cls || !chs) {
 		fprintf(stderr, "No obj-class/chipset enum found\n");
 		abort();
 	}
 
-	for (i = 0; obj = &s->objects[i], i < MAX_OBJECTS; i++) {
-		if (!obj->handle) {
-			obj->handle = handle;
-			obj->class = class;
-			obj->ctx = rnndec_newcontext(s->db);
-			obj->ctx->colors = s->colors;
+	ctx = rnndec_newcontext(s->db);
+	ctx->colors = s->colors;
 
-			v = NULL;
-			FINDARRAY(chs->vals, v, v->value == s->chipset);
-			rnndec_varadd(obj->ctx, "chipset",
-				      v ? v->name : "NV01");
+	v = rnn_findvalue(chs, s->chipset);
+	rnndec_varadd(ctx, "chipset", v ? v->name : "NV01");
 
-			v = NULL;
-			FINDARRAY(cls->vals, v, v->value == class);
-			obj->name = v ? v->name : NULL;
-			rnndec_varadd(obj->ctx, "obj-class",
-				      v ? v->name : "NV01_NULL");
+	v = rnn_findvalue(cls, class);
+	oc.name = v ? v->name : NULL;
+	rnndec_varadd(ctx, "obj-class", v ? v->name : "NV01_NULL");
 
-			return;
-		}
+	oc.chipset = s->chipset;
+	oc.class = class;
+	oc.ctx = rnndec_specialize(ctx);
+	rnndec_freecontext(ctx);
+	ADDARRAY(s->ctxs, oc);
+	return &s->ctxs[s->ctxsnum - 1];
+}
+
+static int
+objhash_slot(struct state *s, uint32_t handle)
+{
+	int mask = s->objhashsize - 1;
+	int i = (handle * 0x9e3779b1u) >> (32 - __builtin_ctz(s->objhashsize));
+
+	while (s->objhash[i] && s->objhash[i]->handle != handle) {
+		i = (i + 1) & mask;
+		s->objstats.probes++;
 	}
 
-	fprintf(stderr, "Too many objects\n");
+	return i;
 }
 
-struct obj *
-get_object(struct state *s, uint32_t handle)
+static void
+objhash_grow(struct state *s)
+{
+	struct obj **old = s->objhash;
+	int oldsize = s->objhashsize;
+	int i;
+
+	s->objhashsize = oldsize ? oldsize * 2 : 64;
+	s->objhash = calloc(s->objhashsize, sizeof *s->objhash);
+
+	for (i = 0; i < oldsize; i++) {
+		if (old[i])
+			s->objhash[objhash_slot(s, old[i]->handle)] = old[i];
+	}
+
+	free(old);
+}
+
+void
+add_object(struct state *s, uint32_t handle, uint32_t class)
 {
-	struct obj *objs = s->objects;
+	struct objctx *oc = get_objctx(s, class);
+	struct obj *obj;
 	int i;
 
-	for (i = 0; i < MAX_OBJECTS; i++) {
-		if (objs[i].handle == handle)
-			return &objs[i];
+	if (2 * (s->nobjects + 1) > s->objhashsize)
+		objhash_grow(s);
+
+	i = objhash_slot(s, handle);
+	obj = s->objhash[i];
+	if (obj) {
+		/* the handle got reused, subchannels bound to it follow */
+		s->objstats.replaced++;
+	} else {
+		obj = s->objhash[i] = calloc(1, sizeof *obj);
+		obj->handle = handle;
+		s->nobjects++;
 	}
 
-	if (s->chipset >= 0xc0) {
+	obj->class = class;
+	obj->ctx = oc->ctx;
+	obj->name = oc->name;
+}
+
+struct obj *
+get_object(struct state *s, uint32_t handle)
+{
+	struct obj *obj = NULL;
+
+	s->objstats.lookups++;
+	if (s->objhashsize)
+		obj = s->objhash[objhash_slot(s, handle)];
+
+	if (!obj && s->chipset >= 0xc0) {
+		s->objstats.implicit++;
 		add_object(s, handle, handle & 0xffff);
 		return get_object(s, handle);
 	}
 
-	return NULL;
+	return obj;
+}
+
+static void
+print_stats(struct state *s)
+{
+	struct cache *c = &s->cache;
+
+	fprintf(stderr, "objects: %d (%d handles reused, %d implicit),"
+		" %d decode contexts\n", s->nobjects, s->objstats.replaced,
+		s->objstats.implicit, s->ctxsnum);
+	fprintf(stderr, "object table: %d slots, %lu lookups,"
+		" %.2f extra probes per lookup\n", s->objhashsize,
+		s->objstats.lookups, s->objstats.lookups ?
+		(double)s->objstats.probes / s->objstats.lookups : 0.0);
+	fprintf(stderr, "reordering window: %d entries, %lu reordered,"
+		" %lu merged, %lu too late\n", c->window, c->stats.reorders,
+		c->stats.merges, c->stats.late);
 }
 
 static void
@@ -110,49 +185,37 @@ pretty_header(struct state *s, struct ent *e)
 static void
 pretty_method(struct state *s, struct ent *e, uint32_t x)
 {
-	struct rnndecaddrinfo *ai;
+	struct rnndecaddrinfo ai;
 	const struct envy_colors *col = s->colors;
 	struct dma *dma = &s->dma;
 	struct obj *obj = s->subchan[dma->subchan];
-	char *dec_obj = NULL;
-	char *dec_addr = NULL;
-	char *dec_val = NULL;
+	struct rnndecbuf *buf = &s->decbuf;
 
-	/* get an object name */
+	/* write the object name */
 	if (obj && obj->name)
-		asprintf(&dec_obj, "%s%s%s", col->rname,
-			 obj->name, col->reset);
+		s->op.print("%08x    %s%s%s", e->val, col->rname,
+			    obj->name, col->reset);
 	else
-		asprintf(&dec_obj, "%sOBJ%X%s", col->err,
-			 (obj ? obj->class : 0), col->reset);
+		s->op.print("%08x    %sOBJ%X%s", e->val, col->err,
+			    (obj ? obj->class : 0), col->reset);
+
+	if (dma->addr == 0) {
+		s->op.print(" mapped to subchannel %d\n", dma->subchan);
+		return;
+	}
 
 	/* get the method name and value */
+	rnndec_bufclear(buf);
 	if (obj) {
-		ai = rnndec_decodeaddr(obj->ctx, s->dom, dma->addr, true);
-
-		dec_addr = ai->name;
-		dec_val = rnndec_decodeval(obj->ctx, ai->typeinfo, x,
-					   ai->width);
-
-		free(ai);
+		rnndec_appendaddr(obj->ctx, buf, s->dom, dma->addr, true, &ai);
+		rnndec_bufprintf(buf, " = ");
+		rnndec_appendval(obj->ctx, buf, ai.typeinfo, x, ai.width);
 	} else {
-		asprintf(&dec_addr, "%s0x%x%s", col->err, dma->addr,
-			 col->reset);
+		rnndec_bufprintf(buf, "%s0x%x%s", col->err, dma->addr,
+				 col->reset);
 	}
 
-	/* write it */
-	s->op.print("%08x    %s", e->val, dec_obj);
-
-	if (dma->addr == 0)
-		s->op.print(" mapped to subchannel %d\n", dma->subchan);
-	else if (dec_val)
-		s->op.print(".%s = %s\n", dec_addr, dec_val);
-	else
-		s->op.print(".%s\n", dec_addr);
-
-	free(dec_val);
-	free(dec_addr);
-	free(dec_obj);
+	s->op.print(".%s\n", buf->str);
 }
 
 static void
@@ -237,79 +300,53 @@ int
 dedma(struct state *s, FILE *f, bool dry_run)
 {
 	struct filter *flt = &s->filter;
-	struct ent *e0 = NULL, *e1;
-	int i, j; /* dump line numbers */
+	struct ent *e0, *e1;
+	uint32_t addr;
+	int j;
 
 	s->f = f;
 	s->op.print = (dry_run ? dont_printf : printf);
+	s->parse.pos = s->parse.len = 0;
+	s->parse.eof = false;
 
-	for (i = 0; e1 = e0, e0 = get_ent(s, i); i++) {
-		if (!e1)
-			continue;
+	while ((e0 = get_ent(s, 0))) {
+		addr = e0->addr;
+		e1 = last_ent(s);
 
-		if (e0->addr < flt->addr0 || e0->addr >= flt->addr1) {
+		if (e0->out_of_band) {
+			/* already caught by the lookahead below */
+
+		} else if (addr < flt->addr0 || addr >= flt->addr1) {
 			/* out of band data */
 			e0->out_of_band = true;
 
-		} else if (abs(e0->addr - e1->addr) > MAX_DELTA &&
-			   !e1->out_of_band) {
+		} else if (e1 && abs(addr - e1->addr) > MAX_DELTA) {
 			/* wrap around or out of band data not caught by
 			 * the address window */
 
-			for (j = i + 1; (j < i + MAX_OUT_OF_BAND &&
-					 (e1 = get_ent(s, j))); j++) {
-				if (abs(e0->addr - e1->addr) > MAX_DELTA) {
-					for (; i < j; i++)
-						get_ent(s, i)->out_of_band = true;
-
+			for (j = 1; (j < MAX_OUT_OF_BAND &&
+				     (e1 = get_ent(s, j))); j++) {
+				if (abs(addr - e1->addr) > MAX_DELTA) {
 					/* shrink the address window */
-					if (e1->addr > e0->addr)
-						flt->addr0 = max(e0->addr + 4,
+					if (e1->addr > addr)
+						flt->addr0 = max(addr + 4,
 								 flt->addr0);
-					else if (e1->addr < e0->addr)
-						flt->addr1 = min(e0->addr,
+					else if (e1->addr < addr)
+						flt->addr1 = min(addr,
 								 flt->addr1);
-					break;
-				}
-			}
-
-		} else if (e0->addr < e1->addr + 4) {
-			/* badly ordered write, find a place for it */
-
-			for (j = i - 1; (j > i - MAX_DELTA &&
-					 (e1 = get_ent(s, j))); j--) {
-				if (e0->addr == e1->addr) {
-					/* duplicated write, keep the
-					 * most recent one */
-					*e1 = *e0;
-					drop_ent(s, i--);
-					break;
-
-				} else if (e0->addr == e1->addr + 3) {
-					/* 8bit writes */
-					e1->val |= e0->val << 24;
-					drop_ent(s, i--);
-					break;
 
-				} else if (e0->addr == e1->addr + 2) {
-					/* 16bit writes */
-					e1->val |= e0->val << 16;
-					drop_ent(s, i--);
-					break;
-
-				} else if (e0->addr == e1->addr + 1) {
-					/* 8bit writes */
-					e1->val |= e0->val << 8;
-					drop_ent(s, i--);
-					break;
-
-				} else if (e0->addr > e1->addr) {
-					/* unordered write */
-					rotate_ent(s, j + 1, i);
+					while (j--)
+						get_ent(s, j)->out_of_band = true;
 					break;
 				}
 			}
+
+			if (!get_ent(s, 0)->out_of_band)
+				new_run(s);
 		}
+
+		/* badly ordered and partial writes get sorted out here */
+		order_ent(s);
 	}
 
 	flush_cache(s);
@@ -318,10 +355,17 @@ dedma(struct state *s, FILE *f, bool dry_run)
 
 static bool
 configure(struct state *s, int argc, char *argv[], char **path,
-	  struct obj obj[MAX_OBJECTS], int *nobj)
+	  struct obj **pobj, int *nobj)
 {
+	struct obj *obj = *pobj;
+	int objnum = *nobj, objmax = objnum;
+	struct obj o = { };
+	char *end;
+	long val;
 	int i;
 
+	s->cache.window = DEF_WINDOW;
+
 	for (i = 1; i < argc; i++) {
 		if (!strcmp(argv[i], "-x")) {
 			s->op.flush = flush_raw;
@@ -339,12 +383,26 @@ configure(struct state *s, int argc, char *argv[], char **path,
 				s->chipset = strtoul(argv[i], NULL, 16);
 
 		} else if (!strcmp(argv[i], "-o")) {
-			if (i + 2 >= argc || *nobj == MAX_OBJECTS)
+			if (i + 2 >= argc)
 				goto fail;
 
-			obj[*nobj].handle = strtoul(argv[++i], NULL, 16);
-			obj[*nobj].class = strtoul(argv[++i], NULL, 16);
-			(*nobj)++;
+			o.handle = strtoul(argv[++i], NULL, 16);
+			o.class = strtoul(argv[++i], NULL, 16);
+			ADDARRAY(obj, o);
+			*pobj = obj;
+			*nobj = objnum;
+
+		} else if (!strcmp(argv[i], "-w")) {
+			if (i + 1 >= argc)
+				goto fail;
+
+			val = strtol(argv[++i], &end, 0);
+			if (*end || end == argv[i] || val < 0 || val > INT_MAX)
+				goto fail;
+			s->cache.window = val;
+
+		} else if (!strcmp(argv[i], "-s")) {
+			s->objstats.print = true;
 
 		} else if (!strcmp(argv[i], "-r")) {
 			if (i + 1 >= argc)
@@ -377,15 +435,21 @@ configure(struct state *s, int argc, char *argv[], char **path,
 	return true;
 fail:
 	fprintf(stderr, "usage: %s [ -x ] [ -c ] [ -m 'chipset' ]"
-		" [ -o 'handle' 'class' ] [ -r 'file' ] [ -v 'map' 'file' ]\n"
+		" [ -o 'handle' 'class' ] [ -w 'entries' ] [ -s ]\n"
+		"\t[ -r 'file' ] [ -v 'map' 'file' ]\n"
 		"\t-x\tHexadecimal output mode.\n"
 		"\t-c\tClassy output mode.\n"
 		"\t-m\tForce chipset version.\n"
 		"\t-o\tForce handle to class mapping"
 		" (repeat for multiple mappings).\n"
+		"\t-w\tReordering window size, in entries, 0 disables"
+		" reordering (default %d).\n"
+		"\t-s\tPrint object table and reordering statistics"
+		" at exit.\n"
 		"\t-r\tParse a renouveau trace.\n"
-		"\t-v\tParse a valgrind-mmt trace.\n",
-		argv[0]);
+		"\t-v\tParse a valgrind-mmt trace, or one converted"
+		" by trace2bin.\n",
+		argv[0], DEF_WINDOW);
 	return false;
 }
 
@@ -393,14 +457,14 @@ int
 main(int argc, char *argv[])
 {
 	struct state s = { };
-	struct obj obj[MAX_OBJECTS];
+	struct obj *obj = NULL;
 	int nobj = 0;
 	char *path = NULL;
 	FILE *f;
 	int i;
 
 	/* parse the command line */
-	if (!configure(&s, argc, argv, &path, obj, &nobj))
+	if (!configure(&s, argc, argv, &path, &obj, &nobj))
 		return EINVAL;
 
 	/* open the input */
@@ -410,6 +474,20 @@ main(int argc, char *argv[])
 		return errno;
 	}
 
+	/* valgrind traces may come already converted by trace2bin */
+	if (s.op.parse == parse_valgrind) {
+		int ret = bintrace_open(&s.parse.bin, path);
+
+		if (ret < 0)
+			return EINVAL;
+		if (!ret && s.parse.bin.kind != BINTRACE_MMT) {
+			fprintf(stderr, "%s: not a valgrind-mmt trace\n", path);
+			return EINVAL;
+		}
+		if (!ret)
+			s.op.parse = parse_bintrace;
+	}
+
 	/* set up an rnn context */
 	rnn_init();
 	s.db = rnn_newdb();
@@ -420,6 +498,7 @@ main(int argc, char *argv[])
 	/* insert objects specified in the command line */
 	for (i = 0; i < nobj; i++)
 		add_object(&s, obj[i].handle, obj[i].class);
+	free(obj);
 
 	if (s.op.parse == parse_renouveau) {
 		path = dirname(path);
@@ -431,9 +510,22 @@ main(int argc, char *argv[])
 	/* do it */
 	dedma(&s, f, false);
 
+	if (s.objstats.print)
+		print_stats(&s);
+
 	/* clean up */
 	fclose(f);
+	if (s.op.parse == parse_bintrace)
+		bintrace_close(&s.parse.bin);
 	free(s.parse.buf);
+	free(s.parse.data);
+	for (i = 0; i < s.objhashsize; i++)
+		free(s.objhash[i]);
+	free(s.objhash);
+	for (i = 0; i < s.ctxsnum; i++)
+		rnndec_freecontext(s.ctxs[i].ctx);
+	free(s.ctxs);
+	rnndec_buffree(&s.decbuf);
 
 	return 0;
 }
@@ -38,12 +38,15 @@
 
 #include "rnn.h"
 #include "rnndec.h"
+#include "bintrace.h"
 
-#define MAX_DELTA 16384 /* size of the reordering window */
+#define MAX_DELTA 16384 /* largest address jump within a run of writes */
 #define MAX_OUT_OF_BAND 8 /* maximum consecutive out of band data entries */
-#define MAX_CACHE 4096 /* dump cache size */
-#define MAX_OBJECTS 256 /* object cache size */
+#define DEF_WINDOW 16384 /* default reordering window, in entries */
+#define MAX_LEVEL 20 /* skiplist levels, plenty for any sane window */
 #define MAX_SUBCHAN 8
+#define PARSE_CHUNK (1 << 18) /* trace read size */
+#define PARSE_BATCH 256 /* entries handed to add_ents() at once */
 
 struct ent {
 	uint32_t addr;
@@ -58,15 +61,55 @@ struct obj {
 	struct rnndeccontext *ctx;
 };
 
+/* decode context shared by all objects of a class */
+struct objctx {
+	uint32_t chipset;
+	uint32_t class;
+	char *name;
+	struct rnndeccontext *ctx;
+};
+
 struct filter {
 	int map;
 	uint32_t addr0, addr1; /* address range we care about */
 };
 
+/* entry held back in the reordering window */
+struct node {
+	struct ent e;
+	int run;
+	struct node *oob, *oobtail; /* out of band entries that followed it */
+	struct node *next[];
+};
+
 struct cache {
-	int i0, i1; /* cached index range */
-	int k; /* offset the cache starts in */
-	struct ent ent[MAX_CACHE];
+	int window; /* entries held back before they get flushed */
+	int num; /* entries held back right now, out of band included */
+
+	/* skiplist ordered by (run, address), a run ends at every jump
+	 * too large to be a reordered write */
+	struct node *head;
+	struct node *tail[MAX_LEVEL]; /* last node on every level */
+	int level;
+	int run;
+	uint32_t seed;
+
+	/* key of the last flushed entry, anything below it came too late */
+	bool flushed;
+	int flushed_run;
+	uint32_t flushed_addr;
+
+	/* parsed entries not yet put in order, a power of two ring */
+	struct {
+		struct ent *ent;
+		int first, num, max;
+	} in;
+
+	struct {
+		unsigned long reorders;
+		unsigned long merges;
+		unsigned long late;
+	} stats;
 };
 
 struct dma {
@@ -100,11 +143,35 @@ struct state {
 		char *buf;
 		size_t n;
 		uint32_t addr;
+
+		/* buffered trace input, see read_line() */
+		char *data;
+		size_t pos, len, max;
+		bool eof;
+
+		/* mmapped binary trace, see parse_bintrace() */
+		struct bintrace bin;
 	} parse;
 
-	struct obj objects[MAX_OBJECTS];
+	/* handle -> object, open addressing, never more than half full */
+	struct obj **objhash;
+	int objhashsize;
+	int nobjects;
+	struct {
+		bool print;
+		unsigned long lookups;
+		unsigned long probes;
+		int replaced;
+		int implicit;
+	} objstats;
+	struct objctx *ctxs;
+	int ctxsnum;
+	int ctxsmax;
 	struct obj *subchan[MAX_SUBCHAN];
 	struct dma dma;
+
+	/* scratch space for decoded method names and values */
+	struct rnndecbuf decbuf;
 };
 
 /* dedma.c */
@@ -121,14 +188,20 @@ dedma(struct state *s, FILE *f, bool dry_run);
 struct ent *
 get_ent(struct state *s, int i);
 
-void
-rotate_ent(struct state *s, int i, int j);
+struct ent *
+last_ent(struct state *s);
 
 void
 add_ent(struct state *s, struct ent *e);
 
 void
-drop_ent(struct state *s, int i);
+add_ents(struct state *s, struct ent *e, int n);
+
+void
+order_ent(struct state *s);
+
+void
+new_run(struct state *s);
 
 void
 flush_cache(struct state *s);
@@ -149,4 +222,7 @@ parse_renouveau(struct state *s);
 bool
 parse_valgrind(struct state *s);
 
+bool
+parse_bintrace(struct state *s);
+
 #endif
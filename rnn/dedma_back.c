@@ -103,71 +103,122 @@ out:
 	free(buf);
 }
 
+/* next line of the trace without its newline, or NULL at the end */
+static char *
+read_line(struct state *s)
+{
+	char *data, *nl, *line;
+	size_t scanned = s->parse.pos, n;
+
+	for (;;) {
+		data = s->parse.data;
+		nl = memchr(data + scanned, '\n', s->parse.len - scanned);
+		if (nl) {
+			*nl = 0;
+			line = data + s->parse.pos;
+			s->parse.pos = nl - data + 1;
+			return line;
+		}
+
+		if (s->parse.eof) {
+			if (s->parse.pos == s->parse.len)
+				return NULL;
+
+			/* last line lacks a newline */
+			data[s->parse.len] = 0;
+			line = data + s->parse.pos;
+			s->parse.pos = s->parse.len;
+			return line;
+		}
+
+		/* keep the partial line, make room and read some more */
+		s->parse.len -= s->parse.pos;
+		memmove(data, data + s->parse.pos, s->parse.len);
+		s->parse.pos = 0;
+		scanned = s->parse.len;
+
+		if (s->parse.max - s->parse.len < PARSE_CHUNK + 1) {
+			s->parse.max = s->parse.len + PARSE_CHUNK + 1;
+			s->parse.data = realloc(s->parse.data, s->parse.max);
+		}
+
+		n = fread(s->parse.data + s->parse.len, 1, PARSE_CHUNK, s->f);
+		if (!n)
+			s->parse.eof = true;
+		s->parse.len += n;
+	}
+}
+
 bool
 parse_renouveau(struct state *s)
 {
-	struct ent e = {
-		.addr = s->parse.addr
-	};
-	int ret;
+	struct ent e[PARSE_BATCH];
+	const char *line;
+	int n = 0;
 
-	for (;;) {
-		if (getline(&s->parse.buf, &s->parse.n, s->f) < 0)
-			return false;
+	while (n < PARSE_BATCH && (line = read_line(s))) {
+		if (!bintrace_scan_hex(&line, &e[n].val))
+			continue;
 
-		ret = sscanf(s->parse.buf, "%x", &e.val);
-		if (ret == 1)
-			break;
+		e[n].out_of_band = false;
+		e[n++].addr = s->parse.addr;
+		s->parse.addr += 4;
 	}
 
-	add_ent(s, &e);
-	s->parse.addr += 4;
-	return true;
+	add_ents(s, e, n);
+	return n > 0;
 }
 
+/* everything but writes to the filtered map and object creations is dropped */
 bool
 parse_valgrind(struct state *s)
 {
-	struct ent e = {};
-	unsigned m, addr, val[4];
-	char c[3] = {};
-	int i;
-
-	for (;;) {
-		if (getline(&s->parse.buf, &s->parse.n, s->f) < 0)
-			return false;
-
-		i = sscanf(s->parse.buf, "--%*d-- w %d:%x, %x%c%x%c%x%c%x",
-			   &m, &addr, &val[0], &c[0], &val[1], &c[1],
-			   &val[2], &c[2], &val[3]);
-		if(i==6){			//reorder words (2,1) => (1,2)
-			unsigned x = val[0];
-			val[0] = val[1];
-			val[1] = x;
-		}
-		else if(i==9){		//reorder words (4,3,2,1) => (1,2,3,4)
-			unsigned x = val[0];
-			val[0] = val[3];
-			val[3] = x;
-			x      = val[1];
-			val[1] = val[2];
-			val[2] = x;
+	struct ent e[PARSE_BATCH + 4];
+	struct bintrace_mmt mmt;
+	char *p;
+	int n = 0, i;
+
+	while (n < PARSE_BATCH && (p = read_line(s))) {
+		if (!bintrace_parse_mmt(p, &mmt))
+			continue;
+
+		if (mmt.type == BINTRACE_OBJECT) {
+			add_object(s, mmt.addr, mmt.val[0]);
+			continue;
 		}
-		if (i >= 4 && m == s->filter.map)
-			break;
+		if (mmt.map != s->filter.map)
+			continue;
 
-		i = sscanf(s->parse.buf, "--%*d-- create gpu object"
-			   " 0x%*x:0x%x type 0x%x", &val[0], &val[1]);
-		if (i == 2)
-			add_object(s, val[0], val[1]);
+		for (i = 0; i < mmt.valsnum; i++) {
+			e[n].addr = mmt.addr + 4 * i;
+			e[n].val = mmt.val[i];
+			e[n++].out_of_band = false;
+		}
 	}
 
-	for (i = 0; i <= 3 && (i == 0 || c[i - 1] == ','); i++) {
-		e.addr = addr;
-		e.val = val[i];
-		add_ent(s, &e);
-		addr += 4;
+	add_ents(s, e, n);
+	return n > 0;
+}
+
+/* valgrind-mmt trace converted by trace2bin, no parsing left to do */
+bool
+parse_bintrace(struct state *s)
+{
+	struct ent e[PARSE_BATCH];
+	const struct bintrace_rec *rec;
+	int n = 0;
+
+	while (n < PARSE_BATCH && (rec = bintrace_next(&s->parse.bin, NULL))) {
+		if (rec->type == BINTRACE_WRITE && rec->map == s->filter.map) {
+			e[n].addr = rec->addr;
+			e[n].val = rec->value;
+			e[n++].out_of_band = false;
+
+		} else if (rec->type == BINTRACE_OBJECT) {
+			add_object(s, rec->addr, rec->value);
+		}
 	}
 
-	return true;
+	add_ents(s, e, n);
+	return n > 0;
 }
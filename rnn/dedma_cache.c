@@ -22,86 +22,261 @@
  * OTHER DEALINGS IN THE SOFTWARE.
  */
 
+
 #include "dedma.h"
 
-#define CACHE_ENT(s, i)							\
-	(&(s)->cache.ent[((i) - (s)->cache.i0 + (s)->cache.k) % MAX_CACHE])
+/*
+ * Writes come out of the trace roughly, but not exactly, in address
+ * order.  Parsed entries wait in the "in" ring until dedma() has looked
+ * at them, then they get inserted into a skiplist keyed by (run,
+ * address), which puts late writes back in place and merges partial and
+ * duplicated ones in O(log n).  Once more than cache.window entries are
+ * held back, the lowest one is flushed.  Out of band entries aren't
+ * ordered, they just hang off the entry that preceded them.
+ */
+
+#define IN_ENT(c, i) (&(c)->in.ent[((c)->in.first + (i)) & ((c)->in.max - 1)])
 
 struct ent *
 get_ent(struct state *s, int i)
 {
 	struct cache *c = &s->cache;
 
-	if (i < c->i0 || i > c->i1)
-		return NULL;
+	while (i >= c->in.num)
+		if (!s->op.parse(s))
+			return NULL;
+
+	return IN_ENT(c, i);
+}
 
-	if (i == c->i1 && !s->op.parse(s))
+struct ent *
+last_ent(struct state *s)
+{
+	struct cache *c = &s->cache;
+	struct node *n = (c->head ? c->tail[0] : NULL);
+
+	if (!n || n == c->head || n->run != c->run)
 		return NULL;
 
-	return CACHE_ENT(s, i);
+	return &n->e;
 }
 
 void
-rotate_ent(struct state *s, int i, int j)
+add_ents(struct state *s, struct ent *e, int n)
 {
-	const int d = sizeof(struct ent);
 	struct cache *c = &s->cache;
-	int ki = CACHE_ENT(s, i) - c->ent;
-	int kj = CACHE_ENT(s, j) - c->ent;
-	struct ent tmp;
+	int i, max;
 
-	assert(j >= i && j >= c->i0 && j < c->i1 &&
-	       i >= c->i0 && i < c->i1);
+	if (c->in.num + n > c->in.max) {
+		struct ent *ent;
 
-	memmove(&tmp, c->ent + kj, d);
+		for (max = (c->in.max ? c->in.max : 16);
+		     max < c->in.num + n; max *= 2)
+			;
 
-	if (ki >= c->k && kj < c->k) {
-		/* the region wraps around */
-		memmove(c->ent + 1, c->ent, d * kj);
-		memmove(c->ent, c->ent + MAX_CACHE - 1, d);
-		memmove(c->ent + ki + 1, c->ent + ki, d * (MAX_CACHE - ki - 1));
+		ent = malloc(max * sizeof *ent);
+		for (i = 0; i < c->in.num; i++)
+			ent[i] = *IN_ENT(c, i);
 
-	} else {
-		/* easy case */
-		memmove(c->ent + ki + 1, c->ent + ki, d * (kj - ki));
+		free(c->in.ent);
+		c->in.ent = ent;
+		c->in.first = 0;
+		c->in.max = max;
 	}
 
-	memmove(c->ent + ki, &tmp, d);
+	for (i = 0; i < n; i++)
+		*IN_ENT(c, c->in.num + i) = e[i];
+	c->in.num += n;
 }
 
 void
 add_ent(struct state *s, struct ent *e)
+{
+	add_ents(s, e, 1);
+}
+
+void
+new_run(struct state *s)
+{
+	s->cache.run++;
+}
+
+/* is n ordered before or at (run, addr)? */
+static bool
+node_le(struct node *n, int run, uint32_t addr)
+{
+	return (n->run != run ? n->run < run : n->e.addr <= addr);
+}
+
+static struct node *
+new_node(int level, struct ent *e, int run)
+{
+	struct node *n = calloc(1, sizeof *n + level * sizeof n->next[0]);
+
+	n->e = *e;
+	n->run = run;
+	return n;
+}
+
+static int
+random_level(struct cache *c)
+{
+	uint32_t x;
+	int l = 1;
+
+	c->seed ^= c->seed << 13;
+	c->seed ^= c->seed >> 17;
+	c->seed ^= c->seed << 5;
+
+	for (x = c->seed; l < MAX_LEVEL && !(x & 3); x >>= 2)
+		l++;
+
+	return l;
+}
+
+static void
+flush_first(struct state *s)
 {
 	struct cache *c = &s->cache;
+	struct node *n = c->head->next[0], *o;
+	int i;
+
+	for (i = 0; i < c->level && c->head->next[i] == n; i++) {
+		c->head->next[i] = n->next[i];
+		if (c->tail[i] == n)
+			c->tail[i] = c->head;
+	}
 
-	if (c->i1 - c->i0 == MAX_CACHE) {
-		s->op.flush(s, CACHE_ENT(s, c->i0));
-		c->k = (c->k + 1) % MAX_CACHE;
-		c->i0++;
+	c->flushed = true;
+	c->flushed_run = n->run;
+	c->flushed_addr = n->e.addr;
+
+	s->op.flush(s, &n->e);
+	c->num--;
+
+	while ((o = n->oob)) {
+		s->op.flush(s, &o->e);
+		c->num--;
+		n->oob = o->oob;
+		free(o);
 	}
 
-	*CACHE_ENT(s, c->i1) = *e;
-	c->i1++;
+	free(n);
 }
 
 void
-drop_ent(struct state *s, int i)
+order_ent(struct state *s)
 {
 	struct cache *c = &s->cache;
+	struct node *update[MAX_LEVEL], *x, *n;
+	struct ent e = *IN_ENT(c, 0);
+	uint32_t d;
+	int i, level;
+
+	c->in.first = (c->in.first + 1) & (c->in.max - 1);
+	c->in.num--;
+
+	if (!c->head) {
+		c->head = new_node(MAX_LEVEL, &e, 0);
+		for (i = 0; i < MAX_LEVEL; i++)
+			c->tail[i] = c->head;
+		c->level = 1;
+		c->seed = 0x2545f491;
+	}
+
+	if (e.out_of_band) {
+		x = c->tail[0];
+
+		if (x == c->head) {
+			/* nothing to keep it in order with */
+			s->op.flush(s, &e);
+			return;
+		}
 
-	rotate_ent(s, c->i0, i);
-	c->k = (c->k + 1) % MAX_CACHE;
-	c->i1--;
+		n = new_node(0, &e, x->run);
+		if (x->oob)
+			x->oobtail->oob = n;
+		else
+			x->oob = n;
+		x->oobtail = n;
+		c->num++;
+
+	} else {
+		if (c->tail[0] != c->head &&
+		    !node_le(c->tail[0], c->run, e.addr)) {
+			/* badly ordered write, find a place for it */
+			x = c->head;
+			for (i = c->level - 1; i >= 0; i--) {
+				while (x->next[i] &&
+				       node_le(x->next[i], c->run, e.addr))
+					x = x->next[i];
+				update[i] = x;
+			}
+		} else {
+			/* the common case, it goes at the end */
+			for (i = 0; i < c->level; i++)
+				update[i] = c->tail[i];
+		}
+
+		x = update[0];
+		d = e.addr - x->e.addr;
+
+		if (x != c->head && x->run == c->run && d <= 3) {
+			/* duplicated write keeps the most recent value,
+			 * 8 and 16 bit writes get merged */
+			if (d)
+				x->e.val |= e.val << (8 * d);
+			else
+				x->e = e;
+
+			c->stats.merges++;
+			return;
+		}
+
+		if (x != c->tail[0])
+			c->stats.reorders++;
+
+		if (c->flushed && c->run == c->flushed_run &&
+		    e.addr < c->flushed_addr)
+			/* its place got flushed already, the best we
+			 * can do is to put it first */
+			c->stats.late++;
+
+		level = random_level(c);
+		for (i = c->level; i < level; i++)
+			update[i] = c->head;
+		if (level > c->level)
+			c->level = level;
+
+		n = new_node(level, &e, c->run);
+		for (i = 0; i < level; i++) {
+			n->next[i] = update[i]->next[i];
+			update[i]->next[i] = n;
+			if (c->tail[i] == update[i])
+				c->tail[i] = n;
+		}
+		c->num++;
+	}
+
+	while (c->num > c->window && c->head->next[0])
+		flush_first(s);
 }
 
 void
 flush_cache(struct state *s)
 {
 	struct cache *c = &s->cache;
-	int i;
 
-	for (i = c->i0; i < c->i1; i++)
-		s->op.flush(s, CACHE_ENT(s, i));
+	while (c->head && c->head->next[0])
+		flush_first(s);
+
+	free(c->head);
+	c->head = NULL;
+	c->num = 0;
+	c->run = 0;
+	c->flushed = false;
 
-	c->i0 = c->i1 = 0;
+	free(c->in.ent);
+	c->in.ent = NULL;
+	c->in.first = c->in.num = c->in.max = 0;
 }
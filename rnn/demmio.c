@@ -28,11 +28,15 @@
 #include "var.h"
 #include "dis.h"
 #include "util.h"
+#include "bintrace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
 #include <string.h>
+#include <stdarg.h>
 #include <getopt.h>
+#include <math.h>
+#include <sys/stat.h>
 
 int sleep_disabled = 0;
 
@@ -63,6 +67,7 @@ struct cctx {
 	uint64_t bar0, bar0l, bar1, bar1l, bar2, bar2l;
 	struct i2c_ctx i2cb[10];
 	int crx0, crx1;
+	char chname[5];	/* first chipset seen, the one rnndec uses */
 };
 
 struct cctx *cctx = 0;
@@ -70,20 +75,71 @@ int cctxnum = 0, cctxmax = 0;
 
 struct mpage {
 	uint64_t tag;
+	int dirty;	/* written since the last index checkpoint */
 	uint32_t contents[0x1000/4];
 };
 
-uint32_t *findmem (struct cctx *ctx, uint64_t addr) {
+struct mpage *findpage (struct cctx *ctx, uint64_t addr) {
 	int i;
 	uint64_t tag = addr & ~0xfffull;
 	for (i = 0; i < ctx->pagesnum; i++) {
 		if (tag == ctx->pages[i]->tag)
-			return &ctx->pages[i]->contents[(addr&0xfff)/4];
+			return ctx->pages[i];
 	}
 	struct mpage *pg = calloc (sizeof *pg, 1);
 	pg->tag = tag;
 	ADDARRAY(ctx->pages, pg);
-	return &pg->contents[(addr&0xfff)/4];
+	return pg;
+}
+
+uint32_t *findmem (struct cctx *ctx, uint64_t addr) {
+	return &findpage(ctx, addr)->contents[(addr&0xfff)/4];
+}
+
+void setmem (struct cctx *ctx, uint64_t addr, uint32_t value) {
+	struct mpage *pg = findpage(ctx, addr);
+	pg->contents[(addr&0xfff)/4] = value;
+	pg->dirty = 1;
+}
+
+/* with quiet set, the decoder state is kept up to date but nothing gets printed */
+int quiet = 0;
+int addrfilter = 0;
+uint64_t addrfirst, addrlast;
+double timestamp_old = 0;
+
+void out (const char *fmt, ...) {
+	va_list va;
+	if (quiet)
+		return;
+	va_start(va, fmt);
+	vprintf(fmt, va);
+	va_end(va);
+}
+
+int addr_wanted (uint64_t addr) {
+	return !addrfilter || (addr >= addrfirst && addr <= addrlast);
+}
+
+/* decoded names and values, valid until the next decode */
+struct rnndecbuf namebuf, valbuf;
+
+const char *decodeaddr (struct rnndeccontext *ctx, struct rnndomain *dom, uint64_t addr, int write, struct rnndecaddrinfo *ai) {
+	if (quiet) {
+		memset(ai, 0, sizeof *ai);
+		return "";
+	}
+	rnndec_bufclear(&namebuf);
+	rnndec_appendaddr(ctx, &namebuf, dom, addr, write, ai);
+	return namebuf.str;
+}
+
+const char *decodeval (struct rnndeccontext *ctx, struct rnndecaddrinfo *ai, uint64_t value) {
+	if (quiet)
+		return "";
+	rnndec_bufclear(&valbuf);
+	rnndec_appendval(ctx, &valbuf, ai->typeinfo, value, ai->width);
+	return valbuf.str;
 }
 
 int i2c_bus_num (uint64_t addr) {
@@ -117,9 +173,9 @@ void doi2cr (struct cctx *cc, struct i2c_ctx *ctx, int byte) {
 	if (ctx->pend) {
 		if (ctx->bits == 8) {
 			if (byte & 2)
-				printf ("- ");
+				out ("- ");
 			else
-				printf ("+ ");
+				out ("+ ");
 			if (!ctx->aok) {
 				ctx->aok = 1;
 				ctx->wr = !(ctx->b&1);
@@ -131,7 +187,7 @@ void doi2cr (struct cctx *cc, struct i2c_ctx *ctx, int byte) {
 			ctx->b |= (byte & 2) >> 1;
 			ctx->bits++;
 			if (ctx->bits == 8) {
-				printf ("<%02x", ctx->b);
+				out ("<%02x", ctx->b);
 			}
 		}
 		ctx->pend = 0;
@@ -146,7 +202,7 @@ void doi2cw (struct cctx *cc, struct i2c_ctx *ctx, int byte) {
 	}
 	if ((byte & 1) && !(ctx->last & 1)) {
 		if (ctx->pend) {
-			printf ("\nI2C LOST!\n");
+			out ("\nI2C LOST!\n");
 			doi2cr(cc, ctx, 0);
 			ctx->pend = 0;
 		}
@@ -156,9 +212,9 @@ void doi2cw (struct cctx *cc, struct i2c_ctx *ctx, int byte) {
 				ctx->pend = 1;
 			} else {
 				if (byte & 2)
-					printf ("- ");
+					out ("- ");
 				else
-					printf ("+ ");
+					out ("+ ");
 				ctx->bits = 0;
 				ctx->b = 0;
 			}
@@ -168,7 +224,7 @@ void doi2cw (struct cctx *cc, struct i2c_ctx *ctx, int byte) {
 				ctx->b |= (byte & 2) >> 1;
 				ctx->bits++;
 				if (ctx->bits == 8) {
-					printf (">%02x", ctx->b);
+					out (">%02x", ctx->b);
 				}
 			} else {
 				ctx->pend = 1;
@@ -177,7 +233,7 @@ void doi2cw (struct cctx *cc, struct i2c_ctx *ctx, int byte) {
 	}
 	if ((byte & 1) && !(byte & 2) && (ctx->last & 2)) {
 		/* data went low with high clock - start bit */
-		printf ("START ");
+		out ("START ");
 		ctx->bits = 0;
 		ctx->b = 0;
 		ctx->aok = 0;
@@ -187,7 +243,7 @@ void doi2cw (struct cctx *cc, struct i2c_ctx *ctx, int byte) {
 	}
 	if ((byte & 1) && (byte & 2) && !(ctx->last & 2)) {
 		/* data went high with high clock - stop bit */
-		printf ("STOP\n");
+		out ("STOP\n");
 		cc->i2cip = -1;
 		ctx->bits = 0;
 		ctx->b = 0;
@@ -199,6 +255,13 @@ void doi2cw (struct cctx *cc, struct i2c_ctx *ctx, int byte) {
 	ctx->last = byte;
 }
 
+struct rnndb *db;
+struct rnndomain *mmiodom, *crdom;
+struct ed_decoder *ctx_dec_nv40, *ctx_dec_nv50;
+struct ed_decoder *hwsq_dec_nv17, *hwsq_dec_nv41, *hwsq_dec_nv50;
+struct ed_insn insn;
+const struct envy_colors *colors;
+
 FILE *open_input(char *filename) {
 	const char * const tab[][2] = {
 		{ ".gz", "zcat" },
@@ -225,10 +288,385 @@ FILE *open_input(char *filename) {
 	return fopen(filename, "r");
 }
 
+static void handle_pcidev (const char *line) {
+	uint64_t bar[4], len[4], pciid;
+	int i;
+	sscanf (line, "%*s %*s %"SCNx64" %*s %"SCNx64" %"SCNx64" %"SCNx64" %"SCNx64" %*s %*s %*s %"SCNx64" %"SCNx64" %"SCNx64" %"SCNx64"", &pciid, &bar[0], &bar[1], &bar[2], &bar[3], &len[0], &len[1], &len[2], &len[3]);
+	if ((pciid >> 16) == 0x10de && bar[0] && (bar[0] & 0xf) == 0 && bar[1] && (bar[1] & 0x1) == 0x0) {
+		struct cctx nc = { 0 };
+		nc.bar0 = bar[0], nc.bar0l = len[0];
+		nc.bar1 = bar[1], nc.bar1l = len[1];
+		if (bar[2])
+			nc.bar2 = bar[2], nc.bar2l = len[2];
+		else
+			nc.bar2 = bar[3], nc.bar2l = len[3];
+		nc.bar0 &= ~0xf;
+		nc.bar1 &= ~0xf;
+		nc.bar2 &= ~0xf;
+		nc.i2cip = -1;
+		nc.ctx = rnndec_newcontext(db);
+		nc.ctx->colors = colors;
+		for (i = 0; i < 10; i++)
+			nc.i2cb[i].last = 7;
+		ADDARRAY(cctx, nc);
+	}
+	out ("%s", line);
+}
+
+static void handle_access (char op, int width, double timestamp, uint64_t addr, uint64_t value) {
+	int skip = 0;
+	int wasquiet = quiet;
+	int cci;
+
+	/* Add a SLEEP line when two mmio accesses are more distant than 100µs */
+	if (!sleep_disabled && !addrfilter && timestamp_old > 0 && (timestamp - timestamp_old) > 0.0001)
+		out("SLEEP %lfms\n", (timestamp - timestamp_old)*1000.0);
+	timestamp_old = timestamp;
+
+	for (cci = 0; cci < cctxnum; cci++) {
+		struct cctx *cc = &cctx[cci];
+		if (cc->bar0 && addr >= cc->bar0 && addr < cc->bar0+cc->bar0l) {
+			addr -= cc->bar0;
+			quiet = wasquiet || !addr_wanted(addr);
+			if (cc->hwsqip && addr != cc->hwsqnext) {
+				struct ed_decoder *dec = hwsq_dec_nv17;
+				uint32_t pos, end = cc->hwsqnext & 0x3fc;
+				if (cc->chipset >= 0x41)
+					dec = hwsq_dec_nv41;
+				if (cc->arch == 5)
+					dec = hwsq_dec_nv50;
+				for (pos = 0; pos < end && !quiet; pos += insn.oplen) {
+					ed_decode(dec, cc->hwsq + pos, end - pos, pos, &insn);
+					ed_print_insn(dec, stdout, colors, &insn, 0);
+					ed_insn_fini(&insn);
+				}
+				cc->hwsqip = 0;
+			}
+			if (addr == 0 && !cc->chdone) {
+				char chname[5];
+				if (value & 0x0f000000)
+					snprintf(chname, 5, "NV%02"PRIX64, (value >> 20) & 0xff);
+				else if (value & 0x0000f000)
+					snprintf(chname, 5, "NV%02"PRIX64, ((value >> 20) & 0xf) + 4);
+				else
+					snprintf(chname, 5, "NV%02"PRIX64, ((value >> 16) & 0xf));
+				rnndec_varadd(cc->ctx, "chipset", chname);
+				if (!cc->chname[0])
+					strcpy(cc->chname, chname);
+				switch ((value >> 20) & 0xf0) {
+					case 0:
+						cc->arch = 0;
+						break;
+					case 0x10:
+						cc->arch = 1;
+						break;
+					case 0x20:
+						cc->arch = 2;
+						break;
+					case 0x30:
+						cc->arch = 3;
+						break;
+					case 0x40:
+					case 0x60:
+						cc->arch = 4;
+						break;
+					case 0x50:
+					case 0x80:
+					case 0x90:
+					case 0xa0:
+						cc->arch = 5;
+						break;
+					case 0xc0:
+					case 0xd0:
+					case 0xe0:
+						cc->arch = 6;
+						break;
+				}
+				cc->chipset = (value >> 20) & 0xff;
+			} else if (cc->arch >= 5 && addr == 0x1700) {
+				cc->praminbase = value << 16;
+			} else if (cc->arch == 5 && addr == 0x1704) {
+				cc->fakechan = (value & 0xfffffff) << 12;
+			} else if (cc->arch == 5 && addr == 0x170c) {
+				cc->ramins = (value & 0xffff) << 4;
+			} else if (cc->arch >= 6 && addr == 0x1714) {
+				cc->ramins = (value & 0xfffffff) << 12;
+			} else if (addr == 0x6013d4) {
+				cc->crx0 = value & 0xff;
+			} else if (addr == 0x6033d4) {
+				cc->crx1 = value & 0xff;
+			} else if (addr == 0x6013d5) {
+				struct rnndecaddrinfo ai;
+				const char *name = decodeaddr(cc->ctx, crdom, cc->crx0, op == 'W', &ai);
+				const char *decoded_val = decodeval(cc->ctx, &ai, value);
+				out ("[%d] %lf CRTC0 %c     0x%02x       0x%02"PRIx64" %s %s %s\n", cci, timestamp, op, cc->crx0, value, name, op=='W'?"<=":"=>", decoded_val);
+				skip = 1;
+			} else if (addr == 0x6033d5) {
+				struct rnndecaddrinfo ai;
+				const char *name = decodeaddr(cc->ctx, crdom, cc->crx1, op == 'W', &ai);
+				const char *decoded_val = decodeval(cc->ctx, &ai, value);
+				out ("[%d] %lf CRTC1 %c     0x%02x       0x%02"PRIx64" %s %s %s\n", cci, timestamp, op, cc->crx1, value, name, op=='W'?"<=":"=>", decoded_val);
+				skip = 1;
+			} else if (cc->arch >= 5 && (addr & 0xfff000) == 0xe000) {
+				int bus = i2c_bus_num(addr);
+				if (bus != -1) {
+					if (cc->i2cip != bus) {
+						if (cc->i2cip != -1)
+							out ("\n");
+						struct rnndecaddrinfo ai;
+						out ("[%d] I2C      0x%06"PRIx64"            %s ", cci, addr, decodeaddr(cc->ctx, mmiodom, addr, op == 'W', &ai));
+						cc->i2cip = bus;
+					}
+					if (op == 'R') {
+						doi2cr(cc, &cc->i2cb[bus], value);
+					} else {
+						doi2cw(cc, &cc->i2cb[bus], value);
+					}
+					skip = 1;
+				}
+			} else if ((addr & 0xfff000) == 0x9000 && (cc->i2cip != -1)) {
+				/* ignore PTIMER meddling during I2C */
+				skip = 1;
+			} else if (addr == 0x1400 || addr == 0x80000 || addr == cc->hwsqnext) {
+				if (!cc->hwsqip) {
+					struct rnndecaddrinfo ai;
+					out ("[%d] HWSQ     0x%06"PRIx64"            %s\n", cci, addr, decodeaddr(cc->ctx, mmiodom, addr, op == 'W', &ai));
+				}
+				cc->hwsq[(addr & 0x1fc) + 0] = value;
+				cc->hwsq[(addr & 0x1fc) + 1] = value >> 8;
+				cc->hwsq[(addr & 0x1fc) + 2] = value >> 16;
+				cc->hwsq[(addr & 0x1fc) + 3] = value >> 24;
+				cc->hwsqip = 1;
+				cc->hwsqnext = addr + 4;
+				skip = 1;
+			} else if (addr == 0x400324 && cc->arch >= 4 && cc->arch <= 5) {
+				cc->ctxpos = value;
+			} else if (addr == 0x400328 && cc->arch >= 4 && cc->arch <= 5) {
+				uint8_t param[4];
+				param[0] = value;
+				param[1] = value >> 8;
+				param[2] = value >> 16;
+				param[3] = value >> 24;
+				struct rnndecaddrinfo ai;
+				out ("[%d] MMIO%d %c 0x%06"PRIx64" 0x%08"PRIx64" %s %s ", cci, width, op, addr, value, decodeaddr(cc->ctx, mmiodom, addr, op == 'W', &ai), op=='W'?"<=":"=>");
+				struct ed_decoder *dec = (cc->arch == 5 ? ctx_dec_nv50 : ctx_dec_nv40);
+				if (!quiet) {
+					ed_decode(dec, param, 1, cc->ctxpos, &insn);
+					ed_print_insn(dec, stdout, colors, &insn, 0);
+					ed_insn_fini(&insn);
+				}
+				cc->ctxpos++;
+				skip = 1;
+			}
+			if (!skip && (cc->i2cip != -1)) {
+				out ("\n");
+				cc->i2cip = -1;
+			}
+			if (cc->arch >= 5 && addr >= 0x700000 && addr < 0x800000) {
+				addr -= 0x700000;
+				addr += cc->praminbase;
+				out ("[%d] %lf, MEM%d %"PRIx64" %s %"PRIx64"\n", cci, timestamp, width, addr, op=='W'?"<=":"=>", value);
+				setmem(cc, addr, value);
+			} else if (!skip) {
+				struct rnndecaddrinfo ai;
+				const char *name = decodeaddr(cc->ctx, mmiodom, addr, op == 'W', &ai);
+				if (width == 32 && ai.width == 8) {
+					/* 32-bit write to 8-bit location - split it up */
+					int b;
+					int cnt;
+					for (b = 0; b < 4; b++) {
+						name = decodeaddr(cc->ctx, mmiodom, addr+b, op == 'W', &ai);
+						const char *decoded_val = decodeval(cc->ctx, &ai, value >> b * 8 & 0xff);
+						if (b == 0) {
+							out ("[%d] %lf MMIO%d %c 0x%06"PRIx64" 0x%08"PRIx64" %n%s %s %s\n", cci, timestamp, width, op, addr, value, &cnt, name, op=='W'?"<=":"=>", decoded_val);
+						} else {
+							int c;
+							for (c = 0; c < cnt; c++)
+								out(" ");
+							out ("%s %s %s\n", name, op=='W'?"<=":"=>", decoded_val);
+						}
+					}
+				} else {
+					const char *decoded_val = decodeval(cc->ctx, &ai, value);
+					out ("[%d] %lf MMIO%d %c 0x%06"PRIx64" 0x%08"PRIx64" %s %s %s\n", cci, timestamp, width, op, addr, value, name, op=='W'?"<=":"=>", decoded_val);
+				}
+			}
+		} else if (cc->bar1 && addr >= cc->bar1 && addr < cc->bar1+cc->bar1l) {
+			addr -= cc->bar1;
+			quiet = wasquiet || !addr_wanted(addr);
+			out ("[%d] %lf, FB%d %"PRIx64" %s %"PRIx64"\n", cci, timestamp, width, addr, op=='W'?"<=":"=>", value);
+		} else if (cc->bar2 && addr >= cc->bar2 && addr < cc->bar2+cc->bar2l) {
+			addr -= cc->bar2;
+			quiet = wasquiet || !addr_wanted(addr);
+			if (cc->arch >= 6) {
+				uint64_t pd = *findmem(cc, cc->ramins + 0x200);
+				uint64_t pt = *findmem(cc, pd + 4);
+				pt &= 0xfffffff0;
+				pt <<= 8;
+				uint64_t pg = *findmem(cc, pt + (addr/0x1000) * 8);
+				pg &= 0xfffffff0;
+				pg <<= 8;
+				pg += (addr&0xfff);
+				setmem(cc, pg, value);
+	//					printf ("%"PRIx64" %"PRIx64" %"PRIx64" %"PRIx64"\n", ramins, pd, pt, pg);
+				out ("[%d] %lf RAMIN%d %"PRIx64" %"PRIx64" %s %"PRIx64"\n", cci, timestamp, width, addr, pg, op=='W'?"<=":"=>", value);
+			} else if (cc->arch == 5) {
+				uint64_t paddr = addr;
+				paddr += *findmem(cc, cc->fakechan + cc->ramins + 8);
+				paddr += (uint64_t)(*findmem(cc, cc->fakechan + cc->ramins + 12) >> 24) << 32;
+				uint64_t pt = *findmem(cc, cc->fakechan + (cc->chipset == 0x50 ? 0x1400 : 0x200) + ((paddr >> 29) << 3));
+	//					printf ("%#"PRIx64" PT: %#"PRIx64" %#"PRIx64" ", paddr, fakechan + 0x200 + ((paddr >> 29) << 3), pt);
+				uint32_t div = (pt & 2 ? 0x1000 : 0x10000);
+				pt &= 0xfffff000;
+				uint64_t pg = *findmem(cc, pt + ((paddr&0x1ffff000)/div) * 8);
+				uint64_t pgh = *findmem(cc, pt + ((paddr&0x1ffff000)/div) * 8 + 4);
+	//					printf ("PG: %#"PRIx64" %#"PRIx64"\n", pt + ((paddr&0x1ffff000)/div) * 8, pgh << 32 | pg);
+				pg &= 0xfffff000;
+				pg |= (pgh & 0xff) << 32;
+				pg += (paddr & (div-1));
+				setmem(cc, pg, value);
+	//					printf ("%"PRIx64" %"PRIx64" %"PRIx64" %"PRIx64"\n", ramins, pd, pt, pg);
+				out ("[%d] %lf RAMIN%d %"PRIx64" %"PRIx64" %s %"PRIx64"\n", cci, timestamp, width, addr, pg, op=='W'?"<=":"=>", value);
+			} else {
+				out ("[%d] %lf RAMIN%d %"PRIx64" %s %"PRIx64"\n", cci, timestamp, width, addr, op=='W'?"<=":"=>", value);
+			}
+		}
+	}
+	quiet = wasquiet;
+}
+
+/*
+ * A trace index is a header followed by checkpoints of the whole decoder
+ * state, taken every indexstep accesses.  Shadow memory pages are only
+ * stored by the first checkpoint after they got written, so restoring a
+ * checkpoint replays the pages of all the ones before it.
+ */
+
+#define INDEX_MAGIC "DEMMIOIX"
+#define INDEX_VERSION 1
+
+struct index_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t cctxsize;	/* struct cctx is stored as is */
+	uint64_t size;		/* of the indexed trace */
+	int64_t mtime;
+};
+
+struct index_ckpt {
+	uint64_t pos;		/* where decoding resumes */
+	double timestamp;	/* of the last access before pos */
+	double timestamp_old;
+	int32_t sleep_disabled;
+	int32_t cctxnum;
+	int32_t pagesnum;	/* written pages following the cards */
+	int32_t pad;
+};
+
+struct index_page {
+	int32_t card;
+	int32_t pad;
+	struct mpage page;
+};
+
+int index_header (struct index_header *hdr, const char *file) {
+	struct stat st;
+	if (stat(file, &st))
+		return -1;
+	memset(hdr, 0, sizeof *hdr);
+	memcpy(hdr->magic, INDEX_MAGIC, sizeof hdr->magic);
+	hdr->version = INDEX_VERSION;
+	hdr->cctxsize = sizeof (struct cctx);
+	hdr->size = st.st_size;
+	hdr->mtime = st.st_mtime;
+	return 0;
+}
+
+void index_write (FILE *idx, uint64_t pos, double timestamp) {
+	struct index_ckpt ck = { pos, timestamp, timestamp_old, sleep_disabled, cctxnum };
+	struct index_page ip = { 0 };
+	int i, j;
+	for (i = 0; i < cctxnum; i++)
+		for (j = 0; j < cctx[i].pagesnum; j++)
+			ck.pagesnum += cctx[i].pages[j]->dirty;
+	fwrite(&ck, sizeof ck, 1, idx);
+	fwrite(cctx, sizeof *cctx, cctxnum, idx);
+	for (i = 0; i < cctxnum; i++)
+		for (j = 0; j < cctx[i].pagesnum; j++) {
+			if (!cctx[i].pages[j]->dirty)
+				continue;
+			cctx[i].pages[j]->dirty = 0;
+			ip.card = i;
+			ip.page = *cctx[i].pages[j];
+			fwrite(&ip, sizeof ip, 1, idx);
+		}
+}
+
+/* restores the last checkpoint before fromtime, returns where to resume */
+uint64_t index_restore (FILE *idx, const char *file, double fromtime) {
+	struct index_header hdr, want;
+	struct index_ckpt ck;
+	struct index_page ip;
+	uint64_t pos = 0;
+	int i;
+	if (fread(&hdr, sizeof hdr, 1, idx) != 1 || index_header(&want, file) || memcmp(&hdr, &want, sizeof hdr)) {
+		fprintf (stderr, "Index doesn't match the trace, decoding from the start.\n");
+		return 0;
+	}
+	while (fread(&ck, sizeof ck, 1, idx) == 1 && ck.timestamp < fromtime) {
+		for (i = 0; i < ck.cctxnum; i++) {
+			struct cctx nc;
+			if (fread(&nc, sizeof nc, 1, idx) != 1)
+				goto truncated;
+			if (i < cctxnum) {
+				nc.ctx = cctx[i].ctx;
+				nc.pages = cctx[i].pages;
+				nc.pagesnum = cctx[i].pagesnum;
+				nc.pagesmax = cctx[i].pagesmax;
+				cctx[i] = nc;
+			} else {
+				nc.ctx = rnndec_newcontext(db);
+				nc.ctx->colors = colors;
+				nc.pages = 0;
+				nc.pagesnum = nc.pagesmax = 0;
+				ADDARRAY(cctx, nc);
+			}
+			if (nc.chname[0] && !nc.ctx->varsnum)
+				rnndec_varadd(nc.ctx, "chipset", nc.chname);
+		}
+		for (i = 0; i < ck.pagesnum; i++) {
+			if (fread(&ip, sizeof ip, 1, idx) != 1 || ip.card >= cctxnum)
+				goto truncated;
+			struct mpage *pg = findpage(&cctx[ip.card], ip.page.tag);
+			*pg = ip.page;
+			pg->dirty = 0;
+		}
+		timestamp_old = ck.timestamp_old;
+		sleep_disabled = ck.sleep_disabled;
+		pos = ck.pos;
+	}
+	return pos;
+truncated:
+	fprintf (stderr, "Index is truncated!\n");
+	exit(1);
+}
+
 int main(int argc, char **argv) {
-	char *file = NULL;
+	static const struct option opts[] = {
+		{ "build-index", no_argument, 0, 'I' },
+		{ "index", required_argument, 0, 'i' },
+		{ "index-step", required_argument, 0, 's' },
+		{ "from-time", required_argument, 0, 'F' },
+		{ "to-time", required_argument, 0, 'T' },
+		{ "addr-range", required_argument, 0, 'A' },
+		{ 0 },
+	};
+	char *file = NULL, *indexfile = NULL, *end;
 	int c,use_colors=1;
-	while ((c = getopt (argc, argv, "f:c")) != -1) {
+	int buildindex = 0;
+	long indexstep = 1000000;
+	double fromtime = -HUGE_VAL, totime = HUGE_VAL;
+	while ((c = getopt_long (argc, argv, "f:c", opts, NULL)) != -1) {
 		switch (c) {
 			case 'f':{
 				file = strdup(optarg);
@@ -238,31 +676,79 @@ int main(int argc, char **argv) {
 				use_colors = 0;
 				break;
 			}
-			default:{
+			case 'I':{
+				buildindex = 1;
+				break;
+			}
+			case 'i':{
+				indexfile = strdup(optarg);
+				break;
+			}
+			case 's':{
+				indexstep = strtol(optarg, NULL, 0);
 				break;
 			}
+			case 'F':{
+				fromtime = strtod(optarg, NULL);
+				break;
+			}
+			case 'T':{
+				totime = strtod(optarg, NULL);
+				break;
+			}
+			case 'A':{
+				addrfirst = strtoull(optarg, &end, 16);
+				addrlast = (*end == '-') ? strtoull(end + 1, NULL, 16) : addrfirst;
+				addrfilter = 1;
+				break;
+			}
+			default:{
+				fprintf (stderr, "Usage: %s [-c] [-f trace] [--build-index] [--index file] [--index-step accesses]\n"
+						"\t[--from-time seconds] [--to-time seconds] [--addr-range first-last]\n", argv[0]);
+				return 1;
+			}
 		}
 	}
+	if (indexstep < 1)
+		indexstep = 1;
+	if (file && !indexfile) {
+		indexfile = malloc(strlen(file) + 5);
+		sprintf(indexfile, "%s.idx", file);
+	}
+	if (buildindex && !file) {
+		fprintf (stderr, "Only a trace file can be indexed!\n");
+		return 1;
+	}
 	rnn_init();
 
-	struct rnndb *db = rnn_newdb();
+	db = rnn_newdb();
 	rnn_parsefile (db, "nv_mmio.xml");
 	rnn_prepdb (db);
-	struct rnndomain *mmiodom = rnn_finddomain(db, "NV_MMIO");
-	struct rnndomain *crdom = rnn_finddomain(db, "NV_CR");
-	FILE *fin = (file==NULL) ? stdin : open_input(file);
-	if (!fin) {
+	mmiodom = rnn_finddomain(db, "NV_MMIO");
+	crdom = rnn_finddomain(db, "NV_CR");
+	struct bintrace bt;
+	int res = file ? bintrace_open(&bt, file) : 1;
+	int binary = (res == 0);
+	if (res == -1)
+		return 1;
+	if (binary && bt.kind != BINTRACE_MMIOTRACE) {
+		fprintf (stderr, "%s is not a binary mmiotrace!\n", file);
+		return 1;
+	}
+	FILE *fin = binary ? NULL : (file==NULL) ? stdin : open_input(file);
+	if (!binary && !fin) {
 		fprintf (stderr, "Failed to open input file!\n");
 		return 1;
 	}
 
 	char line[1024];
-	int i;
 	const struct disisa *ctx_isa = ed_getisa("ctx");
 	struct varinfo *ctx_var_nv40 = varinfo_new(ctx_isa->vardata);
 	struct varinfo *ctx_var_nv50 = varinfo_new(ctx_isa->vardata);
 	varinfo_set_variant(ctx_var_nv40, "nv40");
 	varinfo_set_variant(ctx_var_nv50, "nv50");
+	ctx_dec_nv40 = ed_decoder_new(ctx_isa, ctx_var_nv40);
+	ctx_dec_nv50 = ed_decoder_new(ctx_isa, ctx_var_nv50);
 	const struct disisa *hwsq_isa = ed_getisa("hwsq");
 	struct varinfo *hwsq_var_nv17 = varinfo_new(hwsq_isa->vardata);
 	struct varinfo *hwsq_var_nv41 = varinfo_new(hwsq_isa->vardata);
@@ -270,261 +756,94 @@ int main(int argc, char **argv) {
 	varinfo_set_variant(hwsq_var_nv17, "nv17");
 	varinfo_set_variant(hwsq_var_nv41, "nv41");
 	varinfo_set_variant(hwsq_var_nv50, "nv50");
-	const struct envy_colors *colors = use_colors ? &envy_def_colors : &envy_null_colors;
+	hwsq_dec_nv17 = ed_decoder_new(hwsq_isa, hwsq_var_nv17);
+	hwsq_dec_nv41 = ed_decoder_new(hwsq_isa, hwsq_var_nv41);
+	hwsq_dec_nv50 = ed_decoder_new(hwsq_isa, hwsq_var_nv50);
+	colors = use_colors ? &envy_def_colors : &envy_null_colors;
+
+	/* index building decodes the whole trace quietly, seeking needs a real file */
+	FILE *idx = NULL;
+	uint64_t pos = binary ? bt.pos : 0;
+	long accesses = 0;
+	double timestamp = 0;
+	/* whatever comes before the range start is skipped, the indexed run never sees it */
+	quiet = fromtime > -HUGE_VAL;
+	if (!binary && ftello(fin) == -1 && (buildindex || fromtime > -HUGE_VAL)) {
+		fprintf (stderr, "Can't seek in this trace, decoding from the start.\n");
+		buildindex = 0;
+	} else if (buildindex) {
+		struct index_header hdr;
+		idx = fopen(indexfile, "w");
+		if (!idx || index_header(&hdr, file) || fwrite(&hdr, sizeof hdr, 1, idx) != 1) {
+			perror(indexfile);
+			return 1;
+		}
+		quiet = 1;
+	} else if (fromtime > -HUGE_VAL && file && (idx = fopen(indexfile, "r"))) {
+		uint64_t start = index_restore(idx, file, fromtime);
+		fclose(idx);
+		idx = NULL;
+		if (start) {
+			pos = start;
+			if (binary)
+				bt.pos = pos;
+			else
+				fseeko(fin, pos, SEEK_SET);
+		}
+	}
+
 	while (1) {
-		/* yes, static buffer. but mmiotrace lines are bound to have sane length anyway. */
-		if (!fgets(line, sizeof(line), fin))
-			break;
-		if (!strncmp(line, "PCIDEV ", 7)) {
-			uint64_t bar[4], len[4], pciid;
-			sscanf (line, "%*s %*s %"SCNx64" %*s %"SCNx64" %"SCNx64" %"SCNx64" %"SCNx64" %*s %*s %*s %"SCNx64" %"SCNx64" %"SCNx64" %"SCNx64"", &pciid, &bar[0], &bar[1], &bar[2], &bar[3], &len[0], &len[1], &len[2], &len[3]);
-			if ((pciid >> 16) == 0x10de && bar[0] && (bar[0] & 0xf) == 0 && bar[1] && (bar[1] & 0x1) == 0x0) {
-				struct cctx nc = { 0 };
-				nc.bar0 = bar[0], nc.bar0l = len[0];
-				nc.bar1 = bar[1], nc.bar1l = len[1];
-				if (bar[2])
-					nc.bar2 = bar[2], nc.bar2l = len[2];
-				else
-					nc.bar2 = bar[3], nc.bar2l = len[3];
-				nc.bar0 &= ~0xf;
-				nc.bar1 &= ~0xf;
-				nc.bar2 &= ~0xf;
-				nc.i2cip = -1;
-				nc.ctx = rnndec_newcontext(db);
-				nc.ctx->colors = colors;
-				for (i = 0; i < 10; i++)
-					nc.i2cb[i].last = 7;
-				ADDARRAY(cctx, nc);
+		const struct bintrace_rec *rec = NULL;
+		const char *text;
+		uint64_t addr, value;
+		int width;
+		char op = 0;
+		if (binary) {
+			if (!(rec = bintrace_next(&bt, &text)))
+				break;
+			if (rec->type == BINTRACE_READ || rec->type == BINTRACE_WRITE) {
+				op = rec->type == BINTRACE_WRITE ? 'W' : 'R';
+				width = rec->width;
+				/* ns to s is exact enough to print the very same timestamps */
+				timestamp = rec->time / 1e9;
+				addr = rec->addr;
+				value = rec->value;
 			}
-			printf ("%s", line);
-		} else if (!strncmp(line, "W ", 2) || !strncmp(line, "R ", 2)) {
-			int skip = 0;
-			static double timestamp, timestamp_old = 0;
-			uint64_t addr, value;
-			int width;
-			int cci;
-			sscanf (line, "%*s %d %lf %*d %"SCNx64" %"SCNx64, &width, &timestamp, &addr, &value);
-			width *= 8;
-
-			/* Add a SLEEP line when two mmio accesses are more distant than 100µs */
-			if (!sleep_disabled && timestamp_old > 0 && (timestamp - timestamp_old) > 0.0001)
-				printf("SLEEP %lfms\n", (timestamp - timestamp_old)*1000.0);
-			timestamp_old = timestamp;
-
-			for (cci = 0; cci < cctxnum; cci++) {
-				struct cctx *cc = &cctx[cci];
-				if (cc->bar0 && addr >= cc->bar0 && addr < cc->bar0+cc->bar0l) {
-					addr -= cc->bar0;
-					if (cc->hwsqip && addr != cc->hwsqnext) {
-						struct varinfo *var = hwsq_var_nv17;
-						if (cc->chipset >= 0x41)
-							var = hwsq_var_nv41;
-						if (cc->arch == 5)
-							var = hwsq_var_nv50;
-						envydis(hwsq_isa, stdout, cc->hwsq, 0, cc->hwsqnext & 0x3fc, var, 0, 0, 0, colors);
-						cc->hwsqip = 0;
-					}
-					if (addr == 0 && !cc->chdone) {
-						char chname[5];
-						if (value & 0x0f000000)
-							snprintf(chname, 5, "NV%02"PRIX64, (value >> 20) & 0xff);
-						else if (value & 0x0000f000)
-							snprintf(chname, 5, "NV%02"PRIX64, ((value >> 20) & 0xf) + 4);
-						else
-							snprintf(chname, 5, "NV%02"PRIX64, ((value >> 16) & 0xf));
-						rnndec_varadd(cc->ctx, "chipset", chname);
-						switch ((value >> 20) & 0xf0) {
-							case 0:
-								cc->arch = 0;
-								break;
-							case 0x10:
-								cc->arch = 1;
-								break;
-							case 0x20:
-								cc->arch = 2;
-								break;
-							case 0x30:
-								cc->arch = 3;
-								break;
-							case 0x40:
-							case 0x60:
-								cc->arch = 4;
-								break;
-							case 0x50:
-							case 0x80:
-							case 0x90:
-							case 0xa0:
-								cc->arch = 5;
-								break;
-							case 0xc0:
-							case 0xd0:
-							case 0xe0:
-								cc->arch = 6;
-								break;
-						}
-						cc->chipset = (value >> 20) & 0xff;
-					} else if (cc->arch >= 5 && addr == 0x1700) {
-						cc->praminbase = value << 16;
-					} else if (cc->arch == 5 && addr == 0x1704) {
-						cc->fakechan = (value & 0xfffffff) << 12;
-					} else if (cc->arch == 5 && addr == 0x170c) {
-						cc->ramins = (value & 0xffff) << 4;
-					} else if (cc->arch >= 6 && addr == 0x1714) {
-						cc->ramins = (value & 0xfffffff) << 12;
-					} else if (addr == 0x6013d4) {
-						cc->crx0 = value & 0xff;
-					} else if (addr == 0x6033d4) {
-						cc->crx1 = value & 0xff;
-					} else if (addr == 0x6013d5) {
-						struct rnndecaddrinfo *ai = rnndec_decodeaddr(cc->ctx, crdom, cc->crx0, line[0] == 'W');
-						char *decoded_val = rnndec_decodeval(cc->ctx, ai->typeinfo, value, ai->width);
-						printf ("[%d] %lf CRTC0 %c     0x%02x       0x%02"PRIx64" %s %s %s\n", cci, timestamp, line[0], cc->crx0, value, ai->name, line[0]=='W'?"<=":"=>", decoded_val);
-						free(ai->name);
-						free(ai);
-						free(decoded_val);
-						skip = 1;
-					} else if (addr == 0x6033d5) {
-						struct rnndecaddrinfo *ai = rnndec_decodeaddr(cc->ctx, crdom, cc->crx1, line[0] == 'W');
-						char *decoded_val = rnndec_decodeval(cc->ctx, ai->typeinfo, value, ai->width);
-						printf ("[%d] %lf CRTC1 %c     0x%02x       0x%02"PRIx64" %s %s %s\n", cci, timestamp, line[0], cc->crx1, value, ai->name, line[0]=='W'?"<=":"=>", decoded_val);
-						free(ai->name);
-						free(ai);
-						free(decoded_val);
-						skip = 1;
-					} else if (cc->arch >= 5 && (addr & 0xfff000) == 0xe000) {
-						int bus = i2c_bus_num(addr);
-						if (bus != -1) {
-							if (cc->i2cip != bus) {
-								if (cc->i2cip != -1)
-									printf ("\n");
-								struct rnndecaddrinfo *ai = rnndec_decodeaddr(cc->ctx, mmiodom, addr, line[0] == 'W');
-								printf ("[%d] I2C      0x%06"PRIx64"            %s ", cci, addr, ai->name);
-								free(ai->name);
-								free(ai);
-								cc->i2cip = bus;
-							}
-							if (line[0] == 'R') {
-								doi2cr(cc, &cc->i2cb[bus], value);
-							} else {
-								doi2cw(cc, &cc->i2cb[bus], value);
-							}
-							skip = 1;
-						}
-					} else if ((addr & 0xfff000) == 0x9000 && (cc->i2cip != -1)) {
-						/* ignore PTIMER meddling during I2C */
-						skip = 1;
-					} else if (addr == 0x1400 || addr == 0x80000 || addr == cc->hwsqnext) {
-						if (!cc->hwsqip) {
-							struct rnndecaddrinfo *ai = rnndec_decodeaddr(cc->ctx, mmiodom, addr, line[0] == 'W');
-							printf ("[%d] HWSQ     0x%06"PRIx64"            %s\n", cci, addr, ai->name);
-							free(ai->name);
-							free(ai);
-						}
-						cc->hwsq[(addr & 0x1fc) + 0] = value;
-						cc->hwsq[(addr & 0x1fc) + 1] = value >> 8;
-						cc->hwsq[(addr & 0x1fc) + 2] = value >> 16;
-						cc->hwsq[(addr & 0x1fc) + 3] = value >> 24;
-						cc->hwsqip = 1;
-						cc->hwsqnext = addr + 4;
-						skip = 1;
-					} else if (addr == 0x400324 && cc->arch >= 4 && cc->arch <= 5) {
-						cc->ctxpos = value;
-					} else if (addr == 0x400328 && cc->arch >= 4 && cc->arch <= 5) {
-						uint8_t param[4];
-						param[0] = value;
-						param[1] = value >> 8;
-						param[2] = value >> 16;
-						param[3] = value >> 24;
-						struct rnndecaddrinfo *ai = rnndec_decodeaddr(cc->ctx, mmiodom, addr, line[0] == 'W');
-						printf ("[%d] MMIO%d %c 0x%06"PRIx64" 0x%08"PRIx64" %s %s ", cci, width, line[0], addr, value, ai->name, line[0]=='W'?"<=":"=>");
-						envydis(ctx_isa, stdout, param, cc->ctxpos, 4, (cc->arch == 5 ? ctx_var_nv50 : ctx_var_nv40), 0, 0, 0, colors);
-						cc->ctxpos++;
-						free(ai->name);
-						free(ai);
-						skip = 1;
-					}
-					if (!skip && (cc->i2cip != -1)) {
-						printf ("\n");
-						cc->i2cip = -1;
-					}
-					if (cc->arch >= 5 && addr >= 0x700000 && addr < 0x800000) {
-						addr -= 0x700000;
-						addr += cc->praminbase;
-						printf ("[%d] %lf, MEM%d %"PRIx64" %s %"PRIx64"\n", cci, timestamp, width, addr, line[0]=='W'?"<=":"=>", value);
-						*findmem(cc, addr) = value;
-					} else if (!skip) {
-						struct rnndecaddrinfo *ai = rnndec_decodeaddr(cc->ctx, mmiodom, addr, line[0] == 'W');
-						if (width == 32 && ai->width == 8) {
-							/* 32-bit write to 8-bit location - split it up */
-							int b;
-							free(ai->name);
-							free(ai);
-							int cnt;
-							for (b = 0; b < 4; b++) {
-								struct rnndecaddrinfo *ai = rnndec_decodeaddr(cc->ctx, mmiodom, addr+b, line[0] == 'W');
-								char *decoded_val = rnndec_decodeval(cc->ctx, ai->typeinfo, value >> b * 8 & 0xff, ai->width);
-								if (b == 0) {
-									printf ("[%d] %lf MMIO%d %c 0x%06"PRIx64" 0x%08"PRIx64" %n%s %s %s\n", cci, timestamp, width, line[0], addr, value, &cnt, ai->name, line[0]=='W'?"<=":"=>", decoded_val);
-								} else {
-									int c;
-									for (c = 0; c < cnt; c++)
-										printf(" ");
-									printf ("%s %s %s\n", ai->name, line[0]=='W'?"<=":"=>", decoded_val);
-								}
-								free(ai->name);
-								free(ai);
-								free(decoded_val);
-							}
-						} else {
-							char *decoded_val = rnndec_decodeval(cc->ctx, ai->typeinfo, value, ai->width);
-							printf ("[%d] %lf MMIO%d %c 0x%06"PRIx64" 0x%08"PRIx64" %s %s %s\n", cci, timestamp, width, line[0], addr, value, ai->name, line[0]=='W'?"<=":"=>", decoded_val);
-							free(ai->name);
-							free(ai);
-							free(decoded_val);
-						}
-					}
-				} else if (cc->bar1 && addr >= cc->bar1 && addr < cc->bar1+cc->bar1l) {
-					addr -= cc->bar1;
-					printf ("[%d] %lf, FB%d %"PRIx64" %s %"PRIx64"\n", cci, timestamp, width, addr, line[0]=='W'?"<=":"=>", value);
-				} else if (cc->bar2 && addr >= cc->bar2 && addr < cc->bar2+cc->bar2l) {
-					addr -= cc->bar2;
-					if (cc->arch >= 6) {
-						uint64_t pd = *findmem(cc, cc->ramins + 0x200);
-						uint64_t pt = *findmem(cc, pd + 4);
-						pt &= 0xfffffff0;
-						pt <<= 8;
-						uint64_t pg = *findmem(cc, pt + (addr/0x1000) * 8);
-						pg &= 0xfffffff0;
-						pg <<= 8;
-						pg += (addr&0xfff);
-						*findmem(cc, pg) = value;
-	//					printf ("%"PRIx64" %"PRIx64" %"PRIx64" %"PRIx64"\n", ramins, pd, pt, pg);
-						printf ("[%d] %lf RAMIN%d %"PRIx64" %"PRIx64" %s %"PRIx64"\n", cci, timestamp, width, addr, pg, line[0]=='W'?"<=":"=>", value);
-					} else if (cc->arch == 5) {
-						uint64_t paddr = addr;
-						paddr += *findmem(cc, cc->fakechan + cc->ramins + 8);
-						paddr += (uint64_t)(*findmem(cc, cc->fakechan + cc->ramins + 12) >> 24) << 32;
-						uint64_t pt = *findmem(cc, cc->fakechan + (cc->chipset == 0x50 ? 0x1400 : 0x200) + ((paddr >> 29) << 3));
-	//					printf ("%#"PRIx64" PT: %#"PRIx64" %#"PRIx64" ", paddr, fakechan + 0x200 + ((paddr >> 29) << 3), pt);
-						uint32_t div = (pt & 2 ? 0x1000 : 0x10000);
-						pt &= 0xfffff000;
-						uint64_t pg = *findmem(cc, pt + ((paddr&0x1ffff000)/div) * 8);
-						uint64_t pgh = *findmem(cc, pt + ((paddr&0x1ffff000)/div) * 8 + 4);
-	//					printf ("PG: %#"PRIx64" %#"PRIx64"\n", pt + ((paddr&0x1ffff000)/div) * 8, pgh << 32 | pg);
-						pg &= 0xfffff000;
-						pg |= (pgh & 0xff) << 32;
-						pg += (paddr & (div-1));
-						*findmem(cc, pg) = value;
-	//					printf ("%"PRIx64" %"PRIx64" %"PRIx64" %"PRIx64"\n", ramins, pd, pt, pg);
-						printf ("[%d] %lf RAMIN%d %"PRIx64" %"PRIx64" %s %"PRIx64"\n", cci, timestamp, width, addr, pg, line[0]=='W'?"<=":"=>", value);
-					} else {
-						printf ("[%d] %lf RAMIN%d %"PRIx64" %s %"PRIx64"\n", cci, timestamp, width, addr, line[0]=='W'?"<=":"=>", value);
-					}
-				}
+		} else {
+			/* yes, static buffer. but mmiotrace lines are bound to have sane length anyway. */
+			if (!fgets(line, sizeof(line), fin))
+				break;
+			text = line;
+			if (!strncmp(line, "W ", 2) || !strncmp(line, "R ", 2)) {
+				op = line[0];
+				sscanf (line, "%*s %d %lf %*d %"SCNx64" %"SCNx64, &width, &timestamp, &addr, &value);
+			}
+		}
+		if (op) {
+			if (idx && accesses && !(accesses % indexstep))
+				index_write(idx, pos, timestamp_old);
+			accesses++;
+			if (!idx) {
+				if (timestamp > totime)
+					break;
+				quiet = timestamp < fromtime;
 			}
+			handle_access(op, width * 8, timestamp, addr, value);
+		} else if (binary ? rec->type == BINTRACE_PCIDEV : !strncmp(line, "PCIDEV ", 7)) {
+			handle_pcidev(text);
 		} else {
-			printf ("%s", line);
+			out ("%s", text);
+		}
+		pos = binary ? bt.pos : pos + strlen(line);
+	}
+	if (idx) {
+		if (fclose(idx)) {
+			perror(indexfile);
+			return 1;
 		}
+		fprintf (stderr, "Indexed %ld accesses, %ld checkpoints.\n", accesses, (accesses - 1) / indexstep);
 	}
+	if (binary)
+		bintrace_close(&bt);
 	return 0;
 }
@@ -26,24 +26,59 @@
 
 #include "rnn.h"
 #include "rnndec.h"
+#include "bintrace.h"
+#include "util.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
 #include <getopt.h>
 
+struct written {
+	uint32_t idx;	/* register slot within the domain */
+	uint32_t val;
+};
+
 struct domain {
 	char name[32];
 	struct rnndomain *dom;
 	uint32_t base, size;
 	int shift;
-	char *writemask;
-	uint32_t *val;
+	/* last value written to each register, in first write order */
+	struct written *written;
+	int writtennum, writtenmax;
+	/* open addressing on idx, 1-based positions in written[] */
+	int *whash;
+	int whashsize;
+};
+
+/*
+ * Regions can overlap, so they're cut into segments at every region
+ * boundary.  Each segment lists the domains covering it in the order the
+ * regions were seen, which is the order find_domain used to try them in.
+ */
+struct segment {
+	uint32_t start, end;	/* end is inclusive, regions can reach 0xffffffff */
+	int *doms;
+	int domsnum, domsmax;
 };
 
-static struct domain domains[16];
-static int domains_count = 0;
+/* find_domain results for recently accessed addresses */
+#define RESCACHE_SIZE 4096
+
+struct rescache {
+	uint32_t addr;
+	uint32_t resaddr;
+	int dom;	/* -1 if not in any domain */
+	int valid;
+};
 
+static struct domain *domains;
+static int domainsnum, domainsmax;
+static struct segment *segs;
+static int segsnum, segsmax;
+static struct rescache rescache[RESCACHE_SIZE];
+static struct rnndecbuf namebuf, valbuf;
 
 static int is_a2xx(const char *name)
 {
@@ -72,33 +107,142 @@ static int is_adreno(const char *name)
 	return is_a2xx(name) || is_a3xx(name) || is_a4xx(name);
 }
 
-static struct domain *find_domain(struct rnndeccontext *ctx, uint32_t *addrp)
+static int seg_cmp(const void *a, const void *b)
 {
-	struct domain *first_domain = NULL; /* if no exact match, pick first closest match */
-	uint32_t addr = *addrp;
-	int i;
-	for (i = 0; i < domains_count; i++) {
-		struct domain *d = &domains[i];
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return x < y ? -1 : x > y;
+}
+
+/* rebuilds the segment table after a new region shows up */
+static void build_segments(void)
+{
+	uint32_t *cuts = malloc(2 * domainsnum * sizeof *cuts);
+	int cutsnum = 0;
+	int i, j;
+	for (i = 0; i < segsnum; i++)
+		free(segs[i].doms);
+	segsnum = 0;
+	for (i = 0; i < domainsnum; i++) {
+		if (!domains[i].size)
+			continue;
+		cuts[cutsnum++] = domains[i].base;
+		if (domains[i].base + domains[i].size)
+			cuts[cutsnum++] = domains[i].base + domains[i].size;
+	}
+	qsort(cuts, cutsnum, sizeof *cuts, seg_cmp);
+	for (i = 0; i < cutsnum; i++) {
+		struct segment seg = { 0 };
+		if (i && cuts[i] == cuts[i-1])
+			continue;
+		seg.start = cuts[i];
+		for (j = i + 1; j < cutsnum && cuts[j] == seg.start; j++);
+		seg.end = j < cutsnum ? cuts[j] - 1 : 0xffffffff;
+		for (j = 0; j < domainsnum; j++) {
+			struct domain *d = &domains[j];
+			if (d->size && d->base <= seg.start && seg.start - d->base < d->size)
+				ADDARRAY(seg.doms, j);
+		}
+		if (seg.domsnum)
+			ADDARRAY(segs, seg);
+	}
+	free(cuts);
+	memset(rescache, 0, sizeof rescache);
+}
 
-		if ((d->base <= addr) && (addr < (d->base + d->size))) {
+static struct segment *find_segment(uint32_t addr)
+{
+	int lo = 0, hi = segsnum;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		if (segs[mid].end < addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < segsnum && segs[lo].start <= addr)
+		return &segs[lo];
+	return NULL;
+}
+
+static struct domain *find_domain_uncached(struct rnndeccontext *ctx, uint32_t *addrp)
+{
+	struct domain *first_domain;
+	struct segment *seg;
+	int i;
+	while (1) {
+		uint32_t addr = *addrp;
+		first_domain = NULL; /* if no exact match, pick first closest match */
+		seg = find_segment(addr);
+		for (i = 0; seg && i < seg->domsnum; i++) {
+			struct domain *d = &domains[seg->doms[i]];
 			if (!d->dom)
 				continue;
 			if (!first_domain)
 				first_domain = d;
-			if (rnndec_checkaddr(ctx, d->dom, (addr - d->base) >> d->shift, 0)) {
+			if (rnndec_checkaddr(ctx, d->dom, (addr - d->base) >> d->shift, 0))
 				return d;
+		}
+		if (first_domain && is_a3xx(first_domain->name)) {
+			/* we appear to have some banked registers: */
+			uint32_t off = addr - first_domain->base;
+			if ((0x9000 <= off) && (off < 0x10000)) {
+				*addrp -= 0x1000;
+				continue;
+			}
+		}
+		return first_domain;
+	}
+}
+
+static struct domain *find_domain(struct rnndeccontext *ctx, uint32_t *addrp)
+{
+	struct rescache *rc = &rescache[(*addrp >> 2) % RESCACHE_SIZE];
+	if (!rc->valid || rc->addr != *addrp) {
+		struct domain *d;
+		rc->addr = *addrp;
+		d = find_domain_uncached(ctx, addrp);
+		rc->resaddr = *addrp;
+		rc->dom = d ? d - domains : -1;
+		rc->valid = 1;
+	}
+	*addrp = rc->resaddr;
+	return rc->dom == -1 ? NULL : &domains[rc->dom];
+}
+
+static void add_written(struct domain *d, uint32_t idx, uint32_t val)
+{
+	struct written w = { idx, val };
+	uint32_t mask = d->whashsize - 1;
+	uint32_t h;
+	int i;
+	if (d->whashsize) {
+		for (h = idx * 0x9e3779b1u & mask; d->whash[h]; h = (h + 1) & mask) {
+			if (d->written[d->whash[h] - 1].idx == idx) {
+				d->written[d->whash[h] - 1].val = val;
+				return;
 			}
 		}
 	}
-	if (first_domain && is_a3xx(first_domain->name)) {
-		/* we appear to have some banked registers: */
-		uint32_t off = addr - first_domain->base;
-		if ((0x9000 <= off) && (off < 0x10000)) {
-			*addrp -= 0x1000;
-			return find_domain(ctx, addrp);
+	ADDARRAY(d->written, w);
+	if (d->writtennum * 2 > d->whashsize) {
+		d->whashsize = d->whashsize ? d->whashsize * 2 : 64;
+		free(d->whash);
+		d->whash = calloc(d->whashsize, sizeof *d->whash);
+		mask = d->whashsize - 1;
+		for (i = 0; i < d->writtennum; i++) {
+			for (h = d->written[i].idx * 0x9e3779b1u & mask; d->whash[h]; h = (h + 1) & mask);
+			d->whash[h] = i + 1;
 		}
+	} else {
+		for (h = idx * 0x9e3779b1u & mask; d->whash[h]; h = (h + 1) & mask);
+		d->whash[h] = d->writtennum;
 	}
-	return first_domain;
+}
+
+static int written_cmp(const void *a, const void *b)
+{
+	const struct written *x = a, *y = b;
+	return x->idx < y->idx ? -1 : x->idx > y->idx;
 }
 
 static int find_region(const char *buf, char *name, uint32_t *base, uint32_t *size)
@@ -152,30 +296,72 @@ static void printval(struct rnndeccontext *ctx, uint32_t addr, uint32_t val, uin
 	struct domain *d = find_domain(ctx, &addr);
 	if (d && d->dom) {
 		uint32_t off = addr - d->base;
-		struct rnndecaddrinfo *ai = rnndec_decodeaddr(ctx, d->dom, off >> d->shift, op);
-		char *decoded_val = rnndec_decodeval(ctx, ai->typeinfo, val, ai->width);
+		struct rnndecaddrinfo ai;
+		rnndec_bufclear(&namebuf);
+		rnndec_bufclear(&valbuf);
+		rnndec_appendaddr(ctx, &namebuf, d->dom, off >> d->shift, op, &ai);
+		rnndec_appendval(ctx, &valbuf, ai.typeinfo, val, ai.width);
 		if (origaddr != addr) {
-			printf("!%9s:%-30s %s", d->dom->name, ai->name, decoded_val);
+			printf("!%9s:%-30s %s", d->dom->name, namebuf.str, valbuf.str);
 		} else {
-			printf("%10s:%-30s %s", d->dom->name, ai->name, decoded_val);
+			printf("%10s:%-30s %s", d->dom->name, namebuf.str, valbuf.str);
 		}
-		free(ai->name);
-		free(ai);
-		free(decoded_val);
 
-		if (op == 1) { /* write */
-			uint32_t idx = off/4;
+		if (op == 1) /* write */
+			add_written(d, off/4, val);
+	} else {
+		printf("%08x %08x", addr, val);
+	}
+}
 
-			if (!d->writemask) {
-				d->writemask = calloc(1, d->size / 8);
-				d->val = calloc(1, d->size);
-			}
+static void handle_region(struct rnndb *db, const char *buf, struct domain r)
+{
+	int j;
+
+	printf("%s", buf);
+	/* special handling for gpu: */
+	if (is_adreno(r.name)) {
+		if (is_a4xx(r.name))
+			sprintf(r.name, "A4XX");
+		else if (is_a3xx(r.name))
+			sprintf(r.name, "A3XX");
+		else
+			sprintf(r.name, "A2XX");
+		r.dom = rnn_finddomain(db, r.name);
+		r.shift = 2;
+		ADDARRAY(domains, r);
+		sprintf(r.name, "AXXX");
+	}
+	r.dom = rnn_finddomain(db, r.name);
+	ADDARRAY(domains, r);
+
+	/* attempt to load hw specific domains: */
+	for (j = 0; domain_suffixes[j]; j++) {
+		r = domains[domainsnum-1];
+		/* a truncated name could find the wrong domain */
+		if (snprintf(r.name, sizeof r.name, "%s_%s", domains[domainsnum-1].name, domain_suffixes[j]) >= sizeof r.name)
+			continue;
+		r.dom = rnn_finddomain(db, r.name);
+		if (r.dom)
+			ADDARRAY(domains, r);
+	}
+	build_segments();
+}
 
-			d->writemask[idx / 8] |= 1 << (idx % 8);
-			d->val[idx] = val;
-		}
+static void handle_reg(struct rnndeccontext *ctx, const char *prefix, int n,
+		uint32_t op, uint32_t addr, uint32_t val, const char *suffix)
+{
+	printf("%.*s %s%c%s ", n, prefix,
+			ctx->colors->regsp,
+			(op == 1) ? 'W' : 'R',
+			ctx->colors->reset);
+
+	printval(ctx, addr, val, op);
+
+	if (suffix) {
+		printf("\t\t%s", suffix);
 	} else {
-		printf("%08x %08x", addr, val);
+		printf("\n");
 	}
 }
 
@@ -212,70 +398,65 @@ int main(int argc, char **argv) {
 	struct rnndeccontext *ctx = rnndec_newcontext(db);
 	ctx->colors = use_colors ? &envy_def_colors : &envy_null_colors;
 
-	FILE *fin = (file==NULL) ? stdin : fopen(file, "r");;
-	if (!fin) {
+	struct bintrace bt;
+	int res = file ? bintrace_open(&bt, file) : 1;
+	int binary = (res == 0);
+	if (res == -1)
+		return 1;
+	if (binary && bt.kind != BINTRACE_MSM) {
+		fprintf (stderr, "%s is not a binary msm trace!\n", file);
+		return 1;
+	}
+
+	FILE *fin = binary ? NULL : (file==NULL) ? stdin : fopen(file, "r");;
+	if (!binary && !fin) {
 		fprintf (stderr, "Failed to open input file!\n");
 		return 1;
 	}
 
 	rnndec_varadd(ctx, "chipset", "MDP40");
 
-	while (1) {
-		char buf[1024];
+	if (binary) {
+		const struct bintrace_rec *rec;
+		const char *text;
 
-		i = domains_count;
+		while ((rec = bintrace_next(&bt, &text))) {
+			struct domain r = { 0 };
+
+			switch (rec->type) {
+			case BINTRACE_REGION:
+				if (find_region(text, r.name, &r.base, &r.size))
+					handle_region(db, text, r);
+				break;
+			case BINTRACE_READ:
+			case BINTRACE_WRITE:
+				/* text is the line prefix, NUL, and the rest of the line */
+				handle_reg(ctx, text, strlen(text), rec->type == BINTRACE_WRITE,
+						rec->addr, rec->value, verbose ? text + strlen(text) + 1 : NULL);
+				break;
+			default:
+				printf("%s", text);
+				break;
+			}
+		}
+		bintrace_close(&bt);
+	}
+
+	while (fin) {
+		char buf[1024];
+		struct domain r = { 0 };
 
 		if (!fgets(buf, sizeof(buf), fin))
 			break;
 
-		if (find_region(buf, domains[i].name, &domains[i].base, &domains[i].size)) {
-			printf("%s", buf);
-			/* special handling for gpu: */
-			if (is_adreno(domains[i].name)) {
-				if (is_a4xx(domains[i].name)) {
-					sprintf(domains[i].name, "A4XX");
-					domains[i].dom = rnn_finddomain(db, domains[i].name);
-				} else if (is_a3xx(domains[i].name)) {
-					sprintf(domains[i].name, "A3XX");
-					domains[i].dom = rnn_finddomain(db, domains[i].name);
-				} else {
-					sprintf(domains[i].name, "A2XX");
-					domains[i].dom = rnn_finddomain(db, domains[i].name);
-				}
-				domains[i].shift = 2;
-				i = ++domains_count;
-				domains[i] = domains[i-1];
-				sprintf(domains[i].name, "AXXX");
-			}
-			domains[i].dom = rnn_finddomain(db, domains[i].name);
-			i = ++domains_count;
-
-			/* attempt to load hw specific domains: */
-			for (j = 0; domain_suffixes[j]; j++) {
-				domains[i] = domains[i-1];
-				sprintf(domains[i].name, "%s_%s", domains[i-1].name, domain_suffixes[j]);
-				domains[i].dom = rnn_finddomain(db, domains[i].name);
-				if (domains[i].dom)
-					i = ++domains_count;
-			}
+		if (find_region(buf, r.name, &r.base, &r.size)) {
+			handle_region(db, buf, r);
 		} else {
 			int n, m;
 			uint32_t op, addr, val;
 
 			if (find_reg(buf, &n, &m, &op, &addr, &val)) {
-
-				printf("%.*s %s%c%s ", n, buf,
-						ctx->colors->regsp,
-						(op == 1) ? 'W' : 'R',
-						ctx->colors->reset);
-
-				printval(ctx, addr, val, op);
-
-				if (verbose) {
-					printf("\t\t%s", buf + m);
-				} else {
-					printf("\n");
-				}
+				handle_reg(ctx, buf, n, op, addr, val, verbose ? buf + m : NULL);
 			} else {
 				printf("%s", buf);
 			}
@@ -283,17 +464,12 @@ int main(int argc, char **argv) {
 	}
 
 	printf("WRITTEN REGISTER SUMMARY\n");
-	for (i = 0; i < domains_count; i++) {
+	for (i = 0; i < domainsnum; i++) {
 		struct domain *d = &domains[i];
-		if (d->writemask) {
-			for (j = 0; j < d->size; j++) {
-				if (d->writemask[j / 8] & (1 << (j % 8))) {
-					uint32_t off = j * 4;
-					uint32_t addr = off + d->base;
-					printval(ctx, addr, d->val[j], 0);
-					printf("\n");
-				}
-			}
+		qsort(d->written, d->writtennum, sizeof *d->written, written_cmp);
+		for (j = 0; j < d->writtennum; j++) {
+			printval(ctx, d->base + d->written[j].idx * 4, d->written[j].val, 0);
+			printf("\n");
 		}
 	}
 
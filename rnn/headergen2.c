@@ -53,6 +53,21 @@ int offsetfnsmax = 0;
 
 int startcol = 64;
 
+/* for -r: every register instance of the domain being printed */
+struct regent {
+	uint64_t addr;
+	int reg;
+	uint64_t idx;
+};
+
+struct regent *regents = NULL;
+int regentsnum = 0;
+int regentsmax = 0;
+
+char **regnames = NULL;
+int regnamesnum = 0;
+int regnamesmax = 0;
+
 struct fout {
 	char *name;
 	FILE *file;
@@ -63,6 +78,10 @@ struct fout *fouts = 0;
 int foutsnum = 0;
 int foutsmax = 0;
 
+struct fout *regfouts = 0;
+int regfoutsnum = 0;
+int regfoutsmax = 0;
+
 static void seekcol (FILE *f, int src, int dst) {
 	if (dst <= src)
 		fprintf (f, "\t");
@@ -206,6 +225,28 @@ static void printtypeinfo (struct rnntypeinfo *ti, struct rnnbitfield *bf,
 		fprintf(dst, ") << %s__SHIFT) & %s__MASK;\n", prefix, prefix);
 		fprintf(dst, "}\n");
 
+		/* and the inverse, extracting the field from a register value */
+		fprintf(dst, "static inline %s %s__UNPACK(uint32_t reg)\n", typename, prefix);
+		fprintf(dst, "{\n");
+		fprintf(dst, "\tuint32_t field = (reg & %s__MASK) >> %s__SHIFT;\n", prefix, prefix);
+		fprintf(dst, "\treturn ");
+		if (intype == RNN_TTYPE_ENUM)
+			fprintf(dst, "(%s)", typename);
+		if (ti->type == RNN_TTYPE_FIXED || ti->type == RNN_TTYPE_INT)
+			fprintf(dst, "((int32_t)(field << %d) >> %d)", 32 - width, 32 - width);
+		else if (ti->type == RNN_TTYPE_FLOAT && width == 32)
+			fprintf(dst, "uif(field)");
+		else if (ti->type == RNN_TTYPE_FLOAT)
+			fprintf(dst, "util_half_to_float(field)");
+		else
+			fprintf(dst, "field");
+		if (ti->shr)
+			fprintf(dst, " * %d", 1 << ti->shr);
+		if (ti->type == RNN_TTYPE_FIXED || ti->type == RNN_TTYPE_UFIXED)
+			fprintf(dst, " / %d.0", (1 << ti->radix));
+		fprintf(dst, ";\n");
+		fprintf(dst, "}\n");
+
 		if (intype == RNN_TTYPE_ENUM)
 			free(typename);
 	}
@@ -226,6 +267,17 @@ static void printbitfield (struct rnnbitfield *bf, int shift) {
 	printtypeinfo (&bf->typeinfo, bf, bf->fullname, bf->low, bf->file);
 }
 
+/* the symbolic name for index i of an enum-indexed array */
+static struct rnnvalue *findindexval (struct rnndelem *elem, int i) {
+	int j;
+	if (!elem->index)
+		return NULL;
+	for (j = 0; j < elem->index->valsnum; j++)
+		if (elem->index->vals[j]->value == i)
+			return elem->index->vals[j];
+	return NULL;
+}
+
 static void printdelem (struct rnndelem *elem, uint64_t offset) {
 	int use_offset_fxn;
 	char *offsetfn = NULL;
@@ -262,32 +314,31 @@ static void printdelem (struct rnndelem *elem, uint64_t offset) {
 				fprintf(dst, "{\n");
 				if (elem->doffset) {
 					fprintf(dst, "\treturn (%s) + (%#" PRIx64 "*idx);\n", elem->doffset, elem->stride);
+				} else if (elem->offsets) {
+					fprintf(dst, "\tstatic const uint32_t offsets[] = {\n");
+					for (i = 0; i < elem->offsetsnum; i++) {
+						struct rnnvalue *val = findindexval(elem, i);
+						if (val)
+							fprintf(dst, "\t\t[%s] = 0x%08" PRIx64 ",\n", val->name, elem->offsets[i]);
+						else
+							fprintf(dst, "\t\t0x%08" PRIx64 ",\n", elem->offsets[i]);
+					}
+					fprintf(dst, "\t};\n");
+					fprintf(dst, "\tif ((uint32_t)idx < %d)\n", elem->offsetsnum);
+					fprintf(dst, "\t\treturn offsets[idx];\n");
+					fprintf(dst, "\treturn INVALID_IDX(idx);\n");
 				} else {
-					int valuesnum = elem->doffsets ? elem->doffsetsnum : elem->offsetsnum;
-
+					/* runtime expressions, can't go in a static table */
 					fprintf(dst, "\tswitch (idx) {\n");
-					for (i = 0; i < valuesnum; i++) {
-						struct rnnvalue *val = NULL;
+					for (i = 0; i < elem->doffsetsnum; i++) {
+						struct rnnvalue *val = findindexval(elem, i);
 						fprintf(dst, "\t\tcase ");
-						if (elem->index) {
-							int j;
-							for (j = 0; j < elem->index->valsnum; j++) {
-								if (elem->index->vals[j]->value == i) {
-									val = elem->index->vals[j];
-									break;
-								}
-							}
-						}
 						if (val) {
 							fprintf(dst, "%s", val->name);
 						} else {
 							fprintf(dst, "%d", i);
 						}
-						if (elem->offsets) {
-							fprintf(dst, ": return 0x%08lx;\n", elem->offsets[i]);
-						} else {
-							fprintf(dst, ": return (%s);\n", elem->doffsets[i]);
-						}
+						fprintf(dst, ": return (%s);\n", elem->doffsets[i]);
 					}
 					fprintf(dst, "\t\tdefault: return INVALID_IDX(idx);\n");
 					fprintf(dst, "\t}\n");
@@ -337,6 +388,144 @@ static void printdelem (struct rnndelem *elem, uint64_t offset) {
 	free(offsetfn);
 }
 
+/* instances are all the (address, flattened index) pairs the parent appears at */
+static void collectregs (struct rnndelem *elem, struct regent *insts, int instsnum) {
+	struct regent *sub;
+	uint64_t i;
+	int j, k, n = 0;
+	int reg = -1;
+	/* runtime offsets have no address to put in the table */
+	if (elem->varinfo.dead || elem->doffset || elem->doffsets || elem->type == RNN_ETYPE_USE_GROUP)
+		return;
+	if (elem->type == RNN_ETYPE_REG && elem->name) {
+		reg = regnamesnum;
+		ADDARRAY(regnames, elem->fullname);
+	}
+	sub = calloc(instsnum * elem->length + 1, sizeof *sub);
+	for (k = 0; k < instsnum; k++) {
+		for (i = 0; i < elem->length; i++) {
+			struct regent e = insts[k];
+			e.addr += elem->offset;
+			if (elem->offsets) {
+				if (i >= elem->offsetsnum)
+					break;
+				e.addr += elem->offsets[i];
+			} else {
+				e.addr += i * elem->stride;
+			}
+			if (elem->length != 1)
+				e.idx = e.idx * elem->length + i;
+			e.reg = reg;
+			if (reg != -1)
+				ADDARRAY(regents, e);
+			sub[n++] = e;
+		}
+	}
+	for (j = 0; j < elem->subelemsnum; j++)
+		collectregs(elem->subelems[j], sub, n);
+	free(sub);
+}
+
+static int regentcmp (const void *va, const void *vb) {
+	const struct regent *a = va, *b = vb;
+	if (a->addr != b->addr)
+		return a->addr < b->addr ? -1 : 1;
+	return a->reg - b->reg;
+}
+
+static void printhead(struct fout f, struct rnndb *db);
+
+static FILE *findregfout (char *file, struct rnndb *db) {
+	int i;
+	for (i = 0; i < regfoutsnum; i++)
+		if (!strcmp(regfouts[i].name, file))
+			return regfouts[i].file;
+	char *dstname;
+	asprintf(&dstname, "%s.regs.h", file);
+	struct fout f = { file, fopen(dstname, "w") };
+	if (!f.file) {
+		perror(dstname);
+		exit(1);
+	}
+	free(dstname);
+	char *pretty = strrchr(file, '/');
+	pretty = pretty ? pretty + 1 : file;
+	asprintf(&f.guard, "%s_REGS", pretty);
+	for (i = 0; f.guard[i]; i++)
+		if (isalnum(f.guard[i]))
+			f.guard[i] = toupper(f.guard[i]);
+		else
+			f.guard[i] = '_';
+	ADDARRAY(regfouts, f);
+	printhead(f, db);
+	fprintf(f.file, "#ifndef RNN_REGENT_DEFINED\n");
+	fprintf(f.file, "#define RNN_REGENT_DEFINED\n");
+	fprintf(f.file, "/* a register instance: address, index into the domain's regnames and\n");
+	fprintf(f.file, " * index into the enclosing arrays, flattened outermost first */\n");
+	fprintf(f.file, "struct rnn_regent {\n");
+	fprintf(f.file, "\tuint32_t addr;\n");
+	fprintf(f.file, "\tuint16_t reg;\n");
+	fprintf(f.file, "\tuint16_t idx;\n");
+	fprintf(f.file, "};\n");
+	fprintf(f.file, "#endif\n\n");
+	return f.file;
+}
+
+/*
+ * Address -> register table for a domain, sorted by address, plus a binary
+ * search over it.  Registers that share an address (variants) are adjacent,
+ * the lookup returns the first one.
+ */
+static void printregtable (struct rnndomain *dom, struct rnndb *db) {
+	struct regent top = { 0, -1, 0 };
+	int i;
+	char *pfx;
+	FILE *dst;
+	regentsnum = 0;
+	regnamesnum = 0;
+	for (i = 0; i < dom->subelemsnum; i++)
+		collectregs(dom->subelems[i], &top, 1);
+	if (!regentsnum)
+		return;
+	qsort(regents, regentsnum, sizeof *regents, regentcmp);
+	if (regnamesnum > 0x10000 || regents[regentsnum-1].addr > 0xffffffffull) {
+		fprintf(stderr, "%s: too big for a register table\n", dom->name);
+		exit(1);
+	}
+	for (i = 0; i < regentsnum; i++)
+		if (regents[i].idx > 0xffff) {
+			fprintf(stderr, "%s: array index too big for a register table\n", regnames[regents[i].reg]);
+			exit(1);
+		}
+	pfx = strdup(dom->fullname);
+	for (i = 0; pfx[i]; i++)
+		pfx[i] = tolower(pfx[i]);
+	dst = findregfout(dom->file, db);
+	fprintf(dst, "static const char *const %s_regnames[] = {\n", pfx);
+	for (i = 0; i < regnamesnum; i++)
+		fprintf(dst, "\t\"%s\",\n", regnames[i]);
+	fprintf(dst, "};\n\n");
+	fprintf(dst, "static const struct rnn_regent %s_regs[] = {\n", pfx);
+	for (i = 0; i < regentsnum; i++)
+		fprintf(dst, "\t{ 0x%08" PRIx64 ", %d, %" PRIu64 " },\n", regents[i].addr, regents[i].reg, regents[i].idx);
+	fprintf(dst, "};\n\n");
+	fprintf(dst, "static inline const struct rnn_regent *%s_reglookup(uint32_t addr)\n", pfx);
+	fprintf(dst, "{\n");
+	fprintf(dst, "\tunsigned lo = 0, hi = %d;\n", regentsnum);
+	fprintf(dst, "\twhile (lo < hi) {\n");
+	fprintf(dst, "\t\tunsigned mid = (lo + hi) / 2;\n");
+	fprintf(dst, "\t\tif (%s_regs[mid].addr < addr)\n", pfx);
+	fprintf(dst, "\t\t\tlo = mid + 1;\n");
+	fprintf(dst, "\t\telse\n");
+	fprintf(dst, "\t\t\thi = mid;\n");
+	fprintf(dst, "\t}\n");
+	fprintf(dst, "\tif (lo < %d && %s_regs[lo].addr == addr)\n", regentsnum, pfx);
+	fprintf(dst, "\t\treturn &%s_regs[lo];\n", pfx);
+	fprintf(dst, "\treturn NULL;\n");
+	fprintf(dst, "}\n\n");
+	free(pfx);
+}
+
 static void print_file_info_(FILE *dst, struct stat* sb, struct tm* tm)
 {
 	char timestr[64];
@@ -411,16 +600,26 @@ static void printhead(struct fout f, struct rnndb *db) {
 
 int main(int argc, char **argv) {
 	struct rnndb *db;
-	int i, j;
-
-	if (argc < 2) {
-		fprintf(stderr, "Usage:\n\theadergen database-file\n");
+	int i, j, c;
+	int regtable = 0;
+
+	while ((c = getopt (argc, argv, "r")) != -1)
+		switch (c) {
+			case 'r':
+				regtable = 1;
+				break;
+			default:
+				exit(1);
+		}
+	if (optind >= argc) {
+		fprintf(stderr, "Usage:\n\theadergen2 [-r] database-file\n");
+		fprintf(stderr, "\t-r: also write <file>.regs.h address to register tables\n");
 		exit(1);
 	}
 
 	rnn_init();
 	db = rnn_newdb();
-	rnn_parsefile (db, argv[1]);
+	rnn_parsefile (db, argv[optind]);
 	rnn_prepdb (db);
 	for(i = 0; i < db->filesnum; ++i) {
 		char *dstname = malloc(strlen(db->files[i]) + 3);
@@ -481,9 +680,14 @@ int main(int argc, char **argv) {
 		for (j = 0; j < db->domains[i]->subelemsnum; j++) {
 			printdelem(db->domains[i]->subelems[j], 0);
 		}
+		if (regtable)
+			printregtable(db->domains[i], db);
 	}
 	for(i = 0; i < foutsnum; ++i) {
 		fprintf (fouts[i].file, "\n#endif /* %s */\n", fouts[i].guard);
 	}
+	for(i = 0; i < regfoutsnum; ++i) {
+		fprintf (regfouts[i].file, "#endif /* %s */\n", regfouts[i].guard);
+	}
 	return db->estatus;
 }
@@ -147,13 +147,15 @@ int main(int argc, char **argv) {
 		struct rnndomain *dom = rnn_finddomain (db, name);
 
 		if (dom) {
-			struct rnndecaddrinfo *info = rnndec_decodeaddr(vc, dom, reg, 0);
-			if (info && info->typeinfo)
-				printf ("%s => %s\n", info->name, rnndec_decodeval(vc, info->typeinfo, val, info->width));
-			else if (info)
-				printf ("%s\n", info->name);
-			else
-				return 1;
+			struct rnndecbuf buf = { 0 };
+			struct rnndecaddrinfo info;
+			rnndec_appendaddr(vc, &buf, dom, reg, 0, &info);
+			if (info.typeinfo) {
+				rnndec_bufprintf(&buf, " => ");
+				rnndec_appendval(vc, &buf, info.typeinfo, val, info.width);
+			}
+			printf ("%s\n", buf.str);
+			rnndec_buffree(&buf);
 			return 0;
 		} else {
 			fprintf(stderr, "Not a domain: '%s'\n", name);
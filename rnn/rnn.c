@@ -35,6 +35,11 @@
 #include <limits.h>
 #include <ctype.h>
 #include <stdio.h>
+#include <stdarg.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <time.h>
 #include "rnn.h"
 #include "rnn_path.h"
 #include "util.h"
@@ -870,28 +875,330 @@ static int trytop (struct rnndb *db, char *file, xmlNode *node) {
 	return 0;
 }
 
-void rnn_parsefile (struct rnndb *db, char *file_orig) {
-	int i;
+/*
+ * Loading a database tree is done in three steps: the files reachable through
+ * <import> are found by a plain text scan, parsed by libxml2 on several
+ * threads, and then walked exactly as if they were parsed one by one in
+ * import order.  The text scan can only guess - it also sees commented out
+ * imports - so the walk treats the parsed documents as a cache and parses
+ * anything it doesn't find there itself.  libxml2 messages for each file are
+ * buffered and printed when the walk gets to it, so output doesn't change.
+ *
+ * With db->cache set, the documents are kept for the next load instead of
+ * being freed after the walk, together with the file's stat and a hash of
+ * its contents to tell when they go stale.
+ */
+struct rnnpfile {
 	char *fname;
-	const char *rnn_path = getenv("RNN_PATH");
+	xmlDocPtr doc;
+	char *errs;
+	size_t errslen;
+	int taken;
+	struct stat st;
+	uint64_t hash;
+	int racy;	/* st is too recent to tell a later write apart */
+	int valid;	/* cache only: doc and errs match what's on disk */
+	int fresh;	/* cache only: parsed by the current load */
+};
+
+struct rnnprefetch {
+	struct rnnpfile *files;
+	int filesnum;
+	int filesmax;
+	int next;
+};
 
+static char *rnn_findfile (const char *file_orig, FILE **pfile) {
+	const char *rnn_path = getenv("RNN_PATH");
+	char *fname;
 	if (!rnn_path)
 		rnn_path = RNN_DEF_PATH;
+	*pfile = find_in_path(file_orig, rnn_path, &fname);
+	return *pfile ? fname : 0;
+}
+
+/* FNV-1a */
+static uint64_t filehash (const char *buf, size_t len) {
+	uint64_t h = 0xcbf29ce484222325ull;
+	size_t i;
+	for (i = 0; i < len; i++) {
+		h ^= (unsigned char)buf[i];
+		h *= 0x100000001b3ull;
+	}
+	return h;
+}
+
+/*
+ * Reads the whole file, NUL-terminated.  The stat is taken before reading:
+ * a write racing with us then at worst makes the next poll hash the file
+ * once more, instead of going unnoticed.  Same for a write landing in the
+ * same timestamp tick as st - mtime is only as fine as the kernel's clock
+ * tick, so a file modified in the last second or so gets hashed regardless.
+ */
+static char *readfile (FILE *file, struct rnnpfile *pfile, size_t *plen) {
+	char *buf = 0;
+	size_t len = 0, max = 0, n;
+	fstat(fileno(file), &pfile->st);
+	pfile->racy = pfile->st.st_mtime >= time(0) - 1;
+	do {
+		if (len + 0x1000 + 1 > max) {
+			max = max ? max * 2 : 0x10000;
+			buf = realloc(buf, max);
+		}
+		n = fread(buf + len, 1, max - len - 1, file);
+		len += n;
+	} while (n);
+	buf[len] = 0;
+	pfile->hash = filehash(buf, len);
+	*plen = len;
+	return buf;
+}
+
+static void prefetch_scan (struct rnndb *db, struct rnnprefetch *pf, const char *file_orig) {
+	struct rnnpfile pfile = { 0 };
+	FILE *file;
+	char *fname = rnn_findfile(file_orig, &file);
+	char *buf, *p;
+	size_t len;
+	int i;
+	if (!fname)
+		return;
+	for (i = 0; i < db->filesnum; i++)
+		if (!strcmp(db->files[i], fname))
+			goto skip;
+	for (i = 0; i < pf->filesnum; i++)
+		if (!strcmp(pf->files[i].fname, fname))
+			goto skip;
+	pfile.fname = fname;
+	buf = readfile(file, &pfile, &len);
+	fclose(file);
+	ADDARRAY(pf->files, pfile);
+	for (p = buf; (p = strstr(p, "<import")); ) {
+		char *end = strchr(p, '>');
+		char *attr = strstr(p, "file=");
+		char quote, *fend;
+		p += 7;
+		if (!end || !attr || attr > end)
+			continue;
+		quote = attr[5];
+		if (quote != '"' && quote != '\'')
+			continue;
+		fend = strchr(attr + 6, quote);
+		if (!fend || fend > end)
+			continue;
+		*fend = 0;
+		prefetch_scan(db, pf, attr + 6);
+		p = fend + 1;
+	}
+	free(buf);
+	return;
+skip:
+	fclose(file);
+	free(fname);
+}
+
+static void prefetch_error (void *ctx, const char *msg, ...) {
+	struct rnnpfile *pfile = ctx;
+	va_list ap;
+	int len;
+	va_start(ap, msg);
+	len = vsnprintf(0, 0, msg, ap);
+	va_end(ap);
+	if (len < 0)
+		return;
+	pfile->errs = realloc(pfile->errs, pfile->errslen + len + 1);
+	va_start(ap, msg);
+	vsnprintf(pfile->errs + pfile->errslen, len + 1, msg, ap);
+	va_end(ap);
+	pfile->errslen += len;
+}
+
+static void *prefetch_worker (void *arg) {
+	struct rnnprefetch *pf = arg;
+	int i;
+	while ((i = __sync_fetch_and_add(&pf->next, 1)) < pf->filesnum) {
+		/* the handler is per thread */
+		xmlSetGenericErrorFunc(&pf->files[i], prefetch_error);
+		pf->files[i].doc = xmlParseFile(pf->files[i].fname);
+	}
+	xmlSetGenericErrorFunc(0, 0);
+	return 0;
+}
+
+static struct rnnprefetch *prefetch (struct rnndb *db, const char *file_orig, int jobs) {
+	struct rnnprefetch *pf = calloc(sizeof *pf, 1);
+	pthread_t *threads;
+	int i;
+	prefetch_scan(db, pf, file_orig);
+	if (jobs > pf->filesnum)
+		jobs = pf->filesnum;
+	threads = calloc(jobs, sizeof *threads);
+	for (i = 0; i < jobs; i++)
+		if (pthread_create(&threads[i], 0, prefetch_worker, pf))
+			break;
+	jobs = i;
+	/* whatever's left if we couldn't get any threads */
+	if (!jobs)
+		prefetch_worker(pf);
+	for (i = 0; i < jobs; i++)
+		pthread_join(threads[i], 0);
+	free(threads);
+	return pf;
+}
+
+static void prefetch_free (struct rnnprefetch *pf) {
+	int i;
+	for (i = 0; i < pf->filesnum; i++) {
+		if (!pf->files[i].taken)
+			xmlFreeDoc(pf->files[i].doc);
+		free(pf->files[i].fname);
+		free(pf->files[i].errs);
+	}
+	free(pf->files);
+	free(pf);
+}
+
+/* finds or adds the cache entry for fname, which is replaced by the cache's copy */
+static struct rnnpfile *cachefile (struct rnncache *cache, char **pfname) {
+	struct rnnpfile cf = { 0 };
+	int i;
+	for (i = 0; i < cache->filesnum; i++)
+		if (!strcmp(cache->files[i].fname, *pfname)) {
+			free(*pfname);
+			*pfname = cache->files[i].fname;
+			return &cache->files[i];
+		}
+	cf.fname = *pfname;
+	ADDARRAY(cache->files, cf);
+	return &cache->files[cache->filesnum - 1];
+}
+
+static void cacheparse (struct rnnpfile *cf) {
+	xmlGenericErrorFunc handler = xmlGenericError;
+	void *ctx = xmlGenericErrorContext;
+	FILE *file = fopen(cf->fname, "r");
+	if (file) {
+		size_t len;
+		free(readfile(file, cf, &len));
+		fclose(file);
+	} else {
+		memset(&cf->st, 0, sizeof cf->st);
+		cf->racy = 0;
+	}
+	xmlSetGenericErrorFunc(cf, prefetch_error);
+	cf->doc = xmlParseFile(cf->fname);
+	xmlSetGenericErrorFunc(ctx, handler);
+	cf->valid = cf->fresh = 1;
+}
+
+static void cachedrop (struct rnnpfile *cf) {
+	xmlFreeDoc(cf->doc);
+	free(cf->errs);
+	cf->doc = 0;
+	cf->errs = 0;
+	cf->errslen = 0;
+	cf->valid = 0;
+}
+
+struct rnncache *rnn_newcache() {
+	struct rnncache *cache = calloc(sizeof *cache, 1);
+	return cache;
+}
+
+static int samestat (struct stat *a, struct stat *b) {
+	return a->st_dev == b->st_dev && a->st_ino == b->st_ino && a->st_size == b->st_size &&
+		a->st_mtim.tv_sec == b->st_mtim.tv_sec && a->st_mtim.tv_nsec == b->st_mtim.tv_nsec;
+}
+
+/*
+ * Checks every cached file against the disk and drops the documents of
+ * those whose contents changed.  Returns how many changed - touching or
+ * rewriting a file with the same contents doesn't count.
+ */
+int rnn_pollcache (struct rnncache *cache) {
+	int i, res = 0;
+	for (i = 0; i < cache->filesnum; i++) {
+		struct rnnpfile *cf = &cache->files[i];
+		struct rnnpfile now = { 0 };
+		FILE *file;
+		if (stat(cf->fname, &now.st))
+			memset(&now.st, 0, sizeof now.st);
+		if (samestat(&now.st, &cf->st) && !cf->racy)
+			continue;
+		if (cf->valid && (file = fopen(cf->fname, "r"))) {
+			size_t len;
+			free(readfile(file, &now, &len));
+			fclose(file);
+			if (now.hash == cf->hash) {
+				cf->st = now.st;
+				cf->racy = now.racy;
+				continue;
+			}
+		}
+		cf->st = now.st;
+		cf->racy = 0;
+		cachedrop(cf);
+		res++;
+	}
+	return res;
+}
+
+static xmlDocPtr loaddoc (struct rnndb *db, char *fname, struct rnnpfile *cf) {
+	struct rnnpfile *pfile = 0;
+	int i;
+	if (cf && cf->valid) {
+		pfile = cf;
+	} else if (db->prefetch) {
+		struct rnnprefetch *pf = db->prefetch;
+		for (i = 0; i < pf->filesnum; i++)
+			if (!pf->files[i].taken && !strcmp(pf->files[i].fname, fname)) {
+				pfile = &pf->files[i];
+				pfile->taken = 1;
+				break;
+			}
+		if (pfile && cf) {
+			cf->doc = pfile->doc;
+			cf->errs = pfile->errs;
+			cf->errslen = pfile->errslen;
+			cf->st = pfile->st;
+			cf->hash = pfile->hash;
+			cf->racy = pfile->racy;
+			cf->valid = cf->fresh = 1;
+			pfile->errs = 0;
+			pfile = cf;
+		}
+	}
+	if (!pfile && cf) {
+		cacheparse(cf);
+		pfile = cf;
+	}
+	if (!pfile)
+		return xmlParseFile(fname);
+	if (pfile->errs)
+		xmlGenericError(xmlGenericErrorContext, "%s", pfile->errs);
+	return pfile->doc;
+}
 
-	FILE *file = find_in_path(file_orig, rnn_path, &fname);
-	if (!file) {
+static void parsefile (struct rnndb *db, char *file_orig) {
+	int i;
+	FILE *file;
+	struct rnnpfile *cf = 0;
+	char *fname = rnn_findfile(file_orig, &file);
+	if (!fname) {
 		fprintf (stderr, "%s: couldn't find database file. Please set the env var RNN_PATH.\n", file_orig);
 		db->estatus = 1;
 		return;
 	}
 	fclose(file);
+	if (db->cache)
+		cf = cachefile(db->cache, &fname);
 
 	for (i = 0; i < db->filesnum; i++)
 		if (!strcmp(db->files[i], fname))
 			return;
 		
 	ADDARRAY(db->files, fname);
-	xmlDocPtr doc = xmlParseFile(fname);
+	xmlDocPtr doc = loaddoc(db, fname, cf);
 	if (!doc) {
 		fprintf (stderr, "%s: couldn't open database file. Please set the env var RNN_PATH.\n", fname);
 		db->estatus = 1;
@@ -916,7 +1223,23 @@ void rnn_parsefile (struct rnndb *db, char *file_orig) {
 		}
 		root = root->next;
 	}
-	xmlFreeDoc(doc);
+	if (!cf)
+		xmlFreeDoc(doc);
+}
+
+void rnn_parsefile (struct rnndb *db, char *file_orig) {
+	int jobs = db->jobs;
+	if (!jobs)
+		jobs = sysconf(_SC_NPROCESSORS_ONLN);
+	if (db->prefetch || jobs <= 1 || (db->cache && db->cache->filesnum)) {
+		/* an import, nothing to gain from threads, or a reload */
+		parsefile(db, file_orig);
+		return;
+	}
+	db->prefetch = prefetch(db, file_orig, jobs);
+	parsefile(db, file_orig);
+	prefetch_free(db->prefetch);
+	db->prefetch = 0;
 }
 
 static struct rnnvalue *copyvalue (struct rnnvalue *val, char *file) {
@@ -1187,6 +1510,8 @@ static void preptypeinfo(struct rnndb *db, struct rnntypeinfo *ti, char *prefix,
 		prepbitfield(db,  ti->bitfields[i], prefix, vi);
 	for (i = 0; i < ti->valsnum; i++)
 		prepvalue(db, ti->vals[i], prefix, vi);
+	if (ti->type == RNN_TTYPE_INLINE_ENUM && !ti->vindex)
+		ti->vindex = rnn_valindex(ti->vals, ti->valsnum);
 }
 
 static void prepbitfield(struct rnndb *db, struct rnnbitfield *bf, char *prefix, struct rnnvarinfo *parvi) {
@@ -1246,6 +1571,9 @@ static void prepdelem(struct rnndb *db, struct rnndelem *elem, char *prefix, str
 }
 
 static void prepdomain(struct rnndb *db, struct rnndomain *dom) {
+	if (dom->prepared)
+		return;
+	dom->prepared = 1;
 	prepvarinfo (db, dom->name, &dom->varinfo, 0);
 	int i;
 	for (i = 0; i < dom->subelemsnum; i++)
@@ -1256,6 +1584,7 @@ static void prepdomain(struct rnndb *db, struct rnndomain *dom) {
 static void prepenum(struct rnndb *db, struct rnnenum *en) {
 	if (en->prepared)
 		return;
+	en->prepared = 1;
 	prepvarinfo (db, en->name, &en->varinfo, 0);
 	int i;
 	if (en->isinline)
@@ -1263,10 +1592,13 @@ static void prepenum(struct rnndb *db, struct rnnenum *en) {
 	for (i = 0; i < en->valsnum; i++)
 		prepvalue(db, en->vals[i], en->bare?0:en->name, &en->varinfo);
 	en->fullname = catstr(en->varinfo.prefix, en->name);
-	en->prepared = 1;
+	en->vindex = rnn_valindex(en->vals, en->valsnum);
 }
 
 static void prepbitset(struct rnndb *db, struct rnnbitset *bs) {
+	if (bs->prepared)
+		return;
+	bs->prepared = 1;
 	prepvarinfo (db, bs->name, &bs->varinfo, 0);
 	int i;
 	if (bs->isinline)
@@ -1277,19 +1609,703 @@ static void prepbitset(struct rnndb *db, struct rnnbitset *bs) {
 }
 
 static void prepspectype(struct rnndb *db, struct rnnspectype *st) {
+	if (st->prepared)
+		return;
+	st->prepared = 1;
 	preptypeinfo(db, &st->typeinfo, st->name, 0, 32, st->file); // XXX doesn't exactly make sense...
 }
 
+static struct rnnvalue **sortvals;
+
+static int valcmp(const void *a, const void *b) {
+	uint64_t va = sortvals[*(const int *)a]->value;
+	uint64_t vb = sortvals[*(const int *)b]->value;
+	if (va != vb)
+		return va < vb ? -1 : 1;
+	return *(const int *)a - *(const int *)b;
+}
+
+struct rnnvalindex *rnn_valindex (struct rnnvalue **vals, int valsnum) {
+	struct rnnvalindex *res = calloc (sizeof *res, 1);
+	uint64_t lo = UINT64_MAX, hi = 0;
+	int i, n = 0;
+	res->vals = vals;
+	res->next = malloc((valsnum ? valsnum : 1) * sizeof *res->next);
+	for (i = 0; i < valsnum; i++) {
+		res->next[i] = -1;
+		if (!vals[i]->valvalid)
+			continue;
+		if (vals[i]->value < lo)
+			lo = vals[i]->value;
+		if (vals[i]->value > hi)
+			hi = vals[i]->value;
+		n++;
+	}
+	if (!n)
+		return res;
+	if (hi - lo < 4 * n + 16) {
+		res->base = lo;
+		res->densenum = hi - lo + 1;
+		res->dense = malloc(res->densenum * sizeof *res->dense);
+		for (i = 0; i < res->densenum; i++)
+			res->dense[i] = -1;
+		/* walk backwards so that chains come out in database order */
+		for (i = valsnum - 1; i >= 0; i--) {
+			if (!vals[i]->valvalid)
+				continue;
+			res->next[i] = res->dense[vals[i]->value - lo];
+			res->dense[vals[i]->value - lo] = i;
+		}
+		return res;
+	}
+	int *order = malloc(n * sizeof *order);
+	n = 0;
+	for (i = 0; i < valsnum; i++)
+		if (vals[i]->valvalid)
+			order[n++] = i;
+	sortvals = vals;
+	qsort(order, n, sizeof *order, valcmp);
+	res->sorted = malloc(n * sizeof *res->sorted);
+	for (i = 0; i < n; i++) {
+		if (i && vals[order[i]]->value == vals[order[i-1]]->value)
+			res->next[order[i-1]] = order[i];
+		else
+			res->sorted[res->sortednum++] = order[i];
+	}
+	free(order);
+	return res;
+}
+
+/* first index in vals[] with the given value, or -1; continue with vindex->next */
+int rnn_valindex_first (struct rnnvalindex *vindex, uint64_t value) {
+	if (vindex->dense) {
+		if (value < vindex->base || value - vindex->base >= vindex->densenum)
+			return -1;
+		return vindex->dense[value - vindex->base];
+	}
+	int lo = 0, hi = vindex->sortednum;
+	while (lo < hi) {
+		int mid = (lo + hi) / 2;
+		uint64_t v = vindex->vals[vindex->sorted[mid]]->value;
+		if (v == value)
+			return vindex->sorted[mid];
+		if (v < value)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return -1;
+}
+
+void rnn_freevalindex (struct rnnvalindex *vindex) {
+	if (!vindex)
+		return;
+	free(vindex->dense);
+	free(vindex->sorted);
+	free(vindex->next);
+	free(vindex);
+}
+
+/* first value in database order, regardless of variants */
+struct rnnvalue *rnn_findvalue (struct rnnenum *en, uint64_t value) {
+	int i;
+	if (en->vindex) {
+		i = rnn_valindex_first(en->vindex, value);
+		return i == -1 ? 0 : en->vals[i];
+	}
+	for (i = 0; i < en->valsnum; i++)
+		if (en->vals[i]->valvalid && en->vals[i]->value == value)
+			return en->vals[i];
+	return 0;
+}
+
+/* follows spectypes down to the type that does the decoding, NULL if anything shifts */
+static struct rnntypeinfo *planresolve(struct rnntypeinfo *ti) {
+	int depth;
+	for (depth = 0; depth < 16; depth++) {
+		if (ti->shr)
+			return 0;
+		if (ti->type != RNN_TTYPE_SPECTYPE)
+			return ti;
+		ti = &ti->spectype->typeinfo;
+	}
+	return 0;
+}
+
+static void planfield(struct rnnbitplanfield *f, struct rnnbitfield *bf) {
+	struct rnntypeinfo *ti = planresolve(&bf->typeinfo);
+	f->bf = bf;
+	f->mask = bf->mask;
+	f->low = bf->low;
+	f->width = bf->high - bf->low + 1;
+	f->always = !bf->varinfo.varsetsnum;
+	f->kind = RNN_PLAN_GENERIC;
+	if (bf->typeinfo.type == RNN_TTYPE_BOOLEAN) {
+		f->kind = RNN_PLAN_BOOLEAN;
+		return;
+	}
+	if (!ti)
+		return;
+	switch (ti->type) {
+		case RNN_TTYPE_HEX:
+			f->kind = RNN_PLAN_HEX;
+			return;
+		case RNN_TTYPE_UINT:
+			f->kind = RNN_PLAN_UINT;
+			return;
+		case RNN_TTYPE_ENUM:
+			f->vindex = ti->eenum->vindex;
+			break;
+		case RNN_TTYPE_INLINE_ENUM:
+			f->vindex = ti->vindex;
+			break;
+		default:
+			return;
+	}
+	if (f->vindex)
+		f->kind = RNN_PLAN_ENUM;
+}
+
+struct rnnbitplan *rnn_bitplan (struct rnnbitfield **bitfields, int bitfieldsnum) {
+	struct rnnbitplan *plan = calloc (sizeof *plan, 1);
+	int i;
+	plan->always = 1;
+	for (i = 0; i < bitfieldsnum; i++) {
+		struct rnnbitplanfield f = { 0 };
+		if (bitfields[i]->varinfo.dead)
+			continue;
+		planfield(&f, bitfields[i]);
+		plan->mask |= f.mask;
+		if (!f.always)
+			plan->always = 0;
+		ADDARRAY(plan->fields, f);
+	}
+	return plan;
+}
+
+void rnn_freebitplan (struct rnnbitplan *plan) {
+	if (!plan)
+		return;
+	free(plan->fields);
+	free(plan);
+}
+
+static void plantypeinfo(struct rnntypeinfo *ti) {
+	int i;
+	if (ti->type == RNN_TTYPE_INLINE_BITSET && !ti->plan)
+		ti->plan = rnn_bitplan(ti->bitfields, ti->bitfieldsnum);
+	for (i = 0; i < ti->bitfieldsnum; i++)
+		plantypeinfo(&ti->bitfields[i]->typeinfo);
+}
+
+static void plandelem(struct rnndelem *elem) {
+	int i;
+	if (elem->varinfo.dead)
+		return;
+	plantypeinfo(&elem->typeinfo);
+	for (i = 0; i < elem->subelemsnum; i++)
+		plandelem(elem->subelems[i]);
+}
+
+/* runs after everything is prepared, since plans look through spectypes */
+static void plandb(struct rnndb *db) {
+	int i, j;
+	for (i = 0; i < db->bitsetsnum; i++) {
+		struct rnnbitset *bs = db->bitsets[i];
+		if (bs->isinline || bs->varinfo.dead || bs->plan)
+			continue;
+		bs->plan = rnn_bitplan(bs->bitfields, bs->bitfieldsnum);
+		for (j = 0; j < bs->bitfieldsnum; j++)
+			plantypeinfo(&bs->bitfields[j]->typeinfo);
+	}
+	for (i = 0; i < db->domainsnum; i++)
+		for (j = 0; j < db->domains[i]->subelemsnum; j++)
+			plandelem(db->domains[i]->subelems[j]);
+	for (i = 0; i < db->spectypesnum; i++)
+		plantypeinfo(&db->spectypes[i]->typeinfo);
+}
+
+/*
+ * With a cache, every entity is prepared with a clean estatus, and those that
+ * complain are noted so that rnn_reloaddb never reuses them: their errors then
+ * get printed again on every reload, like everything else's.
+ */
+static int prepbegin(struct rnndb *db) {
+	int estatus = db->estatus;
+	db->estatus = 0;
+	return estatus;
+}
+
+static void prepend(struct rnndb *db, void *ent, int estatus) {
+	if (db->cache) {
+		if (db->estatus)
+			ADDARRAY(db->cache->failed, ent);
+		db->cache->prepared++;
+	}
+	db->estatus |= estatus;
+}
+
+/* skips whatever is already prepared, like the entities rnn_reloaddb reused */
 void rnn_prepdb (struct rnndb *db) {
+	int i, estatus;
+	for (i = 0; i < db->enumsnum; i++)
+		if (!db->enums[i]->prepared) {
+			estatus = prepbegin(db);
+			prepenum(db, db->enums[i]);
+			prepend(db, db->enums[i], estatus);
+		}
+	for (i = 0; i < db->bitsetsnum; i++)
+		if (!db->bitsets[i]->prepared) {
+			estatus = prepbegin(db);
+			prepbitset(db, db->bitsets[i]);
+			prepend(db, db->bitsets[i], estatus);
+		}
+	for (i = 0; i < db->domainsnum; i++)
+		if (!db->domains[i]->prepared) {
+			estatus = prepbegin(db);
+			prepdomain(db, db->domains[i]);
+			prepend(db, db->domains[i], estatus);
+		}
+	for (i = 0; i < db->spectypesnum; i++)
+		if (!db->spectypes[i]->prepared) {
+			estatus = prepbegin(db);
+			prepspectype(db, db->spectypes[i]);
+			prepend(db, db->spectypes[i], estatus);
+		}
+	plandb(db);
+}
+
+/*
+ * Reloading walks the whole tree again, from the cached documents where the
+ * files didn't change, which is cheap.  Preparing is what's left, so every
+ * top-level entity that provably didn't change is swapped for its prepared
+ * counterpart from the previous database, and rnn_prepdb skips it.  An entity
+ * changed if:
+ *
+ *  - a file it collects elements from was parsed again, in either database,
+ *  - its own attributes differ, since merging can change those without
+ *    adding any element,
+ *  - its preparation complained last time, or
+ *  - something it refers to by name (type, prefix, varset, index, group)
+ *    changed, appeared or went away.
+ *
+ * If the list of files itself changed, the order entities get merged in
+ * could have too, and nothing is reused.
+ */
+enum rnnentkind {
+	RNN_ENT_ENUM,
+	RNN_ENT_BITSET,
+	RNN_ENT_DOMAIN,
+	RNN_ENT_SPECTYPE,
+	RNN_ENT_GROUP,
+};
+
+struct rnnent {
+	enum rnnentkind kind;
+	int idx;	/* in the new database's array for kind */
+	char *name;
+	void *old;
+	char **deps;
+	int depsnum;
+	int depsmax;
+	int dirty;
+};
+
+struct rnnreuse {
+	struct rnndb *db;
+	struct rnndb *old;
+	struct rnnent *ents;
+	int entsnum;
+	int entsmax;
+	char **dirty;	/* names of changed entities */
+	int dirtynum;
+	int dirtymax;
+};
+
+static int freshfile (struct rnncache *cache, char *file) {
+	int i;
+	for (i = 0; i < cache->filesnum; i++)
+		if (cache->files[i].fname == file)
+			return cache->files[i].fresh;
+	return 1;
+}
+
+static int freshdelems (struct rnncache *cache, struct rnndelem **elems, int num) {
+	int i;
+	for (i = 0; i < num; i++)
+		if (freshfile(cache, elems[i]->file))
+			return 1;
+	return 0;
+}
+
+static int failedent (struct rnncache *cache, void *ent) {
+	int i;
+	for (i = 0; i < cache->failednum; i++)
+		if (cache->failed[i] == ent)
+			return 1;
+	return 0;
+}
+
+static int diffvarinfo (struct rnnvarinfo *a, struct rnnvarinfo *b) {
+	return strdiff(a->prefixstr, b->prefixstr) || strdiff(a->varsetstr, b->varsetstr) || strdiff(a->variantsstr, b->variantsstr);
+}
+
+static void adddep (struct rnnent *ent, char *name) {
+	if (name)
+		ADDARRAY(ent->deps, name);
+}
+
+static void depsvarinfo (struct rnnent *ent, struct rnnvarinfo *vi) {
+	adddep(ent, vi->prefixstr);
+	adddep(ent, vi->varsetstr);
+}
+
+static void depsbitfield (struct rnnent *ent, struct rnnbitfield *bf);
+
+static void depstypeinfo (struct rnnent *ent, struct rnntypeinfo *ti) {
+	int i;
+	adddep(ent, ti->name);
+	for (i = 0; i < ti->valsnum; i++)
+		depsvarinfo(ent, &ti->vals[i]->varinfo);
+	for (i = 0; i < ti->bitfieldsnum; i++)
+		depsbitfield(ent, ti->bitfields[i]);
+}
+
+static void depsbitfield (struct rnnent *ent, struct rnnbitfield *bf) {
+	depsvarinfo(ent, &bf->varinfo);
+	depstypeinfo(ent, &bf->typeinfo);
+}
+
+static void depsdelem (struct rnnent *ent, struct rnndelem *elem) {
+	int i;
+	if (elem->type == RNN_ETYPE_USE_GROUP)
+		adddep(ent, elem->name);
+	if (elem->index)
+		adddep(ent, elem->index->name);
+	depsvarinfo(ent, &elem->varinfo);
+	depstypeinfo(ent, &elem->typeinfo);
+	for (i = 0; i < elem->subelemsnum; i++)
+		depsdelem(ent, elem->subelems[i]);
+}
+
+static struct rnngroup *findgroup (struct rnndb *db, const char *name) {
+	int i;
+	for (i = 0; i < db->groupsnum; i++)
+		if (!strcmp(db->groups[i]->name, name))
+			return db->groups[i];
+	return 0;
+}
+
+/* looks at one entity of the new database, which isn't prepared yet */
+static void reuseent (struct rnnreuse *r, enum rnnentkind kind, int idx) {
+	struct rnncache *cache = r->db->cache;
+	struct rnnent ent = { kind, idx };
+	int i, dirty = 0;
+	switch (kind) {
+		case RNN_ENT_ENUM: {
+			struct rnnenum *en = r->db->enums[idx], *old = rnn_findenum(r->old, en->name);
+			ent.name = en->name;
+			ent.old = old;
+			dirty = !old || !old->prepared || diffvarinfo(&en->varinfo, &old->varinfo) ||
+				en->isinline != old->isinline || en->bare != old->bare || en->valsnum != old->valsnum ||
+				freshfile(cache, en->file) || freshfile(cache, old->file);
+			for (i = 0; i < en->valsnum && !dirty; i++)
+				dirty = freshfile(cache, en->vals[i]->file) || freshfile(cache, old->vals[i]->file);
+			depsvarinfo(&ent, &en->varinfo);
+			for (i = 0; i < en->valsnum; i++)
+				depsvarinfo(&ent, &en->vals[i]->varinfo);
+			break;
+		}
+		case RNN_ENT_BITSET: {
+			struct rnnbitset *bs = r->db->bitsets[idx], *old = rnn_findbitset(r->old, bs->name);
+			ent.name = bs->name;
+			ent.old = old;
+			dirty = !old || !old->prepared || diffvarinfo(&bs->varinfo, &old->varinfo) ||
+				bs->isinline != old->isinline || bs->bare != old->bare || bs->bitfieldsnum != old->bitfieldsnum ||
+				freshfile(cache, bs->file) || freshfile(cache, old->file);
+			for (i = 0; i < bs->bitfieldsnum && !dirty; i++)
+				dirty = freshfile(cache, bs->bitfields[i]->file) || freshfile(cache, old->bitfields[i]->file);
+			depsvarinfo(&ent, &bs->varinfo);
+			for (i = 0; i < bs->bitfieldsnum; i++)
+				depsbitfield(&ent, bs->bitfields[i]);
+			break;
+		}
+		case RNN_ENT_DOMAIN: {
+			struct rnndomain *dom = r->db->domains[idx], *old = rnn_finddomain(r->old, dom->name);
+			ent.name = dom->name;
+			ent.old = old;
+			dirty = !old || !old->prepared || diffvarinfo(&dom->varinfo, &old->varinfo) ||
+				dom->bare != old->bare || dom->width != old->width || dom->size != old->size ||
+				dom->subelemsnum != old->subelemsnum ||
+				freshfile(cache, dom->file) || freshfile(cache, old->file) ||
+				freshdelems(cache, dom->subelems, dom->subelemsnum) ||
+				freshdelems(cache, old->subelems, old->subelemsnum);
+			depsvarinfo(&ent, &dom->varinfo);
+			for (i = 0; i < dom->subelemsnum; i++)
+				depsdelem(&ent, dom->subelems[i]);
+			break;
+		}
+		case RNN_ENT_SPECTYPE: {
+			struct rnnspectype *st = r->db->spectypes[idx], *old = rnn_findspectype(r->old, st->name);
+			ent.name = st->name;
+			ent.old = old;
+			dirty = !old || !old->prepared || freshfile(cache, st->file) || freshfile(cache, old->file);
+			depstypeinfo(&ent, &st->typeinfo);
+			break;
+		}
+		case RNN_ENT_GROUP: {
+			struct rnngroup *gr = r->db->groups[idx], *old = findgroup(r->old, gr->name);
+			ent.name = gr->name;
+			ent.old = old;
+			dirty = !old || gr->subelemsnum != old->subelemsnum ||
+				freshdelems(cache, gr->subelems, gr->subelemsnum) ||
+				freshdelems(cache, old->subelems, old->subelemsnum);
+			for (i = 0; i < gr->subelemsnum; i++)
+				depsdelem(&ent, gr->subelems[i]);
+			break;
+		}
+	}
+	if (dirty || failedent(cache, ent.old)) {
+		ent.dirty = 1;
+		ADDARRAY(r->dirty, ent.name);
+	}
+	ADDARRAY(r->ents, ent);
+}
+
+static int namecmp (const void *a, const void *b) {
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* marks everything referring to a changed name as changed itself, until nothing more does */
+static void reusedeps (struct rnnreuse *r) {
+	int i, j, num;
+	do {
+		num = r->dirtynum;
+		qsort(r->dirty, num, sizeof *r->dirty, namecmp);
+		for (i = 0; i < r->entsnum; i++) {
+			struct rnnent *ent = &r->ents[i];
+			for (j = 0; j < ent->depsnum && !ent->dirty; j++)
+				if (bsearch(&ent->deps[j], r->dirty, num, sizeof *r->dirty, namecmp)) {
+					ent->dirty = 1;
+					ADDARRAY(r->dirty, ent->name);
+				}
+		}
+	} while (r->dirtynum != num);
+}
+
+/* these only know about what parsing allocates - they're for unprepared entities */
+static void freetypeinfo (struct rnntypeinfo *ti);
+
+static void freevarinfo (struct rnnvarinfo *vi) {
+	free(vi->prefixstr);
+	free(vi->varsetstr);
+	free(vi->variantsstr);
+}
+
+static void freevalue (struct rnnvalue *val) {
+	free(val->name);
+	freevarinfo(&val->varinfo);
+	free(val);
+}
+
+static void freebitfield (struct rnnbitfield *bf) {
+	free(bf->name);
+	freevarinfo(&bf->varinfo);
+	freetypeinfo(&bf->typeinfo);
+	free(bf);
+}
+
+static void freetypeinfo (struct rnntypeinfo *ti) {
+	int i;
+	free(ti->name);
+	for (i = 0; i < ti->valsnum; i++)
+		freevalue(ti->vals[i]);
+	free(ti->vals);
+	for (i = 0; i < ti->bitfieldsnum; i++)
+		freebitfield(ti->bitfields[i]);
+	free(ti->bitfields);
+}
+
+static void freedelems (struct rnndelem **elems, int num);
+
+static void freedelem (struct rnndelem *elem) {
+	int i;
+	free(elem->name);
+	free(elem->offsets);
+	free(elem->doffset);
+	for (i = 0; i < elem->doffsetsnum; i++)
+		free(elem->doffsets[i]);
+	free(elem->doffsets);
+	freedelems(elem->subelems, elem->subelemsnum);
+	freevarinfo(&elem->varinfo);
+	freetypeinfo(&elem->typeinfo);
+	free(elem);
+}
+
+static void freedelems (struct rnndelem **elems, int num) {
 	int i;
+	for (i = 0; i < num; i++)
+		freedelem(elems[i]);
+	free(elems);
+}
+
+static void freeent (enum rnnentkind kind, void *ptr) {
+	int i;
+	switch (kind) {
+		case RNN_ENT_ENUM: {
+			struct rnnenum *en = ptr;
+			free(en->name);
+			freevarinfo(&en->varinfo);
+			for (i = 0; i < en->valsnum; i++)
+				freevalue(en->vals[i]);
+			free(en->vals);
+			break;
+		}
+		case RNN_ENT_BITSET: {
+			struct rnnbitset *bs = ptr;
+			free(bs->name);
+			freevarinfo(&bs->varinfo);
+			for (i = 0; i < bs->bitfieldsnum; i++)
+				freebitfield(bs->bitfields[i]);
+			free(bs->bitfields);
+			break;
+		}
+		case RNN_ENT_DOMAIN: {
+			struct rnndomain *dom = ptr;
+			free(dom->name);
+			freevarinfo(&dom->varinfo);
+			freedelems(dom->subelems, dom->subelemsnum);
+			break;
+		}
+		case RNN_ENT_SPECTYPE: {
+			struct rnnspectype *st = ptr;
+			free(st->name);
+			freetypeinfo(&st->typeinfo);
+			break;
+		}
+		case RNN_ENT_GROUP: {
+			struct rnngroup *gr = ptr;
+			free(gr->name);
+			freedelems(gr->subelems, gr->subelemsnum);
+			break;
+		}
+	}
+	free(ptr);
+}
+
+/* index enums are looked up while parsing, so they may point at entities about to be swapped out */
+static void reindex (struct rnndb *db, struct rnndelem **elems, int num) {
+	int i;
+	for (i = 0; i < num; i++) {
+		if (elems[i]->index)
+			elems[i]->index = rnn_findenum(db, elems[i]->index->name);
+		reindex(db, elems[i]->subelems, elems[i]->subelemsnum);
+	}
+}
+
+static void reuse (struct rnndb *db, struct rnndb *old) {
+	struct rnnreuse r = { db, old };
+	void **slot = 0;
+	int i;
+	if (db->filesnum != old->filesnum)
+		return;
+	for (i = 0; i < db->filesnum; i++)
+		if (db->files[i] != old->files[i])
+			return;
 	for (i = 0; i < db->enumsnum; i++)
-		prepenum(db, db->enums[i]);
+		reuseent(&r, RNN_ENT_ENUM, i);
 	for (i = 0; i < db->bitsetsnum; i++)
-		prepbitset(db, db->bitsets[i]);
+		reuseent(&r, RNN_ENT_BITSET, i);
 	for (i = 0; i < db->domainsnum; i++)
-		prepdomain(db, db->domains[i]);
+		reuseent(&r, RNN_ENT_DOMAIN, i);
 	for (i = 0; i < db->spectypesnum; i++)
-		prepspectype(db, db->spectypes[i]);
+		reuseent(&r, RNN_ENT_SPECTYPE, i);
+	for (i = 0; i < db->groupsnum; i++)
+		reuseent(&r, RNN_ENT_GROUP, i);
+	/* gone ones */
+	for (i = 0; i < old->enumsnum; i++)
+		if (!rnn_findenum(db, old->enums[i]->name))
+			ADDARRAY(r.dirty, old->enums[i]->name);
+	for (i = 0; i < old->bitsetsnum; i++)
+		if (!rnn_findbitset(db, old->bitsets[i]->name))
+			ADDARRAY(r.dirty, old->bitsets[i]->name);
+	for (i = 0; i < old->domainsnum; i++)
+		if (!rnn_finddomain(db, old->domains[i]->name))
+			ADDARRAY(r.dirty, old->domains[i]->name);
+	for (i = 0; i < old->spectypesnum; i++)
+		if (!rnn_findspectype(db, old->spectypes[i]->name))
+			ADDARRAY(r.dirty, old->spectypes[i]->name);
+	for (i = 0; i < old->groupsnum; i++)
+		if (!findgroup(db, old->groups[i]->name))
+			ADDARRAY(r.dirty, old->groups[i]->name);
+	reusedeps(&r);
+	/* swap, but keep the new ones around until the index pointers are fixed */
+	for (i = 0; i < r.entsnum; i++) {
+		struct rnnent *ent = &r.ents[i];
+		free(ent->deps);
+		if (ent->dirty)
+			continue;
+		switch (ent->kind) {
+			case RNN_ENT_ENUM: slot = (void **)&db->enums[ent->idx]; break;
+			case RNN_ENT_BITSET: slot = (void **)&db->bitsets[ent->idx]; break;
+			case RNN_ENT_DOMAIN: slot = (void **)&db->domains[ent->idx]; break;
+			case RNN_ENT_SPECTYPE: slot = (void **)&db->spectypes[ent->idx]; break;
+			case RNN_ENT_GROUP: slot = (void **)&db->groups[ent->idx]; break;
+		}
+		void *cur = *slot;
+		*slot = ent->old;
+		ent->old = cur;
+		if (ent->kind != RNN_ENT_GROUP)
+			db->cache->reused++;
+	}
+	for (i = 0; i < r.entsnum; i++) {
+		struct rnnent *ent = &r.ents[i];
+		if (!ent->dirty)
+			continue;
+		if (ent->kind == RNN_ENT_DOMAIN)
+			reindex(db, db->domains[ent->idx]->subelems, db->domains[ent->idx]->subelemsnum);
+		else if (ent->kind == RNN_ENT_GROUP)
+			reindex(db, db->groups[ent->idx]->subelems, db->groups[ent->idx]->subelemsnum);
+	}
+	for (i = 0; i < r.entsnum; i++)
+		if (!r.ents[i].dirty)
+			freeent(r.ents[i].kind, r.ents[i].old);
+	free(r.ents);
+	free(r.dirty);
+}
+
+/*
+ * Loads and prepares file into a new database using the cache, reusing
+ * whatever it can from old, which was loaded the same way.  old is consumed:
+ * the entities that weren't reused are simply dropped, since prepared ones
+ * share too much to be freed safely - that's only what changed, each time.
+ */
+struct rnndb *rnn_reloaddb (struct rnncache *cache, struct rnndb *old, char *file) {
+	struct rnndb *db = rnn_newdb();
+	int i;
+	db->cache = cache;
+	if (old)
+		db->jobs = old->jobs;
+	cache->parsed = cache->prepared = cache->reused = 0;
+	for (i = 0; i < cache->filesnum; i++)
+		cache->files[i].fresh = 0;
+	rnn_parsefile(db, file);
+	for (i = 0; i < cache->filesnum; i++)
+		cache->parsed += cache->files[i].fresh;
+	if (old && old->cache == cache)
+		reuse(db, old);
+	cache->failednum = 0;
+	rnn_prepdb(db);
+	if (old) {
+		free(old->enums);
+		free(old->bitsets);
+		free(old->domains);
+		free(old->groups);
+		free(old->spectypes);
+		free(old->files);
+		free(old);
+	}
+	return db;
 }
 
 struct rnnenum *rnn_findenum (struct rnndb *db, const char *name) {
@@ -25,22 +25,76 @@
 #include "rnn.h"
 #include "rnndec.h"
 #include <stdio.h>
+#include <getopt.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
 
 void usage()
 {
 	printf ("Usage:\n"
-			"\trnncheck file.xml\n"
+			"\trnncheck [-w] [-i interval] file.xml\n"
+			"\t-w: keep watching the database files, and check again after every change\n"
+			"\t-i: how often to look at the files in watch mode, in milliseconds [10]\n"
 		);
 	exit(2);
 }
 
+static double now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+/*
+ * Keeps the database in memory and reloads it whenever a file's contents
+ * change: only changed files get parsed again, and only entities from them
+ * or depending on them get prepared again.  Messages go to stderr as usual,
+ * followed by one status line on stdout per check.
+ */
+static void watch(char *file, int interval) {
+	struct rnncache *cache = rnn_newcache();
+	struct rnndb *db = 0;
+	while (1) {
+		double start = now();
+		db = rnn_reloaddb(cache, db, file);
+		fflush(stderr);
+		printf("%s: %s, %d files parsed, %d entities prepared, %d reused, %.2f ms\n",
+				file, db->estatus ? "errors" : "ok", cache->parsed, cache->prepared, cache->reused, now() - start);
+		fflush(stdout);
+		while (!rnn_pollcache(cache))
+			usleep(interval * 1000);
+	}
+}
+
 int main(int argc, char **argv) {
+	int watchmode = 0, interval = 10;
+	int c;
+	long val;
+	char *end;
+	while ((c = getopt (argc, argv, "wi:")) != -1)
+		switch (c) {
+			case 'w':
+				watchmode = 1;
+				break;
+			case 'i':
+				val = strtol(optarg, &end, 0);
+				/* interval * 1000 has to fit in an int for usleep */
+				if (*end || end == optarg || val <= 0 || val > INT_MAX / 1000)
+					usage();
+				interval = val;
+				break;
+			default:
+				usage();
+		}
 	rnn_init();
-	if (argc < 2) {
+	if (optind >= argc) {
 		usage();
 	}
+	if (watchmode)
+		watch(argv[optind], interval);
 	struct rnndb *db = rnn_newdb();
-	rnn_parsefile (db, argv[1]);
+	rnn_parsefile (db, argv[optind]);
 	rnn_prepdb (db);
 	return db->estatus;
 }
@@ -26,6 +26,7 @@
 #define _GNU_SOURCE // for asprintf
 #include "rnndec.h"
 #include <assert.h>
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -77,6 +78,222 @@ int rnndec_varmatch(struct rnndeccontext *ctx, struct rnnvarinfo *vi) {
 	return 1;
 }
 
+/*
+ * Specialization: a specialized context decodes through copies of the
+ * domains, enums, bitsets and spectypes it uses that only contain the
+ * elements live for its variants, so decoding skips all variant checks.
+ * Anonymous single stripes at offset 0 (expanded use-groups) are merged
+ * into their parent.  Copies are made lazily, on first use of a domain, and
+ * are owned by the context.
+ */
+
+static inline int rnndec_live(struct rnndeccontext *ctx, struct rnnvarinfo *vi) {
+	return ctx->specialized || rnndec_varmatch(ctx, vi);
+}
+
+static void *spec_alloc(struct rnndeccontext *ctx, size_t size) {
+	void *res = calloc(size, 1);
+	ADDARRAY(ctx->specmem, res);
+	return res;
+}
+
+static void *spec_find(struct rnndecspec *specs, int specsnum, const void *orig) {
+	int i;
+	for (i = 0; i < specsnum; i++)
+		if (specs[i].orig == orig)
+			return specs[i].copy;
+	return 0;
+}
+
+static void spec_add(struct rnndeccontext *ctx, const void *orig, void *copy) {
+	struct rnndecspec spec = { orig, copy };
+	ADDARRAY(ctx->specs, spec);
+}
+
+static struct rnnenum *spec_enum(struct rnndeccontext *ctx, struct rnnenum *en);
+static struct rnnbitset *spec_bitset(struct rnndeccontext *ctx, struct rnnbitset *bs);
+static struct rnnspectype *spec_spectype(struct rnndeccontext *ctx, struct rnnspectype *st);
+
+static struct rnnvalue **spec_vals(struct rnndeccontext *ctx, struct rnnvalue **vals, int valsnum, int *pnum) {
+	struct rnnvalue **res = spec_alloc(ctx, valsnum * sizeof *res);
+	int i, num = 0;
+	for (i = 0; i < valsnum; i++)
+		if (rnndec_varmatch(ctx, &vals[i]->varinfo))
+			res[num++] = vals[i];
+	*pnum = num;
+	return res;
+}
+
+static void spec_typeinfo(struct rnndeccontext *ctx, struct rnntypeinfo *dst, struct rnntypeinfo *src);
+
+/* indices and plans have to be rebuilt over the pruned value and field lists */
+static struct rnnvalindex *spec_vindex(struct rnndeccontext *ctx, struct rnnvalue **vals, int valsnum) {
+	struct rnnvalindex *vindex = rnn_valindex(vals, valsnum);
+	ADDARRAY(ctx->specindices, vindex);
+	return vindex;
+}
+
+static struct rnnbitplan *spec_plan(struct rnndeccontext *ctx, struct rnnbitfield **bitfields, int bitfieldsnum) {
+	struct rnnbitplan *plan = rnn_bitplan(bitfields, bitfieldsnum);
+	ADDARRAY(ctx->specplans, plan);
+	return plan;
+}
+
+static struct rnnbitfield **spec_bitfields(struct rnndeccontext *ctx, struct rnnbitfield **bitfields, int bitfieldsnum, int *pnum) {
+	struct rnnbitfield **res = spec_alloc(ctx, bitfieldsnum * sizeof *res);
+	int i, num = 0;
+	for (i = 0; i < bitfieldsnum; i++) {
+		if (!rnndec_varmatch(ctx, &bitfields[i]->varinfo))
+			continue;
+		struct rnnbitfield *bf = spec_alloc(ctx, sizeof *bf);
+		*bf = *bitfields[i];
+		spec_typeinfo(ctx, &bf->typeinfo, &bitfields[i]->typeinfo);
+		res[num++] = bf;
+	}
+	*pnum = num;
+	return res;
+}
+
+static void spec_typeinfo(struct rnndeccontext *ctx, struct rnntypeinfo *dst, struct rnntypeinfo *src) {
+	*dst = *src;
+	if (src->eenum)
+		dst->eenum = spec_enum(ctx, src->eenum);
+	if (src->ebitset)
+		dst->ebitset = spec_bitset(ctx, src->ebitset);
+	if (src->spectype)
+		dst->spectype = spec_spectype(ctx, src->spectype);
+	dst->vals = spec_vals(ctx, src->vals, src->valsnum, &dst->valsnum);
+	dst->valsmax = dst->valsnum;
+	if (src->vindex)
+		dst->vindex = spec_vindex(ctx, dst->vals, dst->valsnum);
+	dst->bitfields = spec_bitfields(ctx, src->bitfields, src->bitfieldsnum, &dst->bitfieldsnum);
+	dst->bitfieldsmax = dst->bitfieldsnum;
+	if (src->plan)
+		dst->plan = spec_plan(ctx, dst->bitfields, dst->bitfieldsnum);
+}
+
+static struct rnnenum *spec_enum(struct rnndeccontext *ctx, struct rnnenum *en) {
+	struct rnnenum *res = spec_find(ctx->specs, ctx->specsnum, en);
+	if (res)
+		return res;
+	res = spec_alloc(ctx, sizeof *res);
+	*res = *en;
+	spec_add(ctx, en, res);
+	res->vals = spec_vals(ctx, en->vals, en->valsnum, &res->valsnum);
+	res->valsmax = res->valsnum;
+	if (en->vindex)
+		res->vindex = spec_vindex(ctx, res->vals, res->valsnum);
+	return res;
+}
+
+static struct rnnbitset *spec_bitset(struct rnndeccontext *ctx, struct rnnbitset *bs) {
+	struct rnnbitset *res = spec_find(ctx->specs, ctx->specsnum, bs);
+	if (res)
+		return res;
+	res = spec_alloc(ctx, sizeof *res);
+	*res = *bs;
+	spec_add(ctx, bs, res);
+	res->bitfields = spec_bitfields(ctx, bs->bitfields, bs->bitfieldsnum, &res->bitfieldsnum);
+	res->bitfieldsmax = res->bitfieldsnum;
+	if (bs->plan)
+		res->plan = spec_plan(ctx, res->bitfields, res->bitfieldsnum);
+	return res;
+}
+
+static struct rnnspectype *spec_spectype(struct rnndeccontext *ctx, struct rnnspectype *st) {
+	struct rnnspectype *res = spec_find(ctx->specs, ctx->specsnum, st);
+	if (res)
+		return res;
+	res = spec_alloc(ctx, sizeof *res);
+	*res = *st;
+	spec_add(ctx, st, res);
+	spec_typeinfo(ctx, &res->typeinfo, &st->typeinfo);
+	return res;
+}
+
+struct spec_delems {
+	struct rnndelem **elems;
+	int elemsnum;
+	int elemsmax;
+};
+
+static void spec_delems(struct rnndeccontext *ctx, struct rnndelem **elems, int elemsnum, struct spec_delems *res);
+
+static void spec_subelems(struct rnndeccontext *ctx, struct rnndelem **elems, int elemsnum, struct rnndelem ***psubelems, int *psubelemsnum, int *psubelemsmax) {
+	struct spec_delems list = { 0 };
+	spec_delems(ctx, elems, elemsnum, &list);
+	if (list.elems)
+		ADDARRAY(ctx->specmem, (void *)list.elems);
+	*psubelems = list.elems;
+	*psubelemsnum = list.elemsnum;
+	*psubelemsmax = list.elemsmax;
+}
+
+static void spec_delems(struct rnndeccontext *ctx, struct rnndelem **elems, int elemsnum, struct spec_delems *list) {
+	int i;
+	for (i = 0; i < elemsnum; i++) {
+		struct rnndelem *elem = elems[i];
+		if (!rnndec_varmatch(ctx, &elem->varinfo))
+			continue;
+		if (elem->type == RNN_ETYPE_STRIPE && !elem->name && elem->length == 1 && !elem->offset) {
+			spec_delems(ctx, elem->subelems, elem->subelemsnum, list);
+			continue;
+		}
+		struct rnndelem *res = spec_alloc(ctx, sizeof *res);
+		*res = *elem;
+		spec_typeinfo(ctx, &res->typeinfo, &elem->typeinfo);
+		if (elem->index)
+			res->index = spec_enum(ctx, elem->index);
+		spec_subelems(ctx, elem->subelems, elem->subelemsnum, &res->subelems, &res->subelemsnum, &res->subelemsmax);
+		ADDARRAY(list->elems, res);
+	}
+}
+
+static struct rnndomain *spec_domain(struct rnndeccontext *ctx, struct rnndomain *dom) {
+	struct rnndomain *res = spec_find(ctx->specdoms, ctx->specdomsnum, dom);
+	if (res)
+		return res;
+	res = spec_alloc(ctx, sizeof *res);
+	*res = *dom;
+	spec_subelems(ctx, dom->subelems, dom->subelemsnum, &res->subelems, &res->subelemsnum, &res->subelemsmax);
+	struct rnndecspec spec = { dom, res };
+	ADDARRAY(ctx->specdoms, spec);
+	return res;
+}
+
+/* returns a new context with the same variants, decoding through pruned copies */
+struct rnndeccontext *rnndec_specialize(struct rnndeccontext *ctx) {
+	struct rnndeccontext *res = rnndec_newcontext(ctx->db);
+	int i;
+	res->colors = ctx->colors;
+	for (i = 0; i < ctx->varsnum; i++) {
+		struct rnndecvariant *ci = calloc (sizeof *ci, 1);
+		*ci = *ctx->vars[i];
+		ADDARRAY(res->vars, ci);
+	}
+	res->specialized = 1;
+	return res;
+}
+
+void rnndec_freecontext(struct rnndeccontext *ctx) {
+	int i;
+	for (i = 0; i < ctx->varsnum; i++)
+		free(ctx->vars[i]);
+	free(ctx->vars);
+	for (i = 0; i < ctx->specmemnum; i++)
+		free(ctx->specmem[i]);
+	free(ctx->specmem);
+	for (i = 0; i < ctx->specplansnum; i++)
+		rnn_freebitplan(ctx->specplans[i]);
+	free(ctx->specplans);
+	for (i = 0; i < ctx->specindicesnum; i++)
+		rnn_freevalindex(ctx->specindices[i]);
+	free(ctx->specindices);
+	free(ctx->specs);
+	free(ctx->specdoms);
+	free(ctx);
+}
+
 /* see https://en.wikipedia.org/wiki/Half-precision_floating-point_format */
 static uint32_t float16i(uint16_t val)
 {
@@ -109,11 +326,17 @@ static float float16(uint16_t val)
 }
 
 static const char *rnndec_decode_enum_val(struct rnndeccontext *ctx,
-		struct rnnvalue **vals, int valsnum, uint64_t value)
+		struct rnnvalue **vals, int valsnum, struct rnnvalindex *vindex, uint64_t value)
 {
 	int i;
+	if (vindex) {
+		for (i = rnn_valindex_first(vindex, value); i != -1; i = vindex->next[i])
+			if (rnndec_live(ctx, &vals[i]->varinfo))
+				return vals[i]->name;
+		return NULL;
+	}
 	for (i = 0; i < valsnum; i++)
-		if (rnndec_varmatch(ctx, &vals[i]->varinfo) &&
+		if (rnndec_live(ctx, &vals[i]->varinfo) &&
 				vals[i]->valvalid && vals[i]->value == value)
 			return vals[i]->name;
 	return NULL;
@@ -123,23 +346,179 @@ char *rnndec_decode_enum(struct rnndeccontext *ctx, const char *enumname, uint64
 {
 	struct rnnenum *en = rnn_findenum (ctx->db, enumname);
 	if (en) {
-		int i;
-		for (i = 0; i < en->valsnum; i++)
-			if (en->vals[i]->valvalid && en->vals[i]->value == enumval)
-				return en->vals[i]->name;
+		struct rnnvalue *val = rnn_findvalue(en, enumval);
+		if (val)
+			return val->name;
 	}
 	return NULL;
 }
 
-char *rnndec_decodeval(struct rnndeccontext *ctx, struct rnntypeinfo *ti, uint64_t value, int width) {
-	char *res = 0;
+/*
+ * Formatting goes through a caller-owned growable buffer, so decoding a wide
+ * bitset or a deeply nested address is linear in the output length and
+ * doesn't allocate once the buffer has grown.  A NULL buffer discards output.
+ */
+
+void rnndec_bufprintf(struct rnndecbuf *buf, const char *format, ...) {
+	va_list va;
+	if (!buf)
+		return;
+	for (;;) {
+		size_t avail = buf->max - buf->len;
+		va_start(va, format);
+		int sz = vsnprintf(buf->str + buf->len, avail, format, va);
+		va_end(va);
+		if (sz < avail) {
+			buf->len += sz;
+			return;
+		}
+		buf->max = max(buf->max * 2, buf->len + sz + 1);
+		buf->str = realloc(buf->str, buf->max);
+	}
+}
+
+void rnndec_bufclear(struct rnndecbuf *buf) {
+	buf->len = 0;
+	if (buf->str)
+		buf->str[0] = 0;
+}
+
+void rnndec_buffree(struct rnndecbuf *buf) {
+	free(buf->str);
+	buf->str = 0;
+	buf->len = buf->max = 0;
+}
+
+static void buftrunc(struct rnndecbuf *buf, size_t len) {
+	if (buf && buf->str) {
+		buf->len = len;
+		buf->str[len] = 0;
+	}
+}
+
+static void bufgrow(struct rnndecbuf *buf, size_t len) {
+	if (buf->len + len + 1 > buf->max) {
+		buf->max = max(buf->max * 2, buf->len + len + 1);
+		buf->str = realloc(buf->str, buf->max);
+	}
+}
+
+/* printf-free appends for the bitset plan fast paths */
+static void bufputs(struct rnndecbuf *buf, const char *str) {
+	size_t len = strlen(str);
+	if (!buf)
+		return;
+	bufgrow(buf, len);
+	memcpy(buf->str + buf->len, str, len + 1);
+	buf->len += len;
+}
+
+/* same as %#"PRIx64" or %"PRIu64" */
+static void bufnum(struct rnndecbuf *buf, uint64_t val, int hex) {
+	char tmp[24];
+	char *p = tmp + sizeof tmp;
+	*--p = 0;
+	do {
+		*--p = "0123456789abcdef"[hex ? val & 0xf : val % 10];
+		val = hex ? val >> 4 : val / 10;
+	} while (val);
+	if (hex && p[0] != '0') {
+		*--p = 'x';
+		*--p = '0';
+	}
+	bufputs(buf, p);
+}
+
+static void bufputs3(struct rnndecbuf *buf, const char *a, const char *b, const char *c) {
+	bufputs(buf, a);
+	bufputs(buf, b);
+	bufputs(buf, c);
+}
+
+static size_t buflen(struct rnndecbuf *buf) {
+	return buf ? buf->len : 0;
+}
+
+/* detaches the contents as a malloced string */
+static char *bufstr(struct rnndecbuf *buf) {
+	char *res = buf->str ? buf->str : strdup("");
+	buf->str = 0;
+	buf->len = buf->max = 0;
+	return res;
+}
+
+static void appendplan(struct rnndeccontext *ctx, struct rnndecbuf *buf, struct rnnbitplan *plan, uint64_t value) {
+	const struct envy_colors *col = ctx->colors;
+	uint64_t mask = plan->always ? plan->mask : 0;
+	const char *name;
+	int first = 1;
+	int i;
+	bufputs (buf, "{ ");
+	for (i = 0; i < plan->fieldsnum; i++) {
+		struct rnnbitplanfield *f = &plan->fields[i];
+		if (!f->always) {
+			if (!rnndec_live(ctx, &f->bf->varinfo))
+				continue;
+		}
+		if (!plan->always)
+			mask |= f->mask;
+		uint64_t sval = (value & f->mask) >> f->low;
+		if (f->kind == RNN_PLAN_BOOLEAN && sval == 0)
+			continue;
+		if (!first)
+			bufputs (buf, " | ");
+		first = 0;
+		if (f->kind == RNN_PLAN_BOOLEAN && sval == 1) {
+			bufputs3 (buf, col->mod, f->bf->name, col->reset);
+			continue;
+		}
+		bufputs3 (buf, col->rname, f->bf->name, col->reset);
+		bufputs (buf, " = ");
+		switch (f->kind) {
+			case RNN_PLAN_HEX:
+			case RNN_PLAN_UINT:
+				bufputs (buf, col->num);
+				bufnum (buf, sval, f->kind == RNN_PLAN_HEX);
+				bufputs (buf, col->reset);
+				break;
+			case RNN_PLAN_ENUM:
+				name = rnndec_decode_enum_val(ctx, f->vindex->vals, 0, f->vindex, sval);
+				if (name) {
+					bufputs3 (buf, col->eval, name, col->reset);
+				} else {
+					bufputs (buf, col->num);
+					bufnum (buf, sval, 1);
+					bufputs (buf, col->reset);
+				}
+				break;
+			default:
+				rnndec_appendval(ctx, buf, &f->bf->typeinfo, sval, f->width);
+				break;
+		}
+	}
+	if (value & ~mask) {
+		if (!first)
+			bufputs (buf, " | ");
+		bufputs (buf, col->err);
+		bufnum (buf, value & ~mask, 1);
+		bufputs (buf, col->reset);
+		first = 0;
+	}
+	if (first)
+		bufputs3 (buf, col->num, "0", col->reset);
+	bufputs (buf, " }");
+}
+
+void rnndec_appendval(struct rnndeccontext *ctx, struct rnndecbuf *buf, struct rnntypeinfo *ti, uint64_t value, int width) {
 	int i;
 	struct rnnvalue **vals;
 	int valsnum;
+	struct rnnvalindex *vindex;
 	struct rnnbitfield **bitfields;
 	int bitfieldsnum;
-	char *tmp;
+	const char *tmp;
 	uint64_t mask;
+	int first;
 	if (!ti)
 		goto failhex;
 	if (ti->shr) value <<= ti->shr;
@@ -147,30 +526,42 @@ char *rnndec_decodeval(struct rnndeccontext *ctx, struct rnntypeinfo *ti, uint64
 		case RNN_TTYPE_ENUM:
 			vals = ti->eenum->vals;
 			valsnum = ti->eenum->valsnum;
+			vindex = ti->eenum->vindex;
 			goto doenum;
 		case RNN_TTYPE_INLINE_ENUM:
 			vals = ti->vals;
 			valsnum = ti->valsnum;
+			vindex = ti->vindex;
 			goto doenum;
 		doenum:
-			tmp = rnndec_decode_enum_val(ctx, vals, valsnum, value);
+			tmp = rnndec_decode_enum_val(ctx, vals, valsnum, vindex, value);
 			if (tmp) {
-				asprintf (&res, "%s%s%s", ctx->colors->eval, tmp, ctx->colors->reset);
-				return res;
+				rnndec_bufprintf (buf, "%s%s%s", ctx->colors->eval, tmp, ctx->colors->reset);
+				return;
 			}
 			goto failhex;
 		case RNN_TTYPE_BITSET:
+			if (ti->ebitset->plan) {
+				appendplan(ctx, buf, ti->ebitset->plan, value);
+				return;
+			}
 			bitfields = ti->ebitset->bitfields;
 			bitfieldsnum = ti->ebitset->bitfieldsnum;
 			goto dobitset;
 		case RNN_TTYPE_INLINE_BITSET:
+			if (ti->plan) {
+				appendplan(ctx, buf, ti->plan, value);
+				return;
+			}
 			bitfields = ti->bitfields;
 			bitfieldsnum = ti->bitfieldsnum;
 			goto dobitset;
 		dobitset:
 			mask = 0;
+			first = 1;
+			rnndec_bufprintf (buf, "{ ");
 			for (i = 0; i < bitfieldsnum; i++) {
-				if (!rnndec_varmatch(ctx, &bitfields[i]->varinfo))
+				if (!rnndec_live(ctx, &bitfields[i]->varinfo))
 					continue;
 				uint64_t sval = (value & bitfields[i]->mask) >> bitfields[i]->low;
 				mask |= bitfields[i]->mask;
@@ -178,116 +569,118 @@ char *rnndec_decodeval(struct rnndeccontext *ctx, struct rnntypeinfo *ti, uint64
 					if (sval == 0)
 						continue;
 					else if (sval == 1) {
-						if (!res)
-							asprintf (&res, "%s%s%s", ctx->colors->mod, bitfields[i]->name, ctx->colors->reset);
-						else {
-							asprintf (&tmp, "%s | %s%s%s", res, ctx->colors->mod, bitfields[i]->name, ctx->colors->reset);
-							free(res);
-							res = tmp;
-						}
+						rnndec_bufprintf (buf, "%s%s%s%s", first ? "" : " | ", ctx->colors->mod, bitfields[i]->name, ctx->colors->reset);
+						first = 0;
 						continue;
 					}
 				}
-				char *subval = rnndec_decodeval(ctx, &bitfields[i]->typeinfo, sval, bitfields[i]->high - bitfields[i]->low + 1);
-				if (!res)
-					asprintf (&res, "%s%s%s = %s", ctx->colors->rname, bitfields[i]->name, ctx->colors->reset, subval);
-				else {
-					asprintf (&tmp, "%s | %s%s%s = %s", res, ctx->colors->rname, bitfields[i]->name, ctx->colors->reset, subval);
-					free(res);
-					res = tmp;
-				}
-				free(subval);
+				rnndec_bufprintf (buf, "%s%s%s%s = ", first ? "" : " | ", ctx->colors->rname, bitfields[i]->name, ctx->colors->reset);
+				rnndec_appendval(ctx, buf, &bitfields[i]->typeinfo, sval, bitfields[i]->high - bitfields[i]->low + 1);
+				first = 0;
 			}
 			if (value & ~mask) {
-				if (!res)
-					asprintf (&res, "%s%#"PRIx64"%s", ctx->colors->err, value & ~mask, ctx->colors->reset);
-				else {
-					asprintf (&tmp, "%s | %s%#"PRIx64"%s", res, ctx->colors->err, value & ~mask, ctx->colors->reset);
-					free(res);
-					res = tmp;
-				}
+				rnndec_bufprintf (buf, "%s%s%#"PRIx64"%s", first ? "" : " | ", ctx->colors->err, value & ~mask, ctx->colors->reset);
+				first = 0;
 			}
-			if (!res)
-				asprintf (&res, "%s0%s", ctx->colors->num, ctx->colors->reset);
-			asprintf (&tmp, "{ %s }", res);
-			free(res);
-			return tmp;
+			if (first)
+				rnndec_bufprintf (buf, "%s0%s", ctx->colors->num, ctx->colors->reset);
+			rnndec_bufprintf (buf, " }");
+			return;
 		case RNN_TTYPE_SPECTYPE:
-			return rnndec_decodeval(ctx, &ti->spectype->typeinfo, value, width);
+			rnndec_appendval(ctx, buf, &ti->spectype->typeinfo, value, width);
+			return;
 		case RNN_TTYPE_HEX:
-			asprintf (&res, "%s%#"PRIx64"%s", ctx->colors->num, value, ctx->colors->reset);
-			return res;
+			rnndec_bufprintf (buf, "%s%#"PRIx64"%s", ctx->colors->num, value, ctx->colors->reset);
+			return;
 		case RNN_TTYPE_FIXED:
 			if (value & UINT64_C(1) << (width-1)) {
-				asprintf (&res, "%s-%lf%s", ctx->colors->num,
+				rnndec_bufprintf (buf, "%s-%lf%s", ctx->colors->num,
 						((double)((UINT64_C(1) << width) - value)) / ((double)(1 << ti->radix)),
 						ctx->colors->reset);
-				return res;
+				return;
 			}
 			/* fallthrough */
 		case RNN_TTYPE_UFIXED:
-			asprintf (&res, "%s%lf%s", ctx->colors->num,
+			rnndec_bufprintf (buf, "%s%lf%s", ctx->colors->num,
 					((double)value) / ((double)(1LL << ti->radix)),
 					ctx->colors->reset);
-			return res;
+			return;
 		case RNN_TTYPE_A3XX_REGID:
-			asprintf (&res, "%sr%"PRIu64".%c%s", ctx->colors->num, (value >> 2), "xyzw"[value & 0x3], ctx->colors->reset);
-			return res;
+			rnndec_bufprintf (buf, "%sr%"PRIu64".%c%s", ctx->colors->num, (value >> 2), "xyzw"[value & 0x3], ctx->colors->reset);
+			return;
 		case RNN_TTYPE_UINT:
-			asprintf (&res, "%s%"PRIu64"%s", ctx->colors->num, value, ctx->colors->reset);
-			return res;
+			rnndec_bufprintf (buf, "%s%"PRIu64"%s", ctx->colors->num, value, ctx->colors->reset);
+			return;
 		case RNN_TTYPE_INT:
 			if (value & UINT64_C(1) << (width-1))
-				asprintf (&res, "%s-%"PRIi64"%s", ctx->colors->num, (UINT64_C(1) << width) - value, ctx->colors->reset);
+				rnndec_bufprintf (buf, "%s-%"PRIi64"%s", ctx->colors->num, (UINT64_C(1) << width) - value, ctx->colors->reset);
 			else
-				asprintf (&res, "%s%"PRIi64"%s", ctx->colors->num, value, ctx->colors->reset);
-			return res;
+				rnndec_bufprintf (buf, "%s%"PRIi64"%s", ctx->colors->num, value, ctx->colors->reset);
+			return;
 		case RNN_TTYPE_BOOLEAN:
 			if (value == 0) {
-				asprintf (&res, "%sFALSE%s", ctx->colors->eval, ctx->colors->reset);
-				return res;
+				rnndec_bufprintf (buf, "%sFALSE%s", ctx->colors->eval, ctx->colors->reset);
+				return;
 			} else if (value == 1) {
-				asprintf (&res, "%sTRUE%s", ctx->colors->eval, ctx->colors->reset);
-				return res;
+				rnndec_bufprintf (buf, "%sTRUE%s", ctx->colors->eval, ctx->colors->reset);
+				return;
 			}
 		case RNN_TTYPE_FLOAT: {
 			union { uint64_t i; float f; double d; } val;
 			val.i = value;
 			if (width == 64)
-				asprintf(&res, "%s%f%s", ctx->colors->num,
+				rnndec_bufprintf(buf, "%s%f%s", ctx->colors->num,
 					val.d, ctx->colors->reset);
 			else if (width == 32)
-				asprintf(&res, "%s%f%s", ctx->colors->num,
+				rnndec_bufprintf(buf, "%s%f%s", ctx->colors->num,
 					val.f, ctx->colors->reset);
 			else if (width == 16)
-				asprintf(&res, "%s%f%s", ctx->colors->num,
+				rnndec_bufprintf(buf, "%s%f%s", ctx->colors->num,
 					float16(value), ctx->colors->reset);
 			else
 				goto failhex;
 
-			return res;
+			return;
 		}
 		failhex:
 		default:
-			asprintf (&res, "%s%#"PRIx64"%s", ctx->colors->num, value, ctx->colors->reset);
-			return res;
+			rnndec_bufprintf (buf, "%s%#"PRIx64"%s", ctx->colors->num, value, ctx->colors->reset);
+			return;
 			break;
 	}
 }
 
-static char *appendidx (struct rnndeccontext *ctx, char *name, uint64_t idx, struct rnnenum *index) {
-	char *res, *index_name = NULL;
+char *rnndec_decodeval(struct rnndeccontext *ctx, struct rnntypeinfo *ti, uint64_t value, int width) {
+	struct rnndecbuf buf = { 0 };
+	rnndec_appendval(ctx, &buf, ti, value, width);
+	return bufstr(&buf);
+}
+
+static void appendidx (struct rnndeccontext *ctx, struct rnndecbuf *buf, uint64_t idx, struct rnnenum *index) {
+	const char *index_name = NULL;
+
+	if (!buf)
+		return;
 
 	if (index)
-		index_name = rnndec_decode_enum_val(ctx, index->vals, index->valsnum, idx);
+		index_name = rnndec_decode_enum_val(ctx, index->vals, index->valsnum, index->vindex, idx);
 
 	if (index_name)
-		asprintf (&res, "%s[%s%s%s]", name, ctx->colors->eval, index_name, ctx->colors->reset);
+		rnndec_bufprintf (buf, "[%s%s%s]", ctx->colors->eval, index_name, ctx->colors->reset);
 	else
-		asprintf (&res, "%s[%s%#"PRIx64"%s]", name, ctx->colors->num, idx, ctx->colors->reset);
+		rnndec_bufprintf (buf, "[%s%#"PRIx64"%s]", ctx->colors->num, idx, ctx->colors->reset);
+}
 
-	free (name);
-	return res;
+/* appends the element name with all outer and own indices */
+static void appendname (struct rnndeccontext *ctx, struct rnndecbuf *buf, struct rnndelem *elem, uint64_t idx, uint64_t *indices, int indicesnum) {
+	int j;
+	if (!buf)
+		return;
+	rnndec_bufprintf (buf, "%s%s%s", ctx->colors->rname, elem->name, ctx->colors->reset);
+	for (j = 0; j < indicesnum; j++)
+		appendidx(ctx, buf, indices[j], NULL);
+	if (elem->length != 1)
+		appendidx(ctx, buf, idx, elem->index);
 }
 
 /* This could probably be made to work for stripes too.. */
@@ -318,14 +711,40 @@ static int get_array_idx_offset(struct rnndelem *elem, uint64_t addr, uint64_t *
 	}
 }
 
-static struct rnndecaddrinfo *trymatch (struct rnndeccontext *ctx, struct rnndelem **elems, int elemsnum, uint64_t addr, int write, int dwidth, uint64_t *indices, int indicesnum) {
-	struct rnndecaddrinfo *res;
+/*
+ * Path recording for rnndec_decodebatch.  Like a NULL buf, a NULL batch
+ * makes these no-ops.
+ */
+static int batchpush(struct rnndecbatch *batch, struct rnndelem *elem, uint64_t idx) {
+	struct rnndecstep step = { elem, idx };
+	if (!batch)
+		return 0;
+	ADDARRAY(batch->steps, step);
+	return batch->stepsnum - 1;
+}
+
+static void batchpop(struct rnndecbatch *batch, int mark) {
+	if (batch)
+		batch->stepsnum = mark;
+}
+
+static void batchoffset(struct rnndecbatch *batch, uint64_t offset) {
+	if (batch)
+		batch->matches[batch->matchesnum - 1].offset = offset;
+}
+
+/*
+ * Names are appended outermost first; a parent's name is written before
+ * descending into it and cut off again if nothing inside matches.
+ */
+static int trymatch (struct rnndeccontext *ctx, struct rnndecbuf *buf, struct rnndecbatch *batch, struct rnndelem **elems, int elemsnum, uint64_t addr, int write, int dwidth, uint64_t *indices, int indicesnum, struct rnndecaddrinfo *info) {
 	int i, j;
 	for (i = 0; i < elemsnum; i++) {
-		if (!rnndec_varmatch(ctx, &elems[i]->varinfo))
+		if (!rnndec_live(ctx, &elems[i]->varinfo))
 			continue;
 		uint64_t offset, idx;
-		char *tmp, *name;
+		size_t start;
+		int mark;
 		switch (elems[i]->type) {
 			case RNN_ETYPE_REG:
 				if (addr < elems[i]->offset)
@@ -341,20 +760,14 @@ static struct rnndecaddrinfo *trymatch (struct rnndeccontext *ctx, struct rnndel
 					break;
 				if (elems[i]->length && idx >= elems[i]->length)
 					break;
-				res = calloc (sizeof *res, 1);
-				res->typeinfo = &elems[i]->typeinfo;
-				res->width = elems[i]->width;
-				asprintf (&res->name, "%s%s%s", ctx->colors->rname, elems[i]->name, ctx->colors->reset);
-				for (j = 0; j < indicesnum; j++)
-					res->name = appendidx(ctx, res->name, indices[j], NULL);
-				if (elems[i]->length != 1)
-					res->name = appendidx(ctx, res->name, idx, elems[i]->index);
-				if (offset) {
-					asprintf (&tmp, "%s+%s%#"PRIx64"%s", res->name, ctx->colors->err, offset, ctx->colors->reset);
-					free(res->name);
-					res->name = tmp;
-				}
-				return res;
+				info->typeinfo = &elems[i]->typeinfo;
+				info->width = elems[i]->width;
+				batchpush(batch, elems[i], idx);
+				batchoffset(batch, offset);
+				appendname(ctx, buf, elems[i], idx, indices, indicesnum);
+				if (offset)
+					rnndec_bufprintf (buf, "+%s%#"PRIx64"%s", ctx->colors->err, offset, ctx->colors->reset);
+				return 1;
 			case RNN_ETYPE_STRIPE:
 				for (idx = 0; idx < elems[i]->length || !elems[i]->length; idx++) {
 					if (addr < elems[i]->offset + elems[i]->stride * idx)
@@ -363,49 +776,39 @@ static struct rnndecaddrinfo *trymatch (struct rnndeccontext *ctx, struct rnndel
 					int extraidx = (elems[i]->length != 1);
 					int nindnum = (elems[i]->name ? 0 : indicesnum + extraidx);
 					uint64_t nind[nindnum];
+					start = buflen(buf);
+					mark = batchpush(batch, elems[i], idx);
 					if (!elems[i]->name) {
 						for (j = 0; j < indicesnum; j++)
 							nind[j] = indices[j];
 						if (extraidx)
 							nind[indicesnum] = idx;
+					} else {
+						appendname(ctx, buf, elems[i], idx, indices, indicesnum);
+						rnndec_bufprintf (buf, ".");
 					}
-					res = trymatch (ctx, elems[i]->subelems, elems[i]->subelemsnum, offset, write, dwidth, nind, nindnum);
-					if (!res)
-						continue;
-					if (!elems[i]->name)
-						return res;
-					asprintf (&name, "%s%s%s", ctx->colors->rname, elems[i]->name, ctx->colors->reset);
-					for (j = 0; j < indicesnum; j++)
-						name = appendidx(ctx, name, indices[j], NULL);
-					if (elems[i]->length != 1)
-						name = appendidx(ctx, name, idx, elems[i]->index);
-					asprintf (&tmp, "%s.%s", name, res->name);
-					free(name);
-					free(res->name);
-					res->name = tmp;
-					return res;
+					if (trymatch (ctx, buf, batch, elems[i]->subelems, elems[i]->subelemsnum, offset, write, dwidth, nind, nindnum, info))
+						return 1;
+					buftrunc(buf, start);
+					batchpop(batch, mark);
 				}
 				break;
 			case RNN_ETYPE_ARRAY:
 				if (get_array_idx_offset(elems[i], addr, &idx, &offset))
 					break;
-				asprintf (&name, "%s%s%s", ctx->colors->rname, elems[i]->name, ctx->colors->reset);
-				for (j = 0; j < indicesnum; j++)
-					name = appendidx(ctx, name, indices[j], NULL);
-				if (elems[i]->length != 1)
-					name = appendidx(ctx, name, idx, elems[i]->index);
-				if ((res = trymatch (ctx, elems[i]->subelems, elems[i]->subelemsnum, offset, write, dwidth, 0, 0))) {
-					asprintf (&tmp, "%s.%s", name, res->name);
-					free(name);
-					free(res->name);
-					res->name = tmp;
-					return res;
-				}
-				res = calloc (sizeof *res, 1);
-				asprintf (&tmp, "%s+%s%#"PRIx64"%s", name, ctx->colors->err, offset, ctx->colors->reset);
-				free(name);
-				res->name = tmp;
-				return res;
+				mark = batchpush(batch, elems[i], idx) + 1;
+				appendname(ctx, buf, elems[i], idx, indices, indicesnum);
+				start = buflen(buf);
+				rnndec_bufprintf (buf, ".");
+				if (trymatch (ctx, buf, batch, elems[i]->subelems, elems[i]->subelemsnum, offset, write, dwidth, 0, 0, info))
+					return 1;
+				buftrunc(buf, start);
+				batchpop(batch, mark);
+				batchoffset(batch, offset);
+				info->typeinfo = 0;
+				info->width = 0;
+				rnndec_bufprintf (buf, "+%s%#"PRIx64"%s", ctx->colors->err, offset, ctx->colors->reset);
+				return 1;
 			default:
 				break;
 		}
@@ -414,23 +817,143 @@ static struct rnndecaddrinfo *trymatch (struct rnndeccontext *ctx, struct rnndel
 }
 
 int rnndec_checkaddr(struct rnndeccontext *ctx, struct rnndomain *domain, uint64_t addr, int write) {
-	struct rnndecaddrinfo *res = trymatch(ctx, domain->subelems, domain->subelemsnum, addr, write, domain->width, 0, 0);
-	if (res) {
-		free(res->name);
-		free(res);
-	}
-	return res != NULL;
+	struct rnndecaddrinfo info;
+	if (ctx->specialized)
+		domain = spec_domain(ctx, domain);
+	return trymatch(ctx, 0, 0, domain->subelems, domain->subelemsnum, addr, write, domain->width, 0, 0, &info);
+}
+
+int rnndec_appendaddr(struct rnndeccontext *ctx, struct rnndecbuf *buf, struct rnndomain *domain, uint64_t addr, int write, struct rnndecaddrinfo *info) {
+	if (ctx->specialized)
+		domain = spec_domain(ctx, domain);
+	info->name = 0;
+	if (trymatch(ctx, buf, 0, domain->subelems, domain->subelemsnum, addr, write, domain->width, 0, 0, info))
+		return 1;
+	info->typeinfo = 0;
+	info->width = 0;
+	rnndec_bufprintf (buf, "%s%#"PRIx64"%s", ctx->colors->err, addr, ctx->colors->reset);
+	return 0;
 }
 
 struct rnndecaddrinfo *rnndec_decodeaddr(struct rnndeccontext *ctx, struct rnndomain *domain, uint64_t addr, int write) {
-	struct rnndecaddrinfo *res = trymatch(ctx, domain->subelems, domain->subelemsnum, addr, write, domain->width, 0, 0);
-	if (res)
-		return res;
-	res = calloc (sizeof *res, 1);
-	asprintf (&res->name, "%s%#"PRIx64"%s", ctx->colors->err, addr, ctx->colors->reset);
+	struct rnndecaddrinfo *res = calloc (sizeof *res, 1);
+	struct rnndecbuf buf = { 0 };
+	rnndec_appendaddr(ctx, &buf, domain, addr, write, res);
+	res->name = bufstr(&buf);
 	return res;
 }
 
+/*
+ * Matches are kept in an open-addressed hash on (addr, write) that lives as
+ * long as the batch, so a trace decoded in chunks only resolves each
+ * register once.  Switching context or domain starts over; so must the
+ * caller after changing the variants of a context.
+ */
+
+static int batchslot(struct rnndecbatch *batch, uint64_t addr, int write) {
+	uint64_t key = (addr << 1 | write) * 0x9e3779b97f4a7c15ull;
+	return (key >> 32) & (batch->hashsize - 1);
+}
+
+static void batchrehash(struct rnndecbatch *batch) {
+	int i, h;
+	batch->hashsize = batch->hashsize ? batch->hashsize * 2 : 64;
+	batch->hash = realloc(batch->hash, batch->hashsize * sizeof *batch->hash);
+	memset(batch->hash, -1, batch->hashsize * sizeof *batch->hash);
+	for (i = 0; i < batch->matchesnum; i++) {
+		h = batchslot(batch, batch->matches[i].addr, batch->matches[i].write);
+		while (batch->hash[h] != -1)
+			h = (h + 1) & (batch->hashsize - 1);
+		batch->hash[h] = i;
+	}
+}
+
+static int batchfind(struct rnndeccontext *ctx, struct rnndecbatch *batch, struct rnndomain *domain, uint64_t addr, int write) {
+	struct rnndecmatch match = { 0 }, *m;
+	struct rnndecaddrinfo info;
+	int h;
+	if (batch->matchesnum * 2 >= batch->hashsize)
+		batchrehash(batch);
+	for (h = batchslot(batch, addr, write); batch->hash[h] != -1; h = (h + 1) & (batch->hashsize - 1)) {
+		m = &batch->matches[batch->hash[h]];
+		if (m->addr == addr && m->write == write)
+			return batch->hash[h];
+	}
+	match.addr = addr;
+	match.write = write;
+	match.steps = batch->stepsnum;
+	ADDARRAY(batch->matches, match);
+	batch->hash[h] = batch->matchesnum - 1;
+	m = &batch->matches[batch->matchesnum - 1];
+	m->found = trymatch(ctx, 0, batch, domain->subelems, domain->subelemsnum, addr, write, domain->width, 0, 0, &info);
+	if (m->found) {
+		m->typeinfo = info.typeinfo;
+		m->width = info.width;
+	}
+	m->stepsnum = batch->stepsnum - m->steps;
+	return batch->matchesnum - 1;
+}
+
+void rnndec_decodebatch(struct rnndeccontext *ctx, struct rnndecbatch *batch, struct rnndomain *domain, struct rnndecaccess *accs, int accsnum) {
+	struct rnndomain *dom = ctx->specialized ? spec_domain(ctx, domain) : domain;
+	int i, prev = -1;
+	if (batch->ctx != ctx || batch->domain != domain) {
+		rnndec_batchclear(batch);
+		batch->ctx = ctx;
+		batch->domain = domain;
+	}
+	for (i = 0; i < accsnum; i++) {
+		/* polling loops hit the same register over and over */
+		if (prev != -1 && batch->matches[prev].addr == accs[i].addr && batch->matches[prev].write == accs[i].write) {
+			accs[i].match = prev;
+			continue;
+		}
+		prev = accs[i].match = batchfind(ctx, batch, dom, accs[i].addr, accs[i].write);
+	}
+}
+
+/* replays the naming done by trymatch along the recorded steps */
+int rnndec_appendmatch(struct rnndeccontext *ctx, struct rnndecbuf *buf, struct rnndecbatch *batch, int match) {
+	struct rnndecmatch *m = &batch->matches[match];
+	struct rnndecstep *steps = &batch->steps[m->steps];
+	uint64_t indices[m->stepsnum + 1];
+	int indicesnum = 0;
+	int i;
+	if (!m->found) {
+		rnndec_bufprintf (buf, "%s%#"PRIx64"%s", ctx->colors->err, m->addr, ctx->colors->reset);
+		return 0;
+	}
+	for (i = 0; i < m->stepsnum; i++) {
+		struct rnndelem *elem = steps[i].elem;
+		if (elem->type == RNN_ETYPE_STRIPE && !elem->name) {
+			if (elem->length != 1)
+				indices[indicesnum++] = steps[i].idx;
+			continue;
+		}
+		appendname(ctx, buf, elem, steps[i].idx, indices, indicesnum);
+		indicesnum = 0;
+		if (i + 1 < m->stepsnum)
+			rnndec_bufprintf (buf, ".");
+		else if (m->offset || elem->type == RNN_ETYPE_ARRAY)
+			rnndec_bufprintf (buf, "+%s%#"PRIx64"%s", ctx->colors->err, m->offset, ctx->colors->reset);
+	}
+	return 1;
+}
+
+void rnndec_batchclear(struct rnndecbatch *batch) {
+	batch->matchesnum = 0;
+	batch->stepsnum = 0;
+	if (batch->hash)
+		memset(batch->hash, -1, batch->hashsize * sizeof *batch->hash);
+}
+
+void rnndec_batchfree(struct rnndecbatch *batch) {
+	free(batch->matches);
+	free(batch->steps);
+	free(batch->hash);
+	memset(batch, 0, sizeof *batch);
+}
+
 static uint64_t tryreg(struct rnndeccontext *ctx, struct rnndelem **elems, int elemsnum,
 		int dwidth, const char *name)
 {
@@ -449,7 +972,7 @@ static uint64_t tryreg(struct rnndeccontext *ctx, struct rnndelem **elems, int e
 
 	for (i = 0; i < elemsnum; i++) {
 		struct rnndelem *elem = elems[i];
-		if (!rnndec_varmatch(ctx, &elem->varinfo))
+		if (!rnndec_live(ctx, &elem->varinfo))
 			continue;
 		int match = (strlen(elem->name) == n) && !strncmp(elem->name, name, n);
 		switch (elem->type) {
@@ -478,5 +1001,7 @@ static uint64_t tryreg(struct rnndeccontext *ctx, struct rnndelem **elems, int e
 
 uint64_t rnndec_decodereg(struct rnndeccontext *ctx, struct rnndomain *domain, const char *name)
 {
+	if (ctx->specialized)
+		domain = spec_domain(ctx, domain);
 	return tryreg(ctx, domain->subelems, domain->subelemsnum, domain->width, name);
 }
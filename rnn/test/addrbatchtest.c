@@ -0,0 +1,230 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Checks that rnndec_decodebatch followed by rnndec_appendmatch names every
+ * address exactly like rnndec_appendaddr, with and without colors, variants
+ * and specialization, then times per-access rnndec_decodeaddr against
+ * batched decoding with and without formatting.  Uses a generated domain
+ * covering registers, arrays, named and unnamed stripes, plus the database
+ * files given on the command line.
+ */
+
+#include "rnndec.h"
+#include "util.h"
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char testxml[] =
+	"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+	"<enum name=\"chip\"><value name=\"C1\"/><value name=\"C2\"/></enum>\n"
+	"<enum name=\"eng\"><value name=\"ENG_A\" value=\"0\"/><value name=\"ENG_B\" value=\"1\"/></enum>\n"
+	"<bitset name=\"ctrl\"><bitfield name=\"EN\" pos=\"0\"/><bitfield name=\"MODE\" low=\"4\" high=\"7\"/></bitset>\n"
+	"<domain name=\"TEST\" width=\"32\" varset=\"chip\">\n"
+	"\t<reg32 offset=\"0x0\" name=\"CTRL\" type=\"ctrl\"/>\n"
+	"\t<reg64 offset=\"0x8\" name=\"WIDE\"/>\n"
+	"\t<reg32 offset=\"0x10\" name=\"LIST\" length=\"4\" stride=\"4\"/>\n"
+	"\t<reg32 offset=\"0x21\" name=\"NEW\" variants=\"C2\"/>\n"
+	"\t<array offset=\"0x100\" name=\"ENG\" stride=\"0x40\" length=\"2\" index=\"eng\">\n"
+	"\t\t<reg32 offset=\"0\" name=\"STATUS\"/>\n"
+	"\t\t<stripe offset=\"0x10\" stride=\"8\" length=\"2\">\n"
+	"\t\t\t<reg32 offset=\"0\" name=\"LO\"/>\n"
+	"\t\t\t<reg32 offset=\"4\" name=\"HI\"/>\n"
+	"\t\t</stripe>\n"
+	"\t</array>\n"
+	"\t<stripe offset=\"0x200\" name=\"CH\" stride=\"0x20\" length=\"3\">\n"
+	"\t\t<reg32 offset=\"0\" name=\"PUT\"/>\n"
+	"\t\t<array offset=\"0x8\" name=\"SUB\" stride=\"8\" length=\"2\"><reg32 offset=\"4\" name=\"VAL\"/></array>\n"
+	"\t</stripe>\n"
+	"\t<array offsets=\"0x400,0x480,0x500\" name=\"PORT\" stride=\"0x10\"><reg32 offset=\"0\" name=\"CFG\" variants=\"C1\"/></array>\n"
+	"\t<stripe offset=\"0x600\" stride=\"0x10\" length=\"2\">\n"
+	"\t\t<stripe offset=\"0\" stride=\"4\" length=\"2\"><reg32 offset=\"0\" name=\"DEEP\"/></stripe>\n"
+	"\t\t<stripe offset=\"8\"><reg32 offset=\"0\" name=\"FLAT\"/></stripe>\n"
+	"\t</stripe>\n"
+	"</domain>\n"
+	"</database>\n";
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* a scrambled walk over [0, range) that revisits addresses and repeats accesses */
+static struct rnndecaccess *mktrace(uint64_t range, int num) {
+	struct rnndecaccess *accs = calloc(num, sizeof *accs);
+	uint64_t x = 1;
+	int i;
+	for (i = 0; i < num; i++) {
+		x = x * 6364136223846793005ull + 1442695040888963407ull;
+		if (i && (x >> 60) < 4) {
+			accs[i] = accs[i-1];
+		} else {
+			accs[i].addr = (x >> 24) % range;
+			accs[i].write = x >> 63;
+		}
+		accs[i].value = x >> 17;
+	}
+	return accs;
+}
+
+static int check(struct rnndeccontext *ctx, struct rnndomain *dom, uint64_t range, const char *what) {
+	struct rnndecbatch batch = { 0 };
+	struct rnndecbuf buf = { 0 }, bbuf = { 0 };
+	struct rnndecaccess *accs = mktrace(range, range * 4);
+	int i, chunk, res = 0;
+
+	/* uneven chunks, so lookups also hit matches from earlier calls */
+	for (i = 0, chunk = 1; i < range * 4; i += chunk, chunk = chunk * 3 + 1)
+		rnndec_decodebatch(ctx, &batch, dom, accs + i, min(chunk, (int)(range * 4 - i)));
+	for (i = 0; i < range * 4; i++) {
+		struct rnndecaddrinfo info;
+		struct rnndecmatch *m = &batch.matches[accs[i].match];
+		int found, bfound;
+		rnndec_bufclear(&buf);
+		rnndec_bufclear(&bbuf);
+		found = rnndec_appendaddr(ctx, &buf, dom, accs[i].addr, accs[i].write, &info);
+		bfound = rnndec_appendmatch(ctx, &bbuf, &batch, accs[i].match);
+		if (m->addr != accs[i].addr || m->write != accs[i].write || found != bfound ||
+				info.typeinfo != m->typeinfo || info.width != m->width || strcmp(buf.str, bbuf.str)) {
+			fprintf(stderr, "%s %s: mismatch for %#"PRIx64"%s: %d %s vs %d %s\n", dom->name, what,
+				accs[i].addr, accs[i].write ? " (write)" : "", found, buf.str, bfound, bbuf.str);
+			res = 1;
+		}
+		if (m->typeinfo) {
+			char *str = rnndec_decodeval(ctx, m->typeinfo, accs[i].value, m->width);
+			free(str);
+		}
+	}
+	rnndec_buffree(&buf);
+	rnndec_buffree(&bbuf);
+	rnndec_batchfree(&batch);
+	free(accs);
+	return res;
+}
+
+static void bench(struct rnndeccontext *ctx, struct rnndomain *dom, uint64_t range, int num) {
+	struct rnndecbatch batch = { 0 };
+	struct rnndecbuf buf = { 0 };
+	struct rnndecaccess *accs = mktrace(range, num);
+	double t0, t1, t2, t3;
+	int i;
+
+	t0 = now();
+	for (i = 0; i < num; i++) {
+		struct rnndecaddrinfo *info = rnndec_decodeaddr(ctx, dom, accs[i].addr, accs[i].write);
+		free(info->name);
+		free(info);
+	}
+	t1 = now();
+	rnndec_decodebatch(ctx, &batch, dom, accs, num);
+	t2 = now();
+	for (i = 0; i < num; i++) {
+		struct rnndecmatch *m = &batch.matches[accs[i].match];
+		rnndec_bufclear(&buf);
+		rnndec_appendmatch(ctx, &buf, &batch, accs[i].match);
+		if (m->typeinfo) {
+			rnndec_bufprintf(&buf, " = ");
+			rnndec_appendval(ctx, &buf, m->typeinfo, accs[i].value, m->width);
+		}
+	}
+	t3 = now();
+	printf("%-12s decodeaddr %8.1f ns   batch %8.1f ns   batch+names %8.1f ns   (%d accesses, %d distinct)\n", dom->name,
+		(t1 - t0) * 1e9 / num, (t2 - t1) * 1e9 / num, (t3 - t1) * 1e9 / num, num, batch.matchesnum);
+	rnndec_buffree(&buf);
+	rnndec_batchfree(&batch);
+	free(accs);
+}
+
+static int checkdb(struct rnndb *db, uint64_t range, int num, int vars) {
+	struct rnndeccontext *ctx = rnndec_newcontext(db);
+	struct rnndeccontext *cctx = rnndec_newcontext(db);
+	struct rnndeccontext *sctx;
+	int i, res = 0;
+	ctx->colors = &envy_null_colors;
+	cctx->colors = &envy_def_colors;
+	if (vars) {
+		rnndec_varadd(ctx, "chip", "C1");
+		rnndec_varadd(cctx, "chip", "C2");
+	}
+	sctx = rnndec_specialize(cctx);
+	for (i = 0; i < db->domainsnum; i++) {
+		struct rnndomain *dom = db->domains[i];
+		res |= check(ctx, dom, range, "plain");
+		res |= check(cctx, dom, range, "colors");
+		res |= check(sctx, dom, range, "specialized");
+	}
+	for (i = 0; i < db->domainsnum && num; i++)
+		bench(ctx, db->domains[i], range, num);
+	rnndec_freecontext(ctx);
+	rnndec_freecontext(cctx);
+	rnndec_freecontext(sctx);
+	return res;
+}
+
+int main(int argc, char **argv) {
+	char dir[] = "/tmp/addrbatchtestXXXXXX";
+	char *name, *path;
+	struct rnndb *db;
+	FILE *f;
+	int i, res = 0;
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	name = aprintf("%s/test.xml", dir);
+	f = fopen(name, "w");
+	fputs(testxml, f);
+	fclose(f);
+	rnn_init();
+	path = getenv("RNN_PATH");
+	path = path ? strdup(path) : 0;
+	setenv("RNN_PATH", dir, 1);
+	db = rnn_newdb();
+	rnn_parsefile(db, "test.xml");
+	rnn_prepdb(db);
+	unlink(name);
+	rmdir(dir);
+	free(name);
+	if (path)
+		setenv("RNN_PATH", path, 1);
+	else
+		unsetenv("RNN_PATH");
+	if (db->estatus) {
+		fprintf(stderr, "failed to parse the test database\n");
+		return 1;
+	}
+	res |= checkdb(db, 0x800, 100000, 1);
+	for (i = 1; i < argc; i++) {
+		db = rnn_newdb();
+		rnn_parsefile(db, argv[i]);
+		rnn_prepdb(db);
+		res |= checkdb(db, 0x1000, 0, 0);
+	}
+	if (res)
+		return 1;
+	printf("All ok\n");
+	return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Converts a valgrind-mmt trace with trace2bin and checks that dedma decodes
+ * the binary trace exactly like the text one.  Takes the paths of the
+ * trace2bin and dedma executables, and uses a generated object database.
+ */
+
+#include "util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char *const files[][2] = {
+	{ "nv_objects.xml",
+		"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+		"<enum name=\"chipset\" bare=\"yes\" prefix=\"chipset\"><value name=\"NV01\" value=\"0x01\"/><value name=\"NV50\" value=\"0x50\"/></enum>\n"
+		"<enum name=\"obj-class\" bare=\"yes\" prefix=\"chipset\"><value name=\"NV50_3D\" value=\"0x5097\" variants=\"NV50-\"/></enum>\n"
+		"<domain name=\"NV01_SUBCHAN\" width=\"32\">\n"
+		"\t<stripe variants=\"NV50_3D\" varset=\"obj-class\">\n"
+		"\t\t<reg32 offset=\"0x0000\" name=\"OBJECT\"/>\n"
+		"\t\t<reg32 offset=\"0x0100\" name=\"NOP\"/>\n"
+		"\t\t<reg32 offset=\"0x0200\" name=\"CTL\"/>\n"
+		"\t\t<reg32 offset=\"0x0300\" name=\"FMT\" length=\"8\"/>\n"
+		"\t</stripe>\n"
+		"</domain>\n"
+		"</database>\n" },
+	/* multi-word writes, a dangling comma, other maps, junk, and no final newline */
+	{ "t.txt",
+		"==1== valgrind banner\n"
+		"--1-- create gpu object 0x0:0xbeef0001 type 0x5097\n"
+		"--1-- w 1:0x0, 0x00042000\n"
+		"--1-- w 1:0x4, 0xbeef0001\n"
+		"--1-- w 1:0x8, 0x00082200,\n"
+		"--1-- w 2:0x10, 0x5\n"
+		"--1-- w 1:0xc, 0x1, 0x2\n"
+		"--1-- r 1:0x10, 0x3\n"
+		"--1-- w 1:0x14, 0x00102300, 0x3, 0x4, 0x5\n"
+		"--1-- w 1:0x24, 0x5, 0x6, 0x7\n"
+		"--1-- w 1:0x30, 0x00042100\n"
+		"--1-- w 1:0x34,\n"
+		"--1-- w 1:0x38, 0x7" },
+};
+
+static char *slurp(const char *name) {
+	FILE *f = fopen(name, "r");
+	char *res = 0;
+	size_t len = 0;
+	if (!f)
+		return strdup("");
+	getdelim(&res, &len, 0, f);
+	fclose(f);
+	return res ? res : strdup("");
+}
+
+static int run(const char *cmd) {
+	int res = system(cmd);
+	if (res)
+		fprintf(stderr, "%s: exit status %d\n", cmd, res);
+	return res;
+}
+
+static int check(const char *dedma, const char *dir, const char *opts) {
+	char *cmd, *name, *txt, *bin;
+	int res = 0;
+	cmd = aprintf("%s %s -v 1 %s/t.txt > %s/txt.out", dedma, opts, dir, dir);
+	res |= run(cmd);
+	free(cmd);
+	cmd = aprintf("%s %s -v 1 %s/t.bin > %s/bin.out", dedma, opts, dir, dir);
+	res |= run(cmd);
+	free(cmd);
+	name = aprintf("%s/txt.out", dir);
+	txt = slurp(name);
+	unlink(name);
+	free(name);
+	name = aprintf("%s/bin.out", dir);
+	bin = slurp(name);
+	unlink(name);
+	free(name);
+	if (!*txt) {
+		fprintf(stderr, "dedma %s: no output\n", opts);
+		res = 1;
+	} else if (strcmp(txt, bin)) {
+		fprintf(stderr, "dedma %s: binary trace decodes differently\n--- text:\n%s--- binary:\n%s", opts, txt, bin);
+		res = 1;
+	}
+	free(txt);
+	free(bin);
+	return res;
+}
+
+int main(int argc, char **argv) {
+	char dir[] = "/tmp/bintracetestXXXXXX";
+	char *cmd, *name;
+	int i, res = 0;
+	if (argc != 3) {
+		fprintf(stderr, "usage: %s trace2bin dedma\n", argv[0]);
+		return 1;
+	}
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	for (i = 0; i < ARRAY_SIZE(files); i++) {
+		name = aprintf("%s/%s", dir, files[i][0]);
+		FILE *f = fopen(name, "w");
+		fputs(files[i][1], f);
+		fclose(f);
+		free(name);
+	}
+	setenv("RNN_PATH", dir, 1);
+	cmd = aprintf("%s -t mmt -f %s/t.txt -o %s/t.bin", argv[1], dir, dir);
+	res |= run(cmd);
+	free(cmd);
+	if (!res) {
+		res |= check(argv[2], dir, "-x");
+		res |= check(argv[2], dir, "");
+	}
+	for (i = 0; i < ARRAY_SIZE(files); i++) {
+		name = aprintf("%s/%s", dir, files[i][0]);
+		unlink(name);
+		free(name);
+	}
+	name = aprintf("%s/t.bin", dir);
+	unlink(name);
+	free(name);
+	rmdir(dir);
+	if (res)
+		return 1;
+	printf("All ok\n");
+	return 0;
+}
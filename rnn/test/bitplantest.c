@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Builds random bitsets - overlapping fields, variant-restricted fields and
+ * enum values, duplicate enum values, spectypes, shifts, nested bitsets -
+ * and checks that decoding through bitset plans and enum value indices,
+ * with and without a specialized context, gives the same text as the plain
+ * recursive decoder with linear enum scans.
+ */
+
+#include "rnndec.h"
+#include "util.h"
+#include <string.h>
+
+#define NVARIANTS 4
+
+static struct rnnenum venum;
+static struct rnnenum *enums[4];
+static struct rnnspectype *spectypes[4];
+
+/* everything that got a plan or value index, so they can be switched off */
+static struct rnntypeinfo **tis;
+static int tisnum, tismax;
+static struct rnnbitplan **tiplans;
+static int tiplansnum, tiplansmax;
+static struct rnntypeinfo **etis;
+static int etisnum, etismax;
+static struct rnnvalindex **etivindices;
+static int etivindicesnum, etivindicesmax;
+static struct rnnvalindex *enumvindices[4];
+
+static char *mkname(const char *prefix, int i) {
+	return aprintf("%s%d", prefix, i);
+}
+
+static void mkvarinfo(struct rnnvarinfo *vi) {
+	int r = rand() % 20;
+	int i;
+	if (r == 0) {
+		vi->dead = 1;
+	} else if (r < 7) {
+		struct rnnvarset *vs = calloc(sizeof *vs, 1);
+		vs->venum = &venum;
+		vs->variants = calloc(sizeof *vs->variants, NVARIANTS);
+		for (i = 0; i < NVARIANTS; i++)
+			vs->variants[i] = rand() & 1;
+		ADDARRAY(vi->varsets, vs);
+	}
+}
+
+static struct rnnvalue **mkvals(int width, int *pnum) {
+	struct rnnvalue **vals = 0;
+	int valsnum = 0, valsmax = 0;
+	int n = rand() % 12;
+	int i;
+	for (i = 0; i < n; i++) {
+		struct rnnvalue *v = calloc(sizeof *v, 1);
+		v->name = mkname("V", i);
+		v->valvalid = rand() % 8 != 0;
+		/* small ranges so that values repeat */
+		v->value = rand() % (width < 4 ? 1 << width : 12);
+		if (rand() % 16 == 0)
+			v->value = rand();
+		mkvarinfo(&v->varinfo);
+		v->varinfo.dead = 0;
+		ADDARRAY(vals, v);
+	}
+	*pnum = valsnum;
+	return vals;
+}
+
+static void mktypeinfo(struct rnntypeinfo *ti, int width, int depth);
+
+static struct rnnbitfield **mkbitfields(int *pnum, int depth) {
+	struct rnnbitfield **bfs = 0;
+	int bfsnum = 0, bfsmax = 0;
+	int n = rand() % 24;
+	int i;
+	for (i = 0; i < n; i++) {
+		struct rnnbitfield *bf = calloc(sizeof *bf, 1);
+		int a = rand() % 64, b = rand() % (rand() % 3 ? 4 : 64);
+		bf->name = mkname("F", i);
+		bf->low = a;
+		bf->high = min(a + b, 63);
+		bf->mask = bflmask(bf->high - bf->low + 1) << bf->low;
+		mkvarinfo(&bf->varinfo);
+		mktypeinfo(&bf->typeinfo, bf->high - bf->low + 1, depth + 1);
+		ADDARRAY(bfs, bf);
+	}
+	*pnum = bfsnum;
+	return bfs;
+}
+
+static void mktypeinfo(struct rnntypeinfo *ti, int width, int depth) {
+	static const enum rnnttype types[] = {
+		RNN_TTYPE_BOOLEAN, RNN_TTYPE_BOOLEAN, RNN_TTYPE_HEX, RNN_TTYPE_UINT, RNN_TTYPE_INT,
+		RNN_TTYPE_INLINE_ENUM, RNN_TTYPE_INLINE_ENUM, RNN_TTYPE_ENUM, RNN_TTYPE_ENUM,
+		RNN_TTYPE_SPECTYPE, RNN_TTYPE_FIXED, RNN_TTYPE_FLOAT, RNN_TTYPE_INLINE_BITSET,
+	};
+	ti->type = types[rand() % ARRAY_SIZE(types)];
+	if (ti->type == RNN_TTYPE_INLINE_BITSET && depth > 1)
+		ti->type = RNN_TTYPE_HEX;
+	if (rand() % 10 == 0)
+		ti->shr = 1 + rand() % 3;
+	switch (ti->type) {
+		case RNN_TTYPE_INLINE_ENUM:
+			ti->vals = mkvals(width, &ti->valsnum);
+			ti->vindex = rnn_valindex(ti->vals, ti->valsnum);
+			ADDARRAY(etis, ti);
+			ADDARRAY(etivindices, ti->vindex);
+			break;
+		case RNN_TTYPE_ENUM:
+			ti->eenum = enums[rand() % ARRAY_SIZE(enums)];
+			break;
+		case RNN_TTYPE_SPECTYPE:
+			ti->spectype = spectypes[rand() % ARRAY_SIZE(spectypes)];
+			break;
+		case RNN_TTYPE_FIXED:
+			ti->radix = rand() % 8;
+			break;
+		case RNN_TTYPE_INLINE_BITSET:
+			ti->bitfields = mkbitfields(&ti->bitfieldsnum, depth);
+			ADDARRAY(tis, ti);
+			break;
+		default:
+			break;
+	}
+}
+
+static void setplans(int on) {
+	int i;
+	for (i = 0; i < tisnum; i++)
+		tis[i]->plan = on ? tiplans[i] : 0;
+	for (i = 0; i < etisnum; i++)
+		etis[i]->vindex = on ? etivindices[i] : 0;
+	for (i = 0; i < ARRAY_SIZE(enums); i++)
+		enums[i]->vindex = on ? enumvindices[i] : 0;
+}
+
+static void decode(struct rnndeccontext *ctx, struct rnndomain *dom, uint64_t value, struct rnndecbuf *buf) {
+	struct rnndecaddrinfo ai;
+	rnndec_bufclear(buf);
+	rnndec_appendaddr(ctx, buf, dom, 0, 1, &ai);
+	rnndec_bufprintf(buf, " => ");
+	rnndec_appendval(ctx, buf, ai.typeinfo, value, ai.width);
+}
+
+int main() {
+	struct rnndb *db;
+	struct rnndecbuf ref = { 0 }, res = { 0 };
+	int iter, i, fails = 0, checked = 0;
+	int etisbase;
+
+	rnn_init();
+	db = rnn_newdb();
+	srand(1);
+
+	venum.name = "variant";
+	for (i = 0; i < NVARIANTS; i++) {
+		struct rnnvalue *v = calloc(sizeof *v, 1);
+		v->name = mkname("VAR", i);
+		v->value = i;
+		v->valvalid = 1;
+		ADDARRAY(venum.vals, v);
+	}
+	ADDARRAY(db->enums, &venum);
+	for (i = 0; i < ARRAY_SIZE(enums); i++) {
+		enums[i] = calloc(sizeof *enums[i], 1);
+		enums[i]->name = mkname("E", i);
+		enums[i]->vals = mkvals(2 + i, &enums[i]->valsnum);
+		enums[i]->vindex = enumvindices[i] = rnn_valindex(enums[i]->vals, enums[i]->valsnum);
+	}
+	for (i = 0; i < ARRAY_SIZE(spectypes); i++) {
+		spectypes[i] = calloc(sizeof *spectypes[i], 1);
+		spectypes[i]->name = mkname("S", i);
+		/* no spectype chains, and no nested bitsets here */
+		do {
+			mktypeinfo(&spectypes[i]->typeinfo, 8, 2);
+		} while (spectypes[i]->typeinfo.type == RNN_TTYPE_SPECTYPE);
+	}
+	etisbase = etisnum;
+
+	for (iter = 0; iter < 2000; iter++) {
+		struct rnnbitset bs = { 0 };
+		struct rnndelem reg = { 0 };
+		struct rnndelem *regp = &reg;
+		struct rnndomain dom = { 0 };
+		int variant = rand() % NVARIANTS;
+
+		tisnum = 0;
+		tiplansnum = 0;
+		etisnum = etisbase;
+		etivindicesnum = etisbase;
+		reg.type = RNN_ETYPE_REG;
+		reg.name = "REG";
+		reg.width = 64;
+		reg.length = 1;
+		if (rand() & 1) {
+			bs.name = "BS";
+			bs.bitfields = mkbitfields(&bs.bitfieldsnum, 0);
+			reg.typeinfo.type = RNN_TTYPE_BITSET;
+			reg.typeinfo.ebitset = &bs;
+		} else {
+			reg.typeinfo.type = RNN_TTYPE_INLINE_BITSET;
+			reg.typeinfo.bitfields = mkbitfields(&reg.typeinfo.bitfieldsnum, 0);
+			ADDARRAY(tis, &reg.typeinfo);
+		}
+		dom.name = "DOM";
+		dom.width = 64;
+		dom.subelems = &regp;
+		dom.subelemsnum = 1;
+		for (i = 0; i < tisnum; i++)
+			ADDARRAY(tiplans, rnn_bitplan(tis[i]->bitfields, tis[i]->bitfieldsnum));
+		struct rnnbitplan *bsplan = rnn_bitplan(bs.bitfields, bs.bitfieldsnum);
+
+		struct rnndeccontext *ctx = rnndec_newcontext(db);
+		rnndec_varadd(ctx, "variant", venum.vals[variant]->name);
+		if (iter & 1)
+			ctx->colors = &envy_def_colors;
+
+		for (i = 0; i < 16; i++) {
+			uint64_t value = (uint64_t)rand() << 33 ^ (uint64_t)rand() << 11 ^ rand();
+			if (i & 1)
+				value &= (uint64_t)rand() * rand();
+
+			setplans(0);
+			bs.plan = 0;
+			decode(ctx, &dom, value, &ref);
+
+			setplans(1);
+			bs.plan = bsplan;
+			decode(ctx, &dom, value, &res);
+			if (strcmp(ref.str, res.str)) {
+				fprintf(stderr, "plan mismatch, value %#"PRIx64" variant %d:\n%s\n%s\n", value, variant, ref.str, res.str);
+				fails++;
+			}
+
+			struct rnndeccontext *spec = rnndec_specialize(ctx);
+			decode(spec, &dom, value, &res);
+			if (strcmp(ref.str, res.str)) {
+				fprintf(stderr, "specialized mismatch, value %#"PRIx64" variant %d:\n%s\n%s\n", value, variant, ref.str, res.str);
+				fails++;
+			}
+			rnndec_freecontext(spec);
+			checked++;
+		}
+
+		rnndec_freecontext(ctx);
+		for (i = 0; i < tiplansnum; i++)
+			rnn_freebitplan(tiplans[i]);
+		for (i = etisbase; i < etivindicesnum; i++)
+			rnn_freevalindex(etivindices[i]);
+		rnn_freebitplan(bsplan);
+		if (fails > 10)
+			break;
+	}
+	rnndec_buffree(&ref);
+	rnndec_buffree(&res);
+	if (fails) {
+		fprintf(stderr, "%d mismatches\n", fails);
+		return 1;
+	}
+	printf("%d values ok\n", checked);
+	return 0;
+}
@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Loads a database tree serially and with parallel parsing, and checks that
+ * the resulting databases and everything printed to stderr are identical.
+ * Uses a generated tree with broken, missing, cyclic and commented-out
+ * imports, plus the database files given on the command line.
+ */
+
+#include "rnn.h"
+#include "util.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char *const files[][2] = {
+	{ "top.xml",
+		"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+		"<import file=\"a.xml\"/>\n"
+		"<bogus/>\n"
+		"<!-- <import file=\"unused.xml\"/> -->\n"
+		"<import file='b.xml'/>\n"
+		"<import file=\"missing.xml\"/>\n"
+		"<enum name=\"top_enum\"><value name=\"TOP_X\" value=\"1\"/></enum>\n"
+		"<domain name=\"TOP\" width=\"32\">\n"
+		"\t<reg32 offset=\"0x10\" name=\"CTRL\"><bitfield name=\"MODE\" low=\"0\" high=\"3\" type=\"a_enum\"/></reg32>\n"
+		"\t<import file=\"c.xml\"/>\n"
+		"</domain>\n"
+		"</database>\n" },
+	{ "a.xml",
+		"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+		"<enum name=\"a_enum\"><value name=\"A_0\" value=\"0\"/><value name=\"A_1\" value=\"1\"/></enum>\n"
+		"<import file=\"c.xml\"/>\n"
+		"<bitset name=\"a_bits\"><bitfield name=\"LO\" low=\"0\" high=\"7\"/><bitfield name=\"HI\" low=\"8\" high=\"15\" type=\"hex\"/></bitset>\n"
+		"</database>\n" },
+	{ "b.xml",
+		"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+		"<enum name=\"b_enum\"><value name=\"B_0\" value=\"0\"/>\n"
+		"</database>\n" },
+	{ "c.xml",
+		"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+		"<import file=\"a.xml\"/>\n"
+		"<domain name=\"C\" width=\"32\">\n"
+		"\t<array offset=\"0x100\" name=\"ARR\" stride=\"0x10\" length=\"4\"><reg32 offset=\"4\" name=\"R\" type=\"a_bits\"/></array>\n"
+		"</domain>\n"
+		"<enum name=\"a_enum\"><value name=\"A_2\" value=\"2\"/></enum>\n"
+		"</database>\n" },
+	{ "unused.xml",
+		"<database><unclosed>\n" },
+};
+
+static void dumpti (FILE *out, struct rnntypeinfo *ti, int depth);
+
+static void dumpelem (FILE *out, struct rnndelem *elem, int depth) {
+	int i;
+	fprintf(out, "%*selem %d %s %s %"PRIx64" %"PRIu64" %"PRIx64" %s\n", depth, "", elem->type, elem->name, elem->fullname,
+			elem->offset, elem->length, elem->stride, elem->file);
+	dumpti(out, &elem->typeinfo, depth + 1);
+	for (i = 0; i < elem->subelemsnum; i++)
+		dumpelem(out, elem->subelems[i], depth + 1);
+}
+
+static void dumpti (FILE *out, struct rnntypeinfo *ti, int depth) {
+	int i;
+	fprintf(out, "%*stype %d %s\n", depth, "", ti->type, ti->name);
+	for (i = 0; i < ti->valsnum; i++)
+		fprintf(out, "%*sval %s %"PRIx64" %s\n", depth, "", ti->vals[i]->name, ti->vals[i]->value, ti->vals[i]->file);
+	for (i = 0; i < ti->bitfieldsnum; i++) {
+		fprintf(out, "%*sbitfield %s %d %d %s\n", depth, "", ti->bitfields[i]->fullname,
+				ti->bitfields[i]->low, ti->bitfields[i]->high, ti->bitfields[i]->file);
+		dumpti(out, &ti->bitfields[i]->typeinfo, depth + 1);
+	}
+}
+
+/* loads file with the given number of jobs, returns everything printed and the database */
+static char *load (const char *file, int jobs) {
+	char *res;
+	size_t len;
+	FILE *out = open_memstream(&res, &len);
+	FILE *err = tmpfile();
+	struct rnndb *db = rnn_newdb();
+	int saved = dup(2);
+	int i, j;
+	char buf[0x1000];
+	fflush(stderr);
+	dup2(fileno(err), 2);
+	db->jobs = jobs;
+	rnn_parsefile(db, (char *)file);
+	rnn_prepdb(db);
+	fflush(stderr);
+	dup2(saved, 2);
+	close(saved);
+	rewind(err);
+	while ((len = fread(buf, 1, sizeof buf, err)))
+		fwrite(buf, 1, len, out);
+	fclose(err);
+	fprintf(out, "estatus %d\n", db->estatus);
+	for (i = 0; i < db->filesnum; i++)
+		fprintf(out, "file %s\n", db->files[i]);
+	for (i = 0; i < db->enumsnum; i++) {
+		fprintf(out, "enum %s %s\n", db->enums[i]->name, db->enums[i]->file);
+		for (j = 0; j < db->enums[i]->valsnum; j++)
+			fprintf(out, " val %s %"PRIx64" %s\n", db->enums[i]->vals[j]->name, db->enums[i]->vals[j]->value, db->enums[i]->vals[j]->file);
+	}
+	for (i = 0; i < db->bitsetsnum; i++) {
+		fprintf(out, "bitset %s %s\n", db->bitsets[i]->name, db->bitsets[i]->file);
+		for (j = 0; j < db->bitsets[i]->bitfieldsnum; j++)
+			fprintf(out, " bitfield %s %d %d\n", db->bitsets[i]->bitfields[j]->name, db->bitsets[i]->bitfields[j]->low, db->bitsets[i]->bitfields[j]->high);
+	}
+	for (i = 0; i < db->domainsnum; i++) {
+		fprintf(out, "domain %s %s\n", db->domains[i]->name, db->domains[i]->file);
+		for (j = 0; j < db->domains[i]->subelemsnum; j++)
+			dumpelem(out, db->domains[i]->subelems[j], 1);
+	}
+	fclose(out);
+	return res;
+}
+
+static int check (const char *file) {
+	char *serial = load(file, 1);
+	int jobs[] = { 0, 2, 8 };
+	int i, res = 0;
+	for (i = 0; i < ARRAY_SIZE(jobs); i++) {
+		char *par = load(file, jobs[i]);
+		if (strcmp(serial, par)) {
+			fprintf(stderr, "%s: %d jobs differ from serial\n--- serial:\n%s--- parallel:\n%s", file, jobs[i], serial, par);
+			res = 1;
+		}
+		free(par);
+	}
+	free(serial);
+	return res;
+}
+
+int main(int argc, char **argv) {
+	char dir[] = "/tmp/parsetestXXXXXX";
+	char *path;
+	int i, res = 0;
+	if (!mkdtemp(dir)) {
+		perror("mkdtemp");
+		return 1;
+	}
+	for (i = 0; i < ARRAY_SIZE(files); i++) {
+		char *name = aprintf("%s/%s", dir, files[i][0]);
+		FILE *f = fopen(name, "w");
+		fputs(files[i][1], f);
+		fclose(f);
+		free(name);
+	}
+	rnn_init();
+	path = getenv("RNN_PATH");
+	path = path ? strdup(path) : 0;
+	setenv("RNN_PATH", dir, 1);
+	res |= check("top.xml");
+	for (i = 0; i < ARRAY_SIZE(files); i++) {
+		char *name = aprintf("%s/%s", dir, files[i][0]);
+		unlink(name);
+		free(name);
+	}
+	rmdir(dir);
+	if (path)
+		setenv("RNN_PATH", path, 1);
+	else
+		unsetenv("RNN_PATH");
+	for (i = 1; i < argc; i++)
+		res |= check(argv[i]);
+	if (res)
+		return 1;
+	printf("All ok\n");
+	return 0;
+}
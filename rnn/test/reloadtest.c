@@ -0,0 +1,346 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Edits a generated database tree step by step, reloading it incrementally
+ * with rnn_reloaddb after each edit, and checks that every reload prints the
+ * same messages and gives the same prepared database as loading it from
+ * scratch.  Also checks that unchanged entities actually get reused.
+ */
+
+#include "rnn.h"
+#include "util.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static const char top[] =
+	"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+	"<import file=\"a.xml\"/>\n"
+	"<import file=\"b.xml\"/>\n"
+	"<import file=\"d.xml\"/>\n"
+	"<import file=\"e.xml\"/>\n"
+	"<enum name=\"chip\"><value name=\"C1\" value=\"1\"/><value name=\"C2\" value=\"2\"/><value name=\"C3\" value=\"3\"/></enum>\n"
+	"<group name=\"grp\"><reg32 offset=\"0\" name=\"G\" type=\"b_bits\"/></group>\n"
+	"<domain name=\"TOP\" width=\"32\" varset=\"chip\">\n"
+	"\t<reg32 offset=\"0x10\" name=\"CTRL\" type=\"a_enum\"/>\n"
+	"\t<array offset=\"0x100\" name=\"ARR\" stride=\"0x10\" length=\"4\" index=\"a_enum\"><use-group name=\"grp\"/></array>\n"
+	"\t<reg32 offset=\"0x20\" name=\"V\" variants=\"C2-\"/>\n"
+	"</domain>\n"
+	"</database>\n";
+
+static const char top_swapped[] =
+	"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+	"<import file=\"a.xml\"/>\n"
+	"<import file=\"b.xml\"/>\n"
+	"<import file=\"e.xml\"/>\n"
+	"<import file=\"d.xml\"/>\n"
+	"<enum name=\"chip\"><value name=\"C1\" value=\"1\"/><value name=\"C2\" value=\"2\"/><value name=\"C3\" value=\"3\"/></enum>\n"
+	"<group name=\"grp\"><reg32 offset=\"0\" name=\"G\" type=\"b_bits\"/></group>\n"
+	"<domain name=\"TOP\" width=\"32\" varset=\"chip\">\n"
+	"\t<reg32 offset=\"0x10\" name=\"CTRL\" type=\"a_enum\"/>\n"
+	"\t<array offset=\"0x100\" name=\"ARR\" stride=\"0x10\" length=\"4\" index=\"a_enum\"><use-group name=\"grp\"/></array>\n"
+	"\t<reg32 offset=\"0x20\" name=\"V\" variants=\"C2-\"/>\n"
+	"</domain>\n"
+	"</database>\n";
+
+static const char top_nob[] =
+	"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+	"<import file=\"a.xml\"/>\n"
+	"<import file=\"d.xml\"/>\n"
+	"<import file=\"e.xml\"/>\n"
+	"<enum name=\"chip\"><value name=\"C1\" value=\"1\"/><value name=\"C2\" value=\"2\"/><value name=\"C3\" value=\"3\"/></enum>\n"
+	"<domain name=\"TOP\" width=\"32\" varset=\"chip\">\n"
+	"\t<reg32 offset=\"0x10\" name=\"CTRL\" type=\"a_enum\"/>\n"
+	"</domain>\n"
+	"</database>\n";
+
+static const char a[] =
+	"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+	"<enum name=\"a_enum\"><value name=\"A_0\" value=\"0\"/><value name=\"A_1\" value=\"1\"/></enum>\n"
+	"<bitset name=\"a_bits\" inline=\"yes\"><bitfield name=\"LO\" low=\"0\" high=\"7\"/><bitfield name=\"HI\" low=\"8\" high=\"15\" type=\"hex\"/></bitset>\n"
+	"<domain name=\"A\" width=\"32\">\n"
+	"\t<reg32 offset=\"0x4\" name=\"R\" type=\"a_bits\"/>\n"
+	"</domain>\n"
+	"</database>\n";
+
+static const char a2[] =
+	"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+	"<enum name=\"a_enum\"><value name=\"A_0\" value=\"0\"/><value name=\"A_1\" value=\"1\"/><value name=\"A_2\" value=\"2\"/></enum>\n"
+	"<bitset name=\"a_bits\" inline=\"yes\"><bitfield name=\"LO\" low=\"0\" high=\"7\"/><bitfield name=\"HI\" low=\"8\" high=\"15\" type=\"hex\"/></bitset>\n"
+	"<domain name=\"A\" width=\"32\">\n"
+	"\t<reg32 offset=\"0x4\" name=\"R\" type=\"a_bits\"/>\n"
+	"</domain>\n"
+	"</database>\n";
+
+static const char a_broken[] =
+	"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+	"<enum name=\"a_enum\"><value name=\"A_0\" value=\"0\"/>\n"
+	"</database>\n";
+
+static const char b[] =
+	"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+	"<bitset name=\"b_bits\"><bitfield name=\"MODE\" low=\"0\" high=\"1\" type=\"a_enum\"/><bitfield name=\"EN\" pos=\"4\"/></bitset>\n"
+	"<enum name=\"b_only\"><value name=\"B_0\" value=\"0\"/></enum>\n"
+	"</database>\n";
+
+static const char b2[] =
+	"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+	"<bitset name=\"b_bits\"><bitfield name=\"MODE\" low=\"0\" high=\"1\" type=\"a_enum\"/><bitfield name=\"EN\" pos=\"4\"/></bitset>\n"
+	"<enum name=\"b_only\"><value name=\"B_0\" value=\"0\"/><value name=\"B_1\" value=\"1\"/></enum>\n"
+	"</database>\n";
+
+static const char b_bad[] =
+	"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+	"<bitset name=\"b_bits\"><bitfield name=\"MODE\" low=\"0\" high=\"1\" type=\"no_such_type\"/><bitfield name=\"EN\" pos=\"4\"/></bitset>\n"
+	"<enum name=\"b_only\" varset=\"chip\"><value name=\"B_0\" value=\"0\" variants=\"C9\"/></enum>\n"
+	"</database>\n";
+
+/* d.xml and e.xml each add a value to de_enum, and d.xml only sets the size of A */
+static const char d[] =
+	"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+	"<enum name=\"de_enum\"><value name=\"D\" value=\"0xd\"/></enum>\n"
+	"<domain name=\"A\" width=\"32\" size=\"0x100\"/>\n"
+	"</database>\n";
+
+static const char d2[] =
+	"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+	"<enum name=\"de_enum\"><value name=\"D\" value=\"0xd\"/></enum>\n"
+	"<domain name=\"A\" width=\"32\" size=\"0x200\"/>\n"
+	"</database>\n";
+
+static const char e[] =
+	"<database xmlns=\"http://nouveau.freedesktop.org/\">\n"
+	"<enum name=\"de_enum\"><value name=\"E\" value=\"0xe\"/></enum>\n"
+	"</database>\n";
+
+static const struct step {
+	const char *file;
+	const char *contents;
+	int minreused;	/* at least this many entities should be reused */
+} steps[] = {
+	/* the initial tree */
+	{ "top.xml", top },
+	{ "a.xml", a },
+	{ "b.xml", b },
+	{ "d.xml", d },
+	{ "e.xml", e },
+	/* b.xml holds b_bits and b_only, and TOP uses b_bits through grp */
+	{ "b.xml", b2, 4 },
+	{ "b.xml", b_bad, 4 },
+	/* the errors from b_bad should still be there */
+	{ "a.xml", a2, 1 },
+	{ "b.xml", b, 4 },
+	{ "a.xml", a_broken },
+	{ "a.xml", a },
+	/* changed file lists mean no reuse */
+	{ "top.xml", top_nob },
+	{ "top.xml", top },
+	{ "b.xml", b2, 4 },
+	/* same files, different order */
+	{ "top.xml", top_swapped },
+	{ "top.xml", top },
+	/* only the size of A changes */
+	{ "d.xml", d2, 6 },
+};
+
+#define INITIAL 5
+
+static char *dir;
+
+static void writefile (const char *file, const char *contents) {
+	char *name = aprintf("%s/%s", dir, file);
+	FILE *f = fopen(name, "w");
+	fputs(contents, f);
+	fclose(f);
+	free(name);
+}
+
+static void dumpti (FILE *out, struct rnndb *db, struct rnntypeinfo *ti, int depth);
+
+static void dumpvi (FILE *out, struct rnndb *db, struct rnnvarinfo *vi, int depth) {
+	int i, j;
+	fprintf(out, "%*svarinfo %d %s\n", depth, "", vi->dead, vi->prefix);
+	for (i = 0; i < vi->varsetsnum; i++) {
+		fprintf(out, "%*svarset %s%s", depth, "", vi->varsets[i]->venum->name,
+				vi->varsets[i]->venum == rnn_findenum(db, vi->varsets[i]->venum->name) ? "" : " (stale)");
+		for (j = 0; j < vi->varsets[i]->venum->valsnum; j++)
+			fprintf(out, " %d", vi->varsets[i]->variants[j]);
+		fprintf(out, "\n");
+	}
+}
+
+static void dumpelem (FILE *out, struct rnndb *db, struct rnndelem *elem, int depth) {
+	int i;
+	fprintf(out, "%*selem %d %s %s %"PRIx64" %"PRIu64" %"PRIx64" %s\n", depth, "", elem->type, elem->name, elem->fullname,
+			elem->offset, elem->length, elem->stride, elem->file);
+	if (elem->index)
+		fprintf(out, "%*sindex %s%s\n", depth, "", elem->index->name,
+				elem->index == rnn_findenum(db, elem->index->name) ? "" : " (stale)");
+	dumpvi(out, db, &elem->varinfo, depth + 1);
+	dumpti(out, db, &elem->typeinfo, depth + 1);
+	for (i = 0; i < elem->subelemsnum; i++)
+		dumpelem(out, db, elem->subelems[i], depth + 1);
+}
+
+static void dumpti (FILE *out, struct rnndb *db, struct rnntypeinfo *ti, int depth) {
+	int i;
+	fprintf(out, "%*stype %d %s\n", depth, "", ti->type, ti->name);
+	if (ti->eenum)
+		fprintf(out, "%*senum %s\n", depth, "", ti->eenum == rnn_findenum(db, ti->eenum->name) ? "ok" : "stale");
+	if (ti->ebitset)
+		fprintf(out, "%*sbitset %s\n", depth, "", ti->ebitset == rnn_findbitset(db, ti->ebitset->name) ? "ok" : "stale");
+	for (i = 0; i < ti->valsnum; i++)
+		fprintf(out, "%*sval %s %"PRIx64" %s\n", depth, "", ti->vals[i]->fullname, ti->vals[i]->value, ti->vals[i]->file);
+	for (i = 0; i < ti->bitfieldsnum; i++) {
+		fprintf(out, "%*sbitfield %s %d %d %s\n", depth, "", ti->bitfields[i]->fullname,
+				ti->bitfields[i]->low, ti->bitfields[i]->high, ti->bitfields[i]->file);
+		dumpti(out, db, &ti->bitfields[i]->typeinfo, depth + 1);
+	}
+}
+
+/* a full load without cache, or a reload into *pdb with it - returns everything printed and the database */
+static char *load (struct rnncache *cache, struct rnndb **pdb) {
+	char *res;
+	size_t len;
+	FILE *out = open_memstream(&res, &len);
+	FILE *err = tmpfile();
+	struct rnndb *db;
+	int saved = dup(2);
+	int i, j;
+	char buf[0x1000];
+	fflush(stderr);
+	dup2(fileno(err), 2);
+	if (cache) {
+		db = *pdb = rnn_reloaddb(cache, *pdb, "top.xml");
+	} else {
+		db = rnn_newdb();
+		rnn_parsefile(db, "top.xml");
+		rnn_prepdb(db);
+	}
+	fflush(stderr);
+	dup2(saved, 2);
+	close(saved);
+	rewind(err);
+	while ((len = fread(buf, 1, sizeof buf, err)))
+		fwrite(buf, 1, len, out);
+	fclose(err);
+	fprintf(out, "estatus %d\n", db->estatus);
+	for (i = 0; i < db->filesnum; i++)
+		fprintf(out, "file %s\n", db->files[i]);
+	for (i = 0; i < db->enumsnum; i++) {
+		struct rnnenum *en = db->enums[i];
+		fprintf(out, "enum %s %s %s\n", en->name, en->fullname, en->file);
+		dumpvi(out, db, &en->varinfo, 1);
+		for (j = 0; j < en->valsnum; j++) {
+			fprintf(out, " val %s %"PRIx64" %s\n", en->vals[j]->fullname, en->vals[j]->value, en->vals[j]->file);
+			dumpvi(out, db, &en->vals[j]->varinfo, 2);
+		}
+		if (!en->isinline)
+			fprintf(out, " first %d\n", rnn_valindex_first(en->vindex, 1));
+	}
+	for (i = 0; i < db->bitsetsnum; i++) {
+		struct rnnbitset *bs = db->bitsets[i];
+		fprintf(out, "bitset %s %s %s\n", bs->name, bs->fullname, bs->file);
+		for (j = 0; j < bs->bitfieldsnum; j++) {
+			fprintf(out, " bitfield %s %d %d\n", bs->bitfields[j]->fullname, bs->bitfields[j]->low, bs->bitfields[j]->high);
+			dumpti(out, db, &bs->bitfields[j]->typeinfo, 2);
+		}
+		if (bs->plan)
+			fprintf(out, " plan %d %"PRIx64"\n", bs->plan->fieldsnum, bs->plan->mask);
+	}
+	for (i = 0; i < db->domainsnum; i++) {
+		fprintf(out, "domain %s %s %"PRIx64" %s\n", db->domains[i]->name, db->domains[i]->fullname, db->domains[i]->size, db->domains[i]->file);
+		for (j = 0; j < db->domains[i]->subelemsnum; j++)
+			dumpelem(out, db, db->domains[i]->subelems[j], 1);
+	}
+	fclose(out);
+	return res;
+}
+
+int main(int argc, char **argv) {
+	char tmpl[] = "/tmp/reloadtestXXXXXX";
+	struct rnncache *cache;
+	struct rnndb *db = 0;
+	char *path;
+	int i, res = 0;
+	if (!(dir = mkdtemp(tmpl))) {
+		perror("mkdtemp");
+		return 1;
+	}
+	rnn_init();
+	path = getenv("RNN_PATH");
+	path = path ? strdup(path) : 0;
+	setenv("RNN_PATH", dir, 1);
+	cache = rnn_newcache();
+	for (i = 0; i < ARRAY_SIZE(steps); i++) {
+		char *full, *inc;
+		int changed;
+		writefile(steps[i].file, steps[i].contents);
+		if (i < INITIAL - 1)
+			continue;
+		changed = rnn_pollcache(cache);
+		if (i >= INITIAL && changed != 1) {
+			fprintf(stderr, "step %d: %d files changed, expected 1\n", i, changed);
+			res = 1;
+		}
+		full = load(0, 0);
+		inc = load(cache, &db);
+		if (strcmp(full, inc)) {
+			fprintf(stderr, "step %d: reload differs from full load\n--- full:\n%s--- reload:\n%s", i, full, inc);
+			res = 1;
+		}
+		if (cache->reused < steps[i].minreused) {
+			fprintf(stderr, "step %d: only %d entities reused, expected %d\n", i, cache->reused, steps[i].minreused);
+			res = 1;
+		}
+		if (i >= INITIAL && cache->parsed != 1) {
+			fprintf(stderr, "step %d: parsed %d files\n", i, cache->parsed);
+			res = 1;
+		}
+		free(full);
+		free(inc);
+		/* rewriting with the same contents doesn't count */
+		writefile(steps[i].file, steps[i].contents);
+		if ((changed = rnn_pollcache(cache))) {
+			fprintf(stderr, "step %d: %d files changed after rewriting\n", i, changed);
+			res = 1;
+		}
+	}
+	for (i = 0; i < INITIAL; i++) {
+		char *name = aprintf("%s/%s", dir, steps[i].file);
+		unlink(name);
+		free(name);
+	}
+	rmdir(dir);
+	if (path)
+		setenv("RNN_PATH", path, 1);
+	else
+		unsetenv("RNN_PATH");
+	if (res)
+		return 1;
+	printf("All ok\n");
+	return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Times decoding of wide bitset values through rnndec_decodeval (one heap
+ * string per call), rnndec_appendval into a reused buffer, and
+ * rnndec_appendval with a bitset plan, and checks that all three produce
+ * the same text.
+ */
+
+#include "rnndec.h"
+#include "util.h"
+#include <string.h>
+#include <time.h>
+
+static struct rnnvalue *mkval(char *name, uint64_t value) {
+	struct rnnvalue *v = calloc(sizeof *v, 1);
+	v->name = name;
+	v->value = value;
+	v->valvalid = 1;
+	return v;
+}
+
+static void addfield(struct rnntypeinfo *ti, char *name, int low, int high, enum rnnttype type) {
+	struct rnnbitfield *bf = calloc(sizeof *bf, 1);
+	bf->name = name;
+	bf->low = low;
+	bf->high = high;
+	bf->mask = bflmask(high - low + 1) << low;
+	bf->typeinfo.type = type;
+	if (type == RNN_TTYPE_INLINE_ENUM) {
+		ADDARRAY(bf->typeinfo.vals, mkval("ZERO", 0));
+		ADDARRAY(bf->typeinfo.vals, mkval("ONE", 1));
+		ADDARRAY(bf->typeinfo.vals, mkval("TWO", 2));
+		bf->typeinfo.vindex = rnn_valindex(bf->typeinfo.vals, bf->typeinfo.valsnum);
+	}
+	ADDARRAY(ti->bitfields, bf);
+}
+
+/* 64 one-bit flags */
+static void mkflags(struct rnntypeinfo *ti) {
+	static char names[64][8];
+	int i;
+	ti->type = RNN_TTYPE_INLINE_BITSET;
+	for (i = 0; i < 64; i++) {
+		sprintf(names[i], "BIT%d", i);
+		addfield(ti, names[i], i, i, RNN_TTYPE_BOOLEAN);
+	}
+}
+
+/* 2-bit fields of assorted types, leaving the top 8 bits undefined */
+static void mkmixed(struct rnntypeinfo *ti) {
+	static const enum rnnttype types[] = {
+		RNN_TTYPE_HEX, RNN_TTYPE_UINT, RNN_TTYPE_INT, RNN_TTYPE_INLINE_ENUM, RNN_TTYPE_BOOLEAN,
+	};
+	static char names[28][8];
+	int i;
+	ti->type = RNN_TTYPE_INLINE_BITSET;
+	for (i = 0; i < 28; i++) {
+		sprintf(names[i], "F%d", i);
+		addfield(ti, names[i], i * 2, i * 2 + 1, types[i % ARRAY_SIZE(types)]);
+	}
+}
+
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int bench(struct rnndeccontext *ctx, const char *name, struct rnntypeinfo *ti, int iters) {
+	struct rnndecbuf buf = { 0 }, pbuf = { 0 };
+	uint64_t value = 0x123456789abcdef0ull;
+	double t0, t1, t2, t3;
+	int i, res = 0;
+
+	/* check first, on a few different values */
+	for (i = 0; i < 64; i++) {
+		uint64_t v = value * (i + 1) ^ (uint64_t)i << 58;
+		char *str = rnndec_decodeval(ctx, ti, v, 64);
+		rnndec_bufclear(&buf);
+		rnndec_appendval(ctx, &buf, ti, v, 64);
+		ti->plan = rnn_bitplan(ti->bitfields, ti->bitfieldsnum);
+		rnndec_bufclear(&pbuf);
+		rnndec_appendval(ctx, &pbuf, ti, v, 64);
+		rnn_freebitplan(ti->plan);
+		ti->plan = 0;
+		if (strcmp(str, buf.str) || strcmp(str, pbuf.str)) {
+			fprintf(stderr, "%s: mismatch for %#"PRIx64":\n%s\n%s\n%s\n", name, v, str, buf.str, pbuf.str);
+			res = 1;
+		}
+		free(str);
+	}
+
+	t0 = now();
+	for (i = 0; i < iters; i++)
+		free(rnndec_decodeval(ctx, ti, value + i, 64));
+	t1 = now();
+	for (i = 0; i < iters; i++) {
+		rnndec_bufclear(&buf);
+		rnndec_appendval(ctx, &buf, ti, value + i, 64);
+	}
+	t2 = now();
+	ti->plan = rnn_bitplan(ti->bitfields, ti->bitfieldsnum);
+	for (i = 0; i < iters; i++) {
+		rnndec_bufclear(&buf);
+		rnndec_appendval(ctx, &buf, ti, value + i, 64);
+	}
+	t3 = now();
+	rnn_freebitplan(ti->plan);
+	ti->plan = 0;
+
+	printf("%-8s decodeval %8.1f ns   appendval %8.1f ns   planned %8.1f ns   (%zu chars)\n", name,
+		(t1 - t0) * 1e9 / iters, (t2 - t1) * 1e9 / iters, (t3 - t2) * 1e9 / iters, buf.len);
+	rnndec_buffree(&buf);
+	rnndec_buffree(&pbuf);
+	return res;
+}
+
+int main(int argc, char **argv) {
+	struct rnntypeinfo flags = { 0 }, mixed = { 0 };
+	int iters = argc > 1 ? atoi(argv[1]) : 100000;
+	struct rnndeccontext *ctx;
+	int res = 0;
+
+	rnn_init();
+	ctx = rnndec_newcontext(rnn_newdb());
+	mkflags(&flags);
+	mkmixed(&mixed);
+
+	res |= bench(ctx, "flags", &flags, iters);
+	res |= bench(ctx, "mixed", &mixed, iters);
+
+	ctx->colors = &envy_def_colors;
+	res |= bench(ctx, "flags/c", &flags, iters);
+	res |= bench(ctx, "mixed/c", &mixed, iters);
+	return res;
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright (C) 2013 The envytools authors
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+
+/*
+ * Converts mmiotrace, valgrind-mmt and msm register logs to the binary
+ * format of bintrace.h, which demmio, dedma and demsm read directly.
+ */
+
+#include "bintrace.h"
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+#include <getopt.h>
+
+static FILE *fout;
+
+static void emit(int type, int width, uint32_t map, uint64_t time, uint64_t addr, uint64_t value, const char *text, size_t textlen) {
+	struct bintrace_rec rec = { type, width, 0, map, time, addr, value };
+	if (textlen > UINT16_MAX)
+		textlen = UINT16_MAX;
+	rec.textlen = textlen;
+	if (bintrace_write(fout, &rec, text)) {
+		perror("write");
+		exit(1);
+	}
+}
+
+static void emit_text(int type, const char *line) {
+	emit(type, 0, 0, 0, 0, 0, line, strlen(line));
+}
+
+/* "sec.frac" to ns, exactly, so that demmio prints the same timestamps */
+static uint64_t parse_time(const char *str) {
+	uint64_t ns = strtoull(str, (char **)&str, 10) * 1000000000ull;
+	uint64_t scale = 100000000;
+	if (*str == '.')
+		for (str++; *str >= '0' && *str <= '9' && scale; str++, scale /= 10)
+			ns += (*str - '0') * scale;
+	return ns;
+}
+
+static void conv_mmiotrace(const char *line) {
+	char ts[64];
+	int width;
+	uint32_t map;
+	uint64_t addr, value;
+	if (!strncmp(line, "PCIDEV ", 7)) {
+		emit_text(BINTRACE_PCIDEV, line);
+	} else if ((!strncmp(line, "W ", 2) || !strncmp(line, "R ", 2)) &&
+			sscanf(line + 2, "%d %63s %"SCNu32" %"SCNx64" %"SCNx64, &width, ts, &map, &addr, &value) == 5) {
+		emit(line[0] == 'W' ? BINTRACE_WRITE : BINTRACE_READ, width, map, parse_time(ts), addr, value, 0, 0);
+	} else {
+		emit_text(BINTRACE_TEXT, line);
+	}
+}
+
+/* tokenized like dedma does it, so both decode the same; dedma only looks at the writes */
+static void conv_mmt(const char *line) {
+	struct bintrace_mmt mmt;
+	int i;
+	if (!bintrace_parse_mmt(line, &mmt))
+		return;
+	if (mmt.type == BINTRACE_OBJECT) {
+		emit(BINTRACE_OBJECT, 0, 0, 0, mmt.addr, mmt.val[0], 0, 0);
+		return;
+	}
+	for (i = 0; i < mmt.valsnum; i++)
+		emit(BINTRACE_WRITE, 4, mmt.map, 0, mmt.addr + 4 * i, mmt.val[i], 0, 0);
+}
+
+/* keep in sync with find_region and find_reg in demsm.c */
+static void conv_msm(const char *line) {
+	char name[17], *text;
+	const char *str;
+	uint32_t base, size, addr, val;
+	int op, n, m;
+
+	str = strstr(line, "IO:region");
+	if (str ? sscanf(str, "IO:region %16s %x %x", name, &base, &size) == 3 :
+			sscanf(line, "region %16s %x %x", name, &base, &size) == 3) {
+		emit_text(BINTRACE_REGION, line);
+		return;
+	}
+
+	if ((str = strstr(line, "IO:R")) || (str = strstr(line, "IO:W"))) {
+		op = str[3] == 'W';
+		n = str - line;
+		if (sscanf(str + 4, "%x %x%n", &addr, &val, &m) != 2) {
+			emit_text(BINTRACE_TEXT, line);
+			return;
+		}
+		m += n + 4;
+	} else if (sscanf(line, "%*x %*x %n%d %x %x%n", &n, &op, &addr, &val, &m) != 3) {
+		emit_text(BINTRACE_TEXT, line);
+		return;
+	}
+
+	/* the text around the access: prefix, NUL, suffix */
+	text = malloc(strlen(line) + 1);
+	memcpy(text, line, n);
+	text[n] = 0;
+	strcpy(text + n + 1, line + m);
+	emit(op == 1 ? BINTRACE_WRITE : BINTRACE_READ, 4, 0, 0, addr, val, text, n + 1 + strlen(line + m));
+	free(text);
+}
+
+int main(int argc, char **argv) {
+	static const struct {
+		const char *name;
+		int kind;
+		void (*conv)(const char *line);
+	} kinds[] = {
+		{ "mmiotrace", BINTRACE_MMIOTRACE, conv_mmiotrace },
+		{ "mmt", BINTRACE_MMT, conv_mmt },
+		{ "msm", BINTRACE_MSM, conv_msm },
+	};
+	FILE *fin = stdin;
+	char *line = 0;
+	size_t linesz = 0;
+	int c, i, k = -1;
+
+	fout = stdout;
+	while ((c = getopt (argc, argv, "t:f:o:")) != -1) {
+		switch (c) {
+			case 't':
+				for (i = 0; i < sizeof kinds / sizeof kinds[0]; i++)
+					if (!strcmp(optarg, kinds[i].name))
+						k = i;
+				break;
+			case 'f':
+				fin = fopen(optarg, "r");
+				if (!fin) {
+					perror(optarg);
+					return 1;
+				}
+				break;
+			case 'o':
+				fout = fopen(optarg, "w");
+				if (!fout) {
+					perror(optarg);
+					return 1;
+				}
+				break;
+			default:
+				k = -1;
+				optind = argc;
+				break;
+		}
+	}
+	if (k == -1) {
+		fprintf(stderr, "usage: %s -t mmiotrace|mmt|msm [-f input] [-o output]\n", argv[0]);
+		return 1;
+	}
+
+	if (bintrace_write_header(fout, kinds[k].kind)) {
+		perror("write");
+		return 1;
+	}
+	while (getline(&line, &linesz, fin) != -1)
+		kinds[k].conv(line);
+	free(line);
+
+	if (fclose(fout)) {
+		perror("write");
+		return 1;
+	}
+	return 0;
+}